@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 #include "common.h"
 #include "log.h"
+#include "media_clock.h"
 #include "rkaudio_mp3.h"
 #include "rtsp.h"
 #include "storage.h"
@@ -95,16 +96,14 @@ void *save_aenc_thread(void *ptr) {
 			if (buffer) {
 				// LOG_INFO("get frame data = %p, size = %d, pts is %lld, seq is %d\n", buffer,
 				//          pstStream.u32Len, pstStream.u64TimeStamp, pstStream.u32Seq);
+				// every consumer gets it on the video clock, drift corrected
+				int64_t pts = rk_media_clock_map(RK_MEDIA_CLOCK_AUDIO, pstStream.u64TimeStamp);
 				if (!strcmp(encode_type, "MP2") || !strcmp(encode_type, "MP3")) {
-					rk_storage_write_audio_frame(0, buffer, pstStream.u32Len,
-					                             pstStream.u64TimeStamp);
-					rk_storage_write_audio_frame(1, buffer, pstStream.u32Len,
-					                             pstStream.u64TimeStamp);
-					rk_storage_write_audio_frame(2, buffer, pstStream.u32Len,
-					                             pstStream.u64TimeStamp);
+					rk_storage_write_audio_frame(0, buffer, pstStream.u32Len, pts);
+					rk_storage_write_audio_frame(1, buffer, pstStream.u32Len, pts);
+					rk_storage_write_audio_frame(2, buffer, pstStream.u32Len, pts);
 				} else if (!strcmp(encode_type, "G711A")) {
-					rkipc_rtsp_write_audio_frame(0, buffer, pstStream.u32Len,
-					                             pstStream.u64TimeStamp);
+					rkipc_rtsp_write_audio_frame(0, buffer, pstStream.u32Len, pts);
 				}
 				// if (file) {
 				// 	fwrite(buffer, pstStream.u32Len, 1, file);
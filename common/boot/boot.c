@@ -0,0 +1,281 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "boot.h"
+#include "common.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "boot.c"
+
+#define RK_BOOT_READY_POLL_MS 50
+
+typedef enum {
+	RK_BOOT_PENDING = 0,
+	RK_BOOT_RUNNING,
+	RK_BOOT_READY,
+	RK_BOOT_FAILED,  // init returned an error
+	RK_BOOT_TIMEOUT, // the ready probe did not pass in time
+} rk_boot_state;
+
+typedef struct {
+	char name[32];
+	int deps[RK_BOOT_MAX_NODE];
+	int dep_num;
+	char dep_names[128];
+	rk_boot_init_func init;
+	void *init_arg;
+	rk_boot_ready_func ready;
+	void *ready_arg;
+	int ready_timeout_ms;
+	rk_boot_state state;
+	pthread_t tid;
+	// relative to rk_boot_run
+	long long start_ms;
+	long long init_done_ms;
+	long long ready_ms;
+} rk_boot_node_s;
+
+static const char *state_name[] = {"pending", "running", "ready", "failed", "timeout"};
+static rk_boot_node_s g_boot_node[RK_BOOT_MAX_NODE];
+static int g_boot_node_num;
+static long long g_boot_begin_ms;
+static long long g_boot_total_ms;
+static pthread_mutex_t g_boot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_boot_cond = PTHREAD_COND_INITIALIZER;
+
+static int rk_boot_find(const char *name) {
+	for (int i = 0; i < g_boot_node_num; i++) {
+		if (!strcmp(g_boot_node[i].name, name))
+			return i;
+	}
+	return -1;
+}
+
+int rk_boot_add(const char *name, const char *deps, rk_boot_init_func init, void *arg) {
+	RKIPC_CHECK_POINTER(name, -1);
+	if (g_boot_node_num >= RK_BOOT_MAX_NODE || rk_boot_find(name) >= 0) {
+		LOG_ERROR("add node %s fail\n", name);
+		return -1;
+	}
+	rk_boot_node_s *node = &g_boot_node[g_boot_node_num];
+	memset(node, 0, sizeof(*node));
+	snprintf(node->name, sizeof(node->name), "%s", name);
+	if (deps)
+		snprintf(node->dep_names, sizeof(node->dep_names), "%s", deps);
+	node->init = init;
+	node->init_arg = arg;
+	g_boot_node_num++;
+
+	return 0;
+}
+
+int rk_boot_set_ready(const char *name, rk_boot_ready_func ready, void *arg, int timeout_ms) {
+	int id = rk_boot_find(name);
+	if (id < 0) {
+		LOG_ERROR("node %s not found\n", name);
+		return -1;
+	}
+	g_boot_node[id].ready = ready;
+	g_boot_node[id].ready_arg = arg;
+	g_boot_node[id].ready_timeout_ms = timeout_ms;
+
+	return 0;
+}
+
+// dependencies are resolved once every node is added, so the order of rk_boot_add is free
+static int rk_boot_resolve() {
+	char names[128];
+	char *saveptr = NULL;
+	for (int i = 0; i < g_boot_node_num; i++) {
+		rk_boot_node_s *node = &g_boot_node[i];
+		node->dep_num = 0;
+		snprintf(names, sizeof(names), "%s", node->dep_names);
+		for (char *tok = strtok_r(names, ", ", &saveptr); tok;
+		     tok = strtok_r(NULL, ", ", &saveptr)) {
+			int dep = rk_boot_find(tok);
+			if (dep < 0 || dep == i) {
+				LOG_ERROR("node %s: unknown dependency %s\n", node->name, tok);
+				return -1;
+			}
+			node->deps[node->dep_num++] = dep;
+		}
+	}
+	// a cycle would leave its nodes waiting forever, walk the graph once like a topological sort
+	int done[RK_BOOT_MAX_NODE] = {0};
+	for (int round = 0; round < g_boot_node_num; round++) {
+		int progress = 0;
+		for (int i = 0; i < g_boot_node_num; i++) {
+			if (done[i])
+				continue;
+			int ok = 1;
+			for (int j = 0; j < g_boot_node[i].dep_num; j++)
+				ok &= done[g_boot_node[i].deps[j]];
+			if (ok) {
+				done[i] = 1;
+				progress = 1;
+			}
+		}
+		if (!progress)
+			break;
+	}
+	for (int i = 0; i < g_boot_node_num; i++) {
+		if (!done[i]) {
+			LOG_ERROR("node %s is in a dependency cycle\n", g_boot_node[i].name);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void *rk_boot_node_thread(void *arg) {
+	rk_boot_node_s *node = (rk_boot_node_s *)arg;
+	char thread_name[16];
+	snprintf(thread_name, sizeof(thread_name), "Boot%.11s", node->name);
+	prctl(PR_SET_NAME, thread_name, 0, 0, 0);
+
+	// wait until every dependency finished, like the sequential init a failed one does not
+	// stop the rest, the camera should still come up as far as it can
+	pthread_mutex_lock(&g_boot_mutex);
+	for (;;) {
+		int done = 1;
+		for (int i = 0; i < node->dep_num; i++) {
+			if (g_boot_node[node->deps[i]].state <= RK_BOOT_RUNNING)
+				done = 0;
+		}
+		if (done)
+			break;
+		pthread_cond_wait(&g_boot_cond, &g_boot_mutex);
+	}
+	for (int i = 0; i < node->dep_num; i++) {
+		if (g_boot_node[node->deps[i]].state != RK_BOOT_READY)
+			LOG_WARN("%s: dependency %s is not ready\n", node->name,
+			         g_boot_node[node->deps[i]].name);
+	}
+	node->state = RK_BOOT_RUNNING;
+	node->start_ms = rkipc_get_curren_time_ms() - g_boot_begin_ms;
+	pthread_mutex_unlock(&g_boot_mutex);
+
+	rk_boot_state state = RK_BOOT_READY;
+	if (node->init && node->init(node->init_arg))
+		state = RK_BOOT_FAILED;
+	long long init_done_ms = rkipc_get_curren_time_ms() - g_boot_begin_ms;
+	if (state == RK_BOOT_READY && node->ready) {
+		long long deadline = rkipc_get_curren_time_ms() + node->ready_timeout_ms;
+		while (node->ready(node->ready_arg)) {
+			if (rkipc_get_curren_time_ms() >= deadline) {
+				LOG_ERROR("%s not ready after %d ms\n", node->name, node->ready_timeout_ms);
+				state = RK_BOOT_TIMEOUT;
+				break;
+			}
+			usleep(RK_BOOT_READY_POLL_MS * 1000);
+		}
+	}
+
+	pthread_mutex_lock(&g_boot_mutex);
+	node->init_done_ms = init_done_ms;
+	node->ready_ms = rkipc_get_curren_time_ms() - g_boot_begin_ms;
+	node->state = state;
+	pthread_cond_broadcast(&g_boot_cond);
+	pthread_mutex_unlock(&g_boot_mutex);
+	LOG_INFO("%s %s at %lld ms\n", node->name, state == RK_BOOT_READY ? "ready" : "failed",
+	         node->ready_ms);
+
+	return NULL;
+}
+
+int rk_boot_run() {
+	int ret = 0;
+	if (rk_boot_resolve())
+		return -1;
+
+	g_boot_begin_ms = rkipc_get_curren_time_ms();
+	for (int i = 0; i < g_boot_node_num; i++) {
+		if (pthread_create(&g_boot_node[i].tid, NULL, rk_boot_node_thread, &g_boot_node[i])) {
+			LOG_ERROR("create %s thread fail\n", g_boot_node[i].name);
+			pthread_mutex_lock(&g_boot_mutex);
+			g_boot_node[i].state = RK_BOOT_FAILED;
+			pthread_cond_broadcast(&g_boot_cond);
+			pthread_mutex_unlock(&g_boot_mutex);
+			g_boot_node[i].tid = 0;
+		}
+	}
+	for (int i = 0; i < g_boot_node_num; i++) {
+		if (g_boot_node[i].tid)
+			pthread_join(g_boot_node[i].tid, NULL);
+		if (g_boot_node[i].state != RK_BOOT_READY)
+			ret = -1;
+	}
+	g_boot_total_ms = rkipc_get_curren_time_ms() - g_boot_begin_ms;
+
+	LOG_INFO("boot over in %lld ms\n", g_boot_total_ms);
+	// start is the offset from boot begin, init and ready are the time spent in each phase
+	LOG_INFO("%-12s %8s %8s %8s  %-8s %s\n", "node", "start", "init", "ready", "state", "deps");
+	for (int i = 0; i < g_boot_node_num; i++) {
+		rk_boot_node_s *node = &g_boot_node[i];
+		LOG_INFO("%-12s %8lld %8lld %8lld  %-8s %s\n", node->name, node->start_ms,
+		         node->init_done_ms - node->start_ms, node->ready_ms - node->init_done_ms,
+		         state_name[node->state], node->dep_names);
+	}
+
+	return ret;
+}
+
+int rk_boot_get_stats(char *value, int size) {
+	RKIPC_CHECK_POINTER(value, -1);
+	pthread_mutex_lock(&g_boot_mutex);
+	int len = snprintf(value, size, "{\"total_ms\":%lld,\"nodes\":[", g_boot_total_ms);
+	for (int i = 0; i < g_boot_node_num && len < size; i++) {
+		rk_boot_node_s *node = &g_boot_node[i];
+		len += snprintf(value + len, size - len,
+		                "%s{\"name\":\"%s\",\"deps\":\"%s\",\"state\":\"%s\",\"start_ms\":%lld,"
+		                "\"init_done_ms\":%lld,\"ready_ms\":%lld}",
+		                i ? "," : "", node->name, node->dep_names, state_name[node->state],
+		                node->start_ms, node->init_done_ms, node->ready_ms);
+	}
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+	pthread_mutex_unlock(&g_boot_mutex);
+	if (len >= size) {
+		LOG_WARN("stats truncated, need %d bytes\n", len);
+		return -1;
+	}
+
+	return 0;
+}
+
+int rk_boot_probe_tcp(const char *ip, int port) {
+	struct sockaddr_in addr;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	inet_pton(AF_INET, ip, &addr.sin_addr);
+	int ret = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+	close(fd);
+
+	return ret ? -1 : 0;
+}
+
+int rk_boot_probe_unix(const char *path) {
+	struct sockaddr_un addr;
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+	int ret = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+	close(fd);
+
+	return ret ? -1 : 0;
+}
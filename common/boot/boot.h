@@ -0,0 +1,35 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_BOOT_H__
+#define __RKIPC_BOOT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RK_BOOT_MAX_NODE 16
+
+// return 0 on success
+typedef int (*rk_boot_init_func)(void *arg);
+// return 0 once the node is ready, polled until the timeout
+typedef int (*rk_boot_ready_func)(void *arg);
+
+// deps is a comma separated list of node names, NULL for none
+int rk_boot_add(const char *name, const char *deps, rk_boot_init_func init, void *arg);
+int rk_boot_set_ready(const char *name, rk_boot_ready_func ready, void *arg, int timeout_ms);
+// start every node in its own thread once all its dependencies finished, a failed dependency is
+// reported but does not stop its dependents. Return after all nodes finished, -1 if any failed
+int rk_boot_run();
+int rk_boot_get_stats(char *value, int size);
+
+// return 0 when a tcp connection to ip:port succeeds
+int rk_boot_probe_tcp(const char *ip, int port);
+// return 0 when the unix socket at path accepts a connection
+int rk_boot_probe_unix(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
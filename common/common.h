@@ -66,6 +66,12 @@
 		}                                                                                          \
 	} while (0)
 
+// rkmuxer ids, every muxer in the process needs its own
+#define RKIPC_MUXER_ID_STORAGE(id) (id)               // 0-3, record files of storage.N
+#define RKIPC_MUXER_ID_RTMP(id) ((id) + 4)            // 4-6, rtmp sessions
+#define RKIPC_MUXER_ID_STORAGE_STANDBY(id) ((id) + 7) // 7-10, next record file of a rotation
+#define RKIPC_MUXER_ID_EVENT 11                       // event clips
+
 void *rk_signal_create(int defval, int maxval);
 void rk_signal_destroy(void *sem);
 int rk_signal_wait(void *sem, int timeout);
@@ -0,0 +1,146 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "det_ring.h"
+#include "common.h"
+#include "media_clock.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "det_ring.c"
+
+// the writer side, the reader library is det_ring_reader.c
+static pthread_mutex_t g_det_ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static rk_det_ring_header_s *g_ring;
+static size_t g_ring_size;
+
+static int rk_det_ring_compatible(const rk_det_ring_header_s *header, uint32_t slot_count) {
+	return header->magic == RK_DET_RING_MAGIC && header->version == RK_DET_RING_VERSION &&
+	       header->slot_count == slot_count && header->slot_size == sizeof(rk_det_ring_slot_s);
+}
+
+// a ring of another geometry: tell its readers to reopen, then start a new file
+static int rk_det_ring_replace(const char *path, int fd, size_t old_size) {
+	if (old_size >= sizeof(rk_det_ring_header_s)) {
+		rk_det_ring_header_s *old = (rk_det_ring_header_s *)mmap(
+		    NULL, old_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (old != MAP_FAILED) {
+			__atomic_store_n(&old->magic, 0, __ATOMIC_RELEASE);
+			munmap(old, old_size);
+		}
+	}
+	close(fd);
+	unlink(path);
+
+	return open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+}
+
+int rk_det_ring_init() {
+	if (!rk_param_get_int("det_ring:enable", 0))
+		return 0;
+	const char *path = rk_param_get_string("det_ring:path", RK_DET_RING_PATH);
+	int slot_count = rk_param_get_int("det_ring:slot_count", 64);
+	if (slot_count < 2)
+		slot_count = 2;
+	size_t size = sizeof(rk_det_ring_header_s) + slot_count * sizeof(rk_det_ring_slot_s);
+
+	pthread_mutex_lock(&g_det_ring_mutex);
+	if (g_ring) {
+		pthread_mutex_unlock(&g_det_ring_mutex);
+		return 0;
+	}
+	struct stat st;
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd >= 0 && !fstat(fd, &st) && st.st_size && st.st_size != (off_t)size)
+		fd = rk_det_ring_replace(path, fd, st.st_size);
+	// readers map it read only, whatever the umask
+	if (fd < 0 || fchmod(fd, 0644) || ftruncate(fd, size)) {
+		LOG_ERROR("create %s fail, %s\n", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		pthread_mutex_unlock(&g_det_ring_mutex);
+		return -1;
+	}
+	rk_det_ring_header_s *ring = (rk_det_ring_header_s *)mmap(
+	    NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED) {
+		LOG_ERROR("mmap %s fail, %s\n", path, strerror(errno));
+		pthread_mutex_unlock(&g_det_ring_mutex);
+		return -1;
+	}
+	if (rk_det_ring_compatible(ring, slot_count)) {
+		// left by the previous run, a slot it died writing must not pass as a result
+		for (int i = 0; i < slot_count; i++) {
+			rk_det_ring_slot_s *slot = &ring->slot[i];
+			if (slot->seq & 1) {
+				slot->index = 0;
+				__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+			}
+		}
+	} else {
+		memset(ring, 0, size);
+		ring->version = RK_DET_RING_VERSION;
+		ring->slot_count = slot_count;
+		ring->slot_size = sizeof(rk_det_ring_slot_s);
+		__atomic_store_n(&ring->magic, RK_DET_RING_MAGIC, __ATOMIC_RELEASE);
+	}
+	__atomic_store_n(&ring->writer_pid, (int32_t)getpid(), __ATOMIC_RELEASE);
+	g_ring = ring;
+	g_ring_size = size;
+	pthread_mutex_unlock(&g_det_ring_mutex);
+	LOG_INFO("%s, %d slots, head %llu\n", path, slot_count, (unsigned long long)ring->head);
+
+	return 0;
+}
+
+int rk_det_ring_deinit() {
+	pthread_mutex_lock(&g_det_ring_mutex);
+	if (g_ring) {
+		// the file stays, readers keep their mapping and a restart continues it
+		__atomic_store_n(&g_ring->writer_pid, 0, __ATOMIC_RELEASE);
+		munmap(g_ring, g_ring_size);
+		g_ring = NULL;
+	}
+	pthread_mutex_unlock(&g_det_ring_mutex);
+
+	return 0;
+}
+
+int rk_det_ring_publish(int64_t pts, int width, int height, const rk_det_ring_object_s *objects,
+                        int count) {
+	if (count > 0)
+		RKIPC_CHECK_POINTER(objects, -1);
+	if (count > RK_DET_RING_MAX_OBJECT)
+		count = RK_DET_RING_MAX_OBJECT;
+	if (count < 0)
+		count = 0;
+
+	pthread_mutex_lock(&g_det_ring_mutex);
+	if (!g_ring) {
+		pthread_mutex_unlock(&g_det_ring_mutex);
+		return 0;
+	}
+	uint64_t index = g_ring->head + 1;
+	rk_det_ring_slot_s *slot = &g_ring->slot[index % g_ring->slot_count];
+	uint32_t seq = slot->seq;
+	// odd seq before any field changes, even seq after all of them
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->index = index;
+	slot->count = count;
+	slot->pts = pts;
+	slot->utc_ms = rk_media_clock_to_utc_ms(pts);
+	slot->width = width;
+	slot->height = height;
+	if (count)
+		memcpy(slot->object, objects, count * sizeof(objects[0]));
+	__atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&g_ring->head, index, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&g_det_ring_mutex);
+
+	return 0;
+}
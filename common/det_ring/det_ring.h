@@ -0,0 +1,85 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_DET_RING_H__
+#define __RKIPC_DET_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Every npu result in a file under /dev/shm that local processes map read only. rkipc is the
+// only writer, readers never block it and need no syscall per result. Each slot is a seqlock:
+// its seq is odd while rkipc writes it, a reader copies the slot and keeps the copy only when
+// seq was even and did not change meanwhile. head is the index of the latest complete result,
+// the result of index i lives in slot i % slot_count until slot_count newer ones overwrite it.
+// The file outlives rkipc, a restart with the same geometry keeps counting from its head.
+#define RK_DET_RING_PATH "/dev/shm/rkipc_det"
+#define RK_DET_RING_MAGIC 0x54454452 // "RDET"
+#define RK_DET_RING_VERSION 1
+#define RK_DET_RING_MAX_OBJECT 32
+
+typedef struct {
+	int32_t track_id; // 0 when the tracker did not run
+	int32_t class_id;
+	float confidence;
+	int32_t x, y, w, h; // pixels of the analysed frame
+} rk_det_ring_object_s;
+
+typedef struct {
+	uint32_t seq; // odd while written
+	uint32_t count;
+	uint64_t index;
+	int64_t pts;    // CLOCK_MONOTONIC in us of the analysed frame, as the encoded streams
+	int64_t utc_ms; // its capture time
+	uint32_t width, height;
+	rk_det_ring_object_s object[RK_DET_RING_MAX_OBJECT];
+} rk_det_ring_slot_s;
+
+typedef struct {
+	uint32_t magic; // cleared when rkipc replaces the file, readers must reopen then
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t slot_size;
+	int32_t writer_pid; // 0 while rkipc is not running
+	uint32_t reserved;
+	uint64_t head; // 0 before the first result
+	uint8_t pad[32];
+	rk_det_ring_slot_s slot[];
+} rk_det_ring_header_s;
+
+// reader library, plain C with no rkipc dependency, see det_ring_reader.c
+typedef struct {
+	size_t size;
+	const rk_det_ring_header_s *header;
+	uint64_t next; // index of the next result read returns
+	uint64_t lost; // results overwritten before this reader got to them
+} rk_det_ring_reader_s;
+
+// map the ring of path, RK_DET_RING_PATH when NULL, reading starts with the next result
+int rk_det_ring_open(rk_det_ring_reader_s *reader, const char *path);
+void rk_det_ring_close(rk_det_ring_reader_s *reader);
+// Copy the next result in order into slot. Return 1 on a result, 0 when there is no newer one
+// and -1 when the ring was replaced and has to be reopened. Results overwritten before they
+// were read are skipped and counted in lost
+int rk_det_ring_read(rk_det_ring_reader_s *reader, rk_det_ring_slot_s *slot);
+// same, skipping straight to the latest result
+int rk_det_ring_read_latest(rk_det_ring_reader_s *reader, rk_det_ring_slot_s *slot);
+// 1 while rkipc has the ring open
+int rk_det_ring_writer_alive(const rk_det_ring_reader_s *reader);
+
+// the rest is rkipc's side
+int rk_det_ring_init();
+int rk_det_ring_deinit();
+// publish one npu result, objects beyond RK_DET_RING_MAX_OBJECT are dropped
+int rk_det_ring_publish(int64_t pts, int width, int height, const rk_det_ring_object_s *objects,
+                        int count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,115 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Reader side of the detection ring, kept free of rkipc headers so that other processes can
+// build it as is:
+//
+//   $CC -c -Icommon/det_ring common/det_ring/det_ring_reader.c
+#include "det_ring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// a writer holds a slot for a memcpy, a slot still odd after this many tries belongs to a dead one
+#define RK_DET_RING_MAX_RETRY 1000
+
+int rk_det_ring_open(rk_det_ring_reader_s *reader, const char *path) {
+	struct stat st;
+	memset(reader, 0, sizeof(*reader));
+	int fd = open(path ? path : RK_DET_RING_PATH, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(rk_det_ring_header_s)) {
+		close(fd);
+		errno = ENODATA;
+		return -1;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+	const rk_det_ring_header_s *header = (const rk_det_ring_header_s *)map;
+	if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != RK_DET_RING_MAGIC ||
+	    header->version != RK_DET_RING_VERSION ||
+	    header->slot_size != sizeof(rk_det_ring_slot_s) || !header->slot_count ||
+	    st.st_size < (off_t)(sizeof(*header) + header->slot_count * sizeof(rk_det_ring_slot_s))) {
+		munmap(map, st.st_size);
+		errno = EPROTO;
+		return -1;
+	}
+	reader->size = st.st_size;
+	reader->header = header;
+	reader->next = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE) + 1;
+
+	return 0;
+}
+
+void rk_det_ring_close(rk_det_ring_reader_s *reader) {
+	if (reader->header)
+		munmap((void *)reader->header, reader->size);
+	memset(reader, 0, sizeof(*reader));
+}
+
+int rk_det_ring_writer_alive(const rk_det_ring_reader_s *reader) {
+	return reader->header && __atomic_load_n(&reader->header->writer_pid, __ATOMIC_ACQUIRE) != 0;
+}
+
+// a consistent copy of the slot of index, 0 when it holds another result by now
+static int rk_det_ring_copy(const rk_det_ring_header_s *header, uint64_t index,
+                            rk_det_ring_slot_s *out) {
+	const rk_det_ring_slot_s *slot = &header->slot[index % header->slot_count];
+	for (int retry = 0; retry < RK_DET_RING_MAX_RETRY; retry++) {
+		uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		memcpy(out, slot, sizeof(*out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq)
+			continue;
+		if (out->index != index)
+			return 0;
+		if (out->count > RK_DET_RING_MAX_OBJECT)
+			out->count = RK_DET_RING_MAX_OBJECT;
+		return 1;
+	}
+
+	return 0;
+}
+
+int rk_det_ring_read(rk_det_ring_reader_s *reader, rk_det_ring_slot_s *slot) {
+	const rk_det_ring_header_s *header = reader->header;
+	if (!header || __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != RK_DET_RING_MAGIC)
+		return -1;
+	uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+	while (reader->next <= head) {
+		// the older ones are overwritten already
+		if (head - reader->next >= header->slot_count) {
+			reader->lost += head - header->slot_count + 1 - reader->next;
+			reader->next = head - header->slot_count + 1;
+		}
+		if (rk_det_ring_copy(header, reader->next, slot)) {
+			reader->next++;
+			return 1;
+		}
+		reader->lost++;
+		reader->next++;
+	}
+
+	return 0;
+}
+
+int rk_det_ring_read_latest(rk_det_ring_reader_s *reader, rk_det_ring_slot_s *slot) {
+	const rk_det_ring_header_s *header = reader->header;
+	if (!header || __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != RK_DET_RING_MAGIC)
+		return -1;
+	uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+	// skipped on purpose, not lost
+	if (head > reader->next)
+		reader->next = head;
+
+	return rk_det_ring_read(reader, slot);
+}
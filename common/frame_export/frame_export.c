@@ -0,0 +1,460 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // struct ucred
+#endif
+#include "frame_export.h"
+#include "common.h"
+#include "lease.h"
+#include "socket.h"
+#include <poll.h>
+#include <sys/socket.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "frame_export.c"
+
+#define RK_FRAME_EXPORT_MAX_CLIENT 4
+#define RK_FRAME_EXPORT_MAX_CHN 4
+// every client can hold its maximum of the same frame or of different ones
+#define RK_FRAME_EXPORT_MAX_FRAME (RK_FRAME_EXPORT_MAX_CLIENT * RK_FRAME_EXPORT_MAX_HOLD)
+#define RK_FRAME_EXPORT_POLL_MS 100
+// from the vi get to the publish, and the expiry check only runs every poll
+#define RK_FRAME_EXPORT_LEASE_MARGIN_MS 1000
+
+typedef struct {
+	int used;
+	int chn;
+	uint32_t seq;
+	int lease;
+	int ref; // clients still holding it
+} rk_frame_export_slot_s;
+
+typedef struct {
+	int fd; // -1 when free
+	pid_t pid;
+	uid_t uid;
+	int chn; // -1 until subscribed
+	int max_hold;
+	int hold_count;
+	int hold[RK_FRAME_EXPORT_MAX_HOLD]; // slot index
+	long long hold_ms[RK_FRAME_EXPORT_MAX_HOLD];
+	unsigned char rbuf[sizeof(rk_frame_export_request_s)];
+	int rlen;
+	uint32_t dropped_since;
+	unsigned long long sent, returned, dropped;
+} rk_frame_export_client_s;
+
+static pthread_mutex_t g_export_mutex = PTHREAD_MUTEX_INITIALIZER;
+static rk_frame_export_client_s g_client[RK_FRAME_EXPORT_MAX_CLIENT];
+static rk_frame_export_slot_s g_slot[RK_FRAME_EXPORT_MAX_FRAME];
+static int g_chn[RK_FRAME_EXPORT_MAX_CHN], g_chn_count;
+static int g_export_enable, g_listen_fd = -1, g_return_timeout_ms, g_max_hold;
+static int g_lease_timeout_ms; // of a frame that may be exported, 0 for lease:timeout_ms
+static const char *g_allow_uid, *g_allow_gid, *g_path;
+static uint32_t g_seq;
+static int g_export_run;
+static pthread_t g_export_tid;
+static unsigned long long g_refused, g_expired;
+
+// id is in the comma separated list
+static int rk_frame_export_id_allowed(const char *list, unsigned int id) {
+	const char *p = list;
+	while (p && *p) {
+		char *end;
+		unsigned long value = strtoul(p, &end, 10);
+		if (end != p && value == id)
+			return 1;
+		p = strchr(p, ',');
+		if (p)
+			p++;
+	}
+
+	return 0;
+}
+
+static void rk_frame_export_unref(int index) {
+	rk_frame_export_slot_s *slot = &g_slot[index];
+	if (--slot->ref > 0)
+		return;
+	rk_lease_release(slot->lease);
+	slot->used = 0;
+}
+
+static void rk_frame_export_drop_hold(rk_frame_export_client_s *client, int i) {
+	rk_frame_export_unref(client->hold[i]);
+	client->hold_count--;
+	client->hold[i] = client->hold[client->hold_count];
+	client->hold_ms[i] = client->hold_ms[client->hold_count];
+}
+
+static void rk_frame_export_close(rk_frame_export_client_s *client, const char *reason) {
+	LOG_INFO("client pid %d: %s, %d frames reclaimed, sent %llu, returned %llu, dropped %llu\n",
+	         client->pid, reason, client->hold_count, client->sent, client->returned,
+	         client->dropped);
+	while (client->hold_count)
+		rk_frame_export_drop_hold(client, 0);
+	close(client->fd);
+	client->fd = -1;
+}
+
+static int rk_frame_export_reply(rk_frame_export_client_s *client, int status) {
+	rk_frame_export_frame_s reply;
+	memset(&reply, 0, sizeof(reply));
+	reply.magic = RK_FRAME_EXPORT_MAGIC;
+	reply.status = status;
+	reply.chn = client->chn;
+
+	return sock_send_fd(client->fd, &reply, sizeof(reply), -1) == sizeof(reply) ? 0 : -1;
+}
+
+// frames of chn outside the vi queue, the media buffer planner reserves g_max_hold
+static int rk_frame_export_held(int chn) {
+	int held = 0;
+	for (int i = 0; i < RK_FRAME_EXPORT_MAX_FRAME; i++)
+		held += g_slot[i].used && g_slot[i].chn == chn;
+
+	return held;
+}
+
+static int rk_frame_export_has_channel(int chn) {
+	for (int i = 0; i < g_chn_count; i++) {
+		if (g_chn[i] == chn)
+			return 1;
+	}
+
+	return 0;
+}
+
+// one complete request, 0 to keep the client
+static int rk_frame_export_request(rk_frame_export_client_s *client,
+                                   const rk_frame_export_request_s *req) {
+	if (req->magic != RK_FRAME_EXPORT_MAGIC)
+		return -1;
+	if (req->cmd == RK_FRAME_EXPORT_SUBSCRIBE) {
+		int status = 0;
+		if (!rk_frame_export_has_channel(req->chn))
+			status = -EINVAL;
+		else if (client->hold_count)
+			status = -EBUSY; // return the frames of the old channel first
+		if (!status) {
+			client->chn = req->chn;
+			client->max_hold = req->count;
+			if (client->max_hold < 1)
+				client->max_hold = 1;
+			if (client->max_hold > g_max_hold)
+				client->max_hold = g_max_hold;
+			LOG_INFO("client pid %d subscribed vi chn %d, holds up to %d\n", client->pid,
+			         client->chn, client->max_hold);
+		}
+		return rk_frame_export_reply(client, status);
+	}
+	if (req->cmd == RK_FRAME_EXPORT_RETURN) {
+		for (int i = 0; i < client->hold_count; i++) {
+			if (g_slot[client->hold[i]].seq != req->seq)
+				continue;
+			rk_frame_export_drop_hold(client, i);
+			client->returned++;
+			return 0;
+		}
+		// already reclaimed, or never held
+		LOG_WARN("client pid %d returned unknown frame %u\n", client->pid, req->seq);
+		return 0;
+	}
+
+	return -1;
+}
+
+static void rk_frame_export_accept() {
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	int fd = serv_accept(g_listen_fd);
+	if (fd < 0)
+		return;
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len)) {
+		close(fd);
+		return;
+	}
+	// the socket is reachable by everyone, the credentials decide
+	if (!rk_frame_export_id_allowed(g_allow_uid, cred.uid) &&
+	    !rk_frame_export_id_allowed(g_allow_gid, cred.gid)) {
+		LOG_WARN("refuse pid %d, uid %d gid %d not allowed\n", cred.pid, cred.uid, cred.gid);
+		g_refused++;
+		close(fd);
+		return;
+	}
+	for (int i = 0; i < RK_FRAME_EXPORT_MAX_CLIENT; i++) {
+		rk_frame_export_client_s *client = &g_client[i];
+		if (client->fd >= 0)
+			continue;
+		memset(client, 0, sizeof(*client));
+		client->fd = fd;
+		client->pid = cred.pid;
+		client->uid = cred.uid;
+		client->chn = -1;
+		LOG_INFO("client pid %d uid %d connected\n", cred.pid, cred.uid);
+		return;
+	}
+	LOG_WARN("refuse pid %d, %d clients connected\n", cred.pid, RK_FRAME_EXPORT_MAX_CLIENT);
+	g_refused++;
+	close(fd);
+}
+
+static void rk_frame_export_read(rk_frame_export_client_s *client) {
+	int n = recv(client->fd, client->rbuf + client->rlen, sizeof(client->rbuf) - client->rlen,
+	             MSG_DONTWAIT);
+	if (n < 0 && (errno == EAGAIN || errno == EINTR))
+		return;
+	if (n <= 0) {
+		rk_frame_export_close(client, "disconnected");
+		return;
+	}
+	client->rlen += n;
+	if (client->rlen < (int)sizeof(client->rbuf))
+		return;
+	client->rlen = 0;
+	if (rk_frame_export_request(client, (const rk_frame_export_request_s *)client->rbuf))
+		rk_frame_export_close(client, "bad request");
+}
+
+static void *rk_frame_export_thread(void *arg) {
+	struct pollfd fds[RK_FRAME_EXPORT_MAX_CLIENT + 1];
+	int index[RK_FRAME_EXPORT_MAX_CLIENT + 1];
+	prctl(PR_SET_NAME, "RkipcFrameExp", 0, 0, 0);
+
+	while (g_export_run) {
+		int nfds = 0;
+		fds[nfds].fd = g_listen_fd;
+		fds[nfds].events = POLLIN;
+		index[nfds++] = -1;
+		pthread_mutex_lock(&g_export_mutex);
+		for (int i = 0; i < RK_FRAME_EXPORT_MAX_CLIENT; i++) {
+			if (g_client[i].fd < 0)
+				continue;
+			fds[nfds].fd = g_client[i].fd;
+			fds[nfds].events = POLLIN;
+			index[nfds++] = i;
+		}
+		pthread_mutex_unlock(&g_export_mutex);
+
+		int ret = poll(fds, nfds, RK_FRAME_EXPORT_POLL_MS);
+		pthread_mutex_lock(&g_export_mutex);
+		for (int i = 0; ret > 0 && i < nfds; i++) {
+			if (!fds[i].revents)
+				continue;
+			if (index[i] < 0)
+				rk_frame_export_accept();
+			else if (g_client[index[i]].fd == fds[i].fd)
+				rk_frame_export_read(&g_client[index[i]]);
+		}
+		// a frame kept too long starves the vi channel, take it back from a stuck client
+		long long now = rkipc_get_curren_time_ms();
+		for (int i = 0; i < RK_FRAME_EXPORT_MAX_CLIENT; i++) {
+			rk_frame_export_client_s *client = &g_client[i];
+			for (int j = 0; client->fd >= 0 && j < client->hold_count; j++) {
+				if (now - client->hold_ms[j] < g_return_timeout_ms)
+					continue;
+				g_expired++;
+				rk_frame_export_close(client, "frame not returned in time");
+			}
+		}
+		pthread_mutex_unlock(&g_export_mutex);
+	}
+
+	return NULL;
+}
+
+int rk_frame_export_init() {
+	g_export_enable = rk_param_get_int("frame_export:enable", 0);
+	if (!g_export_enable)
+		return 0;
+	g_path = rk_param_get_string("frame_export:path", RK_FRAME_EXPORT_PATH);
+	g_allow_uid = rk_param_get_string("frame_export:allow_uid", "0");
+	g_allow_gid = rk_param_get_string("frame_export:allow_gid", "");
+	g_return_timeout_ms = rk_param_get_int("frame_export:return_timeout_ms", 1000);
+	g_max_hold = rk_param_get_int("frame_export:max_hold", 2);
+	// the lease has to outlive the client's hold, or the reaper hands the frame back to vi
+	// while the client still has it mapped
+	int lease_ms = g_return_timeout_ms + RK_FRAME_EXPORT_LEASE_MARGIN_MS;
+	g_lease_timeout_ms = lease_ms > rk_param_get_int("lease:timeout_ms", 3000) ? lease_ms : 0;
+	if (g_max_hold < 1 || g_max_hold > RK_FRAME_EXPORT_MAX_HOLD)
+		g_max_hold = RK_FRAME_EXPORT_MAX_HOLD;
+	pthread_mutex_lock(&g_export_mutex);
+	for (int i = 0; i < RK_FRAME_EXPORT_MAX_CLIENT; i++)
+		g_client[i].fd = -1;
+	memset(g_slot, 0, sizeof(g_slot));
+	g_chn_count = 0;
+	g_refused = g_expired = 0;
+	pthread_mutex_unlock(&g_export_mutex);
+
+	g_listen_fd = serv_listen(g_path);
+	if (g_listen_fd < 0) {
+		LOG_ERROR("listen on %s fail, %s\n", g_path, strerror(errno));
+		return -1;
+	}
+	g_export_run = 1;
+	if (pthread_create(&g_export_tid, NULL, rk_frame_export_thread, NULL)) {
+		LOG_ERROR("create thread fail\n");
+		g_export_run = 0;
+		close(g_listen_fd);
+		g_listen_fd = -1;
+		return -1;
+	}
+	LOG_INFO("listen on %s, uid %s, gid %s, return timeout %d ms\n", g_path, g_allow_uid,
+	         g_allow_gid, g_return_timeout_ms);
+
+	return 0;
+}
+
+int rk_frame_export_deinit() {
+	if (!g_export_run)
+		return 0;
+	g_export_run = 0;
+	pthread_join(g_export_tid, NULL);
+	pthread_mutex_lock(&g_export_mutex);
+	for (int i = 0; i < RK_FRAME_EXPORT_MAX_CLIENT; i++) {
+		if (g_client[i].fd >= 0)
+			rk_frame_export_close(&g_client[i], "exporter stopped");
+	}
+	g_chn_count = 0;
+	pthread_mutex_unlock(&g_export_mutex);
+	close(g_listen_fd);
+	g_listen_fd = -1;
+	unlink(g_path);
+
+	return 0;
+}
+
+int rk_frame_export_add_channel(int chn) {
+	if (!g_export_run)
+		return 0;
+	pthread_mutex_lock(&g_export_mutex);
+	if (!rk_frame_export_has_channel(chn) && g_chn_count < RK_FRAME_EXPORT_MAX_CHN)
+		g_chn[g_chn_count++] = chn;
+	pthread_mutex_unlock(&g_export_mutex);
+	LOG_INFO("vi chn %d can be subscribed\n", chn);
+
+	return 0;
+}
+
+int rk_frame_export_lease_timeout_ms(int chn) {
+	int timeout_ms = 0;
+	if (!g_export_run)
+		return 0;
+	pthread_mutex_lock(&g_export_mutex);
+	if (rk_frame_export_has_channel(chn))
+		timeout_ms = g_lease_timeout_ms;
+	pthread_mutex_unlock(&g_export_mutex);
+
+	return timeout_ms;
+}
+
+int rk_frame_export_wanted(int chn) {
+	int wanted = 0;
+	if (!g_export_run)
+		return 0;
+	pthread_mutex_lock(&g_export_mutex);
+	if (rk_frame_export_held(chn) < g_max_hold) {
+		for (int i = 0; i < RK_FRAME_EXPORT_MAX_CLIENT && !wanted; i++) {
+			rk_frame_export_client_s *client = &g_client[i];
+			wanted = client->fd >= 0 && client->chn == chn &&
+			         client->hold_count < client->max_hold;
+		}
+	}
+	pthread_mutex_unlock(&g_export_mutex);
+
+	return wanted;
+}
+
+int rk_frame_export_publish(int chn, int dma_fd, const rk_frame_export_frame_s *frame,
+                            int lease) {
+	RKIPC_CHECK_POINTER(frame, -1);
+	int index = -1;
+	if (!g_export_run || dma_fd < 0 || lease <= 0)
+		return -1;
+
+	pthread_mutex_lock(&g_export_mutex);
+	for (int i = 0; i < RK_FRAME_EXPORT_MAX_FRAME; i++) {
+		if (!g_slot[i].used) {
+			index = i;
+			break;
+		}
+	}
+	// the vi queue of chn must keep its own buffers
+	if (index < 0 || rk_frame_export_held(chn) >= g_max_hold) {
+		pthread_mutex_unlock(&g_export_mutex);
+		return -1;
+	}
+	rk_frame_export_slot_s *slot = &g_slot[index];
+	slot->chn = chn;
+	slot->seq = ++g_seq;
+	slot->lease = lease;
+	slot->ref = 0;
+	long long now = rkipc_get_curren_time_ms();
+	for (int i = 0; i < RK_FRAME_EXPORT_MAX_CLIENT; i++) {
+		rk_frame_export_client_s *client = &g_client[i];
+		if (client->fd < 0 || client->chn != chn)
+			continue;
+		if (client->hold_count >= client->max_hold) {
+			client->dropped++;
+			client->dropped_since++;
+			continue;
+		}
+		rk_frame_export_frame_s msg = *frame;
+		msg.magic = RK_FRAME_EXPORT_MAGIC;
+		msg.status = 0;
+		msg.seq = slot->seq;
+		msg.chn = chn;
+		msg.dropped = client->dropped_since;
+		int ret = sock_send_fd(client->fd, &msg, sizeof(msg), dma_fd);
+		if (ret == SOCKERR_TIMEOUT) {
+			// its socket buffer is full, it is not reading
+			client->dropped++;
+			client->dropped_since++;
+			continue;
+		}
+		if (ret != sizeof(msg)) {
+			rk_frame_export_close(client, "send fail");
+			continue;
+		}
+		client->hold[client->hold_count] = index;
+		client->hold_ms[client->hold_count] = now;
+		client->hold_count++;
+		client->dropped_since = 0;
+		client->sent++;
+		slot->ref++;
+	}
+	// a client may return the frame as soon as the lock is released
+	int taken = slot->used = slot->ref > 0;
+	pthread_mutex_unlock(&g_export_mutex);
+
+	return taken ? 0 : -1;
+}
+
+int rk_frame_export_get_stats(char *value, int size) {
+	RKIPC_CHECK_POINTER(value, -1);
+	int len = 0;
+	pthread_mutex_lock(&g_export_mutex);
+	len += snprintf(value + len, size - len,
+	                "{\"enable\":%d,\"refused\":%llu,\"expired\":%llu,\"clients\":[",
+	                g_export_run, g_refused, g_expired);
+	for (int i = 0, n = 0; g_export_run && i < RK_FRAME_EXPORT_MAX_CLIENT && len < size; i++) {
+		rk_frame_export_client_s *client = &g_client[i];
+		if (client->fd < 0)
+			continue;
+		len += snprintf(value + len, size - len,
+		                "%s{\"pid\":%d,\"uid\":%d,\"chn\":%d,\"hold\":%d,\"max_hold\":%d,"
+		                "\"sent\":%llu,\"returned\":%llu,\"dropped\":%llu}",
+		                n++ ? "," : "", client->pid, client->uid, client->chn,
+		                client->hold_count, client->max_hold, client->sent, client->returned,
+		                client->dropped);
+	}
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+	pthread_mutex_unlock(&g_export_mutex);
+
+	return len < size ? 0 : -1;
+}
@@ -0,0 +1,76 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_FRAME_EXPORT_H__
+#define __RKIPC_FRAME_EXPORT_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Raw vi frames for processes outside rkipc, without a copy. A client connects to the unix
+// socket, subscribes to one vi channel and then gets one rk_frame_export_frame_s per frame
+// with the dma-buf fd of the frame attached as SCM_RIGHTS. The buffer stays out of the vi
+// queue until the client returns the frame by its seq. A client holding a frame longer than
+// frame_export:return_timeout_ms is disconnected and its frames are reclaimed, after that
+// the fds it still has may be overwritten at any time.
+#define RK_FRAME_EXPORT_PATH "/var/tmp/rkipc_frame"
+#define RK_FRAME_EXPORT_MAGIC 0x52464531 // "RFE1"
+#define RK_FRAME_EXPORT_MAX_HOLD 4
+#define RK_FRAME_EXPORT_FOURCC_NV12 0x3231564e
+
+typedef enum {
+	RK_FRAME_EXPORT_SUBSCRIBE = 1, // chn, and the frames the client may hold at once in count
+	RK_FRAME_EXPORT_RETURN,        // seq of a frame the client is done with
+} rk_frame_export_cmd;
+
+// client to rkipc
+typedef struct {
+	uint32_t magic;
+	uint32_t cmd;
+	int32_t chn;
+	uint32_t count;
+	uint32_t seq;
+	uint32_t reserved;
+} rk_frame_export_request_s;
+
+// rkipc to client, the subscribe reply has status set and no fd
+typedef struct {
+	uint32_t magic;
+	int32_t status; // 0, or -errno when the subscription was refused
+	uint32_t seq;
+	int32_t chn;
+	uint32_t width;
+	uint32_t height;
+	uint32_t hor_stride;
+	uint32_t ver_stride;
+	uint32_t fourcc;
+	uint32_t size;    // bytes to mmap
+	int64_t pts;      // CLOCK_MONOTONIC in us, as the encoded streams
+	uint32_t dropped; // frames skipped for this client since the previous one
+	uint32_t reserved;
+} rk_frame_export_frame_s;
+
+// the rest is rkipc's side
+int rk_frame_export_init();
+// return every held frame and disconnect the clients
+int rk_frame_export_deinit();
+// allow subscriptions to a vi channel whose frames will be published
+int rk_frame_export_add_channel(int chn);
+// the timeout_ms for the lease of a vi frame of chn, 0 when the default outlasts a client's hold
+int rk_frame_export_lease_timeout_ms(int chn);
+// a client of chn has room for one more frame, lets the caller skip filling a frame
+int rk_frame_export_wanted(int chn);
+// Offer a frame to the clients of chn. On 0 the exporter owns lease, a lease handle of the
+// frame, and releases it once every client returned it. On -1 no client took the frame and
+// lease still belongs to the caller
+int rk_frame_export_publish(int chn, int dma_fd, const rk_frame_export_frame_s *frame, int lease);
+int rk_frame_export_get_stats(char *value, int size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,950 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "hls.h"
+#include "common.h"
+#include "media_clock.h"
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "hls.c"
+
+#define RK_HLS_MAX_STREAM 3
+#define RK_HLS_MAX_SAMPLE 128 // per part
+#define RK_HLS_MAX_NAL 64     // per frame, the low latency streams have many slices
+#define RK_HLS_MAX_PART 48    // per segment
+#define RK_HLS_MAX_SEGMENT 24 // the playlist window and the files still on disk
+#define RK_HLS_MAX_PARAM_SET 256
+#define RK_HLS_TIMESCALE 90000
+#define RK_HLS_PART_SEGMENTS 3 // segments whose parts are still listed
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+typedef struct {
+	unsigned char *data;
+	int len;
+	int cap;
+	int error;
+} rk_hls_buf_s;
+
+typedef struct {
+	rk_packet_s *packet;
+	int64_t dts; // in RK_HLS_TIMESCALE from the stream origin
+	uint32_t duration;
+	uint32_t size; // length prefixed, parameter sets left out
+	int key;
+	int nal_count;
+	uint32_t nal_offset[RK_HLS_MAX_NAL];
+	uint32_t nal_size[RK_HLS_MAX_NAL];
+} rk_hls_sample_s;
+
+typedef struct {
+	unsigned int msn;
+	int init_index;
+	int discontinuity;
+	int complete;
+	int64_t utc_ms;
+	uint32_t duration;
+	int part_count;
+	uint32_t part_duration[RK_HLS_MAX_PART];
+	unsigned char part_independent[RK_HLS_MAX_PART];
+} rk_hls_segment_s;
+
+typedef struct {
+	int enable;
+	int id;
+	int hevc;
+	char dir[192];
+	// parameter sets of the current init segment, vps for hevc only
+	unsigned char param_set[3][RK_HLS_MAX_PARAM_SET];
+	int param_set_len[3];
+	int init_index; // 0 until the first key frame
+	int64_t origin_pts;
+	// the last frame waits for the next one, which gives its duration
+	rk_hls_sample_s pending;
+	int have_pending;
+	uint32_t last_duration;
+	rk_hls_sample_s part[RK_HLS_MAX_SAMPLE];
+	int part_count;
+	int64_t part_start;
+	int64_t segment_start;
+	int segment_open;
+	int segment_fd;
+	int next_discontinuity;
+	unsigned int msn;
+	unsigned int sequence;
+	rk_hls_segment_s segment[RK_HLS_MAX_SEGMENT];
+	unsigned int playlist_first;
+	unsigned int discontinuity_sequence;
+	int oldest_init;
+	uint32_t max_segment_duration;
+	unsigned long long parts, segments, bytes, skipped, write_errors;
+} rk_hls_stream_s;
+
+static pthread_mutex_t g_hls_mutex = PTHREAD_MUTEX_INITIALIZER;
+static rk_hls_stream_s g_hls_stream[RK_HLS_MAX_STREAM];
+static int g_hls_enable;
+static char g_hls_path[128];
+static int g_segment_ms, g_part_ms, g_playlist_segments;
+
+// ---- boxes ----
+
+static void rk_hls_put(rk_hls_buf_s *buf, const void *data, int len) {
+	if (buf->error)
+		return;
+	if (buf->len + len > buf->cap) {
+		int cap = (buf->len + len) * 2 + 256;
+		unsigned char *p = (unsigned char *)realloc(buf->data, cap);
+		if (!p) {
+			buf->error = 1;
+			return;
+		}
+		buf->data = p;
+		buf->cap = cap;
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+}
+
+static void rk_hls_put8(rk_hls_buf_s *buf, uint8_t v) { rk_hls_put(buf, &v, 1); }
+
+static void rk_hls_put16(rk_hls_buf_s *buf, uint16_t v) {
+	uint8_t b[2] = {(uint8_t)(v >> 8), (uint8_t)v};
+	rk_hls_put(buf, b, 2);
+}
+
+static void rk_hls_put32(rk_hls_buf_s *buf, uint32_t v) {
+	uint8_t b[4] = {(uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v};
+	rk_hls_put(buf, b, 4);
+}
+
+static void rk_hls_put64(rk_hls_buf_s *buf, uint64_t v) {
+	rk_hls_put32(buf, (uint32_t)(v >> 32));
+	rk_hls_put32(buf, (uint32_t)v);
+}
+
+static void rk_hls_zero(rk_hls_buf_s *buf, int len) {
+	while (len-- > 0)
+		rk_hls_put8(buf, 0);
+}
+
+static void rk_hls_printf(rk_hls_buf_s *buf, const char *fmt, ...) {
+	char line[256];
+	va_list args;
+	va_start(args, fmt);
+	int len = vsnprintf(line, sizeof(line), fmt, args);
+	va_end(args);
+	rk_hls_put(buf, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+}
+
+// return the offset of the box, its size is set by rk_hls_box_close
+static int rk_hls_box_open(rk_hls_buf_s *buf, const char *type) {
+	int at = buf->len;
+	rk_hls_put32(buf, 0);
+	rk_hls_put(buf, type, 4);
+	return at;
+}
+
+static int rk_hls_full_box_open(rk_hls_buf_s *buf, const char *type, int version,
+                                uint32_t flags) {
+	int at = rk_hls_box_open(buf, type);
+	rk_hls_put32(buf, (uint32_t)version << 24 | flags);
+	return at;
+}
+
+static void rk_hls_box_close(rk_hls_buf_s *buf, int at) {
+	if (buf->error)
+		return;
+	uint32_t size = buf->len - at;
+	buf->data[at] = size >> 24;
+	buf->data[at + 1] = size >> 16;
+	buf->data[at + 2] = size >> 8;
+	buf->data[at + 3] = size;
+}
+
+static void rk_hls_put_matrix(rk_hls_buf_s *buf) {
+	const uint32_t matrix[9] = {0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000};
+	for (int i = 0; i < 9; i++)
+		rk_hls_put32(buf, matrix[i]);
+}
+
+// ---- annex b ----
+
+static int rk_hls_nal_type(const rk_hls_stream_s *stream, const unsigned char *nal) {
+	return stream->hevc ? (nal[0] >> 1) & 0x3f : nal[0] & 0x1f;
+}
+
+// 0 vps, 1 sps, 2 pps, 3 access unit delimiter, -1 for the nal units that go in the samples
+static int rk_hls_nal_class(const rk_hls_stream_s *stream, const unsigned char *nal) {
+	int type = rk_hls_nal_type(stream, nal);
+	if (stream->hevc)
+		return type >= 32 && type <= 35 ? type - 32 : -1;
+	if (type == 7 || type == 8)
+		return type - 6;
+	return type == 9 ? 3 : -1;
+}
+
+// the nal units of the frame without their start codes, -1 when there are too many
+static int rk_hls_split(rk_hls_sample_s *sample) {
+	const unsigned char *data = sample->packet->data;
+	unsigned int len = sample->packet->len, i = 0, start = 0;
+	int found = 0;
+
+	sample->nal_count = 0;
+	while (i + 3 <= len) {
+		if (data[i] || data[i + 1] || data[i + 2] != 1) {
+			i++;
+			continue;
+		}
+		if (found) {
+			unsigned int end = i;
+			while (end > start && !data[end - 1])
+				end--;
+			if (end > start) {
+				if (sample->nal_count == RK_HLS_MAX_NAL)
+					return -1;
+				sample->nal_offset[sample->nal_count] = start;
+				sample->nal_size[sample->nal_count++] = end - start;
+			}
+		}
+		i += 3;
+		start = i;
+		found = 1;
+	}
+	if (found && len > start) {
+		if (sample->nal_count == RK_HLS_MAX_NAL)
+			return -1;
+		sample->nal_offset[sample->nal_count] = start;
+		sample->nal_size[sample->nal_count++] = len - start;
+	}
+
+	return sample->nal_count;
+}
+
+// ---- files ----
+
+static int rk_hls_writev(int fd, struct iovec *iov, int count) {
+	while (count > 0) {
+		int chunk = count < IOV_MAX ? count : IOV_MAX;
+		ssize_t ret = writev(fd, iov, chunk);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		// skip what went out, tmpfs writes it all at once anyway
+		while (count > 0 && (size_t)ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0 && ret) {
+			iov->iov_base = (char *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return 0;
+}
+
+// readers never see a half written file
+static int rk_hls_write_file(rk_hls_stream_s *stream, const char *name, struct iovec *iov,
+                             int count) {
+	char path[256], tmp[264];
+	snprintf(path, sizeof(path), "%s/%s", stream->dir, name);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return -1;
+	int ret = rk_hls_writev(fd, iov, count);
+	close(fd);
+	if (!ret)
+		ret = rename(tmp, path);
+	if (ret)
+		unlink(tmp);
+
+	return ret;
+}
+
+static void rk_hls_unlink(rk_hls_stream_s *stream, const char *fmt, ...) {
+	char name[64], path[256];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(name, sizeof(name), fmt, args);
+	va_end(args);
+	snprintf(path, sizeof(path), "%s/%s", stream->dir, name);
+	unlink(path);
+}
+
+static void rk_hls_write_error(rk_hls_stream_s *stream, const char *what) {
+	if (stream->write_errors++ % 100 == 0)
+		LOG_ERROR("stream %d: write %s fail, %s\n", stream->id, what, strerror(errno));
+}
+
+// ---- init segment ----
+
+static void rk_hls_put_avcc(rk_hls_stream_s *stream, rk_hls_buf_s *buf) {
+	const unsigned char *sps = stream->param_set[1], *pps = stream->param_set[2];
+	int at = rk_hls_box_open(buf, "avcC");
+	rk_hls_put8(buf, 1);
+	rk_hls_put(buf, sps + 1, 3); // profile, compatibility and level
+	rk_hls_put8(buf, 0xfc | 3);  // 4 byte lengths
+	rk_hls_put8(buf, 0xe0 | 1);
+	rk_hls_put16(buf, stream->param_set_len[1]);
+	rk_hls_put(buf, sps, stream->param_set_len[1]);
+	rk_hls_put8(buf, 1);
+	rk_hls_put16(buf, stream->param_set_len[2]);
+	rk_hls_put(buf, pps, stream->param_set_len[2]);
+	rk_hls_box_close(buf, at);
+}
+
+static void rk_hls_put_hvcc(rk_hls_stream_s *stream, rk_hls_buf_s *buf) {
+	unsigned char rbsp[16] = {0};
+	const unsigned char *sps = stream->param_set[1];
+	// the profile_tier_level of the sps without its emulation prevention bytes
+	for (int i = 0, n = 0, zeros = 0; i < stream->param_set_len[1] && n < 16; i++) {
+		if (zeros >= 2 && sps[i] == 3) {
+			zeros = 0;
+			continue;
+		}
+		zeros = sps[i] ? 0 : zeros + 1;
+		rbsp[n++] = sps[i];
+	}
+	const unsigned char *ptl = rbsp + 3;
+	int sub_layers = ((rbsp[2] >> 1) & 7) + 1;
+
+	int at = rk_hls_box_open(buf, "hvcC");
+	rk_hls_put8(buf, 1);
+	rk_hls_put(buf, ptl, 12); // profile space, tier, profile, compatibility, constraints, level
+	rk_hls_put16(buf, 0xf000);
+	rk_hls_put8(buf, 0xfc);
+	rk_hls_put8(buf, 0xfc | 1); // 4:2:0
+	rk_hls_put8(buf, 0xf8);     // 8 bit luma
+	rk_hls_put8(buf, 0xf8);     // 8 bit chroma
+	rk_hls_put16(buf, 0);
+	rk_hls_put8(buf, sub_layers << 3 | (rbsp[2] & 1) << 2 | 3);
+	rk_hls_put8(buf, 3);
+	for (int i = 0; i < 3; i++) {
+		rk_hls_put8(buf, 0x80 | (32 + i));
+		rk_hls_put16(buf, 1);
+		rk_hls_put16(buf, stream->param_set_len[i]);
+		rk_hls_put(buf, stream->param_set[i], stream->param_set_len[i]);
+	}
+	rk_hls_box_close(buf, at);
+}
+
+static void rk_hls_put_sample_entry(rk_hls_stream_s *stream, rk_hls_buf_s *buf, int width,
+                                    int height) {
+	int at = rk_hls_box_open(buf, stream->hevc ? "hvc1" : "avc1");
+	rk_hls_zero(buf, 6);
+	rk_hls_put16(buf, 1); // data reference index
+	rk_hls_zero(buf, 16);
+	rk_hls_put16(buf, width);
+	rk_hls_put16(buf, height);
+	rk_hls_put32(buf, 0x00480000);
+	rk_hls_put32(buf, 0x00480000);
+	rk_hls_put32(buf, 0);
+	rk_hls_put16(buf, 1);
+	rk_hls_zero(buf, 32);
+	rk_hls_put16(buf, 0x18);
+	rk_hls_put16(buf, 0xffff);
+	if (stream->hevc)
+		rk_hls_put_hvcc(stream, buf);
+	else
+		rk_hls_put_avcc(stream, buf);
+	rk_hls_box_close(buf, at);
+}
+
+static int rk_hls_write_init(rk_hls_stream_s *stream) {
+	char entry[64], name[32];
+	rk_hls_buf_s buf = {0};
+	snprintf(entry, sizeof(entry), "video.%d:width", stream->id);
+	int width = rk_param_get_int(entry, 1920);
+	snprintf(entry, sizeof(entry), "video.%d:height", stream->id);
+	int height = rk_param_get_int(entry, 1080);
+
+	int ftyp = rk_hls_box_open(&buf, "ftyp");
+	rk_hls_put(&buf, "iso6", 4);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put(&buf, "iso6cmfcmp41", 12);
+	rk_hls_box_close(&buf, ftyp);
+
+	int moov = rk_hls_box_open(&buf, "moov");
+	int mvhd = rk_hls_full_box_open(&buf, "mvhd", 0, 0);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put32(&buf, 1000);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put32(&buf, 0x00010000);
+	rk_hls_put16(&buf, 0x0100);
+	rk_hls_zero(&buf, 10);
+	rk_hls_put_matrix(&buf);
+	rk_hls_zero(&buf, 24);
+	rk_hls_put32(&buf, 2); // next track id
+	rk_hls_box_close(&buf, mvhd);
+
+	int trak = rk_hls_box_open(&buf, "trak");
+	int tkhd = rk_hls_full_box_open(&buf, "tkhd", 0, 3);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put32(&buf, 1); // track id
+	rk_hls_put32(&buf, 0);
+	rk_hls_put32(&buf, 0);
+	rk_hls_zero(&buf, 16);
+	rk_hls_put_matrix(&buf);
+	rk_hls_put32(&buf, (uint32_t)width << 16);
+	rk_hls_put32(&buf, (uint32_t)height << 16);
+	rk_hls_box_close(&buf, tkhd);
+
+	int mdia = rk_hls_box_open(&buf, "mdia");
+	int mdhd = rk_hls_full_box_open(&buf, "mdhd", 0, 0);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put32(&buf, RK_HLS_TIMESCALE);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put16(&buf, 0x55c4); // und
+	rk_hls_put16(&buf, 0);
+	rk_hls_box_close(&buf, mdhd);
+	int hdlr = rk_hls_full_box_open(&buf, "hdlr", 0, 0);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put(&buf, "vide", 4);
+	rk_hls_zero(&buf, 12);
+	rk_hls_put(&buf, "VideoHandler", 13);
+	rk_hls_box_close(&buf, hdlr);
+
+	int minf = rk_hls_box_open(&buf, "minf");
+	int vmhd = rk_hls_full_box_open(&buf, "vmhd", 0, 1);
+	rk_hls_zero(&buf, 8);
+	rk_hls_box_close(&buf, vmhd);
+	int dinf = rk_hls_box_open(&buf, "dinf");
+	int dref = rk_hls_full_box_open(&buf, "dref", 0, 0);
+	rk_hls_put32(&buf, 1);
+	rk_hls_box_close(&buf, rk_hls_full_box_open(&buf, "url ", 0, 1));
+	rk_hls_box_close(&buf, dref);
+	rk_hls_box_close(&buf, dinf);
+	int stbl = rk_hls_box_open(&buf, "stbl");
+	int stsd = rk_hls_full_box_open(&buf, "stsd", 0, 0);
+	rk_hls_put32(&buf, 1);
+	rk_hls_put_sample_entry(stream, &buf, width, height);
+	rk_hls_box_close(&buf, stsd);
+	// the samples are all in the fragments
+	const char *empty[] = {"stts", "stsc", "stco"};
+	for (int i = 0; i < 3; i++) {
+		int at = rk_hls_full_box_open(&buf, empty[i], 0, 0);
+		rk_hls_put32(&buf, 0);
+		rk_hls_box_close(&buf, at);
+	}
+	int stsz = rk_hls_full_box_open(&buf, "stsz", 0, 0);
+	rk_hls_put32(&buf, 0);
+	rk_hls_put32(&buf, 0);
+	rk_hls_box_close(&buf, stsz);
+	rk_hls_box_close(&buf, stbl);
+	rk_hls_box_close(&buf, minf);
+	rk_hls_box_close(&buf, mdia);
+	rk_hls_box_close(&buf, trak);
+
+	int mvex = rk_hls_box_open(&buf, "mvex");
+	int trex = rk_hls_full_box_open(&buf, "trex", 0, 0);
+	rk_hls_put32(&buf, 1);
+	rk_hls_put32(&buf, 1);
+	rk_hls_zero(&buf, 12);
+	rk_hls_box_close(&buf, trex);
+	rk_hls_box_close(&buf, mvex);
+	rk_hls_box_close(&buf, moov);
+
+	int ret = -1;
+	stream->init_index++;
+	snprintf(name, sizeof(name), "init%d.mp4", stream->init_index);
+	if (!buf.error) {
+		struct iovec iov = {buf.data, (size_t)buf.len};
+		ret = rk_hls_write_file(stream, name, &iov, 1);
+	}
+	free(buf.data);
+	if (ret)
+		rk_hls_write_error(stream, name);
+	else
+		LOG_INFO("stream %d: %s, %s %dx%d\n", stream->id, name, stream->hevc ? "hvc1" : "avc1",
+		         width, height);
+
+	return ret;
+}
+
+// ---- parts, segments and the playlist ----
+
+static rk_hls_segment_s *rk_hls_get_segment(rk_hls_stream_s *stream, unsigned int msn) {
+	return &stream->segment[msn % RK_HLS_MAX_SEGMENT];
+}
+
+static void rk_hls_format_utc(int64_t utc_ms, char *out, int size) {
+	time_t sec = utc_ms / 1000;
+	struct tm tm;
+	gmtime_r(&sec, &tm);
+	int len = strftime(out, size, "%Y-%m-%dT%H:%M:%S", &tm);
+	snprintf(out + len, size - len, ".%03dZ", (int)(utc_ms % 1000));
+}
+
+static void rk_hls_write_playlist(rk_hls_stream_s *stream) {
+	rk_hls_buf_s buf = {0};
+	char utc[40];
+	unsigned int cur = stream->msn;
+	unsigned int first = cur > (unsigned int)g_playlist_segments ? cur - g_playlist_segments : 0;
+	if (first < stream->playlist_first)
+		first = stream->playlist_first;
+	// the discontinuities that left the window are counted in the sequence
+	for (; stream->playlist_first < first; stream->playlist_first++) {
+		rk_hls_segment_s *gone = rk_hls_get_segment(stream, stream->playlist_first);
+		if (gone->msn == stream->playlist_first && gone->discontinuity)
+			stream->discontinuity_sequence++;
+	}
+	int target = (g_segment_ms + 999) / 1000;
+	int longest = (stream->max_segment_duration + RK_HLS_TIMESCALE - 1) / RK_HLS_TIMESCALE;
+	if (longest > target)
+		target = longest;
+
+	rk_hls_printf(&buf, "#EXTM3U\n#EXT-X-VERSION:6\n#EXT-X-TARGETDURATION:%d\n", target);
+	rk_hls_printf(&buf, "#EXT-X-PART-INF:PART-TARGET=%.3f\n", g_part_ms / 1000.0);
+	rk_hls_printf(&buf, "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%.3f\n", g_part_ms * 3 / 1000.0);
+	rk_hls_printf(&buf, "#EXT-X-MEDIA-SEQUENCE:%u\n", first);
+	rk_hls_printf(&buf, "#EXT-X-DISCONTINUITY-SEQUENCE:%u\n", stream->discontinuity_sequence);
+	for (unsigned int msn = first; msn <= cur; msn++) {
+		rk_hls_segment_s *segment = rk_hls_get_segment(stream, msn);
+		if (segment->msn != msn || !segment->part_count)
+			continue;
+		if (msn == first)
+			rk_hls_printf(&buf, "#EXT-X-MAP:URI=\"init%d.mp4\"\n", segment->init_index);
+		else if (segment->discontinuity)
+			rk_hls_printf(&buf, "#EXT-X-DISCONTINUITY\n#EXT-X-MAP:URI=\"init%d.mp4\"\n",
+			              segment->init_index);
+		rk_hls_format_utc(segment->utc_ms, utc, sizeof(utc));
+		rk_hls_printf(&buf, "#EXT-X-PROGRAM-DATE-TIME:%s\n", utc);
+		if (msn + RK_HLS_PART_SEGMENTS > cur) {
+			for (int i = 0; i < segment->part_count; i++)
+				rk_hls_printf(&buf, "#EXT-X-PART:DURATION=%.5f,URI=\"seg%u.%d.m4s\"%s\n",
+				              (double)segment->part_duration[i] / RK_HLS_TIMESCALE, msn, i,
+				              segment->part_independent[i] ? ",INDEPENDENT=YES" : "");
+		}
+		if (segment->complete)
+			rk_hls_printf(&buf, "#EXTINF:%.5f,\nseg%u.m4s\n",
+			              (double)segment->duration / RK_HLS_TIMESCALE, msn);
+	}
+	rk_hls_segment_s *segment = rk_hls_get_segment(stream, cur);
+	rk_hls_printf(&buf, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"seg%u.%d.m4s\"\n", cur,
+	              segment->msn == cur ? segment->part_count : 0);
+
+	struct iovec iov = {buf.data, (size_t)buf.len};
+	if (buf.error || rk_hls_write_file(stream, "index.m3u8", &iov, 1))
+		rk_hls_write_error(stream, "index.m3u8");
+	free(buf.data);
+}
+
+// moof and mdat of the samples in the part, to its own file and appended to the segment
+static void rk_hls_close_part(rk_hls_stream_s *stream) {
+	rk_hls_segment_s *segment = rk_hls_get_segment(stream, stream->msn);
+	rk_hls_buf_s buf = {0};
+	char name[32];
+	int nal_count = 0;
+	uint32_t mdat_size = 8;
+
+	if (!stream->part_count)
+		return;
+	for (int i = 0; i < stream->part_count; i++) {
+		nal_count += stream->part[i].nal_count;
+		mdat_size += stream->part[i].size;
+	}
+	int moof = rk_hls_box_open(&buf, "moof");
+	int mfhd = rk_hls_full_box_open(&buf, "mfhd", 0, 0);
+	rk_hls_put32(&buf, ++stream->sequence);
+	rk_hls_box_close(&buf, mfhd);
+	int traf = rk_hls_box_open(&buf, "traf");
+	int tfhd = rk_hls_full_box_open(&buf, "tfhd", 0, 0x020000); // default base is moof
+	rk_hls_put32(&buf, 1);
+	rk_hls_box_close(&buf, tfhd);
+	int tfdt = rk_hls_full_box_open(&buf, "tfdt", 1, 0);
+	rk_hls_put64(&buf, stream->part[0].dts);
+	rk_hls_box_close(&buf, tfdt);
+	// data offset, sample duration, size and flags
+	int trun = rk_hls_full_box_open(&buf, "trun", 0, 0x000701);
+	rk_hls_put32(&buf, stream->part_count);
+	int data_offset = buf.len;
+	rk_hls_put32(&buf, 0);
+	for (int i = 0; i < stream->part_count; i++) {
+		rk_hls_put32(&buf, stream->part[i].duration);
+		rk_hls_put32(&buf, stream->part[i].size);
+		// a key frame depends on no other, the others are not sync samples
+		rk_hls_put32(&buf, stream->part[i].key ? 0x02000000 : 0x01010000);
+	}
+	rk_hls_box_close(&buf, trun);
+	rk_hls_box_close(&buf, traf);
+	rk_hls_box_close(&buf, moof);
+	uint32_t offset = buf.len - moof + 8;
+	rk_hls_put32(&buf, mdat_size);
+	rk_hls_put(&buf, "mdat", 4);
+
+	// the samples go out straight from the packets, each nal behind its length
+	struct iovec *iov = (struct iovec *)malloc((1 + 2 * nal_count) * sizeof(*iov));
+	uint32_t *length = (uint32_t *)malloc((nal_count + 1) * sizeof(*length));
+	if (!buf.error && iov && length) {
+		buf.data[data_offset] = offset >> 24;
+		buf.data[data_offset + 1] = offset >> 16;
+		buf.data[data_offset + 2] = offset >> 8;
+		buf.data[data_offset + 3] = offset;
+		int count = 0, n = 0;
+		iov[count].iov_base = buf.data;
+		iov[count++].iov_len = buf.len;
+		for (int i = 0; i < stream->part_count; i++) {
+			rk_hls_sample_s *sample = &stream->part[i];
+			for (int j = 0; j < sample->nal_count; j++) {
+				unsigned char *nal = sample->packet->data + sample->nal_offset[j];
+				if (rk_hls_nal_class(stream, nal) >= 0)
+					continue;
+				length[n] = htonl(sample->nal_size[j]);
+				iov[count].iov_base = &length[n++];
+				iov[count++].iov_len = 4;
+				iov[count].iov_base = nal;
+				iov[count++].iov_len = sample->nal_size[j];
+			}
+		}
+		int part = segment->part_count;
+		snprintf(name, sizeof(name), "seg%u.%d.m4s", stream->msn, part);
+		// writev moves the iovecs along, the segment gets its own copy
+		struct iovec *copy = (struct iovec *)malloc(count * sizeof(*iov));
+		if (copy)
+			memcpy(copy, iov, count * sizeof(*iov));
+		if (rk_hls_write_file(stream, name, iov, count))
+			rk_hls_write_error(stream, name);
+		if (!copy || stream->segment_fd < 0 || rk_hls_writev(stream->segment_fd, copy, count))
+			rk_hls_write_error(stream, "segment");
+		free(copy);
+		if (part < RK_HLS_MAX_PART) {
+			segment->part_duration[part] = 0;
+			for (int i = 0; i < stream->part_count; i++)
+				segment->part_duration[part] += stream->part[i].duration;
+			segment->part_independent[part] = stream->part[0].key;
+			segment->part_count++;
+		}
+		stream->parts++;
+		stream->bytes += buf.len + mdat_size - 8;
+	} else {
+		rk_hls_write_error(stream, "part");
+	}
+	free(iov);
+	free(length);
+	free(buf.data);
+	for (int i = 0; i < stream->part_count; i++)
+		rk_packet_unref(stream->part[i].packet);
+	stream->part_count = 0;
+}
+
+// the files that left the playlist window go, and the init segments no one refers to
+static void rk_hls_clean(rk_hls_stream_s *stream) {
+	unsigned int cur = stream->msn;
+	if (cur >= RK_HLS_PART_SEGMENTS + 1) {
+		rk_hls_segment_s *old = rk_hls_get_segment(stream, cur - RK_HLS_PART_SEGMENTS - 1);
+		for (int i = 0; old->msn == cur - RK_HLS_PART_SEGMENTS - 1 && i < old->part_count; i++)
+			rk_hls_unlink(stream, "seg%u.%d.m4s", old->msn, i);
+	}
+	if (cur < (unsigned int)g_playlist_segments + 2)
+		return;
+	unsigned int gone = cur - g_playlist_segments - 2;
+	rk_hls_unlink(stream, "seg%u.m4s", gone);
+	rk_hls_segment_s *next = rk_hls_get_segment(stream, gone + 1);
+	for (; next->msn == gone + 1 && stream->oldest_init < next->init_index; stream->oldest_init++)
+		rk_hls_unlink(stream, "init%d.mp4", stream->oldest_init);
+}
+
+static void rk_hls_close_segment(rk_hls_stream_s *stream, int64_t end) {
+	char name[32], path[256], tmp[264];
+	if (!stream->segment_open)
+		return;
+	rk_hls_close_part(stream);
+	rk_hls_segment_s *segment = rk_hls_get_segment(stream, stream->msn);
+	snprintf(name, sizeof(name), "seg%u.m4s", stream->msn);
+	snprintf(path, sizeof(path), "%s/%s", stream->dir, name);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if (stream->segment_fd >= 0) {
+		close(stream->segment_fd);
+		if (rename(tmp, path))
+			rk_hls_write_error(stream, name);
+	}
+	stream->segment_fd = -1;
+	segment->duration = end - stream->segment_start;
+	segment->complete = 1;
+	if (segment->duration > stream->max_segment_duration)
+		stream->max_segment_duration = segment->duration;
+	stream->segments++;
+	stream->segment_open = 0;
+	stream->msn++;
+}
+
+static void rk_hls_open_segment(rk_hls_stream_s *stream, const rk_hls_sample_s *first) {
+	char path[256];
+	rk_hls_segment_s *segment = rk_hls_get_segment(stream, stream->msn);
+	memset(segment, 0, sizeof(*segment));
+	segment->msn = stream->msn;
+	segment->init_index = stream->init_index;
+	segment->discontinuity = stream->next_discontinuity;
+	segment->utc_ms = rk_media_clock_to_utc_ms(first->packet->pts);
+	stream->next_discontinuity = 0;
+	snprintf(path, sizeof(path), "%s/seg%u.m4s.tmp", stream->dir, stream->msn);
+	stream->segment_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (stream->segment_fd < 0)
+		rk_hls_write_error(stream, path);
+	stream->segment_start = first->dts;
+	stream->part_start = first->dts;
+	stream->segment_open = 1;
+	rk_hls_clean(stream);
+}
+
+// a key frame with other parameter sets, after a resolution or codec change
+static int rk_hls_param_sets_changed(rk_hls_stream_s *stream, const rk_hls_sample_s *sample) {
+	unsigned char set[3][RK_HLS_MAX_PARAM_SET];
+	int set_len[3] = {0};
+	for (int i = 0; i < sample->nal_count; i++) {
+		const unsigned char *nal = sample->packet->data + sample->nal_offset[i];
+		int cls = rk_hls_nal_class(stream, nal);
+		if (cls < 0 || cls > 2 || set_len[cls] || sample->nal_size[i] > RK_HLS_MAX_PARAM_SET)
+			continue;
+		memcpy(set[cls], nal, sample->nal_size[i]);
+		set_len[cls] = sample->nal_size[i];
+	}
+	if (!set_len[1] || !set_len[2] || (stream->hevc && !set_len[0]))
+		return 0;
+	int changed = 0;
+	for (int i = 0; i < 3; i++) {
+		if (set_len[i] != stream->param_set_len[i] ||
+		    memcmp(set[i], stream->param_set[i], set_len[i])) {
+			memcpy(stream->param_set[i], set[i], set_len[i]);
+			stream->param_set_len[i] = set_len[i];
+			changed = 1;
+		}
+	}
+
+	return changed;
+}
+
+static void rk_hls_stream_flush(rk_hls_stream_s *stream) {
+	if (stream->have_pending) {
+		stream->pending.duration = stream->last_duration;
+		if (stream->part_count == RK_HLS_MAX_SAMPLE)
+			rk_hls_close_part(stream);
+		stream->part[stream->part_count++] = stream->pending;
+		stream->have_pending = 0;
+		rk_hls_close_segment(stream, stream->pending.dts + stream->pending.duration);
+	}
+	for (int i = 0; i < stream->part_count; i++)
+		rk_packet_unref(stream->part[i].packet);
+	stream->part_count = 0;
+	if (stream->segment_fd >= 0)
+		close(stream->segment_fd);
+	stream->segment_fd = -1;
+	stream->segment_open = 0;
+}
+
+int rk_hls_write_video(int id, rk_packet_s *packet) {
+	if (id < 0 || id >= RK_HLS_MAX_STREAM || !g_hls_stream[id].enable)
+		return 0;
+	rk_hls_stream_s *stream = &g_hls_stream[id];
+	rk_hls_sample_s sample;
+
+	pthread_mutex_lock(&g_hls_mutex);
+	if (!g_hls_enable || !stream->enable) {
+		pthread_mutex_unlock(&g_hls_mutex);
+		return 0;
+	}
+	sample.packet = packet;
+	sample.key = packet->key_frame;
+	if (rk_hls_split(&sample) <= 0 || (!stream->init_index && !sample.key)) {
+		stream->skipped++;
+		pthread_mutex_unlock(&g_hls_mutex);
+		return 0;
+	}
+	sample.size = 0;
+	for (int i = 0; i < sample.nal_count; i++) {
+		if (rk_hls_nal_class(stream, packet->data + sample.nal_offset[i]) < 0)
+			sample.size += 4 + sample.nal_size[i];
+	}
+	if (sample.key && rk_hls_param_sets_changed(stream, &sample)) {
+		if (stream->init_index) {
+			// the old parameter sets end with the segment, the new ones get their own init
+			rk_hls_stream_flush(stream);
+			stream->next_discontinuity = 1;
+			rk_hls_write_playlist(stream);
+		} else {
+			stream->origin_pts = packet->pts;
+		}
+		rk_hls_write_init(stream);
+	}
+	if (!stream->init_index) {
+		// no parameter sets in front of the key frame, wait for the next one
+		stream->skipped++;
+		pthread_mutex_unlock(&g_hls_mutex);
+		return 0;
+	}
+	sample.dts = (packet->pts - stream->origin_pts) * 9 / 100;
+	if (stream->have_pending) {
+		rk_hls_sample_s *pending = &stream->pending;
+		int64_t duration = sample.dts - pending->dts;
+		if (duration <= 0 || duration > 10 * RK_HLS_TIMESCALE)
+			duration = stream->last_duration;
+		pending->duration = duration;
+		stream->last_duration = duration;
+		if (stream->part_count == RK_HLS_MAX_SAMPLE) {
+			rk_hls_close_part(stream);
+			stream->part_start = pending->dts;
+		}
+		stream->part[stream->part_count++] = *pending;
+		stream->have_pending = 0;
+		int64_t elapsed = pending->dts + duration - stream->segment_start;
+		int64_t part_elapsed = pending->dts + duration - stream->part_start;
+		rk_hls_segment_s *segment = rk_hls_get_segment(stream, stream->msn);
+		if (sample.key && elapsed >= g_segment_ms * 90LL - duration / 2) {
+			rk_hls_close_segment(stream, sample.dts);
+			rk_hls_write_playlist(stream);
+		} else if (part_elapsed + duration > g_part_ms * 90LL &&
+		           segment->part_count < RK_HLS_MAX_PART - 1) {
+			// another frame would make the part longer than the target
+			rk_hls_close_part(stream);
+			stream->part_start = sample.dts;
+			rk_hls_write_playlist(stream);
+		}
+	} else if (!stream->last_duration) {
+		stream->last_duration = RK_HLS_TIMESCALE / 30;
+	}
+	if (!stream->segment_open)
+		rk_hls_open_segment(stream, &sample);
+	stream->pending = sample;
+	stream->pending.packet = rk_packet_ref(packet);
+	stream->have_pending = 1;
+	pthread_mutex_unlock(&g_hls_mutex);
+
+	return 0;
+}
+
+// ---- init ----
+
+static void rk_hls_prepare_dir(const char *dir) {
+	struct dirent *entry;
+	mkdir(g_hls_path, 0755);
+	mkdir(dir, 0755);
+	DIR *d = opendir(dir);
+	if (!d)
+		return;
+	// whatever the previous run left would be served as this one
+	while ((entry = readdir(d))) {
+		if (strncmp(entry->d_name, "seg", 3) && strncmp(entry->d_name, "init", 4) &&
+		    strncmp(entry->d_name, "index", 5))
+			continue;
+		char path[256 + sizeof(entry->d_name)];
+		snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+		unlink(path);
+	}
+	closedir(d);
+}
+
+int rk_hls_init() {
+	char entry[64];
+	if (!rk_param_get_int("hls:enable", 0))
+		return 0;
+	const char *streams = rk_param_get_string("hls:streams", "0,1");
+
+	pthread_mutex_lock(&g_hls_mutex);
+	if (g_hls_enable) {
+		pthread_mutex_unlock(&g_hls_mutex);
+		return 0;
+	}
+	snprintf(g_hls_path, sizeof(g_hls_path), "%s", rk_param_get_string("hls:path", "/tmp/hls"));
+	g_segment_ms = rk_param_get_int("hls:segment_ms", 2000);
+	g_part_ms = rk_param_get_int("hls:part_ms", 334);
+	g_playlist_segments = rk_param_get_int("hls:playlist_segments", 6);
+	if (g_playlist_segments < 2)
+		g_playlist_segments = 2;
+	if (g_playlist_segments > RK_HLS_MAX_SEGMENT - RK_HLS_PART_SEGMENTS - 3)
+		g_playlist_segments = RK_HLS_MAX_SEGMENT - RK_HLS_PART_SEGMENTS - 3;
+	// a part holds at least one frame and a segment has room for all of its parts
+	if (g_part_ms < 34)
+		g_part_ms = 34;
+	if (g_segment_ms < g_part_ms)
+		g_segment_ms = g_part_ms;
+	for (int i = 0; i < RK_HLS_MAX_STREAM; i++) {
+		rk_hls_stream_s *stream = &g_hls_stream[i];
+		memset(stream, 0, sizeof(*stream));
+		stream->id = i;
+		stream->segment_fd = -1;
+		stream->oldest_init = 1;
+		for (const char *p = streams; *p; p++) {
+			if (*p - '0' == i && (p == streams || p[-1] == ',') && (!p[1] || p[1] == ','))
+				stream->enable = 1;
+		}
+		if (!stream->enable)
+			continue;
+		snprintf(entry, sizeof(entry), "video.%d:output_data_type", i);
+		stream->hevc = !strcmp(rk_param_get_string(entry, "H.264"), "H.265");
+		snprintf(stream->dir, sizeof(stream->dir), "%s/%d", g_hls_path, i);
+		rk_hls_prepare_dir(stream->dir);
+		LOG_INFO("stream %d to %s, segment %d ms, part %d ms, %d segments\n", i, stream->dir,
+		         g_segment_ms, g_part_ms, g_playlist_segments);
+	}
+	g_hls_enable = 1;
+	pthread_mutex_unlock(&g_hls_mutex);
+
+	return 0;
+}
+
+int rk_hls_deinit() {
+	pthread_mutex_lock(&g_hls_mutex);
+	if (!g_hls_enable) {
+		pthread_mutex_unlock(&g_hls_mutex);
+		return 0;
+	}
+	for (int i = 0; i < RK_HLS_MAX_STREAM; i++) {
+		rk_hls_stream_s *stream = &g_hls_stream[i];
+		if (!stream->enable)
+			continue;
+		// the last frames make a short segment, the playlist stays for the next run to replace
+		rk_hls_stream_flush(stream);
+		if (stream->init_index)
+			rk_hls_write_playlist(stream);
+		stream->enable = 0;
+	}
+	g_hls_enable = 0;
+	pthread_mutex_unlock(&g_hls_mutex);
+
+	return 0;
+}
+
+int rk_hls_enabled(int id) {
+	return g_hls_enable && id >= 0 && id < RK_HLS_MAX_STREAM && g_hls_stream[id].enable;
+}
+
+int rk_hls_get_stats(char *value, int size) {
+	int len = snprintf(value, size, "{\"enable\":%d,\"path\":\"%s\",\"streams\":[", g_hls_enable,
+	                   g_hls_path);
+	int first = 1;
+
+	pthread_mutex_lock(&g_hls_mutex);
+	for (int i = 0; i < RK_HLS_MAX_STREAM && len < size; i++) {
+		rk_hls_stream_s *stream = &g_hls_stream[i];
+		if (!stream->enable)
+			continue;
+		len += snprintf(value + len, size - len,
+		                "%s{\"id\":%d,\"codec\":\"%s\",\"msn\":%u,\"inits\":%d,\"segments\":%llu,"
+		                "\"parts\":%llu,\"kb\":%llu,\"skipped\":%llu,\"write_errors\":%llu}",
+		                first ? "" : ",", i, stream->hevc ? "hvc1" : "avc1", stream->msn,
+		                stream->init_index, stream->segments, stream->parts,
+		                stream->bytes / 1024, stream->skipped, stream->write_errors);
+		first = 0;
+	}
+	pthread_mutex_unlock(&g_hls_mutex);
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+
+	return len < size ? 0 : -1;
+}
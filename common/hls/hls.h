@@ -0,0 +1,33 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_HLS_H__
+#define __RKIPC_HLS_H__
+
+#include "packet_bus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Low latency hls out of the encoded streams: CMAF fragmented mp4 with partial segments and a
+// rolling playlist per stream, written to a tmpfs directory that any local http server can
+// serve as static files:
+//
+//   <hls:path>/<stream>/index.m3u8, init<n>.mp4, seg<msn>.m4s, seg<msn>.<part>.m4s
+//
+// Segments start on a key frame once hls:segment_ms is reached, parts are cut every
+// hls:part_ms. Video only, the audio encoders have no CMAF codec.
+int rk_hls_init();
+int rk_hls_deinit();
+// 1 when stream id is segmented, see hls:streams
+int rk_hls_enabled(int id);
+// called from the packet bus consumer of the stream, keeps its own reference of the packet
+int rk_hls_write_video(int id, rk_packet_s *packet);
+int rk_hls_get_stats(char *value, int size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
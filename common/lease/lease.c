@@ -0,0 +1,233 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "lease.h"
+#include "common.h"
+#include <limits.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "lease.c"
+
+typedef struct rk_lease_s {
+	int handle;
+	rk_lease_type type;
+	char owner[32];
+	long long acquire_ms;
+	long long deadline_ms;
+	rk_lease_release_func release;
+	void *ctx;
+	struct rk_lease_s *next;
+} rk_lease_s;
+
+static const char *g_type_name[RK_LEASE_TYPE_NUM] = {"vi_frame", "venc_stream", "mb_blk"};
+
+static pthread_mutex_t g_lease_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_reaper_cond = PTHREAD_COND_INITIALIZER;
+static rk_lease_s *g_leases; // newest first
+static int g_next_handle = 1;
+static int g_outstanding[RK_LEASE_TYPE_NUM];
+static unsigned long long g_acquired, g_released, g_reclaimed, g_late_release;
+static int g_timeout_ms, g_reaper_interval_ms;
+static int g_reaper_run;
+static pthread_t g_reaper_tid;
+static int g_lease_inited;
+
+static void rk_lease_free(rk_lease_s *lease, int reclaim) {
+	int ret = lease->release(lease->ctx);
+	if (reclaim)
+		LOG_WARN("reclaim %s of %s after %lld ms, ret %d\n", g_type_name[lease->type],
+		         lease->owner, rkipc_get_curren_time_ms() - lease->acquire_ms, ret);
+	free(lease->ctx);
+	free(lease);
+}
+
+// unlink the leases past their deadline, or all of them, and release them outside the lock
+static int rk_lease_reclaim(int all) {
+	rk_lease_s *expired = NULL;
+	int num = 0;
+	long long now = rkipc_get_curren_time_ms();
+
+	pthread_mutex_lock(&g_lease_mutex);
+	rk_lease_s **prev = &g_leases;
+	while (*prev) {
+		rk_lease_s *lease = *prev;
+		if (!all && lease->deadline_ms > now) {
+			prev = &lease->next;
+			continue;
+		}
+		*prev = lease->next;
+		lease->next = expired;
+		expired = lease;
+		g_outstanding[lease->type]--;
+		g_reclaimed++;
+		num++;
+	}
+	pthread_mutex_unlock(&g_lease_mutex);
+
+	while (expired) {
+		rk_lease_s *lease = expired;
+		expired = lease->next;
+		rk_lease_free(lease, 1);
+	}
+
+	return num;
+}
+
+static void *rk_lease_reaper(void *arg) {
+	prctl(PR_SET_NAME, "RkipcLease", 0, 0, 0);
+
+	pthread_mutex_lock(&g_lease_mutex);
+	while (g_reaper_run) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += g_reaper_interval_ms / 1000;
+		ts.tv_nsec += (g_reaper_interval_ms % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&g_reaper_cond, &g_lease_mutex, &ts);
+		if (!g_reaper_run)
+			break;
+		pthread_mutex_unlock(&g_lease_mutex);
+		rk_lease_reclaim(0);
+		pthread_mutex_lock(&g_lease_mutex);
+	}
+	pthread_mutex_unlock(&g_lease_mutex);
+
+	return NULL;
+}
+
+int rk_lease_init() {
+	if (g_lease_inited)
+		return 0;
+	g_timeout_ms = rk_param_get_int("lease:timeout_ms", 3000);
+	g_reaper_interval_ms = rk_param_get_int("lease:reaper_interval_ms", 500);
+	if (g_reaper_interval_ms < 10)
+		g_reaper_interval_ms = 10;
+	LOG_INFO("timeout %d ms, reaper every %d ms\n", g_timeout_ms, g_reaper_interval_ms);
+
+	g_reaper_run = 1;
+	if (pthread_create(&g_reaper_tid, NULL, rk_lease_reaper, NULL)) {
+		LOG_ERROR("create reaper thread fail\n");
+		g_reaper_run = 0;
+		return -1;
+	}
+	g_lease_inited = 1;
+
+	return 0;
+}
+
+int rk_lease_deinit() {
+	if (!g_lease_inited)
+		return 0;
+	pthread_mutex_lock(&g_lease_mutex);
+	g_reaper_run = 0;
+	pthread_cond_signal(&g_reaper_cond);
+	pthread_mutex_unlock(&g_lease_mutex);
+	pthread_join(g_reaper_tid, NULL);
+	int num = rk_lease_reclaim(1);
+	if (num)
+		LOG_WARN("%d leases still outstanding at deinit\n", num);
+	g_lease_inited = 0;
+
+	return 0;
+}
+
+int rk_lease_acquire(rk_lease_type type, const char *owner, rk_lease_release_func release,
+                     const void *ctx, int ctx_size, int timeout_ms) {
+	RKIPC_CHECK_POINTER(release, -1);
+	if (type < 0 || type >= RK_LEASE_TYPE_NUM || ctx_size < 0)
+		return -1;
+
+	rk_lease_s *lease = (rk_lease_s *)calloc(1, sizeof(rk_lease_s));
+	if (!lease)
+		return -1;
+	if (ctx_size) {
+		lease->ctx = malloc(ctx_size);
+		if (!lease->ctx) {
+			free(lease);
+			return -1;
+		}
+		memcpy(lease->ctx, ctx, ctx_size);
+	}
+	lease->type = type;
+	snprintf(lease->owner, sizeof(lease->owner), "%s", owner ? owner : "");
+	lease->release = release;
+	lease->acquire_ms = rkipc_get_curren_time_ms();
+	lease->deadline_ms = lease->acquire_ms + (timeout_ms > 0 ? timeout_ms : g_timeout_ms);
+
+	pthread_mutex_lock(&g_lease_mutex);
+	lease->handle = g_next_handle;
+	g_next_handle = g_next_handle == INT_MAX ? 1 : g_next_handle + 1;
+	lease->next = g_leases;
+	g_leases = lease;
+	g_outstanding[type]++;
+	g_acquired++;
+	pthread_mutex_unlock(&g_lease_mutex);
+
+	return lease->handle;
+}
+
+int rk_lease_release(int handle) {
+	rk_lease_s *lease = NULL;
+
+	pthread_mutex_lock(&g_lease_mutex);
+	for (rk_lease_s **prev = &g_leases; *prev; prev = &(*prev)->next) {
+		if ((*prev)->handle != handle)
+			continue;
+		lease = *prev;
+		*prev = lease->next;
+		g_outstanding[lease->type]--;
+		g_released++;
+		break;
+	}
+	if (!lease)
+		g_late_release++;
+	pthread_mutex_unlock(&g_lease_mutex);
+
+	if (!lease) {
+		// the reaper already gave the buffer back, never release it twice
+		LOG_WARN("lease %d was already reclaimed\n", handle);
+		return -1;
+	}
+	int ret = lease->release(lease->ctx);
+	free(lease->ctx);
+	free(lease);
+
+	return ret;
+}
+
+int rk_lease_get_stats(char *value, int size) {
+	RKIPC_CHECK_POINTER(value, -1);
+	int len = 0;
+	long long now = rkipc_get_curren_time_ms();
+
+	pthread_mutex_lock(&g_lease_mutex);
+	len += snprintf(value + len, size - len,
+	                "{\"timeout_ms\":%d,\"acquired\":%llu,\"released\":%llu,\"reclaimed\":%llu,"
+	                "\"late_release\":%llu,\"outstanding\":{",
+	                g_timeout_ms, g_acquired, g_released, g_reclaimed, g_late_release);
+	for (int i = 0; i < RK_LEASE_TYPE_NUM && len < size; i++)
+		len += snprintf(value + len, size - len, "%s\"%s\":%d", i ? "," : "", g_type_name[i],
+		                g_outstanding[i]);
+	if (len < size)
+		len += snprintf(value + len, size - len, "},\"leases\":[");
+	for (rk_lease_s *lease = g_leases; lease && len < size; lease = lease->next)
+		len += snprintf(value + len, size - len,
+		                "%s{\"handle\":%d,\"type\":\"%s\",\"owner\":\"%s\",\"age_ms\":%lld}",
+		                lease == g_leases ? "" : ",", lease->handle, g_type_name[lease->type],
+		                lease->owner, now - lease->acquire_ms);
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+	pthread_mutex_unlock(&g_lease_mutex);
+
+	if (len >= size) {
+		LOG_WARN("stats truncated, need %d bytes\n", len);
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_LEASE_H__
+#define __RKIPC_LEASE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	RK_LEASE_VI_FRAME = 0,
+	RK_LEASE_VENC_STREAM,
+	RK_LEASE_MB_BLK,
+	RK_LEASE_TYPE_NUM,
+} rk_lease_type;
+
+// give the buffer back to its pool, ctx is the lease's own copy
+typedef int (*rk_lease_release_func)(void *ctx);
+
+// start the reaper, leases older than their timeout are released with a warning
+int rk_lease_init();
+// release every outstanding lease
+int rk_lease_deinit();
+// copy ctx and track it under owner, timeout_ms <= 0 uses lease:timeout_ms.
+// Return a handle > 0, or -1 when the lease could not be tracked
+int rk_lease_acquire(rk_lease_type type, const char *owner, rk_lease_release_func release,
+                     const void *ctx, int ctx_size, int timeout_ms);
+// return the release function's result, -1 if the lease was already reclaimed
+int rk_lease_release(int handle);
+// outstanding leases with their owner and age, and the totals
+int rk_lease_get_stats(char *value, int size);
+
+#ifdef __cplusplus
+}
+
+// releases the lease when it goes out of scope
+class RkLeaseGuard {
+  public:
+	explicit RkLeaseGuard(int handle = -1) : handle_(handle) {}
+	~RkLeaseGuard() { reset(); }
+	RkLeaseGuard(const RkLeaseGuard &) = delete;
+	RkLeaseGuard &operator=(const RkLeaseGuard &) = delete;
+
+	// release the current lease now and take over handle
+	int reset(int handle = -1) {
+		int ret = 0;
+		if (handle_ > 0)
+			ret = rk_lease_release(handle_);
+		handle_ = handle;
+		return ret;
+	}
+	int get() const { return handle_; }
+	// hand the lease to a new owner, the buffer is not released here
+	int release() {
+		int handle = handle_;
+		handle_ = -1;
+		return handle;
+	}
+
+  private:
+	int handle_;
+};
+#endif
+#endif
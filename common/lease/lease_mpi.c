@@ -0,0 +1,99 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "lease_mpi.h"
+#include "common.h"
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "lease_mpi.c"
+
+#define RK_LEASE_MAX_VENC_PACK 8
+
+typedef struct {
+	int pipe;
+	int chn;
+	VIDEO_FRAME_INFO_S frame;
+} rk_lease_vi_s;
+
+typedef struct {
+	int chn;
+	VENC_STREAM_S stream;
+	// the caller's pack array may be gone by the time the reaper releases it
+	VENC_PACK_S pack[RK_LEASE_MAX_VENC_PACK];
+} rk_lease_venc_s;
+
+static int rk_lease_vi_release(void *ctx) {
+	rk_lease_vi_s *vi = (rk_lease_vi_s *)ctx;
+	int ret = RK_MPI_VI_ReleaseChnFrame(vi->pipe, vi->chn, &vi->frame);
+	if (ret != RK_SUCCESS)
+		LOG_ERROR("RK_MPI_VI_ReleaseChnFrame %d fail %x\n", vi->chn, ret);
+	return ret;
+}
+
+static int rk_lease_venc_release(void *ctx) {
+	rk_lease_venc_s *venc = (rk_lease_venc_s *)ctx;
+	venc->stream.pstPack = venc->pack;
+	int ret = RK_MPI_VENC_ReleaseStream(venc->chn, &venc->stream);
+	if (ret != RK_SUCCESS)
+		LOG_ERROR("RK_MPI_VENC_ReleaseStream %d fail %x\n", venc->chn, ret);
+	return ret;
+}
+
+static int rk_lease_mb_release(void *ctx) {
+	MB_BLK blk = *(MB_BLK *)ctx;
+	int ret = RK_MPI_MB_ReleaseMB(blk);
+	if (ret != RK_SUCCESS)
+		LOG_ERROR("RK_MPI_MB_ReleaseMB fail %x\n", ret);
+	return ret;
+}
+
+int rk_lease_vi_frame(const char *owner, int pipe, int chn, const VIDEO_FRAME_INFO_S *frame,
+                      int timeout_ms) {
+	RKIPC_CHECK_POINTER(frame, -1);
+	rk_lease_vi_s vi;
+	vi.pipe = pipe;
+	vi.chn = chn;
+	vi.frame = *frame;
+	int handle = rk_lease_acquire(RK_LEASE_VI_FRAME, owner, rk_lease_vi_release, &vi,
+	                              sizeof(vi), timeout_ms);
+	// untracked, give it back now rather than starve the vi pool
+	if (handle < 0) {
+		LOG_ERROR("%s: can not track vi frame, release it\n", owner);
+		rk_lease_vi_release(&vi);
+	}
+	return handle;
+}
+
+int rk_lease_venc_stream(const char *owner, int chn, const VENC_STREAM_S *stream,
+                         int timeout_ms) {
+	RKIPC_CHECK_POINTER(stream, -1);
+	rk_lease_venc_s venc;
+	memset(&venc, 0, sizeof(venc));
+	venc.chn = chn;
+	venc.stream = *stream;
+	unsigned int pack_count = stream->u32PackCount ? stream->u32PackCount : 1;
+	if (pack_count > RK_LEASE_MAX_VENC_PACK) {
+		LOG_WARN("%s: %u packs, only %d tracked\n", owner, pack_count, RK_LEASE_MAX_VENC_PACK);
+		pack_count = RK_LEASE_MAX_VENC_PACK;
+	}
+	memcpy(venc.pack, stream->pstPack, pack_count * sizeof(VENC_PACK_S));
+	int handle = rk_lease_acquire(RK_LEASE_VENC_STREAM, owner, rk_lease_venc_release, &venc,
+	                              sizeof(venc), timeout_ms);
+	if (handle < 0) {
+		LOG_ERROR("%s: can not track venc stream, release it\n", owner);
+		rk_lease_venc_release(&venc);
+	}
+	return handle;
+}
+
+int rk_lease_mb(const char *owner, MB_BLK blk, int timeout_ms) {
+	int handle =
+	    rk_lease_acquire(RK_LEASE_MB_BLK, owner, rk_lease_mb_release, &blk, sizeof(blk), timeout_ms);
+	if (handle < 0) {
+		LOG_ERROR("%s: can not track mb blk, release it\n", owner);
+		rk_lease_mb_release(&blk);
+	}
+	return handle;
+}
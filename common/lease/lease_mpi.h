@@ -0,0 +1,28 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_LEASE_MPI_H__
+#define __RKIPC_LEASE_MPI_H__
+
+#include "lease.h"
+#include <rk_mpi_mb.h>
+#include <rk_mpi_venc.h>
+#include <rk_mpi_vi.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// track a buffer just taken from rockit, the lease releases it back with the matching api.
+// On -1 it could not be tracked and is already released, the caller must drop it untouched
+int rk_lease_vi_frame(const char *owner, int pipe, int chn, const VIDEO_FRAME_INFO_S *frame,
+                      int timeout_ms);
+int rk_lease_venc_stream(const char *owner, int chn, const VENC_STREAM_S *stream,
+                         int timeout_ms);
+int rk_lease_mb(const char *owner, MB_BLK blk, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
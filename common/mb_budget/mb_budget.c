@@ -0,0 +1,290 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "mb_budget.h"
+#include "common.h"
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "mb_budget.c"
+
+#define RK_MB_ALIGN(x, a) (((unsigned long long)(x) + (a)-1) / (a) * (a))
+// vi needs a ping-pong pair, venc one buffer being filled and one being read
+#define RK_MB_MIN_BUF_COUNT 2
+
+static const int g_default_vi_chn_id[RK_MB_BUDGET_MAX_STREAM] = {3, 2, 4};
+
+static int rk_mb_stream_get_int(int id, const char *key, int value) {
+	char entry[128] = {'\0'};
+	snprintf(entry, 127, "video.%d:%s", id, key);
+	return rk_param_get_int(entry, value);
+}
+
+static const char *rk_mb_stream_get_string(int id, const char *key, const char *value) {
+	char entry[128] = {'\0'};
+	snprintf(entry, 127, "video.%d:%s", id, key);
+	return rk_param_get_string(entry, value);
+}
+
+static unsigned long long rk_mb_yuv420sp_bytes(int width, int height) {
+	return RK_MB_ALIGN(width, 16) * RK_MB_ALIGN(height, 16) * 3 / 2;
+}
+
+static void rk_mb_budget_add(rk_mb_budget_plan_s *plan, const char *name, int count,
+                             unsigned long long unit_bytes) {
+	if (count <= 0 || !unit_bytes || plan->entry_count >= RK_MB_BUDGET_MAX_ENTRY)
+		return;
+	rk_mb_budget_entry_s *entry = &plan->entry[plan->entry_count++];
+	snprintf(entry->name, sizeof(entry->name), "%s", name);
+	entry->count = count;
+	entry->unit_bytes = unit_bytes;
+	entry->bytes = unit_bytes * count;
+	plan->total_bytes += entry->bytes;
+}
+
+// the counts as configured, with the defaults video.cc has always used
+static void rk_mb_budget_load(rk_mb_budget_plan_s *plan) {
+	char entry[128] = {'\0'};
+	memset(plan, 0, sizeof(*plan));
+	for (int i = 0; i < RK_MB_BUDGET_MAX_STREAM; i++) {
+		rk_mb_budget_stream_s *stream = &plan->stream[i];
+		snprintf(entry, 127, "video.source:enable_venc_%d", i);
+		stream->enable = rk_param_get_int(entry, i < 2);
+		stream->share_vi = rk_mb_stream_get_int(i, "vi_chn_id", g_default_vi_chn_id[i]) ==
+		                   RK_MB_BUDGET_NPU_VI_CHN;
+		int low_latency =
+		    rk_mb_stream_get_int(i, "low_latency", rk_param_get_int("video.source:low_latency", 0));
+		stream->vi_buf_count = low_latency
+		                           ? rk_mb_stream_get_int(i, "low_latency_input_buffer_count", 2)
+		                           : rk_mb_stream_get_int(i, "input_buffer_count", 3);
+		stream->venc_buf_count = low_latency
+		                             ? rk_mb_stream_get_int(i, "low_latency_buffer_count", 2)
+		                             : rk_mb_stream_get_int(i, "buffer_count", 4);
+	}
+	plan->vo_vi_buf_count = rk_param_get_int("video.source:enable_vo", 1) ? 3 : 0;
+	plan->jpeg_buf_count = rk_param_get_int("video.source:enable_jpeg", 1) ? 2 : 0;
+
+	plan->autoframe = rk_param_get_int("video.autoframe:enable", 0);
+	// it reads full frames of the main stream channel and follows the npu detections
+	if (plan->autoframe && (!plan->stream[0].enable || plan->stream[0].share_vi ||
+	                        rk_param_get_int("video.source:enable_wrap", 0) ||
+	                        !rk_param_get_int("video.source:enable_npu", 0))) {
+		LOG_WARN("video.autoframe needs video.0 on its own vi channel, no wrap, and the npu\n");
+		plan->autoframe = 0;
+	}
+	// frames lent to frame_export clients are out of the vi queue as well
+	plan->export_hold = rk_param_get_int("frame_export:enable", 0)
+	                        ? rk_param_get_int("frame_export:max_hold", 2)
+	                        : 0;
+	if (plan->autoframe) {
+		// one more frame for the one held by the auto framing reader, video.0 is exported then
+		plan->stream[0].vi_buf_count += 1 + plan->export_hold;
+		plan->autoframe_pool_count = rk_param_get_int("video.autoframe:pool_count", 3);
+		plan->autoframe_venc_buf_count = rk_param_get_int("video.autoframe:buffer_count", 3);
+	}
+}
+
+// entries and total from the current counts
+static void rk_mb_budget_count(rk_mb_budget_plan_s *plan) {
+	char name[24];
+	int enable_npu = rk_param_get_int("video.source:enable_npu", 0);
+	int enable_ivs = rk_param_get_int("video.source:enable_ivs", 1);
+	int enable_wrap = rk_param_get_int("video.source:enable_wrap", 0);
+	int share_npu_vi = 0;
+
+	plan->entry_count = 0;
+	plan->total_bytes = 0;
+	for (int i = 0; i < RK_MB_BUDGET_MAX_STREAM; i++) {
+		rk_mb_budget_stream_s *stream = &plan->stream[i];
+		if (!stream->enable)
+			continue;
+		int max_width = rk_mb_stream_get_int(i, "max_width", 2560);
+		int max_height = rk_mb_stream_get_int(i, "max_height", 1440);
+		if (stream->share_vi) {
+			share_npu_vi = 1;
+		} else if (i == 0 && enable_wrap) {
+			// the channel writes into one wrap buffer of buffer_line lines
+			int buffer_line = rk_param_get_int("video.source:buffer_line", max_height / 4);
+			if (buffer_line < 128 || buffer_line > max_height)
+				buffer_line = max_height;
+			rk_mb_budget_add(plan, "vi.0 wrap", 1,
+			                 (unsigned long long)buffer_line * max_width * 3 / 2);
+		} else {
+			snprintf(name, sizeof(name), "vi.%d", i);
+			rk_mb_budget_add(plan, name, stream->vi_buf_count,
+			                 rk_mb_yuv420sp_bytes(max_width, max_height));
+		}
+		if (!strcmp(rk_mb_stream_get_string(i, "output_data_type", "H.264"), "NV12"))
+			continue;
+		int width = rk_mb_stream_get_int(i, "width", 1920);
+		int height = rk_mb_stream_get_int(i, "height", 1080);
+		snprintf(name, sizeof(name), "venc.%d stream", i);
+		rk_mb_budget_add(plan, name, stream->venc_buf_count,
+		                 rk_mb_stream_get_int(i, "buffer_size", width * height / 2));
+		// reconstructed and reference frames, smartP and tsvc keep one more
+		int ref_num = rk_param_get_int("mb_budget:venc_ref_num", 2);
+		if (strcmp(rk_mb_stream_get_string(i, "gop_mode", "normalP"), "normalP"))
+			ref_num++;
+		snprintf(name, sizeof(name), "venc.%d ref", i);
+		rk_mb_budget_add(plan, name, ref_num,
+		                 RK_MB_ALIGN(max_width, 64) * RK_MB_ALIGN(max_height, 64) * 3 / 2);
+	}
+
+	plan->npu_vi_buf_count = 0;
+	if (enable_npu || enable_ivs || share_npu_vi) {
+		// vi and ivs ping-pong, one more for the npu and one for a bound encoder
+		plan->npu_vi_buf_count = 2 + (enable_npu ? 1 : 0) + (share_npu_vi ? 1 : 0);
+		if (enable_npu)
+			plan->npu_vi_buf_count += plan->export_hold;
+		rk_mb_budget_add(plan, "vi.npu", plan->npu_vi_buf_count,
+		                 rk_mb_yuv420sp_bytes(rk_param_get_int("video.2:max_width", 960),
+		                                      rk_param_get_int("video.2:max_height", 540)));
+	}
+	rk_mb_budget_add(plan, "vi.vo", plan->vo_vi_buf_count, rk_mb_yuv420sp_bytes(1920, 1080));
+	rk_mb_budget_add(plan, "jpeg stream", plan->jpeg_buf_count,
+	                 rk_param_get_int("video.jpeg:jpeg_buffer_size", 204800));
+	if (plan->autoframe) {
+		// the sub stream resolution unless set
+		int width =
+		    rk_param_get_int("video.autoframe:width", rk_mb_stream_get_int(1, "width", 1920));
+		int height =
+		    rk_param_get_int("video.autoframe:height", rk_mb_stream_get_int(1, "height", 1080));
+		rk_mb_budget_add(plan, "autoframe", plan->autoframe_pool_count,
+		                 rk_mb_yuv420sp_bytes(width, height));
+		rk_mb_budget_add(plan, "venc.af stream", plan->autoframe_venc_buf_count,
+		                 (unsigned long long)width * height / 2);
+		rk_mb_budget_add(plan, "venc.af ref", rk_param_get_int("mb_budget:venc_ref_num", 2),
+		                 RK_MB_ALIGN(width, 64) * RK_MB_ALIGN(height, 64) * 3 / 2);
+	}
+	if (enable_npu)
+		rk_mb_budget_add(plan, "npu", 1, rk_param_get_int("mb_budget:npu_kb", 24576) * 1024ULL);
+	// isp, rga and osd buffers the planner does not model one by one
+	rk_mb_budget_add(plan, "reserved", 1,
+	                 rk_param_get_int("mb_budget:reserved_kb", 16384) * 1024ULL);
+}
+
+// one step at a time: deep queues first, then the sub streams, the main stream always stays
+static int rk_mb_budget_downgrade(rk_mb_budget_plan_s *plan) {
+	for (int i = RK_MB_BUDGET_MAX_STREAM - 1; i >= 0; i--) {
+		rk_mb_budget_stream_s *stream = &plan->stream[i];
+		// auto framing and its exported frames are held on top of the ping-pong pair
+		int min_count = RK_MB_MIN_BUF_COUNT;
+		if (i == 0 && plan->autoframe)
+			min_count += 1 + plan->export_hold;
+		if (stream->enable && !stream->share_vi && stream->vi_buf_count > min_count) {
+			stream->vi_buf_count--;
+			LOG_WARN("video.%d: vi buffers down to %d\n", i, stream->vi_buf_count);
+			return 0;
+		}
+	}
+	for (int i = RK_MB_BUDGET_MAX_STREAM - 1; i >= 0; i--) {
+		rk_mb_budget_stream_s *stream = &plan->stream[i];
+		if (stream->enable && stream->venc_buf_count > RK_MB_MIN_BUF_COUNT) {
+			stream->venc_buf_count--;
+			LOG_WARN("video.%d: venc stream buffers down to %d\n", i, stream->venc_buf_count);
+			return 0;
+		}
+	}
+	if (plan->vo_vi_buf_count > RK_MB_MIN_BUF_COUNT) {
+		plan->vo_vi_buf_count--;
+		LOG_WARN("vo: vi buffers down to %d\n", plan->vo_vi_buf_count);
+		return 0;
+	}
+	if (plan->autoframe) {
+		plan->autoframe = 0;
+		plan->stream[0].vi_buf_count -= 1 + plan->export_hold;
+		LOG_WARN("video.autoframe: disabled, it does not fit the media buffer budget\n");
+		return 0;
+	}
+	for (int i = RK_MB_BUDGET_MAX_STREAM - 1; i > 0; i--) {
+		if (plan->stream[i].enable) {
+			plan->stream[i].enable = 0;
+			LOG_WARN("video.%d: disabled, it does not fit the media buffer budget\n", i);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int rk_mb_budget_plan(rk_mb_budget_plan_s *plan, unsigned long long budget_bytes) {
+	RKIPC_CHECK_POINTER(plan, -1);
+	const char *policy = rk_param_get_string("mb_budget:policy", "downgrade");
+
+	rk_mb_budget_load(plan);
+	plan->budget_bytes = budget_bytes;
+	rk_mb_budget_count(plan);
+	while (budget_bytes && plan->total_bytes > budget_bytes && !strcmp(policy, "downgrade")) {
+		if (rk_mb_budget_downgrade(plan))
+			break;
+		plan->downgrade_count++;
+		rk_mb_budget_count(plan);
+	}
+	plan->fits = !budget_bytes || plan->total_bytes <= budget_bytes;
+	if (plan->fits)
+		return 0;
+	if (!strcmp(policy, "warn")) {
+		LOG_WARN("need %llu KB of %llu KB, start anyway\n", plan->total_bytes / 1024,
+		         budget_bytes / 1024);
+		return 0;
+	}
+	LOG_ERROR("need %llu KB of %llu KB, not starting with policy %s\n", plan->total_bytes / 1024,
+	          budget_bytes / 1024, policy);
+
+	return -1;
+}
+
+unsigned long long rk_mb_budget_get_limit() {
+	unsigned long long total_kb = rk_param_get_int("mb_budget:total_kb", 0);
+	if (total_kb)
+		return total_kb * 1024;
+	// the rockit mb pools come out of the cma area
+	FILE *fp = fopen("/proc/meminfo", "r");
+	if (!fp)
+		return 0;
+	char line[128];
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "CmaTotal: %llu kB", &total_kb) == 1)
+			break;
+	}
+	fclose(fp);
+
+	return total_kb * 1024;
+}
+
+int rk_mb_budget_dump(const rk_mb_budget_plan_s *plan, char *value, int size) {
+	RKIPC_CHECK_POINTER(plan, -1);
+	RKIPC_CHECK_POINTER(value, -1);
+	int len = 0;
+
+	len += snprintf(value + len, size - len, "%-16s %5s %10s %10s\n", "pool", "count", "unit_kb",
+	                "total_kb");
+	for (int i = 0; i < plan->entry_count && len < size; i++) {
+		const rk_mb_budget_entry_s *entry = &plan->entry[i];
+		len += snprintf(value + len, size - len, "%-16s %5d %10llu %10llu\n", entry->name,
+		                entry->count, entry->unit_bytes / 1024, entry->bytes / 1024);
+	}
+	for (int i = 0; i < RK_MB_BUDGET_MAX_STREAM && len < size; i++) {
+		const rk_mb_budget_stream_s *stream = &plan->stream[i];
+		len += snprintf(value + len, size - len, "video.%d: enable %d, vi %d%s, venc %d\n", i,
+		                stream->enable, stream->vi_buf_count,
+		                stream->share_vi ? " (npu channel)" : "", stream->venc_buf_count);
+	}
+	if (len < size)
+		len += snprintf(value + len, size - len, "autoframe: enable %d, pool %d, venc %d\n",
+		                plan->autoframe, plan->autoframe_pool_count,
+		                plan->autoframe_venc_buf_count);
+	if (len < size) {
+		if (plan->budget_bytes)
+			len += snprintf(value + len, size - len,
+			                "total %llu KB of %llu KB, %s, %d downgrades\n",
+			                plan->total_bytes / 1024, plan->budget_bytes / 1024,
+			                plan->fits ? "fits" : "does not fit", plan->downgrade_count);
+		else
+			len += snprintf(value + len, size - len, "total %llu KB, budget unknown\n",
+			                plan->total_bytes / 1024);
+	}
+
+	return len < size ? 0 : -1;
+}
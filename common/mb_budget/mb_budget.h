@@ -0,0 +1,62 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_MB_BUDGET_H__
+#define __RKIPC_MB_BUDGET_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RK_MB_BUDGET_MAX_STREAM 3
+#define RK_MB_BUDGET_MAX_ENTRY 20
+// the vi channel shared by npu, ivs and the encoder of video.N:vi_chn_id = 4
+#define RK_MB_BUDGET_NPU_VI_CHN 4
+
+typedef struct {
+	char name[24];
+	int count;
+	unsigned long long unit_bytes;
+	unsigned long long bytes;
+} rk_mb_budget_entry_s;
+
+typedef struct {
+	int enable;
+	int share_vi;       // bound to the npu/ivs channel, vi_buf_count is unused then
+	int vi_buf_count;   // stIspOpt.u32BufCount of its own vi channel
+	int venc_buf_count; // u32StreamBufCnt
+} rk_mb_budget_stream_s;
+
+// every buffer count the video pipeline allocates with, read by video.cc instead of the ini
+typedef struct {
+	rk_mb_budget_stream_s stream[RK_MB_BUDGET_MAX_STREAM];
+	int npu_vi_buf_count; // 0 when the npu/ivs channel is not created
+	int vo_vi_buf_count;  // 0 when vo is disabled
+	int jpeg_buf_count;   // 0 when jpeg is disabled
+	int autoframe;        // video.autoframe, cropped from the vi channel of video.0
+	int autoframe_pool_count;
+	int autoframe_venc_buf_count;
+	int export_hold; // frame_export:max_hold, 0 when frame_export is disabled
+	unsigned long long total_bytes;
+	unsigned long long budget_bytes; // 0 when unknown, nothing is checked then
+	int downgrade_count;
+	int fits;
+	int entry_count;
+	rk_mb_budget_entry_s entry[RK_MB_BUDGET_MAX_ENTRY];
+} rk_mb_budget_plan_s;
+
+// mb_budget:total_kb, or CmaTotal of /proc/meminfo when that is 0
+unsigned long long rk_mb_budget_get_limit();
+// Plan the media buffers of the configured pipeline before anything is allocated, 0
+// budget_bytes only plans. With mb_budget:policy = downgrade the buffer counts, then the
+// auto framing stream and the sub streams are dropped until the plan fits. Return 0 when
+// the pipeline may start, -1 when it must not
+int rk_mb_budget_plan(rk_mb_budget_plan_s *plan, unsigned long long budget_bytes);
+// per pool breakdown as text, one line per entry
+int rk_mb_budget_dump(const rk_mb_budget_plan_s *plan, char *value, int size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,213 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "media_clock.h"
+#include "common.h"
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "media_clock.c"
+
+// The offset of a source is the lowest arrival - pts seen in a window: the capture to arrival
+// latency without its jitter, plus the distance between the source clock and the monotonic
+// one. How it moves from window to window is the drift of the source clock.
+typedef struct {
+	const char *name;
+	unsigned long long samples;
+	int foreign; // the pts is not on CLOCK_MONOTONIC at all, the offset maps it
+	int locked;  // a full window was seen
+	int64_t window_min;
+	int64_t window_start_us;
+	int64_t base;    // offset of the first window
+	int64_t base_us; // when it ended
+	int64_t offset;  // offset of the last window
+	int64_t correction;
+	double drift_ppm;
+	unsigned int resyncs;
+} rk_media_clock_source_s;
+
+static pthread_mutex_t g_media_clock_mutex = PTHREAD_MUTEX_INITIALIZER;
+static rk_media_clock_source_s g_source[RK_MEDIA_CLOCK_SOURCE_NUM] = {{.name = "video"},
+                                                                       {.name = "audio"}};
+static int64_t g_window_us = 2000000;
+static int64_t g_max_slew_us = 1000;
+static int64_t g_foreign_us = 1000000;
+static int64_t g_utc_step_us = 100000;
+// CLOCK_REALTIME - CLOCK_MONOTONIC, sampled once a second
+static int g_utc_valid;
+static int64_t g_utc_offset_us;
+static int64_t g_utc_sampled_us;
+static unsigned int g_utc_steps;
+static int64_t g_utc_last_step_ms;
+
+static int64_t rk_media_clock_now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void rk_media_clock_reset_source(rk_media_clock_source_s *source) {
+	const char *name = source->name;
+	unsigned int resyncs = source->resyncs;
+	memset(source, 0, sizeof(*source));
+	source->name = name;
+	source->resyncs = resyncs;
+}
+
+int rk_media_clock_init() {
+	pthread_mutex_lock(&g_media_clock_mutex);
+	g_window_us = rk_param_get_int("media_clock:window_ms", 2000) * 1000LL;
+	g_max_slew_us = rk_param_get_int("media_clock:max_slew_us", 1000);
+	g_foreign_us = rk_param_get_int("media_clock:foreign_ms", 1000) * 1000LL;
+	g_utc_step_us = rk_param_get_int("media_clock:utc_step_ms", 100) * 1000LL;
+	for (int i = 0; i < RK_MEDIA_CLOCK_SOURCE_NUM; i++) {
+		g_source[i].resyncs = 0;
+		rk_media_clock_reset_source(&g_source[i]);
+	}
+	g_utc_valid = 0;
+	g_utc_steps = 0;
+	pthread_mutex_unlock(&g_media_clock_mutex);
+	LOG_INFO("window %lld ms, max slew %lld us\n", (long long)g_window_us / 1000,
+	         (long long)g_max_slew_us);
+
+	return 0;
+}
+
+int rk_media_clock_deinit() {
+	char stats[1024];
+	if (!rk_media_clock_get_stats(stats, sizeof(stats)))
+		LOG_INFO("%s\n", stats);
+
+	return 0;
+}
+
+// called with g_media_clock_mutex held, at the end of each window
+static void rk_media_clock_update(rk_media_clock_source_s *source, int reference,
+                                  int64_t now) {
+	int first = !source->locked;
+	source->offset = source->window_min;
+	if (first) {
+		source->locked = 1;
+		source->base = source->offset;
+		source->base_us = now;
+	} else if (now > source->base_us) {
+		source->drift_ppm = (double)(source->offset - source->base) * 1000000.0 /
+		                    (double)(now - source->base_us);
+	}
+	// a monotonic source only gets its drift since the first window corrected, its latency is
+	// real. The reference is left alone, the others are pulled onto it
+	int64_t target;
+	if (source->foreign)
+		target = source->offset;
+	else
+		target = reference ? 0 : source->offset - source->base;
+	int64_t step = target - source->correction;
+	// slewed so that the timeline of the source never jumps, except when it is first mapped
+	if (!first || !source->foreign) {
+		if (step > g_max_slew_us)
+			step = g_max_slew_us;
+		else if (step < -g_max_slew_us)
+			step = -g_max_slew_us;
+	}
+	source->correction += step;
+	source->window_min = INT64_MAX;
+	source->window_start_us = now;
+}
+
+int64_t rk_media_clock_map(rk_media_clock_source source_id, int64_t pts) {
+	if (source_id < 0 || source_id >= RK_MEDIA_CLOCK_SOURCE_NUM)
+		return pts;
+	rk_media_clock_source_s *source = &g_source[source_id];
+	int64_t now = rk_media_clock_now_us();
+	int64_t delta = now - pts;
+
+	pthread_mutex_lock(&g_media_clock_mutex);
+	// the source restarted or its clock was set, map it again from scratch. A consumer late by
+	// more than foreign_ms looks the same, it only costs a resync
+	if (source->locked && llabs(delta - source->offset) > g_foreign_us) {
+		LOG_WARN("%s pts jumped by %lld ms, resync\n", source->name,
+		         (long long)(source->offset - delta) / 1000);
+		rk_media_clock_reset_source(source);
+		source->resyncs++;
+	}
+	if (!source->samples++) {
+		source->foreign = llabs(delta) > g_foreign_us;
+		// until the first window is over the arrival time is the best guess
+		source->correction = source->foreign ? delta : 0;
+		source->window_min = delta;
+		source->window_start_us = now;
+		if (source->foreign)
+			LOG_INFO("%s pts is %lld ms off the monotonic clock, mapped\n", source->name,
+			         (long long)delta / 1000);
+	} else if (delta < source->window_min) {
+		source->window_min = delta;
+	}
+	if (now - source->window_start_us >= g_window_us)
+		rk_media_clock_update(source, source_id == RK_MEDIA_CLOCK_VIDEO, now);
+	pts += source->correction;
+	pthread_mutex_unlock(&g_media_clock_mutex);
+
+	return pts;
+}
+
+// called with g_media_clock_mutex held
+static void rk_media_clock_refresh_utc(int64_t now) {
+	struct timespec mono_0, real, mono_1;
+	if (g_utc_valid && now - g_utc_sampled_us < 1000000)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &mono_0);
+	clock_gettime(CLOCK_REALTIME, &real);
+	clock_gettime(CLOCK_MONOTONIC, &mono_1);
+	int64_t mono_us = ((int64_t)mono_0.tv_sec * 1000000 + mono_0.tv_nsec / 1000 +
+	                   (int64_t)mono_1.tv_sec * 1000000 + mono_1.tv_nsec / 1000) /
+	                  2;
+	int64_t offset = (int64_t)real.tv_sec * 1000000 + real.tv_nsec / 1000 - mono_us;
+	// ntp slewing moves the offset a little every second, a step moves it at once
+	if (g_utc_valid && llabs(offset - g_utc_offset_us) >= g_utc_step_us) {
+		g_utc_steps++;
+		g_utc_last_step_ms = (offset - g_utc_offset_us) / 1000;
+		LOG_WARN("utc stepped by %lld ms\n", (long long)g_utc_last_step_ms);
+	}
+	g_utc_offset_us = offset;
+	g_utc_sampled_us = now;
+	g_utc_valid = 1;
+}
+
+int64_t rk_media_clock_to_utc_ms(int64_t pts) {
+	int64_t now = rk_media_clock_now_us();
+
+	pthread_mutex_lock(&g_media_clock_mutex);
+	rk_media_clock_refresh_utc(now);
+	int64_t utc_ms = (pts + g_utc_offset_us) / 1000;
+	pthread_mutex_unlock(&g_media_clock_mutex);
+
+	return utc_ms;
+}
+
+int rk_media_clock_get_stats(char *value, int size) {
+	int len;
+
+	pthread_mutex_lock(&g_media_clock_mutex);
+	rk_media_clock_refresh_utc(rk_media_clock_now_us());
+	len = snprintf(value, size,
+	               "{\"utc_offset_ms\":%lld,\"utc_steps\":%u,\"utc_last_step_ms\":%lld,"
+	               "\"sources\":[",
+	               (long long)g_utc_offset_us / 1000, g_utc_steps,
+	               (long long)g_utc_last_step_ms);
+	for (int i = 0; i < RK_MEDIA_CLOCK_SOURCE_NUM && len < size; i++) {
+		rk_media_clock_source_s *source = &g_source[i];
+		len += snprintf(value + len, size - len,
+		                "%s{\"name\":\"%s\",\"samples\":%llu,\"domain\":\"%s\","
+		                "\"offset_us\":%lld,\"drift_ppm\":%.2f,\"correction_us\":%lld,"
+		                "\"resyncs\":%u}",
+		                i ? "," : "", source->name, source->samples,
+		                source->foreign ? "foreign" : "monotonic", (long long)source->offset,
+		                source->drift_ppm, (long long)source->correction, source->resyncs);
+	}
+	pthread_mutex_unlock(&g_media_clock_mutex);
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+
+	return len < size ? 0 : -1;
+}
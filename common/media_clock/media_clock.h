@@ -0,0 +1,37 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_MEDIA_CLOCK_H__
+#define __RKIPC_MEDIA_CLOCK_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One time base for everything rkipc stamps: CLOCK_MONOTONIC in us. The vi pts already is,
+// the kernel takes it at capture, so video is the reference. The other capture clocks are
+// mapped onto it and their drift against it is tracked and corrected. UTC is derived from
+// the monotonic time with one shared offset, so every consumer gets the same utc for a pts
+// and an ntp step shows up as a counted step, not as jitter.
+typedef enum {
+	RK_MEDIA_CLOCK_VIDEO = 0,
+	RK_MEDIA_CLOCK_AUDIO,
+	RK_MEDIA_CLOCK_SOURCE_NUM,
+} rk_media_clock_source;
+
+int rk_media_clock_init();
+int rk_media_clock_deinit();
+// the pts of a capture as it arrives from source, returned on CLOCK_MONOTONIC in us
+int64_t rk_media_clock_map(rk_media_clock_source source, int64_t pts);
+// CLOCK_MONOTONIC in us to UTC in ms
+int64_t rk_media_clock_to_utc_ms(int64_t pts);
+// per source offset, drift and correction, and the utc steps seen
+int rk_media_clock_get_stats(char *value, int size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -27,6 +27,8 @@ static int g_osd_font_already_set = 0;
 static double g_x_rate = 1.0;
 static double g_y_rate = 1.0;
 static pthread_t osd_time_thread_id_;
+static int g_osd_latency_server_run_ = 0;
+static pthread_t osd_latency_thread_id_;
 static pthread_mutex_t g_osd_mutex = PTHREAD_MUTEX_INITIALIZER;
 static void *g_osd_signal;
 
@@ -331,6 +333,79 @@ static void *osd_time_server(void *arg) {
 	return NULL;
 }
 
+// burn the current CLOCK_MONOTONIC (the clock of the frame pts) and utc time into the video,
+// comparing a decoded frame with the viewer's clock gives the glass-to-glass latency
+static void generate_latency_probe(wchar_t *result) {
+	char text[MAX_WCH_BYTE] = {0};
+	struct timespec mono, real;
+	struct tm tm;
+
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	clock_gettime(CLOCK_REALTIME, &real);
+	gmtime_r(&real.tv_sec, &tm);
+	snprintf(text, sizeof(text), "%010lld %02d:%02d:%02d.%03ld",
+	         (long long)mono.tv_sec * 1000 + mono.tv_nsec / 1000000, tm.tm_hour, tm.tm_min,
+	         tm.tm_sec, real.tv_nsec / 1000000);
+	iconv_utf8_to_wchar(text, result);
+}
+
+static void *osd_latency_server(void *arg) {
+	printf("#Start %s thread, arg:%p\n", __func__, arg);
+	prctl(PR_SET_NAME, "osd_latency_server", 0, 0, 0);
+	int osd_id = (int)(intptr_t)arg;
+	char entry[128] = {'\0'};
+	osd_data_s osd_data;
+
+	memset(&osd_data, 0, sizeof(osd_data));
+	snprintf(entry, 127, "osd.%d:enabled", osd_id);
+	osd_data.enable = rk_param_get_int(entry, 0);
+	snprintf(entry, 127, "osd.%d:position_x", osd_id);
+	osd_data.origin_x = UPALIGNTO16((int)(rk_param_get_int(entry, -1) * g_x_rate));
+	snprintf(entry, 127, "osd.%d:position_y", osd_id);
+	osd_data.origin_y = UPALIGNTO16((int)(rk_param_get_int(entry, -1) * g_y_rate));
+	snprintf(entry, 127, "osd.%d:interval_ms", osd_id);
+	int interval_ms = rk_param_get_int(entry, 33);
+	if (interval_ms < 10)
+		interval_ms = 10;
+	osd_data.text.font_size = rk_param_get_int("osd.common:font_size", -1);
+	sscanf(rk_param_get_string("osd.common:font_color", NULL), "%x", &osd_data.text.font_color);
+	osd_data.text.color_inverse = 1;
+	osd_data.text.font_path = rk_param_get_string("osd.common:font_path", NULL);
+
+	// the region can not be resized while attached, size it once for the widest digits
+	iconv_utf8_to_wchar("0000000000 00:00:00.000", osd_data.text.wch);
+	osd_data.width = UPALIGNTO16(wstr_get_actual_advance_x(osd_data.text.wch) + 16);
+	osd_data.height = UPALIGNTO16(osd_data.text.font_size);
+	osd_data.size = osd_data.width * osd_data.height * 4; // BGRA8888 4byte
+	osd_data.buffer = malloc(osd_data.size);
+	// the run flag belongs to init and deinit, deinit still joins this thread
+	if (!osd_data.buffer) {
+		LOG_ERROR("malloc %u fail\n", osd_data.size);
+		return NULL;
+	}
+	memset(osd_data.buffer, 0, osd_data.size);
+	generate_latency_probe(osd_data.text.wch);
+	fill_text(&osd_data);
+	if (rk_osd_bmp_create_(osd_id, &osd_data)) {
+		LOG_ERROR("rk_osd_bmp_create_ fail\n");
+		free(osd_data.buffer);
+		return NULL;
+	}
+	LOG_INFO("latency probe on osd %d, every %d ms\n", osd_id, interval_ms);
+
+	while (g_osd_server_run_ && g_osd_latency_server_run_) {
+		usleep(interval_ms * 1000);
+		memset(osd_data.buffer, 0, osd_data.size);
+		generate_latency_probe(osd_data.text.wch);
+		fill_text(&osd_data);
+		rk_osd_bmp_change_(osd_id, &osd_data);
+	}
+	free(osd_data.buffer);
+	LOG_INFO("exit\n");
+
+	return NULL;
+}
+
 int rk_osd_init() {
 	LOG_DEBUG("%s\n", __func__);
 	pthread_mutex_lock(&g_osd_mutex);
@@ -437,6 +512,14 @@ int rk_osd_init() {
 				}
 				rk_osd_bmp_create_(i, &osd_data);
 				free(osd_data.buffer);
+			} else if (!strcmp(osd_type, "latencyProbe")) {
+				g_osd_server_run_ = 1;
+				g_osd_latency_server_run_ = 1;
+				if (pthread_create(&osd_latency_thread_id_, NULL, osd_latency_server,
+				                   (void *)(intptr_t)i)) {
+					LOG_ERROR("create latency probe thread fail\n");
+					g_osd_latency_server_run_ = 0;
+				}
 			} else if (!strcmp(osd_type, "dateTime")) {
 				g_osd_server_run_ = 1;
 				pthread_create(&osd_time_thread_id_, NULL, osd_time_server, NULL);
@@ -469,6 +552,10 @@ int rk_osd_deinit() {
 		rk_signal_destroy(g_osd_signal);
 		g_osd_signal = NULL;
 	}
+	if (g_osd_latency_server_run_) {
+		g_osd_latency_server_run_ = 0;
+		pthread_join(osd_latency_thread_id_, NULL);
+	}
 	for (int i = 0; i < MAX_OSD_NUM; i++) {
 		snprintf(entry, 127, "osd.%d:type", i);
 		osd_type = rk_param_get_string(entry, NULL);
@@ -482,7 +569,7 @@ int rk_osd_deinit() {
 
 		if (!strcmp(osd_type, "channelName")) {
 			rk_osd_bmp_destroy_(i);
-		} else if (!strcmp(osd_type, "dateTime")) {
+		} else if (!strcmp(osd_type, "dateTime") || !strcmp(osd_type, "latencyProbe")) {
 			rk_osd_bmp_destroy_(i);
 		} else if (!strcmp(osd_type, "character")) {
 			rk_osd_bmp_destroy_(i);
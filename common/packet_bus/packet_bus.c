@@ -0,0 +1,464 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "packet_bus.h"
+#include "common.h"
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "packet_bus.c"
+
+// slab classes: 4K, 16K, 64K, 256K, 1M, 4M, larger packets are malloc'ed directly
+#define RK_PACKET_SLAB_CLASS_NUM 6
+#define RK_PACKET_SLAB_MIN_SHIFT 12
+#define RK_PACKET_SLAB_CACHE_BYTES (4 * 1024 * 1024) // cached free bytes per class
+
+typedef struct {
+	rk_packet_s *free_list;
+	int free_count;
+	int max_free;
+	unsigned int size;
+} rk_packet_slab_s;
+
+typedef struct {
+	int used;
+	int run;
+	char name[32];
+	int stream_id;
+	int depth;
+	rk_packet_drop_policy policy;
+	rk_packet_consumer_cb cb;
+	void *arg;
+	pthread_t tid;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	rk_packet_s **queue;
+	int head;
+	int count;
+	int wait_key;
+	// stats
+	unsigned long long delivered;
+	unsigned long long dropped;
+	int max_count;
+	long long max_cb_ms;
+} rk_packet_consumer_s;
+
+static rk_packet_slab_s g_slab[RK_PACKET_SLAB_CLASS_NUM];
+static pthread_mutex_t g_slab_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t g_bus_lock = PTHREAD_RWLOCK_INITIALIZER;
+static rk_packet_consumer_s g_consumer[RK_PACKET_BUS_MAX_STREAM][RK_PACKET_BUS_MAX_CONSUMER];
+static unsigned long long g_published[RK_PACKET_BUS_MAX_STREAM];
+
+int rk_packet_bus_init() {
+	pthread_mutex_lock(&g_slab_mutex);
+	for (int i = 0; i < RK_PACKET_SLAB_CLASS_NUM; i++) {
+		g_slab[i].size = 1u << (RK_PACKET_SLAB_MIN_SHIFT + 2 * i);
+		g_slab[i].max_free = RK_PACKET_SLAB_CACHE_BYTES / g_slab[i].size;
+		if (g_slab[i].max_free < 2)
+			g_slab[i].max_free = 2;
+	}
+	pthread_mutex_unlock(&g_slab_mutex);
+	LOG_INFO("packet bus init\n");
+
+	return 0;
+}
+
+int rk_packet_bus_deinit() {
+	for (int i = 0; i < RK_PACKET_BUS_MAX_STREAM * RK_PACKET_BUS_MAX_CONSUMER; i++)
+		rk_packet_bus_unsubscribe(i);
+
+	pthread_mutex_lock(&g_slab_mutex);
+	for (int i = 0; i < RK_PACKET_SLAB_CLASS_NUM; i++) {
+		while (g_slab[i].free_list) {
+			rk_packet_s *packet = g_slab[i].free_list;
+			g_slab[i].free_list = packet->next;
+			free(packet);
+		}
+		g_slab[i].free_count = 0;
+	}
+	pthread_mutex_unlock(&g_slab_mutex);
+	LOG_INFO("packet bus deinit\n");
+
+	return 0;
+}
+
+rk_packet_s *rk_packet_alloc(unsigned int len) {
+	rk_packet_s *packet = NULL;
+	int slab_class = -1;
+	unsigned int capacity = len;
+
+	for (int i = 0; i < RK_PACKET_SLAB_CLASS_NUM; i++) {
+		if (len <= (1u << (RK_PACKET_SLAB_MIN_SHIFT + 2 * i))) {
+			slab_class = i;
+			capacity = 1u << (RK_PACKET_SLAB_MIN_SHIFT + 2 * i);
+			break;
+		}
+	}
+	if (slab_class >= 0) {
+		pthread_mutex_lock(&g_slab_mutex);
+		packet = g_slab[slab_class].free_list;
+		if (packet) {
+			g_slab[slab_class].free_list = packet->next;
+			g_slab[slab_class].free_count--;
+		}
+		pthread_mutex_unlock(&g_slab_mutex);
+	}
+	if (!packet) {
+		packet = (rk_packet_s *)malloc(sizeof(rk_packet_s) + capacity);
+		if (!packet) {
+			LOG_ERROR("malloc packet %u fail\n", len);
+			return NULL;
+		}
+	}
+	memset(packet, 0, sizeof(rk_packet_s));
+	packet->frame_end = 1;
+	packet->data = (unsigned char *)(packet + 1);
+	packet->len = len;
+	packet->capacity = capacity;
+	packet->slab_class = slab_class;
+	packet->ref = 1;
+
+	return packet;
+}
+
+rk_packet_s *rk_packet_ref(rk_packet_s *packet) {
+	if (packet)
+		__atomic_add_fetch(&packet->ref, 1, __ATOMIC_RELAXED);
+	return packet;
+}
+
+void rk_packet_unref(rk_packet_s *packet) {
+	if (!packet || __atomic_sub_fetch(&packet->ref, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
+
+	int slab_class = packet->slab_class;
+	if (slab_class >= 0) {
+		pthread_mutex_lock(&g_slab_mutex);
+		if (g_slab[slab_class].free_count < g_slab[slab_class].max_free) {
+			packet->next = g_slab[slab_class].free_list;
+			g_slab[slab_class].free_list = packet;
+			g_slab[slab_class].free_count++;
+			packet = NULL;
+		}
+		pthread_mutex_unlock(&g_slab_mutex);
+	}
+	if (packet)
+		free(packet);
+}
+
+static rk_packet_s *rk_packet_consumer_pop(rk_packet_consumer_s *consumer) {
+	rk_packet_s *packet = consumer->queue[consumer->head];
+	consumer->queue[consumer->head] = NULL;
+	consumer->head = (consumer->head + 1) % consumer->depth;
+	consumer->count--;
+	return packet;
+}
+
+static void rk_packet_consumer_flush(rk_packet_consumer_s *consumer) {
+	while (consumer->count > 0) {
+		rk_packet_unref(rk_packet_consumer_pop(consumer));
+		consumer->dropped++;
+	}
+}
+
+// called with consumer->mutex held
+static void rk_packet_consumer_push(rk_packet_consumer_s *consumer, rk_packet_s *packet) {
+	if (consumer->wait_key) {
+		if (!packet->key_frame) {
+			consumer->dropped++;
+			return;
+		}
+		consumer->wait_key = 0;
+	}
+	if (consumer->count == consumer->depth) {
+		switch (consumer->policy) {
+		case RK_PACKET_DROP_OLDEST:
+			rk_packet_unref(rk_packet_consumer_pop(consumer));
+			consumer->dropped++;
+			break;
+		case RK_PACKET_DROP_NEWEST:
+			consumer->dropped++;
+			return;
+		case RK_PACKET_DROP_TO_KEY:
+		default:
+			rk_packet_consumer_flush(consumer);
+			if (!packet->key_frame) {
+				consumer->wait_key = 1;
+				consumer->dropped++;
+				return;
+			}
+			break;
+		}
+		LOG_DEBUG("%s of stream %d is full, drop\n", consumer->name, consumer->stream_id);
+	}
+	consumer->queue[(consumer->head + consumer->count) % consumer->depth] = rk_packet_ref(packet);
+	consumer->count++;
+	if (consumer->count > consumer->max_count)
+		consumer->max_count = consumer->count;
+	pthread_cond_signal(&consumer->cond);
+}
+
+int rk_packet_bus_publish(rk_packet_s *packet) {
+	RKIPC_CHECK_POINTER(packet, -1);
+	if (packet->stream_id < 0 || packet->stream_id >= RK_PACKET_BUS_MAX_STREAM)
+		return -1;
+
+	pthread_rwlock_rdlock(&g_bus_lock);
+	g_published[packet->stream_id]++;
+	for (int i = 0; i < RK_PACKET_BUS_MAX_CONSUMER; i++) {
+		rk_packet_consumer_s *consumer = &g_consumer[packet->stream_id][i];
+		if (!consumer->used)
+			continue;
+		pthread_mutex_lock(&consumer->mutex);
+		rk_packet_consumer_push(consumer, packet);
+		pthread_mutex_unlock(&consumer->mutex);
+	}
+	pthread_rwlock_unlock(&g_bus_lock);
+
+	return 0;
+}
+
+int rk_packet_bus_write(int stream_id, const void *data, unsigned int len, int64_t pts,
+                        int key_frame) {
+	struct iovec iov;
+	iov.iov_base = (void *)data;
+	iov.iov_len = len;
+
+	return rk_packet_bus_writev(stream_id, &iov, 1, pts, key_frame);
+}
+
+int rk_packet_bus_writev(int stream_id, const struct iovec *iov, int iovcnt, int64_t pts,
+                         int key_frame) {
+	return rk_packet_bus_writev_slice(stream_id, iov, iovcnt, pts, key_frame, 1);
+}
+
+int rk_packet_bus_writev_slice(int stream_id, const struct iovec *iov, int iovcnt, int64_t pts,
+                               int key_frame, int frame_end) {
+	RKIPC_CHECK_POINTER(iov, -1);
+	unsigned int len = 0;
+	for (int i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+	rk_packet_s *packet = rk_packet_alloc(len);
+	if (!packet)
+		return -1;
+	unsigned int offset = 0;
+	for (int i = 0; i < iovcnt; i++) {
+		if (!iov[i].iov_len)
+			continue;
+		memcpy(packet->data + offset, iov[i].iov_base, iov[i].iov_len);
+		offset += iov[i].iov_len;
+		// more packs than slots, the tail shares the last one
+		if (packet->pack_count < RK_PACKET_MAX_PACK)
+			packet->pack_count++;
+		packet->pack_len[packet->pack_count - 1] += iov[i].iov_len;
+	}
+	packet->stream_id = stream_id;
+	packet->pts = pts;
+	packet->key_frame = key_frame;
+	packet->frame_end = frame_end;
+	int ret = rk_packet_bus_publish(packet);
+	rk_packet_unref(packet);
+
+	return ret;
+}
+
+int rk_packet_get_iov(const rk_packet_s *packet, struct iovec *iov, int max) {
+	RKIPC_CHECK_POINTER(packet, -1);
+	RKIPC_CHECK_POINTER(iov, -1);
+	if (max < 1)
+		return 0;
+	if (!packet->pack_count) {
+		iov[0].iov_base = packet->data;
+		iov[0].iov_len = packet->len;
+		return 1;
+	}
+	unsigned int offset = 0;
+	int count = 0;
+	for (int i = 0; i < packet->pack_count; i++) {
+		if (count < max) {
+			iov[count].iov_base = packet->data + offset;
+			iov[count].iov_len = packet->pack_len[i];
+			count++;
+		} else {
+			iov[count - 1].iov_len += packet->pack_len[i];
+		}
+		offset += packet->pack_len[i];
+	}
+
+	return count;
+}
+
+static void *rk_packet_consumer_thread(void *arg) {
+	rk_packet_consumer_s *consumer = (rk_packet_consumer_s *)arg;
+	char thread_name[16];
+	snprintf(thread_name, sizeof(thread_name), "Bus%d%.10s", consumer->stream_id % 10,
+	         consumer->name);
+	prctl(PR_SET_NAME, thread_name, 0, 0, 0);
+
+	while (1) {
+		pthread_mutex_lock(&consumer->mutex);
+		while (consumer->run && consumer->count == 0)
+			pthread_cond_wait(&consumer->cond, &consumer->mutex);
+		if (!consumer->run) {
+			pthread_mutex_unlock(&consumer->mutex);
+			break;
+		}
+		rk_packet_s *packet = rk_packet_consumer_pop(consumer);
+		pthread_mutex_unlock(&consumer->mutex);
+
+		long long start = rkipc_get_curren_time_ms();
+		consumer->cb(packet, consumer->arg);
+		long long cost = rkipc_get_curren_time_ms() - start;
+		rk_packet_unref(packet);
+
+		pthread_mutex_lock(&consumer->mutex);
+		consumer->delivered++;
+		if (cost > consumer->max_cb_ms)
+			consumer->max_cb_ms = cost;
+		pthread_mutex_unlock(&consumer->mutex);
+	}
+
+	return NULL;
+}
+
+int rk_packet_bus_subscribe(int stream_id, const char *name, int depth,
+                            rk_packet_drop_policy policy, rk_packet_consumer_cb cb, void *arg) {
+	RKIPC_CHECK_POINTER(cb, -1);
+	if (stream_id < 0 || stream_id >= RK_PACKET_BUS_MAX_STREAM || depth <= 0) {
+		LOG_ERROR("invalid stream_id %d or depth %d\n", stream_id, depth);
+		return -1;
+	}
+
+	pthread_rwlock_wrlock(&g_bus_lock);
+	int slot = -1;
+	for (int i = 0; i < RK_PACKET_BUS_MAX_CONSUMER; i++) {
+		if (!g_consumer[stream_id][i].used) {
+			slot = i;
+			break;
+		}
+	}
+	if (slot < 0) {
+		pthread_rwlock_unlock(&g_bus_lock);
+		LOG_ERROR("stream %d has no free consumer slot for %s\n", stream_id, name);
+		return -1;
+	}
+	rk_packet_consumer_s *consumer = &g_consumer[stream_id][slot];
+	memset(consumer, 0, sizeof(*consumer));
+	consumer->queue = (rk_packet_s **)calloc(depth, sizeof(rk_packet_s *));
+	if (!consumer->queue) {
+		pthread_rwlock_unlock(&g_bus_lock);
+		return -1;
+	}
+	snprintf(consumer->name, sizeof(consumer->name), "%s", name ? name : "unknown");
+	consumer->stream_id = stream_id;
+	consumer->depth = depth;
+	consumer->policy = policy;
+	consumer->cb = cb;
+	consumer->arg = arg;
+	// muxers can only start from a key frame
+	consumer->wait_key = policy == RK_PACKET_DROP_TO_KEY;
+	consumer->run = 1;
+	pthread_mutex_init(&consumer->mutex, NULL);
+	pthread_cond_init(&consumer->cond, NULL);
+	if (pthread_create(&consumer->tid, NULL, rk_packet_consumer_thread, consumer)) {
+		LOG_ERROR("create consumer thread %s fail\n", consumer->name);
+		pthread_mutex_destroy(&consumer->mutex);
+		pthread_cond_destroy(&consumer->cond);
+		free(consumer->queue);
+		consumer->queue = NULL;
+		pthread_rwlock_unlock(&g_bus_lock);
+		return -1;
+	}
+	consumer->used = 1;
+	pthread_rwlock_unlock(&g_bus_lock);
+	LOG_INFO("stream %d subscribe %s, depth %d, policy %d\n", stream_id, consumer->name, depth,
+	         policy);
+
+	return stream_id * RK_PACKET_BUS_MAX_CONSUMER + slot;
+}
+
+int rk_packet_bus_unsubscribe(int handle) {
+	if (handle < 0 || handle >= RK_PACKET_BUS_MAX_STREAM * RK_PACKET_BUS_MAX_CONSUMER)
+		return -1;
+	rk_packet_consumer_s *consumer =
+	    &g_consumer[handle / RK_PACKET_BUS_MAX_CONSUMER][handle % RK_PACKET_BUS_MAX_CONSUMER];
+
+	// stop publishing to it first, then the thread can be joined without the bus lock
+	pthread_rwlock_wrlock(&g_bus_lock);
+	if (!consumer->used) {
+		pthread_rwlock_unlock(&g_bus_lock);
+		return 0;
+	}
+	consumer->used = 0;
+	pthread_rwlock_unlock(&g_bus_lock);
+
+	pthread_mutex_lock(&consumer->mutex);
+	consumer->run = 0;
+	pthread_cond_signal(&consumer->cond);
+	pthread_mutex_unlock(&consumer->mutex);
+	pthread_join(consumer->tid, NULL);
+
+	rk_packet_consumer_flush(consumer);
+	LOG_INFO("stream %d unsubscribe %s, delivered %llu, dropped %llu\n", consumer->stream_id,
+	         consumer->name, consumer->delivered, consumer->dropped);
+	pthread_mutex_destroy(&consumer->mutex);
+	pthread_cond_destroy(&consumer->cond);
+	free(consumer->queue);
+	consumer->queue = NULL;
+
+	return 0;
+}
+
+unsigned long long rk_packet_bus_get_published(int stream_id) {
+	if (stream_id < 0 || stream_id >= RK_PACKET_BUS_MAX_STREAM)
+		return 0;
+	pthread_rwlock_rdlock(&g_bus_lock);
+	unsigned long long published = g_published[stream_id];
+	pthread_rwlock_unlock(&g_bus_lock);
+
+	return published;
+}
+
+int rk_packet_bus_get_stats(char *value, int size) {
+	RKIPC_CHECK_POINTER(value, -1);
+	int len = 0;
+
+	pthread_rwlock_rdlock(&g_bus_lock);
+	len += snprintf(value + len, size - len, "{\"streams\":[");
+	int first_stream = 1;
+	for (int s = 0; s < RK_PACKET_BUS_MAX_STREAM && len < size; s++) {
+		if (!g_published[s])
+			continue;
+		len += snprintf(value + len, size - len, "%s{\"id\":%d,\"published\":%llu,\"consumers\":[",
+		                first_stream ? "" : ",", s, g_published[s]);
+		first_stream = 0;
+		int first = 1;
+		for (int i = 0; i < RK_PACKET_BUS_MAX_CONSUMER && len < size; i++) {
+			rk_packet_consumer_s *consumer = &g_consumer[s][i];
+			if (!consumer->used)
+				continue;
+			pthread_mutex_lock(&consumer->mutex);
+			len += snprintf(value + len, size - len,
+			                "%s{\"name\":\"%s\",\"depth\":%d,\"queued\":%d,\"max_queued\":%d,"
+			                "\"delivered\":%llu,\"dropped\":%llu,\"max_cb_ms\":%lld}",
+			                first ? "" : ",", consumer->name, consumer->depth, consumer->count,
+			                consumer->max_count, consumer->delivered, consumer->dropped,
+			                consumer->max_cb_ms);
+			pthread_mutex_unlock(&consumer->mutex);
+			first = 0;
+		}
+		if (len < size)
+			len += snprintf(value + len, size - len, "]}");
+	}
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+	pthread_rwlock_unlock(&g_bus_lock);
+
+	if (len >= size) {
+		LOG_WARN("stats truncated, need %d bytes\n", len);
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_PACKET_BUS_H__
+#define __RKIPC_PACKET_BUS_H__
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RK_PACKET_BUS_MAX_STREAM 8
+#define RK_PACKET_BUS_MAX_CONSUMER 8
+#define RK_PACKET_MAX_PACK 8
+
+typedef enum {
+	RK_PACKET_DROP_OLDEST = 0, // drop the oldest queued packet
+	RK_PACKET_DROP_NEWEST,     // drop the incoming packet
+	RK_PACKET_DROP_TO_KEY,     // flush the queue and skip packets until the next key frame
+} rk_packet_drop_policy;
+
+typedef struct rk_packet_s {
+	int stream_id;
+	int key_frame;
+	int frame_end; // last packet of its access unit, 0 for the slices before the last of a frame
+	int64_t pts;
+	unsigned int len;
+	unsigned char *data;
+	// encoder packs laid out back to back in data, 0 means data is a single pack
+	int pack_count;
+	unsigned int pack_len[RK_PACKET_MAX_PACK];
+	// private, managed by the bus
+	int ref;
+	int slab_class;
+	unsigned int capacity;
+	struct rk_packet_s *next;
+} rk_packet_s;
+
+// called from the consumer's own thread, the packet is released after return
+typedef int (*rk_packet_consumer_cb)(rk_packet_s *packet, void *arg);
+
+int rk_packet_bus_init();
+int rk_packet_bus_deinit();
+
+// packets come from a slab pool and are shared by all consumers with a reference count
+rk_packet_s *rk_packet_alloc(unsigned int len);
+rk_packet_s *rk_packet_ref(rk_packet_s *packet);
+void rk_packet_unref(rk_packet_s *packet);
+
+// never blocks on consumers, each consumer gets its own reference
+int rk_packet_bus_publish(rk_packet_s *packet);
+// copy data into a pooled packet and publish it
+int rk_packet_bus_write(int stream_id, const void *data, unsigned int len, int64_t pts,
+                        int key_frame);
+// gather the encoder packs straight into a pooled packet, their boundaries are kept
+int rk_packet_bus_writev(int stream_id, const struct iovec *iov, int iovcnt, int64_t pts,
+                         int key_frame);
+// the same for one slice of a frame, frame_end is set on its last slice
+int rk_packet_bus_writev_slice(int stream_id, const struct iovec *iov, int iovcnt, int64_t pts,
+                               int key_frame, int frame_end);
+// one iovec per pack pointing into the packet data, for writev/sendmsg, return the count
+int rk_packet_get_iov(const rk_packet_s *packet, struct iovec *iov, int max);
+
+// return a handle >= 0 on success
+int rk_packet_bus_subscribe(int stream_id, const char *name, int depth,
+                            rk_packet_drop_policy policy, rk_packet_consumer_cb cb, void *arg);
+int rk_packet_bus_unsubscribe(int handle);
+// number of packets published on the stream since init
+unsigned long long rk_packet_bus_get_published(int stream_id);
+int rk_packet_bus_get_stats(char *value, int size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -143,6 +143,16 @@ int rk_param_deinit() {
 	return 0;
 }
 
+int rk_param_close() {
+	pthread_mutex_lock(&g_param_mutex);
+	if (g_ini_d_)
+		iniparser_freedict(g_ini_d_);
+	g_ini_d_ = NULL;
+	pthread_mutex_unlock(&g_param_mutex);
+
+	return 0;
+}
+
 int rk_param_reload() {
 	LOG_INFO("%s\n", __func__);
 	pthread_mutex_lock(&g_param_mutex);
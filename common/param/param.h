@@ -13,4 +13,6 @@ int rk_param_set_string(const char *entry, const char *val);
 int rk_param_save();
 int rk_param_init(char *ini_path);
 int rk_param_deinit();
+// drop the loaded ini without writing it back, for readers of a file they do not own
+int rk_param_close();
 int rk_param_reload();
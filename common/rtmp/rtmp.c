@@ -1,8 +1,14 @@
 // Copyright 2021 Rockchip Electronics Co., Ltd. All rights reserved.
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
+#include "rtmp.h"
 #include "common.h"
 #include "rkmuxer.h"
+#include <net/if.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <sys/time.h>
 
 #ifdef LOG_TAG
@@ -10,88 +16,479 @@
 #endif
 #define LOG_TAG "rtmp.c"
 
-static int g_rtmp_enable[3] = {0, 0, 0};
-static VideoParam g_video_param;
+#define RK_RTMP_MAX_SESSION 3
+#define RK_RTMP_QUEUE_SIZE 256
+
+typedef enum {
+	RK_RTMP_IDLE = 0,
+	RK_RTMP_CONNECTING,
+	RK_RTMP_LIVE,
+	RK_RTMP_BACKOFF,
+} rk_rtmp_state;
+
+static const char *g_rtmp_state_name[] = {"idle", "connecting", "live", "backoff"};
+
+typedef struct {
+	rk_packet_s *packet;
+	int audio;
+} rk_rtmp_entry_s;
+
+typedef struct {
+	int run;
+	pthread_t tid;
+	pthread_cond_t cond;
+	char url[256];
+	char key[128];
+	int reconnect; // url or key changed, or the video parameters
+	rk_rtmp_state state;
+	// written by the encoder side, drained by the session thread
+	rk_rtmp_entry_s queue[RK_RTMP_QUEUE_SIZE];
+	int head;
+	int count;
+	unsigned int queue_bytes;
+	int wait_key;
+	long long retry_ms;
+	int backoff_ms;
+	long long live_since_ms;
+	unsigned long long connects, failures, sent, sent_bytes, dropped, overflows;
+} rk_rtmp_session_s;
+
+// guards every session, the muxers are only touched by their session thread
 static pthread_mutex_t g_rtmp_mutex = PTHREAD_MUTEX_INITIALIZER;
-// static AudioParam g_audio_param;
+static rk_rtmp_session_s g_rtmp_session[RK_RTMP_MAX_SESSION];
+static int g_rtmp_queue_kb = 4096;
+static int g_rtmp_max_delay_ms = 3000;
+static int g_rtmp_backoff_min_ms = 1000;
+static int g_rtmp_backoff_max_ms = 30000;
+static int g_rtmp_connect_timeout_ms = 3000;
 
-int rk_rtmp_init(int id, const char *rtmp_url) {
-	int ret = 0;
+static rk_rtmp_session_s *rk_rtmp_get_session(int id) {
+	if (id < 0 || id >= RK_RTMP_MAX_SESSION)
+		return NULL;
+	return &g_rtmp_session[id];
+}
+
+static void rk_rtmp_get_video_param(int id, VideoParam *video_param) {
 	char entry[128] = {'\0'};
-	LOG_DEBUG("begin\n");
-	system("ifconfig lo up");
 
-	// set g_video_param
-	memset(&g_video_param, 0, sizeof(g_video_param));
-	g_video_param.level = 52;
+	memset(video_param, 0, sizeof(*video_param));
+	video_param->level = 52;
 	snprintf(entry, 127, "video.%d:width", id);
-	g_video_param.width = rk_param_get_int(entry, 1920);
+	video_param->width = rk_param_get_int(entry, 1920);
 	snprintf(entry, 127, "video.%d:height", id);
-	g_video_param.height = rk_param_get_int(entry, 1080);
+	video_param->height = rk_param_get_int(entry, 1080);
 	snprintf(entry, 127, "video.%d:max_rate", id);
-	g_video_param.bit_rate = rk_param_get_int(entry, 1024) * 1024;
+	video_param->bit_rate = rk_param_get_int(entry, 1024) * 1024;
 	snprintf(entry, 127, "video.%d:dst_frame_rate_den", id);
-	g_video_param.frame_rate_den = rk_param_get_int(entry, 1);
+	video_param->frame_rate_den = rk_param_get_int(entry, 1);
 	snprintf(entry, 127, "video.%d:dst_frame_rate_num", id);
-	g_video_param.frame_rate_num = rk_param_get_int(entry, 30);
+	video_param->frame_rate_num = rk_param_get_int(entry, 30);
 	snprintf(entry, 127, "video.%d:output_data_type", id);
 	const char *output_data_type = rk_param_get_string(entry, "H.264");
 	if (output_data_type)
-		memcpy(g_video_param.codec, output_data_type, strlen(output_data_type));
+		snprintf(video_param->codec, sizeof(video_param->codec), "%s", output_data_type);
 	snprintf(entry, 127, "video.%d:h264_profile", id);
 	const char *h264_profile = rk_param_get_string(entry, "high");
 	if (!strcmp(h264_profile, "high"))
-		g_video_param.profile = 100;
+		video_param->profile = 100;
 	else if (!strcmp(h264_profile, "main"))
-		g_video_param.profile = 77;
+		video_param->profile = 77;
 	else if (!strcmp(h264_profile, "baseline"))
-		g_video_param.profile = 66;
-	memcpy(g_video_param.format, "NV12", strlen("NV12"));
-	// set g_audio_param
-	// g_audio_param.channels = rk_param_get_int("audio.0:channels", 2);
-	// g_audio_param.sample_rate = rk_param_get_int("audio.0:sample_rate", 16000);
-	// g_audio_param.frame_size = rk_param_get_int("audio.0:frame_size", 1024);
-	// const char *format = rk_param_get_string("audio.0:format", NULL);
-	// if (format)
-	// 	memcpy(g_audio_param.format, format, strlen(format));
-	// const char *codec = rk_param_get_string("audio.0:encode_type", NULL);
-	// if (codec)
-	// 	memcpy(g_audio_param.codec, codec, strlen(codec));
+		video_param->profile = 66;
+	snprintf(video_param->format, sizeof(video_param->format), "NV12");
+}
+
+// the loopback may still be down this early in boot, the local nginx is reached through it
+static void rk_rtmp_loopback_up() {
+	struct ifreq ifr;
+	int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return;
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "lo");
+	if (!ioctl(fd, SIOCGIFFLAGS, &ifr) && !(ifr.ifr_flags & IFF_UP)) {
+		ifr.ifr_flags |= IFF_UP;
+		if (ioctl(fd, SIOCSIFFLAGS, &ifr))
+			LOG_WARN("bring lo up fail, %s\n", strerror(errno));
+	}
+	close(fd);
+}
+
+// rkmuxer blocks in connect for as long as the kernel retries, a dead ingest is found here
+// within timeout_ms instead
+static int rk_rtmp_probe(const char *url, int timeout_ms) {
+	char host[128], service[8];
+	struct addrinfo hints, *res, *ai;
+	const char *p = strstr(url, "://");
+	int tls = !strncmp(url, "rtmps", 5);
+
+	p = p ? p + 3 : url;
+	size_t len = strcspn(p, ":/");
+	if (!len || len >= sizeof(host))
+		return -1;
+	memcpy(host, p, len);
+	host[len] = '\0';
+	snprintf(service, sizeof(service), "%d",
+	         p[len] == ':' ? atoi(p + len + 1) : (tls ? 443 : 1935));
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, service, &hints, &res))
+		return -1;
+	int ret = -1;
+	for (ai = res; ai && ret; ai = ai->ai_next) {
+		int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			continue;
+		if (!connect(fd, ai->ai_addr, ai->ai_addrlen)) {
+			ret = 0;
+		} else if (errno == EINPROGRESS) {
+			struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+			int err = 0;
+			socklen_t err_len = sizeof(err);
+			if (poll(&pfd, 1, timeout_ms) == 1 &&
+			    !getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) && !err)
+				ret = 0;
+		}
+		close(fd);
+	}
+	freeaddrinfo(res);
+
+	return ret;
+}
+
+// called with g_rtmp_mutex held
+static void rk_rtmp_flush(rk_rtmp_session_s *session) {
+	while (session->count) {
+		rk_packet_unref(session->queue[session->head].packet);
+		session->head = (session->head + 1) % RK_RTMP_QUEUE_SIZE;
+		session->count--;
+	}
+	session->queue_bytes = 0;
+}
+
+static void rk_rtmp_full_url(const rk_rtmp_session_s *session, char *url, int size) {
+	int len = strlen(session->url);
+	if (!session->key[0])
+		snprintf(url, size, "%s", session->url);
+	else if (len && session->url[len - 1] == '/')
+		snprintf(url, size, "%s%s", session->url, session->key);
+	else
+		snprintf(url, size, "%s/%s", session->url, session->key);
+}
+
+static void rk_rtmp_wait_until(rk_rtmp_session_s *session, long long due_ms) {
+	struct timespec ts;
+	long long wait_ms = due_ms - rkipc_get_curren_time_ms();
+	if (wait_ms <= 0)
+		return;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += wait_ms / 1000;
+	ts.tv_nsec += (wait_ms % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	pthread_cond_timedwait(&session->cond, &g_rtmp_mutex, &ts);
+}
+
+// called with g_rtmp_mutex held, the connection is gone or never came up
+static void rk_rtmp_schedule_retry(rk_rtmp_session_s *session, int id) {
+	session->failures++;
+	session->state = RK_RTMP_BACKOFF;
+	session->retry_ms = rkipc_get_curren_time_ms() + session->backoff_ms;
+	LOG_WARN("rtmp %d: %s, retry in %d ms\n", id, session->url, session->backoff_ms);
+	session->backoff_ms *= 2;
+	if (session->backoff_ms > g_rtmp_backoff_max_ms)
+		session->backoff_ms = g_rtmp_backoff_max_ms;
+	rk_rtmp_flush(session);
+}
+
+static void *rk_rtmp_thread(void *arg) {
+	rk_rtmp_session_s *session = (rk_rtmp_session_s *)arg;
+	int id = session - g_rtmp_session;
+	int muxer_id = RKIPC_MUXER_ID_RTMP(id);
+	int connected = 0;
+	char url[sizeof(session->url) + sizeof(session->key)];
+	char name[16];
+	VideoParam video_param;
+
+	snprintf(name, sizeof(name), "RkipcRtmp%d", id);
+	prctl(PR_SET_NAME, name, 0, 0, 0);
 	pthread_mutex_lock(&g_rtmp_mutex);
-	rkmuxer_init(id + 3, "flv", rtmp_url, &g_video_param, NULL);
-	g_rtmp_enable[id] = 1;
+	session->backoff_ms = g_rtmp_backoff_min_ms;
+	while (session->run) {
+		if (session->reconnect) {
+			session->reconnect = 0;
+			session->retry_ms = 0;
+			session->backoff_ms = g_rtmp_backoff_min_ms;
+			session->state = RK_RTMP_CONNECTING;
+			rk_rtmp_flush(session);
+			if (connected) {
+				pthread_mutex_unlock(&g_rtmp_mutex);
+				rkmuxer_deinit(muxer_id);
+				pthread_mutex_lock(&g_rtmp_mutex);
+				connected = 0;
+			}
+			continue;
+		}
+		if (!connected) {
+			if (rkipc_get_curren_time_ms() < session->retry_ms) {
+				rk_rtmp_wait_until(session, session->retry_ms);
+				continue;
+			}
+			session->state = RK_RTMP_CONNECTING;
+			rk_rtmp_full_url(session, url, sizeof(url));
+			pthread_mutex_unlock(&g_rtmp_mutex);
+			rk_rtmp_get_video_param(id, &video_param);
+			int ret = rk_rtmp_probe(url, g_rtmp_connect_timeout_ms);
+			if (!ret)
+				ret = rkmuxer_init(muxer_id, "flv", url, &video_param, NULL);
+			pthread_mutex_lock(&g_rtmp_mutex);
+			if (ret) {
+				rk_rtmp_schedule_retry(session, id);
+				continue;
+			}
+			LOG_INFO("rtmp %d: connected to %s\n", id, session->url);
+			connected = 1;
+			session->connects++;
+			session->state = RK_RTMP_LIVE;
+			session->live_since_ms = rkipc_get_curren_time_ms();
+			// the flv header takes the parameter sets of the first key frame
+			rk_rtmp_flush(session);
+			session->wait_key = 1;
+			continue;
+		}
+		if (!session->count) {
+			pthread_cond_wait(&session->cond, &g_rtmp_mutex);
+			continue;
+		}
+		rk_rtmp_entry_s entry = session->queue[session->head];
+		session->head = (session->head + 1) % RK_RTMP_QUEUE_SIZE;
+		session->count--;
+		session->queue_bytes -= entry.packet->len;
+		pthread_mutex_unlock(&g_rtmp_mutex);
+		int ret = 0;
+		rk_packet_s *packet = entry.packet;
+		if (entry.audio)
+			rkmuxer_write_audio_frame(muxer_id, packet->data, packet->len, packet->pts);
+		else
+			ret = rkmuxer_write_video_frame(muxer_id, packet->data, packet->len, packet->pts,
+			                                packet->key_frame);
+		pthread_mutex_lock(&g_rtmp_mutex);
+		if (ret < 0) {
+			rk_packet_unref(packet);
+			pthread_mutex_unlock(&g_rtmp_mutex);
+			rkmuxer_deinit(muxer_id);
+			pthread_mutex_lock(&g_rtmp_mutex);
+			connected = 0;
+			rk_rtmp_schedule_retry(session, id);
+			continue;
+		}
+		session->sent++;
+		session->sent_bytes += packet->len;
+		// a key frame got through, the ingest really takes the stream
+		if (packet->key_frame)
+			session->backoff_ms = g_rtmp_backoff_min_ms;
+		rk_packet_unref(packet);
+	}
+	session->state = RK_RTMP_IDLE;
 	pthread_mutex_unlock(&g_rtmp_mutex);
+	if (connected)
+		rkmuxer_deinit(muxer_id);
 
-	return ret;
+	return NULL;
+}
+
+int rk_rtmp_init(int id, const char *url, const char *key) {
+	rk_rtmp_session_s *session = rk_rtmp_get_session(id);
+	RKIPC_CHECK_POINTER(session, -1);
+	RKIPC_CHECK_POINTER(url, -1);
+	LOG_DEBUG("begin\n");
+	rk_rtmp_loopback_up();
+
+	pthread_mutex_lock(&g_rtmp_mutex);
+	if (session->run) {
+		pthread_mutex_unlock(&g_rtmp_mutex);
+		return 0;
+	}
+	g_rtmp_queue_kb = rk_param_get_int("video.source:rtmp_queue_kb", 4096);
+	g_rtmp_max_delay_ms = rk_param_get_int("video.source:rtmp_max_delay_ms", 3000);
+	g_rtmp_backoff_min_ms = rk_param_get_int("video.source:rtmp_backoff_min_ms", 1000);
+	g_rtmp_backoff_max_ms = rk_param_get_int("video.source:rtmp_backoff_max_ms", 30000);
+	g_rtmp_connect_timeout_ms = rk_param_get_int("video.source:rtmp_connect_timeout_ms", 3000);
+	snprintf(session->url, sizeof(session->url), "%s", url);
+	snprintf(session->key, sizeof(session->key), "%s", key ? key : "");
+	session->reconnect = 0;
+	session->retry_ms = 0;
+	session->wait_key = 1;
+	session->state = RK_RTMP_CONNECTING;
+	session->connects = session->failures = 0;
+	session->sent = session->sent_bytes = session->dropped = session->overflows = 0;
+	pthread_cond_init(&session->cond, NULL);
+	session->run = 1;
+	if (pthread_create(&session->tid, NULL, rk_rtmp_thread, session)) {
+		LOG_ERROR("create rtmp %d thread fail\n", id);
+		session->run = 0;
+		session->state = RK_RTMP_IDLE;
+		pthread_cond_destroy(&session->cond);
+		pthread_mutex_unlock(&g_rtmp_mutex);
+		return -1;
+	}
+	pthread_mutex_unlock(&g_rtmp_mutex);
+
+	return 0;
 }
 
 int rk_rtmp_deinit(int id) {
+	rk_rtmp_session_s *session = rk_rtmp_get_session(id);
+	RKIPC_CHECK_POINTER(session, -1);
 	LOG_DEBUG("begin\n");
 	pthread_mutex_lock(&g_rtmp_mutex);
-	g_rtmp_enable[id] = 0;
-	rkmuxer_deinit(id + 3);
+	if (!session->run) {
+		pthread_mutex_unlock(&g_rtmp_mutex);
+		return 0;
+	}
+	session->run = 0;
+	pthread_cond_signal(&session->cond);
+	pthread_mutex_unlock(&g_rtmp_mutex);
+	// a write stuck on the uplink is waited for, the probe bounds the connect
+	pthread_join(session->tid, NULL);
+	pthread_mutex_lock(&g_rtmp_mutex);
+	rk_rtmp_flush(session);
+	pthread_cond_destroy(&session->cond);
 	pthread_mutex_unlock(&g_rtmp_mutex);
 	LOG_DEBUG("end\n");
 
 	return 0;
 }
 
-int rk_rtmp_write_video_frame(int id, unsigned char *buffer, unsigned int buffer_size,
-                              int64_t present_time, int key_frame) {
+int rk_rtmp_set_url(int id, const char *url, const char *key) {
+	rk_rtmp_session_s *session = rk_rtmp_get_session(id);
+	RKIPC_CHECK_POINTER(session, -1);
 	pthread_mutex_lock(&g_rtmp_mutex);
-	if (g_rtmp_enable[id])
-		rkmuxer_write_video_frame(id + 3, buffer, buffer_size, present_time, key_frame);
+	if (url)
+		snprintf(session->url, sizeof(session->url), "%s", url);
+	if (key)
+		snprintf(session->key, sizeof(session->key), "%s", key);
+	if (session->run) {
+		session->reconnect = 1;
+		pthread_cond_signal(&session->cond);
+	}
 	pthread_mutex_unlock(&g_rtmp_mutex);
 
 	return 0;
 }
 
-int rk_rtmp_write_audio_frame(int id, unsigned char *buffer, unsigned int buffer_size,
-                              int64_t present_time) {
-	if (g_rtmp_enable[id]) {
-		pthread_mutex_lock(&g_rtmp_mutex);
-		rkmuxer_write_audio_frame(id + 3, buffer, buffer_size, present_time);
+// called with g_rtmp_mutex held, the uplink does not keep up: start over at the next key frame
+static int rk_rtmp_overflow(rk_rtmp_session_s *session, const rk_packet_s *packet) {
+	if (session->count >= RK_RTMP_QUEUE_SIZE)
+		return 1;
+	if (session->queue_bytes + packet->len > (unsigned int)g_rtmp_queue_kb * 1024)
+		return 1;
+	const rk_packet_s *oldest = session->queue[session->head].packet;
+	return session->count && packet->pts - oldest->pts > (int64_t)g_rtmp_max_delay_ms * 1000;
+}
+
+static int rk_rtmp_push(int id, rk_packet_s *packet, int audio) {
+	rk_rtmp_session_s *session = rk_rtmp_get_session(id);
+	RKIPC_CHECK_POINTER(session, -1);
+	RKIPC_CHECK_POINTER(packet, -1);
+	pthread_mutex_lock(&g_rtmp_mutex);
+	// nothing queues while the ingest is away, the reconnect starts at a key frame anyway
+	if (!session->run || session->state != RK_RTMP_LIVE) {
 		pthread_mutex_unlock(&g_rtmp_mutex);
+		return 0;
 	}
+	if (!audio && packet->key_frame)
+		session->wait_key = 0;
+	if (session->wait_key) {
+		session->dropped++;
+		pthread_mutex_unlock(&g_rtmp_mutex);
+		return 0;
+	}
+	if (rk_rtmp_overflow(session, packet)) {
+		session->dropped += session->count;
+		session->overflows++;
+		rk_rtmp_flush(session);
+		if (audio || !packet->key_frame) {
+			session->dropped++;
+			session->wait_key = 1;
+			pthread_mutex_unlock(&g_rtmp_mutex);
+			return 0;
+		}
+	}
+	rk_rtmp_entry_s *entry =
+	    &session->queue[(session->head + session->count) % RK_RTMP_QUEUE_SIZE];
+	entry->packet = rk_packet_ref(packet);
+	entry->audio = audio;
+	session->count++;
+	session->queue_bytes += packet->len;
+	pthread_cond_signal(&session->cond);
+	pthread_mutex_unlock(&g_rtmp_mutex);
+
 	return 0;
 }
+
+int rk_rtmp_write_video_packet(int id, rk_packet_s *packet) {
+	return rk_rtmp_push(id, packet, 0);
+}
+
+int rk_rtmp_write_video_frame(int id, unsigned char *buffer, unsigned int buffer_size,
+                              int64_t present_time, int key_frame) {
+	rk_packet_s *packet = rk_packet_alloc(buffer_size);
+	if (!packet)
+		return -1;
+	memcpy(packet->data, buffer, buffer_size);
+	packet->stream_id = id;
+	packet->pts = present_time;
+	packet->key_frame = key_frame;
+	int ret = rk_rtmp_push(id, packet, 0);
+	rk_packet_unref(packet);
+
+	return ret;
+}
+
+int rk_rtmp_write_audio_frame(int id, unsigned char *buffer, unsigned int buffer_size,
+                              int64_t present_time) {
+	rk_packet_s *packet = rk_packet_alloc(buffer_size);
+	if (!packet)
+		return -1;
+	memcpy(packet->data, buffer, buffer_size);
+	packet->stream_id = id;
+	packet->pts = present_time;
+	int ret = rk_rtmp_push(id, packet, 1);
+	rk_packet_unref(packet);
+
+	return ret;
+}
+
+int rk_rtmp_get_stats(char *value, int size) {
+	long long now = rkipc_get_curren_time_ms();
+	int first = 1;
+	int len = snprintf(value, size, "{\"sessions\":[");
+
+	pthread_mutex_lock(&g_rtmp_mutex);
+	for (int i = 0; i < RK_RTMP_MAX_SESSION && len < size; i++) {
+		rk_rtmp_session_s *session = &g_rtmp_session[i];
+		if (!session->run)
+			continue;
+		// the stream key is a credential, only the ingest url is shown
+		len += snprintf(value + len, size - len,
+		                "%s{\"id\":%d,\"url\":\"%s\",\"state\":\"%s\",\"uptime_ms\":%lld,"
+		                "\"retry_in_ms\":%lld,\"connects\":%llu,\"failures\":%llu,"
+		                "\"queued\":%d,\"queued_kb\":%u,\"sent\":%llu,\"sent_kb\":%llu,"
+		                "\"dropped\":%llu,\"overflows\":%llu}",
+		                first ? "" : ",", i, session->url, g_rtmp_state_name[session->state],
+		                session->state == RK_RTMP_LIVE ? now - session->live_since_ms : 0,
+		                session->state == RK_RTMP_BACKOFF ? session->retry_ms - now : 0,
+		                session->connects, session->failures, session->count,
+		                session->queue_bytes / 1024, session->sent, session->sent_bytes / 1024,
+		                session->dropped, session->overflows);
+		first = 0;
+	}
+	pthread_mutex_unlock(&g_rtmp_mutex);
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+
+	return len < size ? 0 : -1;
+}
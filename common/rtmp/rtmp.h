@@ -5,18 +5,33 @@
 #ifndef __RTMP_DEMO_H__
 #define __RTMP_DEMO_H__
 
+#include "packet_bus.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-int rk_rtmp_init(int id, const char *rtmp_url);
+// Each session is published by its own thread from a bounded queue, the writers never wait
+// for the uplink. A slow uplink flushes the queue and skips to the next key frame, a lost
+// connection is retried with exponential backoff. Any rtmp server works as a sink, for a
+// local test:
+//
+//   ffmpeg -listen 1 -i rtmp://127.0.0.1:1935/live/mainstream -c copy sink.flv
+//
+// url is the ingest url, key the stream key appended to it, NULL or "" for none
+int rk_rtmp_init(int id, const char *url, const char *key);
 int rk_rtmp_deinit(int id);
+// reconnect to another ingest url or stream key, NULL keeps the current one
+int rk_rtmp_set_url(int id, const char *url, const char *key);
+// the session takes its own reference of the packet
+int rk_rtmp_write_video_packet(int id, rk_packet_s *packet);
 int rk_rtmp_write_video_frame(int id, unsigned char *buffer, unsigned int buffer_size,
                               int64_t present_time, int key_frame);
 int rk_rtmp_write_audio_frame(int id, unsigned char *buffer, unsigned int buffer_size,
                               int64_t present_time);
+int rk_rtmp_get_stats(char *value, int size);
 
 #ifdef __cplusplus
 }
 #endif
-#endif
\ No newline at end of file
+#endif
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 #include "common.h"
 #include "rtsp_demo.h"
+#include "rtsp_server.h"
 
 #ifdef LOG_TAG
 #undef LOG_TAG
@@ -14,20 +15,248 @@ rtsp_demo_handle g_rtsplive = NULL;
 rtsp_session_handle g_rtsp_session_0 = NULL;
 rtsp_session_handle g_rtsp_session_1 = NULL;
 rtsp_session_handle g_rtsp_session_2 = NULL;
-int64_t video_first_pts_0 = 0;
-int64_t audio_first_pts_0 = 0;
-int64_t video_audio_diff_pts_0 = 0;
-int64_t video_first_pts_1 = 0;
-int64_t audio_first_pts_1 = 0;
-int64_t video_audio_diff_pts_1 = 0;
-int64_t video_first_pts_2 = 0;
-int64_t audio_first_pts_2 = 0;
-int64_t video_audio_diff_pts_2 = 0;
+// video only sessions beyond the three streams, like the auto framing one
+#define RKIPC_RTSP_MAX_EXTRA 2
+static struct {
+	int id;
+	rtsp_session_handle session;
+} g_rtsp_extra[RKIPC_RTSP_MAX_EXTRA];
+static int g_rtsp_extra_num;
+// video.source:rtsp_native, rtsp_server.c serves the viewers instead of rtsp_demo
+static int g_rtsp_native;
+
+// rtsp_demo has no session callbacks, a viewer join is seen as a new established tcp
+// connection on the rtsp port. The idr request is delayed a little so the PLAY reply is
+// out before it, and joins close together share one idr. The native server reports each
+// PLAY with its session, only that stream gets an idr
+#define RKIPC_RTSP_PORT 554
+#define RKIPC_RTSP_MAX_VIDEO 3
+#define RKIPC_RTSP_MAX_CONN 64
+
+static void (*g_join_cb)(int id) = NULL; // rkipc_rtsp_join_cb, rtsp.h shares its include guard
+static pthread_t g_join_tid;
+static int g_join_run;
+static char g_conn[RKIPC_RTSP_MAX_CONN][48];
+static int g_conn_num;
+static long long g_idr_due_ms, g_last_idr_ms;
+static long long g_join_pending_ms; // earliest join still waiting for its first key frame
+static int g_join_pending_id;       // its stream, -1 for any when the poll cannot tell
+static pthread_mutex_t g_join_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long long g_join_count, g_idr_count;
+static long long g_ttff_last_ms, g_ttff_max_ms, g_ttff_total_ms;
+static unsigned long long g_ttff_count;
+static struct {
+	int id;
+	long long last_idr_ms;
+} g_play_idr[RK_RTSP_SERVER_MAX_SESSION]; // native server, the last idr of every session
+
+int rkipc_rtsp_set_join_callback(void (*cb)(int id)) {
+	pthread_mutex_lock(&g_join_mutex);
+	g_join_cb = cb;
+	pthread_mutex_unlock(&g_join_mutex);
+
+	return 0;
+}
+
+// collect the remote ends of the established connections on the rtsp port
+static int rkipc_rtsp_read_conn(const char *path, char conn[][48], int num) {
+	char line[256], local[40], remote[40];
+	unsigned int local_port, remote_port, state;
+	FILE *fp = fopen(path, "r");
+	if (!fp)
+		return num;
+	while (fgets(line, sizeof(line), fp) && num < RKIPC_RTSP_MAX_CONN) {
+		if (sscanf(line, " %*d: %39[0-9A-Fa-f]:%x %39[0-9A-Fa-f]:%x %x", local, &local_port,
+		           remote, &remote_port, &state) != 5)
+			continue;
+		if (local_port != RKIPC_RTSP_PORT || state != 0x01) // TCP_ESTABLISHED
+			continue;
+		snprintf(conn[num++], 48, "%s:%x", remote, remote_port);
+	}
+	fclose(fp);
+
+	return num;
+}
+
+static void *rkipc_rtsp_join_thread(void *arg) {
+	char conn[RKIPC_RTSP_MAX_CONN][48];
+	int poll_ms = rk_param_get_int("video.source:rtsp_join_poll_ms", 50);
+	int delay_ms = rk_param_get_int("video.source:rtsp_join_idr_delay_ms", 100);
+	int min_interval_ms = rk_param_get_int("video.source:rtsp_idr_min_interval_ms", 1000);
+	prctl(PR_SET_NAME, "RkipcRtspJoin", 0, 0, 0);
+
+	while (g_join_run) {
+		int num = rkipc_rtsp_read_conn("/proc/net/tcp", conn, 0);
+		num = rkipc_rtsp_read_conn("/proc/net/tcp6", conn, num);
+		long long now = rkipc_get_curren_time_ms();
+		int joined = 0;
+		for (int i = 0; i < num; i++) {
+			int found = 0;
+			for (int j = 0; j < g_conn_num && !found; j++)
+				found = !strcmp(conn[i], g_conn[j]);
+			if (!found) {
+				LOG_INFO("rtsp viewer %s joined\n", conn[i]);
+				joined++;
+			}
+		}
+		memcpy(g_conn, conn, sizeof(conn[0]) * num);
+		g_conn_num = num;
+
+		pthread_mutex_lock(&g_join_mutex);
+		if (joined) {
+			g_join_count += joined;
+			if (!g_join_pending_ms) {
+				g_join_pending_ms = now;
+				g_join_pending_id = -1; // the idr below goes to every stream
+			}
+			// one idr for every join inside the rate limit window, a late joiner still gets one
+			if (!g_idr_due_ms) {
+				g_idr_due_ms = now + delay_ms;
+				if (g_idr_due_ms < g_last_idr_ms + min_interval_ms)
+					g_idr_due_ms = g_last_idr_ms + min_interval_ms;
+			}
+		}
+		void (*cb)(int id) = NULL;
+		if (g_idr_due_ms && now >= g_idr_due_ms) {
+			g_idr_due_ms = 0;
+			g_last_idr_ms = now;
+			g_idr_count++;
+			cb = g_join_cb;
+		}
+		pthread_mutex_unlock(&g_join_mutex);
+		if (cb)
+			cb(-1); // the session of a connection is not known, every stream gets an idr
+		usleep(poll_ms * 1000);
+	}
+
+	return NULL;
+}
+
+// a PLAY on the native server, its reply is already out
+static void rkipc_rtsp_native_play(int id) {
+	int min_interval_ms = rk_param_get_int("video.source:rtsp_idr_min_interval_ms", 1000);
+	long long now = rkipc_get_curren_time_ms();
+	void (*cb)(int id) = NULL;
+	int slot = -1;
+
+	pthread_mutex_lock(&g_join_mutex);
+	g_join_count++;
+	for (int i = 0; i < RK_RTSP_SERVER_MAX_SESSION; i++) {
+		if (g_play_idr[i].id == id) {
+			slot = i;
+			break;
+		}
+		if (slot < 0 && g_play_idr[i].id < 0)
+			slot = i;
+	}
+	// plays of one session inside the rate limit window share its last idr
+	if (slot >= 0 && (g_play_idr[slot].id != id ||
+	                  now - g_play_idr[slot].last_idr_ms >= min_interval_ms)) {
+		g_play_idr[slot].id = id;
+		g_play_idr[slot].last_idr_ms = now;
+		g_idr_count++;
+		cb = g_join_cb;
+	}
+	pthread_mutex_unlock(&g_join_mutex);
+	if (cb)
+		cb(id);
+}
+
+// time to first frame, from the join to the first key frame sent after it. With g_join_mutex held
+static void rkipc_rtsp_ttff_add(int id, long long ttff) {
+	g_ttff_last_ms = ttff;
+	g_ttff_total_ms += ttff;
+	g_ttff_count++;
+	if (ttff > g_ttff_max_ms)
+		g_ttff_max_ms = ttff;
+	LOG_INFO("rtsp time to first frame on stream %d %lld ms\n", id, ttff);
+}
+
+// the native server times every viewer itself, up to the end of its first key frame on the wire
+static void rkipc_rtsp_native_first_frame(int id, long long ttff) {
+	pthread_mutex_lock(&g_join_mutex);
+	rkipc_rtsp_ttff_add(id, ttff);
+	pthread_mutex_unlock(&g_join_mutex);
+}
+
+// rtsp_demo, the key frame of the joined stream went to its sessions
+static void rkipc_rtsp_key_frame_sent(int id) {
+	pthread_mutex_lock(&g_join_mutex);
+	if (g_join_pending_ms && !g_idr_due_ms && (g_join_pending_id < 0 || g_join_pending_id == id)) {
+		rkipc_rtsp_ttff_add(id, rkipc_get_curren_time_ms() - g_join_pending_ms);
+		g_join_pending_ms = 0;
+	}
+	pthread_mutex_unlock(&g_join_mutex);
+}
+
+int rkipc_rtsp_get_stats(char *value, int size) {
+	RKIPC_CHECK_POINTER(value, -1);
+	pthread_mutex_lock(&g_join_mutex);
+	int len = snprintf(value, size,
+	                   "{\"viewers\":%d,\"joins\":%llu,\"idr_requests\":%llu,\"ttff_last_ms\":%lld,"
+	                   "\"ttff_avg_ms\":%lld,\"ttff_max_ms\":%lld}",
+	                   g_conn_num, g_join_count, g_idr_count, g_ttff_last_ms,
+	                   g_ttff_count ? g_ttff_total_ms / (long long)g_ttff_count : 0, g_ttff_max_ms);
+	pthread_mutex_unlock(&g_join_mutex);
+	if (!g_rtsp_native || len >= size)
+		return len < size ? 0 : -1;
+	// the viewers of the native server go in before the closing brace
+	len--;
+	len += snprintf(value + len, size - len, ",\"server\":");
+	if (len >= size || rk_rtsp_server_get_stats(value + len, size - len))
+		return -1;
+	len += strlen(value + len);
+	len += snprintf(value + len, size - len, "}");
+
+	return len < size ? 0 : -1;
+}
+
+static void rkipc_rtsp_join_start() {
+	g_conn_num = 0;
+	g_idr_due_ms = g_join_pending_ms = 0;
+	g_join_run = 1;
+	if (pthread_create(&g_join_tid, NULL, rkipc_rtsp_join_thread, NULL)) {
+		LOG_ERROR("create join thread fail\n");
+		g_join_run = 0;
+	}
+}
+
+static int rkipc_rtsp_native_init(const char *rtsp_url[RKIPC_RTSP_MAX_VIDEO]) {
+	char key[64];
+	g_join_pending_ms = 0;
+	for (int i = 0; i < RK_RTSP_SERVER_MAX_SESSION; i++)
+		g_play_idr[i].id = -1;
+	rk_rtsp_server_set_play_callback(rkipc_rtsp_native_play);
+	rk_rtsp_server_set_first_frame_callback(rkipc_rtsp_native_first_frame);
+	if (rk_rtsp_server_init(RKIPC_RTSP_PORT))
+		return -1;
+	for (int i = 0; i < RKIPC_RTSP_MAX_VIDEO; i++) {
+		if (!rtsp_url[i])
+			continue;
+		snprintf(key, sizeof(key), "video.%d:output_data_type", i);
+		int hevc = !strcmp(rk_param_get_string(key, "H.264"), "H.265");
+		// audio.c only feeds the first session
+		int audio_rate = i == 0 && rk_param_get_int("audio.0:enable", 0)
+		                     ? rk_param_get_int("audio.0:sample_rate", 16000)
+		                     : 0;
+		rk_rtsp_server_add_session(i, rtsp_url[i], hevc, audio_rate,
+		                           rk_param_get_int("audio.0:channels", 2));
+	}
+
+	return 0;
+}
 
 int rkipc_rtsp_init(const char *rtsp_url_0, const char *rtsp_url_1, const char *rtsp_url_2) {
 	const char *tmp_output_data_type = "H.264";
 
 	LOG_DEBUG("start\n");
+	g_rtsp_native = rk_param_get_int("video.source:rtsp_native", 0);
+	if (g_rtsp_native) {
+		const char *rtsp_url[RKIPC_RTSP_MAX_VIDEO] = {rtsp_url_0, rtsp_url_1, rtsp_url_2};
+		if (rkipc_rtsp_native_init(rtsp_url))
+			return -1;
+		return 0;
+	}
 	pthread_mutex_lock(&g_rtsp_mutex);
 	g_rtsplive = create_rtsp_demo(554);
 	if (rtsp_url_0) {
@@ -85,14 +314,54 @@ int rkipc_rtsp_init(const char *rtsp_url_0, const char *rtsp_url_1, const char *
 		}
 	}
 
+	g_rtsp_extra_num = 0;
 	pthread_mutex_unlock(&g_rtsp_mutex);
+	rkipc_rtsp_join_start();
 	LOG_DEBUG("end\n");
 
 	return 0;
 }
 
+int rkipc_rtsp_add_video_session(int id, const char *rtsp_url, const char *output_data_type) {
+	RKIPC_CHECK_POINTER(rtsp_url, -1);
+	RKIPC_CHECK_POINTER(output_data_type, -1);
+	if (g_rtsp_native)
+		return rk_rtsp_server_add_session(id, rtsp_url, !strcmp(output_data_type, "H.265"), 0,
+		                                  0);
+	pthread_mutex_lock(&g_rtsp_mutex);
+	if (!g_rtsplive || g_rtsp_extra_num >= RKIPC_RTSP_MAX_EXTRA) {
+		pthread_mutex_unlock(&g_rtsp_mutex);
+		LOG_ERROR("no room for %s, %d sessions added\n", rtsp_url, g_rtsp_extra_num);
+		return -1;
+	}
+	rtsp_session_handle session = rtsp_new_session(g_rtsplive, rtsp_url);
+	if (!session) {
+		pthread_mutex_unlock(&g_rtsp_mutex);
+		LOG_ERROR("rtsp_new_session %s fail\n", rtsp_url);
+		return -1;
+	}
+	if (!strcmp(output_data_type, "H.265"))
+		rtsp_set_video(session, RTSP_CODEC_ID_VIDEO_H265, NULL, 0);
+	else
+		rtsp_set_video(session, RTSP_CODEC_ID_VIDEO_H264, NULL, 0);
+	rtsp_sync_video_ts(session, rtsp_get_reltime(), rtsp_get_ntptime());
+	g_rtsp_extra[g_rtsp_extra_num].id = id;
+	g_rtsp_extra[g_rtsp_extra_num].session = session;
+	g_rtsp_extra_num++;
+	pthread_mutex_unlock(&g_rtsp_mutex);
+	LOG_INFO("stream %d on %s, %s\n", id, rtsp_url, output_data_type);
+
+	return 0;
+}
+
 int rkipc_rtsp_deinit() {
 	LOG_DEBUG("%s\n", __func__);
+	if (g_join_run) {
+		g_join_run = 0;
+		pthread_join(g_join_tid, NULL);
+	}
+	if (g_rtsp_native)
+		return rk_rtsp_server_deinit();
 	pthread_mutex_lock(&g_rtsp_mutex);
 	if (g_rtsp_session_0) {
 		rtsp_del_session(g_rtsp_session_0);
@@ -106,6 +375,9 @@ int rkipc_rtsp_deinit() {
 		rtsp_del_session(g_rtsp_session_2);
 		g_rtsp_session_2 = NULL;
 	}
+	for (int i = 0; i < g_rtsp_extra_num; i++)
+		rtsp_del_session(g_rtsp_extra[i].session);
+	g_rtsp_extra_num = 0;
 	if (g_rtsplive) {
 		rtsp_del_demo(g_rtsplive);
 		g_rtsplive = NULL;
@@ -116,76 +388,68 @@ int rkipc_rtsp_deinit() {
 }
 
 int rkipc_rtsp_write_video_frame(int id, unsigned char *buffer, unsigned int buffer_size,
-                                 int64_t present_time) {
+                                 int64_t present_time, int key_frame) {
+	if (g_rtsp_native) {
+		rk_packet_s *packet = rk_packet_alloc(buffer_size);
+		if (!packet)
+			return -1;
+		memcpy(packet->data, buffer, buffer_size);
+		packet->stream_id = id;
+		packet->pts = present_time;
+		packet->key_frame = key_frame;
+		int ret = rk_rtsp_server_write_video(id, packet);
+		rk_packet_unref(packet);
+		return ret;
+	}
 	pthread_mutex_lock(&g_rtsp_mutex);
 	if (g_rtsplive == NULL) {
 		pthread_mutex_unlock(&g_rtsp_mutex);
 		return -1;
 	}
-	if ((id == 0) && g_rtsp_session_0) {
-		if (video_first_pts_0 == 0) {
-			video_first_pts_0 = present_time;
-			LOG_INFO("video_first_pts_0 is %" PRId64 "\n", video_first_pts_0);
-		}
+	// the media clock keeps every pts on CLOCK_MONOTONIC, the rtsp_get_reltime of rtsp_demo
+	if ((id == 0) && g_rtsp_session_0)
 		rtsp_tx_video(g_rtsp_session_0, buffer, buffer_size, present_time);
-	}
-	if ((id == 1) && g_rtsp_session_1) {
-		if (video_first_pts_1 == 0) {
-			video_first_pts_1 = present_time;
-			LOG_INFO("video_first_pts_1 is %" PRId64 "\n", video_first_pts_1);
-		}
+	if ((id == 1) && g_rtsp_session_1)
 		rtsp_tx_video(g_rtsp_session_1, buffer, buffer_size, present_time);
-	}
-	if ((id == 2) && g_rtsp_session_2) {
-		if (video_first_pts_2 == 0) {
-			video_first_pts_2 = present_time;
-			LOG_INFO("video_first_pts_2 is %" PRId64 "\n", video_first_pts_2);
-		}
+	if ((id == 2) && g_rtsp_session_2)
 		rtsp_tx_video(g_rtsp_session_2, buffer, buffer_size, present_time);
+	for (int i = 0; i < g_rtsp_extra_num; i++) {
+		if (g_rtsp_extra[i].id == id)
+			rtsp_tx_video(g_rtsp_extra[i].session, buffer, buffer_size, present_time);
 	}
 	rtsp_do_event(g_rtsplive);
 	pthread_mutex_unlock(&g_rtsp_mutex);
+	if (key_frame)
+		rkipc_rtsp_key_frame_sent(id);
 
 	return 0;
 }
 
+// the bus packet goes to the native server as is, rtsp_demo copies it
+int rkipc_rtsp_write_video_packet(int id, rk_packet_s *packet) {
+	RKIPC_CHECK_POINTER(packet, -1);
+	if (!g_rtsp_native)
+		return rkipc_rtsp_write_video_frame(id, packet->data, packet->len, packet->pts,
+		                                    packet->key_frame);
+	return rk_rtsp_server_write_video(id, packet);
+}
+
 int rkipc_rtsp_write_audio_frame(int id, unsigned char *buffer, unsigned int buffer_size,
                                  int64_t present_time) {
+	// audio.c mapped the pts onto the video clock already, both servers send it as is
+	if (g_rtsp_native)
+		return rk_rtsp_server_write_audio(id, buffer, buffer_size, present_time);
 	pthread_mutex_lock(&g_rtsp_mutex);
 	if (g_rtsplive == NULL) {
 		pthread_mutex_unlock(&g_rtsp_mutex);
 		return -1;
 	}
-	if ((id == 0) && g_rtsp_session_0) {
-		if ((audio_first_pts_0 == 0) && video_first_pts_0) {
-			audio_first_pts_0 = present_time;
-			video_audio_diff_pts_0 = video_first_pts_0 - audio_first_pts_0;
-			LOG_INFO("audio_first_pts_0 is %" PRId64 ", video_audio_diff_pts_0 is %" PRId64 "\n",
-					audio_first_pts_0, video_audio_diff_pts_0);
-		}
-		present_time += video_audio_diff_pts_0;
+	if ((id == 0) && g_rtsp_session_0)
 		rtsp_tx_audio(g_rtsp_session_0, buffer, buffer_size, present_time);
-	}
-	if ((id == 1) && g_rtsp_session_1) {
-		if ((audio_first_pts_1 == 0) && video_first_pts_1) {
-			audio_first_pts_1 = present_time;
-			video_audio_diff_pts_1 = video_first_pts_1 - audio_first_pts_1;
-			LOG_INFO("audio_first_pts_1 is %" PRId64 ", video_audio_diff_pts_1 is %" PRId64 "\n",
-					audio_first_pts_1, video_audio_diff_pts_1);
-		}
-		present_time += video_audio_diff_pts_1;
+	if ((id == 1) && g_rtsp_session_1)
 		rtsp_tx_audio(g_rtsp_session_1, buffer, buffer_size, present_time);
-	}
-	if ((id == 2) && g_rtsp_session_2) {
-		if ((audio_first_pts_2 == 0) && video_first_pts_2) {
-			audio_first_pts_2 = present_time;
-			video_audio_diff_pts_2 = video_first_pts_2 - audio_first_pts_2;
-			LOG_INFO("audio_first_pts_2 is %" PRId64 ", video_audio_diff_pts_2 is %" PRId64 "\n",
-					audio_first_pts_2, video_audio_diff_pts_2);
-		}
-		present_time += video_audio_diff_pts_2;
+	if ((id == 2) && g_rtsp_session_2)
 		rtsp_tx_audio(g_rtsp_session_2, buffer, buffer_size, present_time);
-	}
 	rtsp_do_event(g_rtsplive);
 	pthread_mutex_unlock(&g_rtsp_mutex);
 
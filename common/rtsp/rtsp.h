@@ -9,10 +9,22 @@
 extern "C" {
 #endif
 
+struct rk_packet_s;
+
+// id is the stream of the new viewer, -1 when it is not known
+typedef void (*rkipc_rtsp_join_cb)(int id);
+
 int rkipc_rtsp_init(const char *rtsp_url_0, const char *rtsp_url_1, const char *rtsp_url_2);
 int rkipc_rtsp_deinit();
+// a video only session for a stream beyond video.0-2, after rkipc_rtsp_init
+int rkipc_rtsp_add_video_session(int id, const char *rtsp_url, const char *output_data_type);
+// called from the join monitor thread, already rate limited
+int rkipc_rtsp_set_join_callback(rkipc_rtsp_join_cb cb);
+int rkipc_rtsp_get_stats(char *value, int size);
 int rkipc_rtsp_write_video_frame(int id, unsigned char *buffer, unsigned int buffer_size,
-                                 int64_t present_time);
+                                 int64_t present_time, int key_frame);
+// same from a packet bus packet, without a copy when video.source:rtsp_native is set
+int rkipc_rtsp_write_video_packet(int id, struct rk_packet_s *packet);
 int rkipc_rtsp_write_audio_frame(int id, unsigned char *buffer, unsigned int buffer_size,
                                  int64_t present_time);
 
@@ -0,0 +1,1138 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // accept4, sendmmsg
+#endif
+#include "rtsp_server.h"
+#include "common.h"
+#include "media_clock.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "rtsp_server.c"
+
+#define RK_RTSP_MAX_NAL 64
+#define RK_RTSP_QUEUE_LEN 128
+#define RK_RTSP_MTU_PAYLOAD 1400
+#define RK_RTSP_BATCH 64 // rtp packets per writev or sendmmsg
+#define RK_RTSP_BATCH_ROUNDS 16
+#define RK_RTSP_HDR_SIZE 20 // interleaved prefix 4, rtp 12, fu 3
+#define RK_RTSP_REQ_SIZE 4096
+#define RK_RTSP_CTRL_SIZE 4096
+#define RK_RTSP_SNDBUF (512 * 1024)
+#define RK_RTSP_SR_INTERVAL_MS 5000
+#define RK_RTSP_TRACK_VIDEO 0
+#define RK_RTSP_TRACK_AUDIO 1
+#define RK_RTSP_TRACK_NUM 2
+#define RK_RTSP_PT_H26X 96
+#define RK_RTSP_PT_PCMA 8
+
+// one encoded frame shared by every viewer, freed with its last reference
+typedef struct {
+	int ref;
+	int track;
+	int key;
+	int frame_end; // the rtp marker goes on the last packet of the access unit only
+	int64_t pts;
+	unsigned int len;
+	rk_packet_s *packet; // video only, data points into it
+	const unsigned char *data;
+	int nal_count;
+	struct {
+		unsigned int offset, len; // without the start code
+	} nal[RK_RTSP_MAX_NAL];
+	unsigned char audio[];
+} rk_rtsp_frame_s;
+
+typedef struct {
+	int used;
+	int id;
+	char path[64];
+	int hevc;
+	int audio_rate;
+	int audio_channels;
+	uint32_t rtp_base[RK_RTSP_TRACK_NUM];
+	// parameter sets of the last key frame for the sdp
+	unsigned char vps[64], sps[128], pps[64];
+	int vps_len, sps_len, pps_len;
+} rk_rtsp_session_s;
+
+typedef struct {
+	int setup;
+	int channel; // interleaved rtp channel, rtcp is the next one
+	struct sockaddr_in rtp_addr, rtcp_addr;
+	uint16_t seq;
+	uint32_t ssrc;
+	uint32_t packets, octets;
+} rk_rtsp_track_s;
+
+typedef struct {
+	int fd; // -1 when free
+	char addr[48];
+	int session; // -1 before the first SETUP
+	int tcp;     // interleaved on the rtsp connection, udp otherwise
+	int playing;
+	int closing; // after the TEARDOWN reply is out
+	char session_id[20];
+	rk_rtsp_track_s track[RK_RTSP_TRACK_NUM];
+	char req[RK_RTSP_REQ_SIZE];
+	int req_len;
+	char ctrl[RK_RTSP_CTRL_SIZE]; // replies and tcp rtcp, sent between rtp packets
+	int ctrl_len, ctrl_off;
+	// pushed by the writers and popped by the loop, both with g_server_mutex held
+	rk_rtsp_frame_s *queue[RK_RTSP_QUEUE_LEN];
+	unsigned int head, count, queued_bytes;
+	int wait_key;
+	long long play_ms; // PLAY still waiting for its first key frame to be sent, 0 after
+	int play_key;      // that key frame is being sent, its last slice ends the wait
+	int overflow; // in a row without catching up
+	const char *evict;
+	// owned by the loop: the frame being packetized and the rtp packets not sent yet
+	rk_rtsp_frame_s *cur;
+	int nal;
+	unsigned int nal_off;
+	int batch_track;
+	unsigned char hdr[RK_RTSP_BATCH][RK_RTSP_HDR_SIZE];
+	struct iovec iov[RK_RTSP_BATCH * 2];
+	int iov_count, iov_pos;
+	int want_out;
+	long long last_progress_ms, last_sr_ms;
+	unsigned long long sent_bytes, dropped;
+} rk_rtsp_client_s;
+
+static pthread_mutex_t g_server_mutex = PTHREAD_MUTEX_INITIALIZER;
+static rk_rtsp_session_s g_session[RK_RTSP_SERVER_MAX_SESSION];
+static rk_rtsp_client_s g_client[RK_RTSP_SERVER_MAX_CLIENT];
+static int g_listen_fd = -1, g_epoll_fd = -1, g_event_fd = -1;
+static int g_udp_fd[2] = {-1, -1}; // rtp and rtcp of every udp viewer
+static int g_port, g_udp_port;
+static unsigned int g_queue_bytes;
+static int g_stall_ms, g_max_overflow;
+static pthread_t g_server_tid;
+static int g_server_run;
+static uint32_t g_random;
+static unsigned long long g_accepted, g_evicted;
+static void (*g_play_cb)(int id);
+static void (*g_first_frame_cb)(int id, long long ttff_ms);
+
+static uint32_t rk_rtsp_random() {
+	// xorshift, session ids and ssrcs only need to differ
+	g_random ^= g_random << 13;
+	g_random ^= g_random >> 17;
+	g_random ^= g_random << 5;
+	return g_random;
+}
+
+static void rk_rtsp_frame_release(rk_rtsp_frame_s *frame) {
+	if (!frame || __atomic_sub_fetch(&frame->ref, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
+	rk_packet_unref(frame->packet);
+	free(frame);
+}
+
+static rk_rtsp_session_s *rk_rtsp_session_by_id(int id) {
+	for (int i = 0; i < RK_RTSP_SERVER_MAX_SESSION; i++) {
+		if (g_session[i].used && g_session[i].id == id)
+			return &g_session[i];
+	}
+	return NULL;
+}
+
+static int64_t rk_rtsp_mono_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t rk_rtsp_rtp_ts(const rk_rtsp_session_s *session, int track, int64_t pts) {
+	int64_t clock = track == RK_RTSP_TRACK_VIDEO ? 90000 : session->audio_rate;
+	return session->rtp_base[track] + (uint32_t)(pts * clock / 1000000);
+}
+
+// ---- queues, writers side ----
+
+// with g_server_mutex held
+static rk_rtsp_frame_s *rk_rtsp_client_pop(rk_rtsp_client_s *client) {
+	if (!client->count)
+		return NULL;
+	rk_rtsp_frame_s *frame = client->queue[client->head];
+	client->head = (client->head + 1) % RK_RTSP_QUEUE_LEN;
+	client->count--;
+	client->queued_bytes -= frame->len;
+	if (!client->count)
+		client->overflow = 0;
+	return frame;
+}
+
+// with g_server_mutex held
+static void rk_rtsp_client_push(rk_rtsp_client_s *client, rk_rtsp_frame_s *frame) {
+	int video = frame->track == RK_RTSP_TRACK_VIDEO;
+	if (video && client->wait_key) {
+		if (!frame->key) {
+			client->dropped++;
+			return;
+		}
+		client->wait_key = 0;
+	}
+	if (client->count == RK_RTSP_QUEUE_LEN || client->queued_bytes + frame->len > g_queue_bytes) {
+		// the viewer does not keep up: drop its backlog, it resumes on the next key frame
+		while (client->count) {
+			rk_rtsp_frame_release(rk_rtsp_client_pop(client));
+			client->dropped++;
+		}
+		if (++client->overflow >= g_max_overflow)
+			client->evict = "too slow";
+		if (video && !frame->key) {
+			client->wait_key = 1;
+			client->dropped++;
+			return;
+		}
+	}
+	__atomic_add_fetch(&frame->ref, 1, __ATOMIC_RELAXED);
+	client->queue[(client->head + client->count) % RK_RTSP_QUEUE_LEN] = frame;
+	client->count++;
+	client->queued_bytes += frame->len;
+}
+
+static void rk_rtsp_wake() {
+	uint64_t one = 1;
+	if (write(g_event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		LOG_ERROR("wake fail, %s\n", strerror(errno));
+}
+
+// hand the frame to every playing viewer of the session, then drop the writer's reference
+static void rk_rtsp_publish(rk_rtsp_session_s *session, rk_rtsp_frame_s *frame) {
+	int queued = 0;
+	pthread_mutex_lock(&g_server_mutex);
+	for (int i = 0; i < RK_RTSP_SERVER_MAX_CLIENT; i++) {
+		rk_rtsp_client_s *client = &g_client[i];
+		if (client->fd < 0 || !client->playing || client->evict ||
+		    &g_session[client->session] != session || !client->track[frame->track].setup)
+			continue;
+		rk_rtsp_client_push(client, frame);
+		queued = 1;
+	}
+	pthread_mutex_unlock(&g_server_mutex);
+	rk_rtsp_frame_release(frame);
+	if (queued)
+		rk_rtsp_wake();
+}
+
+// split an annex b frame into nal units, once for all viewers
+static void rk_rtsp_parse_nal(rk_rtsp_frame_s *frame) {
+	const unsigned char *data = frame->data;
+	unsigned int len = frame->len, start = 0;
+	int in_nal = 0;
+	frame->nal_count = 0;
+	for (unsigned int i = 0; i + 2 < len; i++) {
+		if (data[i + 2] > 1) {
+			i += 2;
+			continue;
+		}
+		if (data[i] || data[i + 1] || data[i + 2] != 1)
+			continue;
+		if (in_nal && frame->nal_count < RK_RTSP_MAX_NAL) {
+			unsigned int end = i;
+			// the leading zero of a 4 byte start code belongs to it
+			while (end > start && !data[end - 1])
+				end--;
+			frame->nal[frame->nal_count].offset = start;
+			frame->nal[frame->nal_count++].len = end - start;
+		}
+		start = i + 3;
+		in_nal = 1;
+		i += 2;
+	}
+	if (!in_nal)
+		start = 0; // no start code at all, one raw nal
+	if (start < len) {
+		// a frame with more nal units than fit keeps the tail in the last one
+		if (frame->nal_count == RK_RTSP_MAX_NAL)
+			frame->nal[RK_RTSP_MAX_NAL - 1].len = len - frame->nal[RK_RTSP_MAX_NAL - 1].offset;
+		else {
+			frame->nal[frame->nal_count].offset = start;
+			frame->nal[frame->nal_count++].len = len - start;
+		}
+	}
+}
+
+// keep the parameter sets of key frames for the sdp of the next DESCRIBE
+static void rk_rtsp_save_param_sets(rk_rtsp_session_s *session, const rk_rtsp_frame_s *frame) {
+	pthread_mutex_lock(&g_server_mutex);
+	for (int i = 0; i < frame->nal_count; i++) {
+		const unsigned char *nal = frame->data + frame->nal[i].offset;
+		int len = frame->nal[i].len;
+		unsigned char *dst = NULL;
+		int *dst_len = NULL, size = 0;
+		// H.265 vps 32, sps 33, pps 34, H.264 sps 7, pps 8
+		int type = session->hevc ? ((nal[0] >> 1) & 0x3f) - 32 : (nal[0] & 0x1f) - 6;
+		if (type == 0 && session->hevc) {
+			dst = session->vps;
+			dst_len = &session->vps_len;
+			size = sizeof(session->vps);
+		} else if (type == 1) {
+			dst = session->sps;
+			dst_len = &session->sps_len;
+			size = sizeof(session->sps);
+		} else if (type == 2) {
+			dst = session->pps;
+			dst_len = &session->pps_len;
+			size = sizeof(session->pps);
+		}
+		if (dst && len <= size) {
+			memcpy(dst, nal, len);
+			*dst_len = len;
+		}
+	}
+	pthread_mutex_unlock(&g_server_mutex);
+}
+
+int rk_rtsp_server_write_video(int id, rk_packet_s *packet) {
+	RKIPC_CHECK_POINTER(packet, -1);
+	rk_rtsp_session_s *session = rk_rtsp_session_by_id(id);
+	if (!g_server_run || !session || !packet->len)
+		return -1;
+	rk_rtsp_frame_s *frame = (rk_rtsp_frame_s *)malloc(sizeof(rk_rtsp_frame_s));
+	if (!frame)
+		return -1;
+	frame->ref = 1;
+	frame->track = RK_RTSP_TRACK_VIDEO;
+	frame->key = packet->key_frame;
+	frame->frame_end = packet->frame_end;
+	frame->pts = packet->pts;
+	frame->len = packet->len;
+	frame->packet = rk_packet_ref(packet);
+	frame->data = packet->data;
+	rk_rtsp_parse_nal(frame);
+	if (frame->key)
+		rk_rtsp_save_param_sets(session, frame);
+	rk_rtsp_publish(session, frame);
+
+	return 0;
+}
+
+int rk_rtsp_server_write_audio(int id, const unsigned char *data, unsigned int len,
+                               int64_t pts) {
+	RKIPC_CHECK_POINTER(data, -1);
+	rk_rtsp_session_s *session = rk_rtsp_session_by_id(id);
+	if (!g_server_run || !session || !session->audio_rate || !len ||
+	    len > RK_RTSP_MTU_PAYLOAD)
+		return -1;
+	rk_rtsp_frame_s *frame = (rk_rtsp_frame_s *)malloc(sizeof(rk_rtsp_frame_s) + len);
+	if (!frame)
+		return -1;
+	memcpy(frame->audio, data, len);
+	frame->ref = 1;
+	frame->track = RK_RTSP_TRACK_AUDIO;
+	frame->key = 1;
+	frame->frame_end = 1;
+	frame->pts = pts;
+	frame->len = len;
+	frame->packet = NULL;
+	frame->data = frame->audio;
+	frame->nal_count = 1;
+	frame->nal[0].offset = 0;
+	frame->nal[0].len = len;
+	rk_rtsp_publish(session, frame);
+
+	return 0;
+}
+
+// ---- rtp, loop side ----
+
+// rtp packets of the current frame into the batch, 0 when the viewer has nothing to send
+static int rk_rtsp_build_batch(rk_rtsp_client_s *client) {
+	client->iov_count = client->iov_pos = 0;
+	if (client->cur && client->nal >= client->cur->nal_count) {
+		// every rtp packet of the frame is out, the ones before wait_key cleared were dropped
+		rk_rtsp_frame_s *done = client->cur;
+		if (client->play_ms && done->track == RK_RTSP_TRACK_VIDEO) {
+			client->play_key |= done->key;
+			if (client->play_key && done->frame_end) {
+				if (g_first_frame_cb)
+					g_first_frame_cb(g_session[client->session].id,
+					                 rkipc_get_curren_time_ms() - client->play_ms);
+				client->play_ms = 0;
+			}
+		}
+		rk_rtsp_frame_release(client->cur);
+		client->cur = NULL;
+	}
+	if (!client->cur) {
+		pthread_mutex_lock(&g_server_mutex);
+		client->cur = rk_rtsp_client_pop(client);
+		pthread_mutex_unlock(&g_server_mutex);
+		client->nal = 0;
+		client->nal_off = 0;
+		if (!client->cur)
+			return 0;
+	}
+	rk_rtsp_frame_s *frame = client->cur;
+	rk_rtsp_session_s *session = &g_session[client->session];
+	rk_rtsp_track_s *track = &client->track[frame->track];
+	int video = frame->track == RK_RTSP_TRACK_VIDEO;
+	uint32_t ts = rk_rtsp_rtp_ts(session, frame->track, frame->pts);
+	int count = 0;
+
+	client->batch_track = frame->track;
+	while (count < RK_RTSP_BATCH && client->nal < frame->nal_count) {
+		const unsigned char *nal = frame->data + frame->nal[client->nal].offset;
+		unsigned int nal_len = frame->nal[client->nal].len;
+		unsigned char *hdr = client->hdr[count];
+		unsigned int hdr_len = 16, payload_len;
+		const unsigned char *payload;
+		int nal_done;
+		if (!video || nal_len <= RK_RTSP_MTU_PAYLOAD) {
+			payload = nal;
+			payload_len = nal_len;
+			nal_done = 1;
+		} else {
+			// FU-A for H.264, type 49 FU for H.265, the nal header moves into the fu header
+			unsigned int skip = session->hevc ? 2 : 1;
+			unsigned int off = client->nal_off ? client->nal_off : skip;
+			unsigned int chunk = nal_len - off;
+			if (chunk > RK_RTSP_MTU_PAYLOAD)
+				chunk = RK_RTSP_MTU_PAYLOAD;
+			unsigned char fu = off == skip ? 0x80 : 0;
+			nal_done = off + chunk == nal_len;
+			if (nal_done)
+				fu |= 0x40;
+			if (session->hevc) {
+				hdr[hdr_len++] = (nal[0] & 0x81) | (49 << 1);
+				hdr[hdr_len++] = nal[1];
+				hdr[hdr_len++] = fu | ((nal[0] >> 1) & 0x3f);
+			} else {
+				hdr[hdr_len++] = (nal[0] & 0xe0) | 28;
+				hdr[hdr_len++] = fu | (nal[0] & 0x1f);
+			}
+			payload = nal + off;
+			payload_len = chunk;
+			client->nal_off = off + chunk;
+		}
+		int marker =
+		    video && frame->frame_end && nal_done && client->nal == frame->nal_count - 1;
+		unsigned int rtp_len = hdr_len - 4 + payload_len;
+		hdr[0] = '$';
+		hdr[1] = track->channel;
+		hdr[2] = rtp_len >> 8;
+		hdr[3] = rtp_len & 0xff;
+		hdr[4] = 0x80;
+		hdr[5] = (marker ? 0x80 : 0) | (video ? RK_RTSP_PT_H26X : RK_RTSP_PT_PCMA);
+		hdr[6] = track->seq >> 8;
+		hdr[7] = track->seq & 0xff;
+		hdr[8] = ts >> 24;
+		hdr[9] = ts >> 16;
+		hdr[10] = ts >> 8;
+		hdr[11] = ts & 0xff;
+		hdr[12] = track->ssrc >> 24;
+		hdr[13] = track->ssrc >> 16;
+		hdr[14] = track->ssrc >> 8;
+		hdr[15] = track->ssrc & 0xff;
+		track->seq++;
+		track->packets++;
+		track->octets += payload_len;
+		// udp datagrams start at the rtp header
+		client->iov[client->iov_count].iov_base = client->tcp ? hdr : hdr + 4;
+		client->iov[client->iov_count++].iov_len = client->tcp ? hdr_len : hdr_len - 4;
+		client->iov[client->iov_count].iov_base = (void *)payload;
+		client->iov[client->iov_count++].iov_len = payload_len;
+		count++;
+		if (nal_done) {
+			client->nal++;
+			client->nal_off = 0;
+		}
+	}
+
+	return count;
+}
+
+static void rk_rtsp_set_out(rk_rtsp_client_s *client, int want_out) {
+	if (client->want_out == want_out)
+		return;
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLRDHUP | (want_out ? EPOLLOUT : 0);
+	ev.data.ptr = client;
+	epoll_ctl(g_epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
+	client->want_out = want_out;
+}
+
+// send what the socket takes: 0 when the viewer is drained, 1 when the socket is full or there
+// is more after this round, -1 on error
+static int rk_rtsp_client_flush(rk_rtsp_client_s *client) {
+	for (int round = 0; round < RK_RTSP_BATCH_ROUNDS;) {
+		// replies only go between whole rtp packets on the interleaved connection
+		if (client->iov_pos == client->iov_count && client->ctrl_off < client->ctrl_len) {
+			ssize_t n = send(client->fd, client->ctrl + client->ctrl_off,
+			                 client->ctrl_len - client->ctrl_off, MSG_NOSIGNAL);
+			if (n < 0)
+				return errno == EAGAIN ? 1 : -1;
+			client->ctrl_off += n;
+			if (client->ctrl_off < client->ctrl_len)
+				return 1;
+			client->ctrl_off = client->ctrl_len = 0;
+		}
+		if (client->closing)
+			return -1;
+		if (client->iov_pos == client->iov_count) {
+			if (!client->playing || !rk_rtsp_build_batch(client))
+				return 0;
+			round++;
+		}
+		ssize_t n;
+		if (client->tcp) {
+			n = writev(client->fd, client->iov + client->iov_pos,
+			           client->iov_count - client->iov_pos);
+			if (n < 0)
+				return errno == EAGAIN ? 1 : -1;
+			client->sent_bytes += n;
+			while (n > 0 && client->iov_pos < client->iov_count) {
+				struct iovec *iov = &client->iov[client->iov_pos];
+				if ((size_t)n < iov->iov_len) {
+					iov->iov_base = (char *)iov->iov_base + n;
+					iov->iov_len -= n;
+					break;
+				}
+				n -= iov->iov_len;
+				client->iov_pos++;
+			}
+		} else {
+			struct mmsghdr msg[RK_RTSP_BATCH];
+			rk_rtsp_track_s *track = &client->track[client->batch_track];
+			int msg_count = (client->iov_count - client->iov_pos) / 2;
+			memset(msg, 0, sizeof(msg[0]) * msg_count);
+			for (int i = 0; i < msg_count; i++) {
+				msg[i].msg_hdr.msg_name = &track->rtp_addr;
+				msg[i].msg_hdr.msg_namelen = sizeof(track->rtp_addr);
+				msg[i].msg_hdr.msg_iov = &client->iov[client->iov_pos + i * 2];
+				msg[i].msg_hdr.msg_iovlen = 2;
+			}
+			n = sendmmsg(g_udp_fd[0], msg, msg_count, MSG_DONTWAIT);
+			if (n < 0)
+				return errno == EAGAIN || errno == ENOBUFS ? 1 : -1;
+			for (int i = 0; i < n; i++)
+				client->sent_bytes += msg[i].msg_len;
+			client->iov_pos += n * 2;
+		}
+		client->last_progress_ms = rkipc_get_curren_time_ms();
+	}
+
+	return 1;
+}
+
+static void rk_rtsp_send_sr(rk_rtsp_client_s *client, long long now_ms) {
+	rk_rtsp_session_s *session = &g_session[client->session];
+	int64_t mono_us = rk_rtsp_mono_us();
+	// the same utc the sei and the detections carry for this instant
+	int64_t utc_ms = rk_media_clock_to_utc_ms(mono_us);
+	client->last_sr_ms = now_ms;
+	for (int t = 0; t < RK_RTSP_TRACK_NUM; t++) {
+		rk_rtsp_track_s *track = &client->track[t];
+		if (!track->setup || !track->packets)
+			continue;
+		// sender report: ntp and rtp time of the same instant, players sync audio on it
+		uint32_t word[8];
+		word[0] = htonl(0x80c80006);
+		word[1] = htonl(track->ssrc);
+		word[2] = htonl((uint32_t)(utc_ms / 1000 + 2208988800u));
+		word[3] = htonl((uint32_t)(((uint64_t)(utc_ms % 1000) << 32) / 1000));
+		word[4] = htonl(rk_rtsp_rtp_ts(session, t, mono_us));
+		word[5] = htonl(track->packets);
+		word[6] = htonl(track->octets);
+		if (!client->tcp) {
+			sendto(g_udp_fd[1], &word[0], 28, MSG_DONTWAIT,
+			       (struct sockaddr *)&track->rtcp_addr, sizeof(track->rtcp_addr));
+		} else if (client->ctrl_len + 32 <= RK_RTSP_CTRL_SIZE) {
+			unsigned char *p = (unsigned char *)client->ctrl + client->ctrl_len;
+			p[0] = '$';
+			p[1] = track->channel + 1;
+			p[2] = 0;
+			p[3] = 28;
+			memcpy(p + 4, word, 28);
+			client->ctrl_len += 32;
+		}
+	}
+}
+
+// ---- rtsp, loop side ----
+
+static void rk_rtsp_client_close(rk_rtsp_client_s *client, const char *reason) {
+	pthread_mutex_lock(&g_server_mutex);
+	while (client->count)
+		rk_rtsp_frame_release(rk_rtsp_client_pop(client));
+	client->playing = 0;
+	pthread_mutex_unlock(&g_server_mutex);
+	rk_rtsp_frame_release(client->cur);
+	client->cur = NULL;
+	LOG_INFO("viewer %s: %s, sent %llu KB, dropped %llu frames\n", client->addr, reason,
+	         client->sent_bytes / 1024, client->dropped);
+	epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+	close(client->fd);
+	pthread_mutex_lock(&g_server_mutex);
+	client->fd = -1;
+	pthread_mutex_unlock(&g_server_mutex);
+}
+
+static void rk_rtsp_accept() {
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	int fd = accept4(g_listen_fd, (struct sockaddr *)&addr, &addr_len,
+	                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+	rk_rtsp_client_s *client = NULL;
+	for (int i = 0; i < RK_RTSP_SERVER_MAX_CLIENT && !client; i++) {
+		if (g_client[i].fd < 0)
+			client = &g_client[i];
+	}
+	if (!client) {
+		LOG_WARN("%d viewers already, refuse one more\n", RK_RTSP_SERVER_MAX_CLIENT);
+		close(fd);
+		return;
+	}
+	int one = 1, sndbuf = RK_RTSP_SNDBUF;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+	pthread_mutex_lock(&g_server_mutex);
+	memset(client, 0, sizeof(*client));
+	client->session = -1;
+	snprintf(client->addr, sizeof(client->addr), "%s:%d", inet_ntoa(addr.sin_addr),
+	         ntohs(addr.sin_port));
+	client->last_progress_ms = rkipc_get_curren_time_ms();
+	client->fd = fd;
+	pthread_mutex_unlock(&g_server_mutex);
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLRDHUP;
+	ev.data.ptr = client;
+	epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+	g_accepted++;
+	LOG_INFO("viewer %s connected\n", client->addr);
+}
+
+static void rk_rtsp_reply(rk_rtsp_client_s *client, int code, const char *status, int cseq,
+                          const char *headers, const char *body) {
+	int body_len = body ? strlen(body) : 0;
+	int room = RK_RTSP_CTRL_SIZE - client->ctrl_len;
+	char session[48] = "";
+	if (client->session_id[0])
+		snprintf(session, sizeof(session), "Session: %s;timeout=60\r\n", client->session_id);
+	int len = snprintf(client->ctrl + client->ctrl_len, room,
+	                   "RTSP/1.0 %d %s\r\nCSeq: %d\r\nServer: rkipc\r\n%s%s", code, status,
+	                   cseq, session, headers ? headers : "");
+	if (len >= room)
+		return;
+	if (body_len)
+		len += snprintf(client->ctrl + client->ctrl_len + len, room - len,
+		                "Content-Type: application/sdp\r\nContent-Length: %d\r\n\r\n%s",
+		                body_len, body);
+	else
+		len += snprintf(client->ctrl + client->ctrl_len + len, room - len, "\r\n");
+	if (len < room)
+		client->ctrl_len += len;
+	else
+		LOG_ERROR("viewer %s: reply %d does not fit\n", client->addr, code);
+}
+
+static int rk_rtsp_base64(const unsigned char *src, int len, char *dst, int size) {
+	static const char table[] =
+	    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	int n = 0;
+	for (int i = 0; i < len && n + 5 <= size; i += 3) {
+		uint32_t v = src[i] << 16 | (i + 1 < len ? src[i + 1] << 8 : 0) |
+		             (i + 2 < len ? src[i + 2] : 0);
+		dst[n++] = table[(v >> 18) & 0x3f];
+		dst[n++] = table[(v >> 12) & 0x3f];
+		dst[n++] = i + 1 < len ? table[(v >> 6) & 0x3f] : '=';
+		dst[n++] = i + 2 < len ? table[v & 0x3f] : '=';
+	}
+	dst[n] = '\0';
+
+	return n;
+}
+
+// the mount point of an rtsp url and its track, -1 when none
+static rk_rtsp_session_s *rk_rtsp_find_session(const char *url, int *track) {
+	const char *path = strstr(url, "://");
+	path = path ? strchr(path + 3, '/') : url;
+	if (!path)
+		return NULL;
+	const char *track_id = strstr(path, "trackID=");
+	*track = track_id ? atoi(track_id + 8) : RK_RTSP_TRACK_VIDEO;
+	for (int i = 0; i < RK_RTSP_SERVER_MAX_SESSION; i++) {
+		rk_rtsp_session_s *session = &g_session[i];
+		int len = strlen(session->path);
+		if (session->used && !strncmp(path, session->path, len) &&
+		    (path[len] == '\0' || path[len] == '/' || path[len] == '?'))
+			return session;
+	}
+	return NULL;
+}
+
+static void rk_rtsp_describe(rk_rtsp_client_s *client, int cseq, const char *url,
+                             rk_rtsp_session_s *session) {
+	char sdp[1536], fmtp[640], vps[96], sps[176], pps[96], headers[320];
+	struct sockaddr_in local;
+	socklen_t local_len = sizeof(local);
+	getsockname(client->fd, (struct sockaddr *)&local, &local_len);
+
+	pthread_mutex_lock(&g_server_mutex);
+	rk_rtsp_base64(session->vps, session->vps_len, vps, sizeof(vps));
+	rk_rtsp_base64(session->sps, session->sps_len, sps, sizeof(sps));
+	rk_rtsp_base64(session->pps, session->pps_len, pps, sizeof(pps));
+	int have_sets = session->sps_len >= 4 && session->pps_len &&
+	                (session->vps_len || !session->hevc);
+	unsigned char profile[3] = {session->sps[1], session->sps[2], session->sps[3]};
+	pthread_mutex_unlock(&g_server_mutex);
+	// without parameter sets yet the player takes the in-band ones of the first key frame
+	if (session->hevc && have_sets)
+		snprintf(fmtp, sizeof(fmtp), "a=fmtp:%d sprop-vps=%s;sprop-sps=%s;sprop-pps=%s\r\n",
+		         RK_RTSP_PT_H26X, vps, sps, pps);
+	else if (session->hevc)
+		fmtp[0] = '\0';
+	else if (have_sets)
+		snprintf(fmtp, sizeof(fmtp),
+		         "a=fmtp:%d packetization-mode=1;profile-level-id=%02X%02X%02X;"
+		         "sprop-parameter-sets=%s,%s\r\n",
+		         RK_RTSP_PT_H26X, profile[0], profile[1], profile[2], sps, pps);
+	else
+		snprintf(fmtp, sizeof(fmtp), "a=fmtp:%d packetization-mode=1\r\n", RK_RTSP_PT_H26X);
+	int len = snprintf(sdp, sizeof(sdp),
+	                   "v=0\r\no=- %u 1 IN IP4 %s\r\ns=rkipc\r\nc=IN IP4 0.0.0.0\r\nt=0 0\r\n"
+	                   "a=control:*\r\na=range:npt=0-\r\n"
+	                   "m=video 0 RTP/AVP %d\r\na=rtpmap:%d %s/90000\r\n%sa=control:trackID=%d\r\n",
+	                   rk_rtsp_random(), inet_ntoa(local.sin_addr), RK_RTSP_PT_H26X,
+	                   RK_RTSP_PT_H26X, session->hevc ? "H265" : "H264", fmtp,
+	                   RK_RTSP_TRACK_VIDEO);
+	if (session->audio_rate && len < (int)sizeof(sdp))
+		snprintf(sdp + len, sizeof(sdp) - len,
+		         "m=audio 0 RTP/AVP %d\r\na=rtpmap:%d PCMA/%d/%d\r\na=control:trackID=%d\r\n",
+		         RK_RTSP_PT_PCMA, RK_RTSP_PT_PCMA, session->audio_rate, session->audio_channels,
+		         RK_RTSP_TRACK_AUDIO);
+	snprintf(headers, sizeof(headers), "Content-Base: %s/\r\n", url);
+	rk_rtsp_reply(client, 200, "OK", cseq, headers, sdp);
+}
+
+static void rk_rtsp_setup(rk_rtsp_client_s *client, int cseq, const char *url,
+                          const char *transport) {
+	char headers[256];
+	int t;
+	rk_rtsp_session_s *session = rk_rtsp_find_session(url, &t);
+	if (!session || t < 0 || t >= RK_RTSP_TRACK_NUM ||
+	    (t == RK_RTSP_TRACK_AUDIO && !session->audio_rate)) {
+		rk_rtsp_reply(client, 404, "Not Found", cseq, NULL, NULL);
+		return;
+	}
+	int index = session - g_session;
+	int tcp = strstr(transport, "RTP/AVP/TCP") != NULL;
+	if (client->session >= 0 && (client->session != index || client->tcp != tcp)) {
+		rk_rtsp_reply(client, 459, "Aggregate Operation Not Allowed", cseq, NULL, NULL);
+		return;
+	}
+	rk_rtsp_track_s *track = &client->track[t];
+	const char *client_port = strstr(transport, "client_port=");
+	const char *interleaved = strstr(transport, "interleaved=");
+	if (!tcp && !client_port) {
+		rk_rtsp_reply(client, 461, "Unsupported Transport", cseq, NULL, NULL);
+		return;
+	}
+	track->ssrc = rk_rtsp_random();
+	track->seq = (uint16_t)rk_rtsp_random();
+	if (tcp) {
+		track->channel = interleaved ? atoi(interleaved + 12) : t * 2;
+		snprintf(headers, sizeof(headers),
+		         "Transport: RTP/AVP/TCP;unicast;interleaved=%d-%d;ssrc=%08X\r\n",
+		         track->channel, track->channel + 1, track->ssrc);
+	} else {
+		struct sockaddr_in peer;
+		socklen_t peer_len = sizeof(peer);
+		int rtp_port = atoi(client_port + 12);
+		const char *dash = strchr(client_port, '-');
+		int rtcp_port = dash ? atoi(dash + 1) : rtp_port + 1;
+		getpeername(client->fd, (struct sockaddr *)&peer, &peer_len);
+		track->rtp_addr = peer;
+		track->rtp_addr.sin_port = htons(rtp_port);
+		track->rtcp_addr = peer;
+		track->rtcp_addr.sin_port = htons(rtcp_port);
+		snprintf(headers, sizeof(headers),
+		         "Transport: RTP/AVP;unicast;client_port=%d-%d;server_port=%d-%d;ssrc=%08X\r\n",
+		         rtp_port, rtcp_port, g_udp_port, g_udp_port + 1, track->ssrc);
+	}
+	if (!client->session_id[0])
+		snprintf(client->session_id, sizeof(client->session_id), "%08X%08X", rk_rtsp_random(),
+		         rk_rtsp_random());
+	pthread_mutex_lock(&g_server_mutex);
+	client->session = index;
+	client->tcp = tcp;
+	track->setup = 1;
+	pthread_mutex_unlock(&g_server_mutex);
+	rk_rtsp_reply(client, 200, "OK", cseq, headers, NULL);
+}
+
+// one complete request, the rest of req is kept
+static void rk_rtsp_request(rk_rtsp_client_s *client, char *req) {
+	char method[32] = "", url[256] = "", transport[256] = "", session[32] = "";
+	int cseq = 0;
+	sscanf(req, "%31s %255s", method, url);
+	for (char *line = strstr(req, "\r\n"); line; line = strstr(line, "\r\n")) {
+		line += 2;
+		if (!strncasecmp(line, "CSeq:", 5))
+			cseq = atoi(line + 5);
+		else if (!strncasecmp(line, "Transport:", 10))
+			sscanf(line + 10, " %255[^\r\n]", transport);
+		else if (!strncasecmp(line, "Session:", 8))
+			sscanf(line + 8, " %31[^;\r\n]", session);
+	}
+	LOG_DEBUG("viewer %s: %s %s\n", client->addr, method, url);
+	if (session[0] && strcmp(session, client->session_id)) {
+		rk_rtsp_reply(client, 454, "Session Not Found", cseq, NULL, NULL);
+		return;
+	}
+
+	int track;
+	if (!strcmp(method, "OPTIONS")) {
+		rk_rtsp_reply(client, 200, "OK", cseq,
+		              "Public: OPTIONS, DESCRIBE, SETUP, TEARDOWN, PLAY, PAUSE, "
+		              "GET_PARAMETER, SET_PARAMETER\r\n",
+		              NULL);
+	} else if (!strcmp(method, "DESCRIBE")) {
+		rk_rtsp_session_s *found = rk_rtsp_find_session(url, &track);
+		if (found)
+			rk_rtsp_describe(client, cseq, url, found);
+		else
+			rk_rtsp_reply(client, 404, "Not Found", cseq, NULL, NULL);
+	} else if (!strcmp(method, "SETUP")) {
+		rk_rtsp_setup(client, cseq, url, transport);
+	} else if (!strcmp(method, "PLAY")) {
+		if (client->session < 0) {
+			rk_rtsp_reply(client, 455, "Method Not Valid In This State", cseq, NULL, NULL);
+			return;
+		}
+		pthread_mutex_lock(&g_server_mutex);
+		// the first frame it gets decodes on its own, rtsp.c asks the encoder for one
+		client->wait_key = 1;
+		client->playing = 1;
+		pthread_mutex_unlock(&g_server_mutex);
+		client->last_progress_ms = rkipc_get_curren_time_ms();
+		client->play_ms = client->last_progress_ms;
+		client->play_key = 0;
+		rk_rtsp_reply(client, 200, "OK", cseq, "Range: npt=0.000-\r\n", NULL);
+		LOG_INFO("viewer %s plays %s over %s\n", client->addr, g_session[client->session].path,
+		         client->tcp ? "tcp" : "udp");
+		if (g_play_cb)
+			g_play_cb(g_session[client->session].id);
+	} else if (!strcmp(method, "PAUSE")) {
+		pthread_mutex_lock(&g_server_mutex);
+		client->playing = 0;
+		while (client->count)
+			rk_rtsp_frame_release(rk_rtsp_client_pop(client));
+		pthread_mutex_unlock(&g_server_mutex);
+		rk_rtsp_reply(client, 200, "OK", cseq, NULL, NULL);
+	} else if (!strcmp(method, "TEARDOWN")) {
+		rk_rtsp_reply(client, 200, "OK", cseq, NULL, NULL);
+		client->closing = 1;
+	} else if (!strcmp(method, "GET_PARAMETER") || !strcmp(method, "SET_PARAMETER")) {
+		rk_rtsp_reply(client, 200, "OK", cseq, NULL, NULL);
+	} else {
+		rk_rtsp_reply(client, 501, "Not Implemented", cseq, NULL, NULL);
+	}
+}
+
+// 0 to keep the connection
+static int rk_rtsp_client_read(rk_rtsp_client_s *client) {
+	ssize_t n = recv(client->fd, client->req + client->req_len,
+	                 RK_RTSP_REQ_SIZE - 1 - client->req_len, 0);
+	if (n == 0 || (n < 0 && errno != EAGAIN))
+		return -1;
+	if (n < 0)
+		return 0;
+	client->req_len += n;
+	client->req[client->req_len] = '\0';
+	for (;;) {
+		int used;
+		if (client->req_len >= 4 && client->req[0] == '$') {
+			// receiver reports on the interleaved connection, not used
+			used = 4 + ((unsigned char)client->req[2] << 8 | (unsigned char)client->req[3]);
+			if (used > client->req_len)
+				break;
+		} else {
+			char *end = strstr(client->req, "\r\n\r\n");
+			if (!end)
+				break;
+			end[2] = '\0';
+			used = end + 4 - client->req;
+			const char *length = strcasestr(client->req, "Content-Length:");
+			if (length)
+				used += atoi(length + 15);
+			if (used > client->req_len)
+				break;
+			rk_rtsp_request(client, client->req);
+		}
+		client->req_len -= used;
+		memmove(client->req, client->req + used, client->req_len);
+		client->req[client->req_len] = '\0';
+	}
+	if (client->req_len == RK_RTSP_REQ_SIZE - 1) {
+		LOG_WARN("viewer %s: request too long\n", client->addr);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void *rk_rtsp_server_thread(void *arg) {
+	struct epoll_event events[RK_RTSP_SERVER_MAX_CLIENT + 4];
+	int timeout_ms = 100;
+	long long last_check_ms = 0;
+	prctl(PR_SET_NAME, "RkipcRtspSrv", 0, 0, 0);
+
+	while (g_server_run) {
+		int n = epoll_wait(g_epoll_fd, events, RK_RTSP_SERVER_MAX_CLIENT + 4, timeout_ms);
+		for (int i = 0; i < n; i++) {
+			void *ptr = events[i].data.ptr;
+			if (ptr == &g_listen_fd) {
+				rk_rtsp_accept();
+			} else if (ptr == &g_event_fd) {
+				uint64_t value;
+				if (read(g_event_fd, &value, sizeof(value)) < 0)
+					LOG_DEBUG("eventfd read fail, %s\n", strerror(errno));
+			} else if (ptr == &g_udp_fd[1]) {
+				// receiver reports, not used
+				char buf[512];
+				while (recv(g_udp_fd[1], buf, sizeof(buf), MSG_DONTWAIT) > 0)
+					;
+			} else {
+				rk_rtsp_client_s *client = (rk_rtsp_client_s *)ptr;
+				if (client->fd < 0)
+					continue;
+				if ((events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) ||
+				    ((events[i].events & EPOLLIN) && rk_rtsp_client_read(client)))
+					rk_rtsp_client_close(client, "disconnected");
+			}
+		}
+
+		long long now = rkipc_get_curren_time_ms();
+		int check = now - last_check_ms >= 1000;
+		if (check)
+			last_check_ms = now;
+		timeout_ms = 100;
+		for (int i = 0; i < RK_RTSP_SERVER_MAX_CLIENT; i++) {
+			rk_rtsp_client_s *client = &g_client[i];
+			if (client->fd < 0)
+				continue;
+			if (client->evict) {
+				g_evicted++;
+				rk_rtsp_client_close(client, client->evict);
+				continue;
+			}
+			if (client->playing && now - client->last_sr_ms >= RK_RTSP_SR_INTERVAL_MS)
+				rk_rtsp_send_sr(client, now);
+			int ret = rk_rtsp_client_flush(client);
+			if (ret < 0) {
+				rk_rtsp_client_close(client, client->closing ? "teardown" : "send fail");
+				continue;
+			}
+			if (ret > 0 && client->tcp)
+				rk_rtsp_set_out(client, 1);
+			else if (ret == 0)
+				rk_rtsp_set_out(client, 0);
+			// a full udp socket buffer has no readiness of its own per viewer, poll it
+			if (ret > 0)
+				timeout_ms = client->tcp && client->want_out ? timeout_ms : 2;
+			if (!check)
+				continue;
+			if (ret == 0) {
+				client->last_progress_ms = now;
+			} else if (now - client->last_progress_ms > g_stall_ms) {
+				g_evicted++;
+				rk_rtsp_client_close(client, "stalled");
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static int rk_rtsp_udp_bind(int port) {
+	struct sockaddr_in addr;
+	int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	int sndbuf = RK_RTSP_SNDBUF * 2;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		LOG_ERROR("bind udp port %d fail, %s\n", port, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+	return fd;
+}
+
+static void rk_rtsp_close_fds() {
+	int *fds[] = {&g_listen_fd, &g_epoll_fd, &g_event_fd, &g_udp_fd[0], &g_udp_fd[1]};
+	for (unsigned int i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+		if (*fds[i] >= 0)
+			close(*fds[i]);
+		*fds[i] = -1;
+	}
+}
+
+int rk_rtsp_server_init(int port) {
+	struct sockaddr_in addr;
+	struct epoll_event ev;
+	int one = 1;
+	g_port = port;
+	g_udp_port = rk_param_get_int("video.source:rtsp_udp_port", 6970) & ~1;
+	g_queue_bytes = rk_param_get_int("video.source:rtsp_client_queue_kb", 2048) * 1024;
+	g_stall_ms = rk_param_get_int("video.source:rtsp_client_stall_ms", 3000);
+	g_max_overflow = rk_param_get_int("video.source:rtsp_client_max_overflow", 3);
+	g_random = (uint32_t)rk_rtsp_mono_us() ^ (uint32_t)getpid() << 16;
+	if (!g_random)
+		g_random = 1;
+	memset(g_session, 0, sizeof(g_session));
+	for (int i = 0; i < RK_RTSP_SERVER_MAX_CLIENT; i++)
+		g_client[i].fd = -1;
+	g_accepted = g_evicted = 0;
+
+	g_listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (g_listen_fd < 0 ||
+	    setsockopt(g_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+	    bind(g_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(g_listen_fd, 16)) {
+		LOG_ERROR("listen on port %d fail, %s\n", port, strerror(errno));
+		rk_rtsp_close_fds();
+		return -1;
+	}
+	g_udp_fd[0] = rk_rtsp_udp_bind(g_udp_port);
+	g_udp_fd[1] = rk_rtsp_udp_bind(g_udp_port + 1);
+	g_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	g_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (g_udp_fd[0] < 0 || g_udp_fd[1] < 0 || g_event_fd < 0 || g_epoll_fd < 0) {
+		rk_rtsp_close_fds();
+		return -1;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = &g_listen_fd;
+	epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_listen_fd, &ev);
+	ev.data.ptr = &g_event_fd;
+	epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_event_fd, &ev);
+	ev.data.ptr = &g_udp_fd[1];
+	epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_udp_fd[1], &ev);
+
+	g_server_run = 1;
+	if (pthread_create(&g_server_tid, NULL, rk_rtsp_server_thread, NULL)) {
+		LOG_ERROR("create thread fail\n");
+		g_server_run = 0;
+		rk_rtsp_close_fds();
+		return -1;
+	}
+	LOG_INFO("port %d, udp %d-%d, queue %u KB, stall %d ms, max overflow %d\n", port,
+	         g_udp_port, g_udp_port + 1, g_queue_bytes / 1024, g_stall_ms, g_max_overflow);
+
+	return 0;
+}
+
+int rk_rtsp_server_deinit() {
+	if (!g_server_run)
+		return 0;
+	g_server_run = 0;
+	rk_rtsp_wake();
+	pthread_join(g_server_tid, NULL);
+	for (int i = 0; i < RK_RTSP_SERVER_MAX_CLIENT; i++) {
+		if (g_client[i].fd >= 0)
+			rk_rtsp_client_close(&g_client[i], "server stopped");
+	}
+	pthread_mutex_lock(&g_server_mutex);
+	memset(g_session, 0, sizeof(g_session));
+	pthread_mutex_unlock(&g_server_mutex);
+	rk_rtsp_close_fds();
+
+	return 0;
+}
+
+int rk_rtsp_server_add_session(int id, const char *path, int hevc, int audio_rate,
+                               int audio_channels) {
+	RKIPC_CHECK_POINTER(path, -1);
+	pthread_mutex_lock(&g_server_mutex);
+	rk_rtsp_session_s *session = NULL;
+	for (int i = 0; i < RK_RTSP_SERVER_MAX_SESSION && !session; i++) {
+		if (!g_session[i].used)
+			session = &g_session[i];
+	}
+	if (!session || rk_rtsp_session_by_id(id)) {
+		pthread_mutex_unlock(&g_server_mutex);
+		LOG_ERROR("no room for stream %d on %s\n", id, path);
+		return -1;
+	}
+	memset(session, 0, sizeof(*session));
+	session->id = id;
+	snprintf(session->path, sizeof(session->path), "%s", path);
+	session->hevc = hevc;
+	session->audio_rate = audio_rate;
+	session->audio_channels = audio_channels;
+	for (int t = 0; t < RK_RTSP_TRACK_NUM; t++)
+		session->rtp_base[t] = rk_rtsp_random();
+	session->used = 1;
+	pthread_mutex_unlock(&g_server_mutex);
+	LOG_INFO("stream %d on %s, %s%s\n", id, path, hevc ? "H.265" : "H.264",
+	         audio_rate ? " and G.711A" : "");
+
+	return 0;
+}
+
+int rk_rtsp_server_set_play_callback(void (*cb)(int id)) {
+	g_play_cb = cb;
+
+	return 0;
+}
+
+int rk_rtsp_server_set_first_frame_callback(void (*cb)(int id, long long ttff_ms)) {
+	g_first_frame_cb = cb;
+
+	return 0;
+}
+
+int rk_rtsp_server_get_stats(char *value, int size) {
+	RKIPC_CHECK_POINTER(value, -1);
+	pthread_mutex_lock(&g_server_mutex);
+	int len = snprintf(value, size, "{\"port\":%d,\"accepted\":%llu,\"evicted\":%llu,\"viewers\":[",
+	                   g_port, g_accepted, g_evicted);
+	int first = 1;
+	for (int i = 0; i < RK_RTSP_SERVER_MAX_CLIENT && len < size; i++) {
+		rk_rtsp_client_s *client = &g_client[i];
+		if (client->fd < 0)
+			continue;
+		len += snprintf(value + len, size - len,
+		                "%s{\"addr\":\"%s\",\"path\":\"%s\",\"transport\":\"%s\",\"playing\":%d,"
+		                "\"queued\":%u,\"queued_kb\":%u,\"sent_kb\":%llu,\"dropped\":%llu}",
+		                first ? "" : ",", client->addr,
+		                client->session >= 0 ? g_session[client->session].path : "",
+		                client->tcp ? "tcp" : "udp", client->playing, client->count,
+		                client->queued_bytes / 1024, client->sent_bytes / 1024, client->dropped);
+		first = 0;
+	}
+	pthread_mutex_unlock(&g_server_mutex);
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+
+	return len < size ? 0 : -1;
+}
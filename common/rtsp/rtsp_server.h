@@ -0,0 +1,42 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_RTSP_SERVER_H__
+#define __RKIPC_RTSP_SERVER_H__
+
+#include "packet_bus.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The native rtsp server rtsp.c uses instead of librtsp's rtsp_demo when
+// video.source:rtsp_native is set. One epoll thread owns every connection, the writers only
+// queue a reference of the packet for each viewer and never touch a socket. The rtp packets
+// point into the packet data, interleaved tcp and udp transports, H.264/H.265 with FU-A/FU
+// fragmentation and G.711 A-law audio.
+#define RK_RTSP_SERVER_MAX_SESSION 8
+#define RK_RTSP_SERVER_MAX_CLIENT 32
+
+int rk_rtsp_server_init(int port);
+int rk_rtsp_server_deinit();
+// a mount point like /live/0, audio_rate 0 for a video only session
+int rk_rtsp_server_add_session(int id, const char *path, int hevc, int audio_rate,
+                               int audio_channels);
+// queue an annex b frame for the viewers of session id, the server takes its own reference
+int rk_rtsp_server_write_video(int id, rk_packet_s *packet);
+// G.711 A-law, copied
+int rk_rtsp_server_write_audio(int id, const unsigned char *data, unsigned int len,
+                               int64_t pts);
+int rk_rtsp_server_get_stats(char *value, int size);
+// called from the server thread after the PLAY reply, with the id of the viewer's session
+int rk_rtsp_server_set_play_callback(void (*cb)(int id));
+// called from the server thread once the first key frame after a PLAY is sent to the viewer
+int rk_rtsp_server_set_first_frame_callback(void (*cb)(int id, long long ttff_ms));
+
+#ifdef __cplusplus
+}
+#endif
+#endif
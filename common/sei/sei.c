@@ -0,0 +1,275 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "sei.h"
+#include "common.h"
+#include "media_clock.h"
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "sei.c"
+
+#define RK_SEI_MAX_TRACK 64
+#define RK_SEI_MAX_PAYLOAD 3072
+#define RK_SEI_TYPE_USER_DATA_UNREGISTERED 5
+
+// "rkipc-analytics1"
+const unsigned char rk_sei_uuid[RK_SEI_UUID_LEN] = {0x72, 0x6b, 0x69, 0x70, 0x63, 0x2d,
+                                                    0x61, 0x6e, 0x61, 0x6c, 0x79, 0x74,
+                                                    0x69, 0x63, 0x73, 0x31};
+
+typedef struct {
+	int track_id;
+	int class_id;
+	int x, y, w, h;
+	int missed; // results in a row without a match
+} rk_sei_track_s;
+
+static pthread_mutex_t g_sei_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_sei_enable, g_sei_stream_id, g_sei_utc_every_frame;
+static int g_track_iou, g_track_max_missed;
+static rk_sei_track_s g_track[RK_SEI_MAX_TRACK];
+static int g_track_count, g_next_track_id;
+// the latest detection result not yet put into the stream
+static int g_pending;
+static int64_t g_pending_pts;
+static int g_pending_width, g_pending_height, g_pending_count;
+static rk_sei_object_s g_pending_objects[RK_SEI_MAX_OBJECT];
+
+int rk_sei_init() {
+	pthread_mutex_lock(&g_sei_mutex);
+	g_sei_enable = rk_param_get_int("sei:enable", 0);
+	g_sei_stream_id = rk_param_get_int("sei:stream_id", 0);
+	g_sei_utc_every_frame = rk_param_get_int("sei:utc_every_frame", 1);
+	g_track_iou = rk_param_get_int("sei:track_iou", 30);
+	g_track_max_missed = rk_param_get_int("sei:track_max_missed", 5);
+	g_track_count = 0;
+	g_next_track_id = 1;
+	g_pending = 0;
+	pthread_mutex_unlock(&g_sei_mutex);
+	LOG_INFO("enable %d, stream %d, utc every frame %d, track iou %d%%, max missed %d\n",
+	         g_sei_enable, g_sei_stream_id, g_sei_utc_every_frame, g_track_iou,
+	         g_track_max_missed);
+
+	return 0;
+}
+
+int rk_sei_get_stream() { return g_sei_enable ? g_sei_stream_id : -1; }
+
+// intersection over union in percent
+static int rk_sei_iou(const rk_sei_track_s *track, const rk_sei_object_s *object) {
+	int x0 = track->x > object->x ? track->x : object->x;
+	int y0 = track->y > object->y ? track->y : object->y;
+	int x1 = track->x + track->w < object->x + object->w ? track->x + track->w
+	                                                       : object->x + object->w;
+	int y1 = track->y + track->h < object->y + object->h ? track->y + track->h
+	                                                       : object->y + object->h;
+	if (x1 <= x0 || y1 <= y0)
+		return 0;
+	long long inter = (long long)(x1 - x0) * (y1 - y0);
+	long long uni = (long long)track->w * track->h + (long long)object->w * object->h - inter;
+
+	return uni > 0 ? (int)(inter * 100 / uni) : 0;
+}
+
+int rk_sei_set_objects(int64_t pts, int width, int height, rk_sei_object_s *objects, int count) {
+	RKIPC_CHECK_POINTER(objects, -1);
+	if (count > RK_SEI_MAX_OBJECT)
+		count = RK_SEI_MAX_OBJECT;
+	int matched[RK_SEI_MAX_TRACK] = {0};
+	rk_sei_track_s born[RK_SEI_MAX_OBJECT];
+	int born_count = 0;
+
+	pthread_mutex_lock(&g_sei_mutex);
+	// greedy: each object takes the best overlapping track of its class
+	for (int i = 0; i < count; i++) {
+		int best = -1, best_iou = 0;
+		for (int t = 0; t < g_track_count; t++) {
+			if (matched[t] || g_track[t].class_id != objects[i].class_id)
+				continue;
+			int iou = rk_sei_iou(&g_track[t], &objects[i]);
+			if (iou >= g_track_iou && iou > best_iou) {
+				best = t;
+				best_iou = iou;
+			}
+		}
+		rk_sei_track_s *track;
+		if (best >= 0) {
+			matched[best] = 1;
+			track = &g_track[best];
+			track->missed = 0;
+		} else {
+			track = &born[born_count++];
+			track->track_id = g_next_track_id++;
+			track->class_id = objects[i].class_id;
+			track->missed = 0;
+		}
+		track->x = objects[i].x;
+		track->y = objects[i].y;
+		track->w = objects[i].w;
+		track->h = objects[i].h;
+		objects[i].track_id = track->track_id;
+	}
+	// forget the tracks lost for too long, then add the new ones
+	int n = 0;
+	for (int t = 0; t < g_track_count; t++) {
+		if (!matched[t] && ++g_track[t].missed > g_track_max_missed)
+			continue;
+		g_track[n++] = g_track[t];
+	}
+	for (int i = 0; i < born_count && n < RK_SEI_MAX_TRACK; i++)
+		g_track[n++] = born[i];
+	g_track_count = n;
+	// the detection ring takes the track ids without the sei
+	if (!g_sei_enable) {
+		pthread_mutex_unlock(&g_sei_mutex);
+		return 0;
+	}
+
+	g_pending = 1;
+	g_pending_pts = pts;
+	g_pending_width = width;
+	g_pending_height = height;
+	g_pending_count = count;
+	memcpy(g_pending_objects, objects, count * sizeof(objects[0]));
+	pthread_mutex_unlock(&g_sei_mutex);
+
+	return 0;
+}
+
+// sei rbsp to an annex b nalu, with emulation prevention
+static int rk_sei_pack(int hevc, const char *payload, int payload_len, unsigned char *nalu,
+                       int size) {
+	unsigned char rbsp[RK_SEI_MAX_PAYLOAD + 64];
+	int n = 0, len = 0, zeros = 0;
+	int sei_size = RK_SEI_UUID_LEN + payload_len;
+
+	rbsp[n++] = RK_SEI_TYPE_USER_DATA_UNREGISTERED;
+	for (; sei_size >= 255; sei_size -= 255)
+		rbsp[n++] = 0xff;
+	rbsp[n++] = sei_size;
+	memcpy(rbsp + n, rk_sei_uuid, RK_SEI_UUID_LEN);
+	n += RK_SEI_UUID_LEN;
+	memcpy(rbsp + n, payload, payload_len);
+	n += payload_len;
+	rbsp[n++] = 0x80; // rbsp trailing bits
+
+	if (size < 6)
+		return -1;
+	nalu[len++] = 0;
+	nalu[len++] = 0;
+	nalu[len++] = 0;
+	nalu[len++] = 1;
+	if (hevc) {
+		nalu[len++] = 39 << 1; // prefix sei
+		nalu[len++] = 1;
+	} else {
+		nalu[len++] = 6;
+	}
+	for (int i = 0; i < n; i++) {
+		if (zeros >= 2 && rbsp[i] <= 3) {
+			if (len >= size)
+				return -1;
+			nalu[len++] = 3;
+			zeros = 0;
+		}
+		if (len >= size)
+			return -1;
+		nalu[len++] = rbsp[i];
+		zeros = rbsp[i] ? 0 : zeros + 1;
+	}
+
+	return len;
+}
+
+int rk_sei_build_frame(int hevc, int64_t pts, unsigned char *nalu, int size) {
+	RKIPC_CHECK_POINTER(nalu, -1);
+	char payload[RK_SEI_MAX_PAYLOAD];
+	int len = 0;
+	if (!g_sei_enable)
+		return 0;
+
+	pthread_mutex_lock(&g_sei_mutex);
+	if (!g_pending && !g_sei_utc_every_frame) {
+		pthread_mutex_unlock(&g_sei_mutex);
+		return 0;
+	}
+	len += snprintf(payload + len, sizeof(payload) - len,
+	                "{\"pts\":%" PRId64 ",\"utc_ms\":%" PRId64, pts, rk_media_clock_to_utc_ms(pts));
+	// the detections lag the encoder, their own pts tells which frame they describe
+	if (g_pending) {
+		len += snprintf(payload + len, sizeof(payload) - len,
+		                ",\"det\":{\"pts\":%" PRId64 ",\"utc_ms\":%" PRId64
+		                ",\"size\":[%d,%d],\"objects\":[",
+		                g_pending_pts, rk_media_clock_to_utc_ms(g_pending_pts), g_pending_width,
+		                g_pending_height);
+		for (int i = 0; i < g_pending_count && len < (int)sizeof(payload); i++) {
+			rk_sei_object_s *object = &g_pending_objects[i];
+			len += snprintf(payload + len, sizeof(payload) - len,
+			                "%s{\"track\":%d,\"class\":%d,\"conf\":%.3f,\"box\":[%d,%d,%d,%d]}",
+			                i ? "," : "", object->track_id, object->class_id,
+			                object->confidence, object->x, object->y, object->w, object->h);
+		}
+		if (len < (int)sizeof(payload))
+			len += snprintf(payload + len, sizeof(payload) - len, "]}");
+		g_pending = 0;
+	}
+	if (len < (int)sizeof(payload))
+		len += snprintf(payload + len, sizeof(payload) - len, "}");
+	pthread_mutex_unlock(&g_sei_mutex);
+	if (len >= (int)sizeof(payload)) {
+		LOG_WARN("payload truncated, need %d bytes\n", len);
+		return -1;
+	}
+
+	return rk_sei_pack(hevc, payload, len, nalu, size);
+}
+
+// offset of the start code of the first vcl nalu in an annex b buffer, -1 if none
+static int rk_sei_find_vcl(const unsigned char *data, unsigned int len, int hevc) {
+	for (unsigned int i = 0; i + 3 < len; i++) {
+		if (data[i] || data[i + 1] || data[i + 2] != 1)
+			continue;
+		int type = hevc ? (data[i + 3] >> 1) & 0x3f : data[i + 3] & 0x1f;
+		if (hevc ? type < 32 : (type >= 1 && type <= 5))
+			return (i > 0 && !data[i - 1]) ? i - 1 : i;
+		i += 2;
+	}
+
+	return -1;
+}
+
+int rk_sei_insert_iov(struct iovec *iov, int count, int max, const unsigned char *nalu,
+                      unsigned int len, int hevc) {
+	RKIPC_CHECK_POINTER(iov, count);
+	RKIPC_CHECK_POINTER(nalu, count);
+	for (int i = 0; i < count; i++) {
+		int offset = rk_sei_find_vcl((const unsigned char *)iov[i].iov_base, iov[i].iov_len, hevc);
+		if (offset < 0)
+			continue;
+		// parameter sets and the slice can share a pack, split it in front of the slice
+		int extra = offset ? 2 : 1;
+		if (count + extra > max) {
+			LOG_WARN("no room for the sei in %d packs\n", count);
+			return count;
+		}
+		memmove(&iov[i + extra], &iov[i], (count - i) * sizeof(iov[0]));
+		if (offset) {
+			iov[i].iov_len = offset;
+			iov[i + 2].iov_base = (unsigned char *)iov[i + 2].iov_base + offset;
+			iov[i + 2].iov_len -= offset;
+		}
+		iov[i + extra - 1].iov_base = (void *)nalu;
+		iov[i + extra - 1].iov_len = len;
+		return count + extra;
+	}
+	// no slice in these packs, it comes with the next ones
+	if (count < max) {
+		iov[count].iov_base = (void *)nalu;
+		iov[count].iov_len = len;
+		count++;
+	}
+
+	return count;
+}
@@ -0,0 +1,45 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_SEI_H__
+#define __RKIPC_SEI_H__
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RK_SEI_MAX_OBJECT 32
+#define RK_SEI_MAX_NALU 4096
+#define RK_SEI_UUID_LEN 16
+
+// the uuid of the user data unregistered sei, host tools look for it
+extern const unsigned char rk_sei_uuid[RK_SEI_UUID_LEN];
+
+typedef struct {
+	int track_id; // filled in by rk_sei_set_objects
+	int class_id;
+	float confidence;
+	int x, y, w, h; // pixels of the analysed frame
+} rk_sei_object_s;
+
+int rk_sei_init();
+// the video stream carrying the metadata, -1 when disabled
+int rk_sei_get_stream();
+// assign track ids, and keep the result until the next frame of the sei stream takes it
+// when the sei is enabled
+int rk_sei_set_objects(int64_t pts, int width, int height, rk_sei_object_s *objects, int count);
+// the annex b sei nalu for the frame of pts: its utc capture time and any new detections.
+// Return its length, 0 when the frame gets none, -1 on error
+int rk_sei_build_frame(int hevc, int64_t pts, unsigned char *nalu, int size);
+// splice the nalu into the packs of a frame right before its first slice, return the new count
+int rk_sei_insert_iov(struct iovec *iov, int count, int max, const unsigned char *nalu,
+                      unsigned int len, int hevc);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
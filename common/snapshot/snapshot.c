@@ -0,0 +1,286 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // syncfs
+#endif
+#include "snapshot.h"
+#include "common.h"
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "snapshot.c"
+
+static pthread_mutex_t g_snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_writer_cond = PTHREAD_COND_INITIALIZER;
+
+// ram ring, g_ring[g_ring_start] is the oldest
+static rk_snapshot_s *g_ring[RK_SNAPSHOT_MAX_RING];
+static int g_ring_start, g_ring_count, g_ring_num;
+static unsigned int g_ring_bytes, g_ring_max_bytes;
+static unsigned int g_seq;
+
+// waiting for the disk writer
+static rk_snapshot_s *g_pending[RK_SNAPSHOT_MAX_PENDING];
+static int g_pending_count;
+static long long g_pending_first_ms;
+static int g_batch_num, g_batch_ms;
+static unsigned long long g_written, g_write_dropped;
+
+static const char *g_file_path;
+static int g_writer_run;
+static pthread_t g_writer_tid;
+static int g_snapshot_inited;
+
+static void rk_snapshot_unref_locked(rk_snapshot_s *snapshot) {
+	if (--snapshot->ref > 0)
+		return;
+	free(snapshot->data);
+	free(snapshot);
+}
+
+void rk_snapshot_release(rk_snapshot_s *snapshot) {
+	if (!snapshot)
+		return;
+	pthread_mutex_lock(&g_snapshot_mutex);
+	rk_snapshot_unref_locked(snapshot);
+	pthread_mutex_unlock(&g_snapshot_mutex);
+}
+
+static int rk_snapshot_write_file(rk_snapshot_s *snapshot) {
+	char file_name[256];
+	time_t t = snapshot->time_ms / 1000;
+	struct tm tm;
+	localtime_r(&t, &tm);
+	// a burst can land several frames in one second, keep the milliseconds
+	snprintf(file_name, sizeof(file_name), "%s/%d%02d%02d%02d%02d%02d_%03d.jpeg", g_file_path,
+	         tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+	         (int)(snapshot->time_ms % 1000));
+	FILE *fp = fopen(file_name, "wb");
+	if (!fp) {
+		LOG_ERROR("open %s fail, %s\n", file_name, strerror(errno));
+		return -1;
+	}
+	size_t len = fwrite(snapshot->data, 1, snapshot->len, fp);
+	fclose(fp);
+	if (len != snapshot->len) {
+		LOG_ERROR("write %s fail, %zu/%u\n", file_name, len, snapshot->len);
+		return -1;
+	}
+	LOG_INFO("file_name is %s, reason %s\n", file_name, snapshot->reason);
+
+	return 0;
+}
+
+static void *rk_snapshot_writer(void *arg) {
+	rk_snapshot_s *batch[RK_SNAPSHOT_MAX_PENDING];
+	int num;
+	prctl(PR_SET_NAME, "RkipcSnapWriter", 0, 0, 0);
+
+	pthread_mutex_lock(&g_snapshot_mutex);
+	while (g_writer_run || g_pending_count) {
+		// wait for a full batch, or for the oldest pending one to get too old
+		if (g_writer_run && g_pending_count < g_batch_num) {
+			struct timespec ts;
+			long long wait_ms = 1000;
+			if (g_pending_count)
+				wait_ms = g_pending_first_ms + g_batch_ms - rkipc_get_curren_time_ms();
+			if (wait_ms > 0) {
+				clock_gettime(CLOCK_REALTIME, &ts);
+				ts.tv_sec += wait_ms / 1000;
+				ts.tv_nsec += (wait_ms % 1000) * 1000000;
+				if (ts.tv_nsec >= 1000000000) {
+					ts.tv_sec++;
+					ts.tv_nsec -= 1000000000;
+				}
+				pthread_cond_timedwait(&g_writer_cond, &g_snapshot_mutex, &ts);
+				continue;
+			}
+		}
+		if (!g_pending_count)
+			continue;
+		num = g_pending_count;
+		memcpy(batch, g_pending, num * sizeof(batch[0]));
+		g_pending_count = 0;
+		pthread_mutex_unlock(&g_snapshot_mutex);
+
+		// the sd card is slow to flush, one sync per batch instead of one per file
+		int failed = 0;
+		for (int i = 0; i < num; i++)
+			failed += rk_snapshot_write_file(batch[i]) ? 1 : 0;
+		int dir_fd = open(g_file_path, O_RDONLY | O_DIRECTORY);
+		if (dir_fd >= 0) {
+			syncfs(dir_fd);
+			close(dir_fd);
+		}
+		LOG_DEBUG("wrote %d snapshots, %d failed\n", num, failed);
+
+		pthread_mutex_lock(&g_snapshot_mutex);
+		g_written += num - failed;
+		g_write_dropped += failed;
+		for (int i = 0; i < num; i++)
+			rk_snapshot_unref_locked(batch[i]);
+	}
+	pthread_mutex_unlock(&g_snapshot_mutex);
+
+	return NULL;
+}
+
+int rk_snapshot_init() {
+	if (g_snapshot_inited)
+		return 0;
+	g_ring_num = rk_param_get_int("video.jpeg:ring_num", 8);
+	if (g_ring_num < 1)
+		g_ring_num = 1;
+	if (g_ring_num > RK_SNAPSHOT_MAX_RING)
+		g_ring_num = RK_SNAPSHOT_MAX_RING;
+	g_ring_max_bytes = rk_param_get_int("video.jpeg:ring_max_kb", 4096) * 1024;
+	g_batch_num = rk_param_get_int("video.jpeg:persist_batch_num", 4);
+	if (g_batch_num < 1)
+		g_batch_num = 1;
+	if (g_batch_num > RK_SNAPSHOT_MAX_PENDING)
+		g_batch_num = RK_SNAPSHOT_MAX_PENDING;
+	g_batch_ms = rk_param_get_int("video.jpeg:persist_batch_ms", 2000);
+	g_file_path = rk_param_get_string("storage:file_path", "/userdata");
+	LOG_INFO("ring %d, max %u bytes, batch %d/%d ms, path %s\n", g_ring_num, g_ring_max_bytes,
+	         g_batch_num, g_batch_ms, g_file_path);
+
+	g_ring_start = g_ring_count = 0;
+	g_ring_bytes = 0;
+	g_pending_count = 0;
+	g_written = g_write_dropped = 0;
+	g_writer_run = 1;
+	if (pthread_create(&g_writer_tid, NULL, rk_snapshot_writer, NULL)) {
+		LOG_ERROR("create writer thread fail\n");
+		g_writer_run = 0;
+		return -1;
+	}
+	g_snapshot_inited = 1;
+
+	return 0;
+}
+
+int rk_snapshot_deinit() {
+	if (!g_snapshot_inited)
+		return 0;
+	pthread_mutex_lock(&g_snapshot_mutex);
+	g_writer_run = 0;
+	pthread_cond_signal(&g_writer_cond);
+	pthread_mutex_unlock(&g_snapshot_mutex);
+	pthread_join(g_writer_tid, NULL);
+
+	pthread_mutex_lock(&g_snapshot_mutex);
+	while (g_ring_count) {
+		rk_snapshot_unref_locked(g_ring[g_ring_start]);
+		g_ring_start = (g_ring_start + 1) % RK_SNAPSHOT_MAX_RING;
+		g_ring_count--;
+	}
+	g_ring_bytes = 0;
+	g_snapshot_inited = 0;
+	pthread_mutex_unlock(&g_snapshot_mutex);
+
+	return 0;
+}
+
+int rk_snapshot_push(const void *data, unsigned int len, int64_t pts, const char *reason,
+                     int persist) {
+	RKIPC_CHECK_POINTER(data, -1);
+	if (!g_snapshot_inited)
+		return -1;
+
+	// copy outside the lock, a jpeg can be a few hundred KB
+	rk_snapshot_s *snapshot = (rk_snapshot_s *)calloc(1, sizeof(rk_snapshot_s));
+	if (!snapshot)
+		return -1;
+	snapshot->data = (unsigned char *)malloc(len);
+	if (!snapshot->data) {
+		free(snapshot);
+		return -1;
+	}
+	memcpy(snapshot->data, data, len);
+	snapshot->len = len;
+	snapshot->pts = pts;
+	snprintf(snapshot->reason, sizeof(snapshot->reason), "%s", reason ? reason : "");
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	snapshot->time_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	snapshot->ref = 1;
+
+	pthread_mutex_lock(&g_snapshot_mutex);
+	snapshot->seq = g_seq++;
+	while (g_ring_count &&
+	       (g_ring_count >= g_ring_num || g_ring_bytes + len > g_ring_max_bytes)) {
+		rk_snapshot_s *oldest = g_ring[g_ring_start];
+		g_ring_bytes -= oldest->len;
+		rk_snapshot_unref_locked(oldest);
+		g_ring_start = (g_ring_start + 1) % RK_SNAPSHOT_MAX_RING;
+		g_ring_count--;
+	}
+	g_ring[(g_ring_start + g_ring_count) % RK_SNAPSHOT_MAX_RING] = snapshot;
+	g_ring_count++;
+	g_ring_bytes += len;
+
+	if (persist) {
+		if (g_pending_count >= RK_SNAPSHOT_MAX_PENDING) {
+			// the card can not keep up, keep the newest ones
+			rk_snapshot_unref_locked(g_pending[0]);
+			memmove(g_pending, g_pending + 1, (RK_SNAPSHOT_MAX_PENDING - 1) * sizeof(g_pending[0]));
+			g_pending_count--;
+			g_write_dropped++;
+			LOG_WARN("persist queue full, drop the oldest snapshot\n");
+		}
+		if (!g_pending_count)
+			g_pending_first_ms = rkipc_get_curren_time_ms();
+		snapshot->ref++;
+		g_pending[g_pending_count++] = snapshot;
+		if (g_pending_count >= g_batch_num)
+			pthread_cond_signal(&g_writer_cond);
+	}
+	pthread_mutex_unlock(&g_snapshot_mutex);
+
+	return 0;
+}
+
+rk_snapshot_s *rk_snapshot_get(int index) {
+	rk_snapshot_s *snapshot = NULL;
+	pthread_mutex_lock(&g_snapshot_mutex);
+	if (index >= 0 && index < g_ring_count) {
+		snapshot = g_ring[(g_ring_start + g_ring_count - 1 - index) % RK_SNAPSHOT_MAX_RING];
+		snapshot->ref++;
+	}
+	pthread_mutex_unlock(&g_snapshot_mutex);
+
+	return snapshot;
+}
+
+int rk_snapshot_get_list(char *value, int size) {
+	RKIPC_CHECK_POINTER(value, -1);
+	int len = 0;
+
+	pthread_mutex_lock(&g_snapshot_mutex);
+	len += snprintf(value + len, size - len,
+	                "{\"ring_bytes\":%u,\"pending\":%d,\"written\":%llu,\"write_dropped\":%llu,"
+	                "\"snapshots\":[",
+	                g_ring_bytes, g_pending_count, g_written, g_write_dropped);
+	// latest first, the same order as the index of rk_snapshot_get
+	for (int i = 0; i < g_ring_count && len < size; i++) {
+		rk_snapshot_s *snapshot =
+		    g_ring[(g_ring_start + g_ring_count - 1 - i) % RK_SNAPSHOT_MAX_RING];
+		len += snprintf(value + len, size - len,
+		                "%s{\"index\":%d,\"seq\":%u,\"reason\":\"%s\",\"pts\":%" PRId64
+		                ",\"time_ms\":%" PRId64 ",\"len\":%u}",
+		                i ? "," : "", i, snapshot->seq, snapshot->reason, snapshot->pts,
+		                snapshot->time_ms, snapshot->len);
+	}
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+	pthread_mutex_unlock(&g_snapshot_mutex);
+
+	if (len >= size) {
+		LOG_WARN("list truncated, need %d bytes\n", len);
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,45 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_SNAPSHOT_H__
+#define __RKIPC_SNAPSHOT_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RK_SNAPSHOT_MAX_RING 64
+#define RK_SNAPSHOT_MAX_PENDING 32
+
+typedef struct {
+	unsigned int seq;
+	int64_t pts;
+	int64_t time_ms; // CLOCK_REALTIME, used for the file name
+	char reason[16];
+	unsigned int len;
+	unsigned char *data;
+	// private
+	int ref;
+} rk_snapshot_s;
+
+// reads the ring size, memory cap and persist batching from video.jpeg:*
+int rk_snapshot_init();
+// writes out the snapshots still waiting for disk
+int rk_snapshot_deinit();
+
+// copy a jpeg into the ram ring, the oldest ones are dropped beyond the count or byte cap.
+// persist queues it for the disk writer thread, which never blocks the caller
+int rk_snapshot_push(const void *data, unsigned int len, int64_t pts, const char *reason,
+                     int persist);
+// index 0 is the latest, return NULL if there is none, release it after use
+rk_snapshot_s *rk_snapshot_get(int index);
+void rk_snapshot_release(rk_snapshot_s *snapshot);
+int rk_snapshot_get_list(char *value, int size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -25,10 +25,18 @@
 
 // set by CMakeList.txt
 #include "audio.h"
+#include "boot.h"
+#include "frame_export.h"
+#include "hls.h"
 #include "isp.h"
+#include "lease.h"
+#include "media_clock.h"
 #include "osd.h"
+#include "packet_bus.h"
 #include "region_clip.h"
 #include "roi.h"
+#include "snapshot.h"
+#include "trace.h"
 #include "video.h"
 
 #ifdef LOG_TAG
@@ -2100,6 +2108,76 @@ int ser_rk_video_set_output_data_type(int fd) {
 	return 0;
 }
 
+int ser_rk_video_get_rtmp_url(int fd) {
+	int err = 0;
+	int id, len;
+	const char *value;
+
+	if (sock_read(fd, &id, sizeof(id)) == SOCKERR_CLOSED)
+		return -1;
+	err = rk_video_get_rtmp_url(id, &value);
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s, addr is %p\n", len, value, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_video_set_rtmp_url(int fd) {
+	int ret = 0;
+	int id, len;
+	char *value = NULL;
+
+	if (sock_read(fd, &id, sizeof(id)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_read(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (len) {
+		value = (char *)malloc(len);
+		if (sock_read(fd, value, len) == SOCKERR_CLOSED) {
+			free(value);
+			return -1;
+		}
+		LOG_DEBUG("id is %d, value is %s\n", id, value);
+		ret = rk_video_set_rtmp_url(id, value);
+		free(value);
+		if (sock_write(fd, &ret, sizeof(int)) == SOCKERR_CLOSED)
+			return -1;
+	}
+
+	return 0;
+}
+
+int ser_rk_video_set_rtmp_key(int fd) {
+	int ret = 0;
+	int id, len;
+	char *value = NULL;
+
+	if (sock_read(fd, &id, sizeof(id)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_read(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (len) {
+		value = (char *)malloc(len);
+		if (sock_read(fd, value, len) == SOCKERR_CLOSED) {
+			free(value);
+			return -1;
+		}
+		// not logged, the stream key is a credential
+		ret = rk_video_set_rtmp_key(id, value);
+		free(value);
+		if (sock_write(fd, &ret, sizeof(int)) == SOCKERR_CLOSED)
+			return -1;
+	}
+
+	return 0;
+}
+
 int ser_rk_video_get_rc_quality(int fd) {
 	int err = 0;
 	int id, len;
@@ -2493,6 +2571,196 @@ int ser_rk_video_set_rotation(int fd) {
 	return 0;
 }
 
+int ser_rk_video_get_npu_profile(int fd) {
+	int err = 0;
+	int len;
+	char value[8192];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_video_get_npu_profile(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_video_get_adaptive_rc_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[512];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_video_get_adaptive_rc_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_video_get_scene_change_events(int fd) {
+	int err = 0;
+	int len;
+	char value[1536];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_video_get_scene_change_events(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_video_get_mb_plan(int fd) {
+	int err = 0;
+	int len;
+	char value[2048];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_video_get_mb_plan(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_video_get_packet_bus_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[4096];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_packet_bus_get_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_video_get_rtsp_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[8192]; // every viewer of the native rtsp server
+
+	memset(value, '\0', 1); // set terminator
+	err = rkipc_rtsp_get_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_video_get_frame_export_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[1024];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_frame_export_get_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_video_get_rtmp_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[2048];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_rtmp_get_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_video_get_media_clock_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[1024];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_media_clock_get_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_video_get_hls_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[1024];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_hls_get_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
 // jpeg
 
 int ser_rk_video_get_enable_cycle_snapshot(int fd) {
@@ -4443,6 +4711,100 @@ int ser_rk_take_photo(int fd) {
 	return 0;
 }
 
+int ser_rk_video_snapshot_burst(int fd) {
+	int err = 0;
+	int count;
+	int interval_ms;
+
+	if (sock_read(fd, &count, sizeof(count)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_read(fd, &interval_ms, sizeof(interval_ms)) == SOCKERR_CLOSED)
+		return -1;
+	LOG_DEBUG("count is %d, interval_ms is %d\n", count, interval_ms);
+	err = rk_video_snapshot_trigger("socket", count, interval_ms, 1);
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+// index 0 is the latest jpeg in the ram ring, len is 0 when there is none
+int ser_rk_video_get_snapshot(int fd) {
+	int err = 0;
+	int index;
+	int len = 0;
+
+	if (sock_read(fd, &index, sizeof(index)) == SOCKERR_CLOSED)
+		return -1;
+	rk_snapshot_s *snapshot = rk_snapshot_get(index);
+	if (snapshot)
+		len = snapshot->len;
+	else
+		err = -1;
+	LOG_DEBUG("index is %d, len is %d\n", index, len);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		goto out;
+	if (len && sock_write(fd, snapshot->data, len) == SOCKERR_CLOSED)
+		goto out;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		goto out;
+	rk_snapshot_release(snapshot);
+
+	return 0;
+out:
+	rk_snapshot_release(snapshot);
+	return -1;
+}
+
+int ser_rk_video_get_snapshot_list(int fd) {
+	int err = 0;
+	int len;
+	char value[8192];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_snapshot_get_list(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_storage_event_trigger(int fd) {
+	int err = 0;
+
+	LOG_DEBUG("begin\n");
+	err = rk_storage_event_trigger("socket");
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_storage_event_get_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[1024];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_storage_event_get_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
 // event
 int ser_rk_event_ri_get_enabled(int fd) {
 	int err = 0;
@@ -5149,6 +5511,97 @@ int ser_rk_system_reboot(int fd) {
 	return 0;
 }
 
+int ser_rk_system_get_boot_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[2048];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_boot_get_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_system_get_trace_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[8192];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_trace_get_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d\n", len);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_system_get_trace_frame(int fd) {
+	int err = 0;
+	int len;
+	int stream_id;
+	int64_t pts;
+	char value[1024];
+
+	if (sock_read(fd, &stream_id, sizeof(stream_id)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_read(fd, &pts, sizeof(pts)) == SOCKERR_CLOSED)
+		return -1;
+	memset(value, '\0', 1); // set terminator
+	err = rk_trace_get_frame(stream_id, pts, value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_system_reset_trace(int fd) {
+	int err = rk_trace_reset();
+
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
+int ser_rk_system_get_lease_stats(int fd) {
+	int err = 0;
+	int len;
+	char value[4096];
+
+	memset(value, '\0', 1); // set terminator
+	err = rk_lease_get_stats(value, sizeof(value));
+	len = strlen(value);
+	LOG_DEBUG("len is %d, value is %s\n", len, value);
+	if (sock_write(fd, &len, sizeof(len)) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, value, len) == SOCKERR_CLOSED)
+		return -1;
+	if (sock_write(fd, &err, sizeof(int)) == SOCKERR_CLOSED)
+		return -1;
+
+	return 0;
+}
+
 int ser_rk_system_factory_reset(int fd) {
 	int err = 0;
 
@@ -5572,6 +6025,9 @@ static const struct FunMap map[] = {
     {(char *)"rk_video_set_RC_mode", &ser_rk_video_set_RC_mode},
     {(char *)"rk_video_get_output_data_type", &ser_rk_video_get_output_data_type},
     {(char *)"rk_video_set_output_data_type", &ser_rk_video_set_output_data_type},
+    {(char *)"rk_video_get_rtmp_url", &ser_rk_video_get_rtmp_url},
+    {(char *)"rk_video_set_rtmp_url", &ser_rk_video_set_rtmp_url},
+    {(char *)"rk_video_set_rtmp_key", &ser_rk_video_set_rtmp_key},
     {(char *)"rk_video_get_rc_quality", &ser_rk_video_get_rc_quality},
     {(char *)"rk_video_set_rc_quality", &ser_rk_video_set_rc_quality},
     {(char *)"rk_video_get_smart", &ser_rk_video_get_smart},
@@ -5590,6 +6046,16 @@ static const struct FunMap map[] = {
     {(char *)"rk_video_set_frame_rate_in", &ser_rk_video_set_frame_rate_in},
     {(char *)"rk_video_get_rotation", &ser_rk_video_get_rotation},
     {(char *)"rk_video_set_rotation", &ser_rk_video_set_rotation},
+    {(char *)"rk_video_get_npu_profile", &ser_rk_video_get_npu_profile},
+    {(char *)"rk_video_get_adaptive_rc_stats", &ser_rk_video_get_adaptive_rc_stats},
+    {(char *)"rk_video_get_scene_change_events", &ser_rk_video_get_scene_change_events},
+    {(char *)"rk_video_get_mb_plan", &ser_rk_video_get_mb_plan},
+    {(char *)"rk_video_get_packet_bus_stats", &ser_rk_video_get_packet_bus_stats},
+    {(char *)"rk_video_get_rtsp_stats", &ser_rk_video_get_rtsp_stats},
+    {(char *)"rk_video_get_frame_export_stats", &ser_rk_video_get_frame_export_stats},
+    {(char *)"rk_video_get_rtmp_stats", &ser_rk_video_get_rtmp_stats},
+    {(char *)"rk_video_get_media_clock_stats", &ser_rk_video_get_media_clock_stats},
+    {(char *)"rk_video_get_hls_stats", &ser_rk_video_get_hls_stats},
     // jpeg
     {(char *)"rk_video_get_enable_cycle_snapshot", &ser_rk_video_get_enable_cycle_snapshot},
     {(char *)"rk_video_set_enable_cycle_snapshot", &ser_rk_video_set_enable_cycle_snapshot},
@@ -5696,6 +6162,11 @@ static const struct FunMap map[] = {
     {(char *)"rk_storage_record_stop", &ser_rk_storage_record_stop},
     {(char *)"rk_storage_record_statue_get", &ser_rk_storage_record_statue_get},
     {(char *)"rk_take_photo", &ser_rk_take_photo},
+    {(char *)"rk_video_snapshot_burst", &ser_rk_video_snapshot_burst},
+    {(char *)"rk_video_get_snapshot", &ser_rk_video_get_snapshot},
+    {(char *)"rk_video_get_snapshot_list", &ser_rk_video_get_snapshot_list},
+    {(char *)"rk_storage_event_trigger", &ser_rk_storage_event_trigger},
+    {(char *)"rk_storage_event_get_stats", &ser_rk_storage_event_get_stats},
     // event
     {(char *)"rk_event_ri_get_enabled", &ser_rk_event_ri_get_enabled},
     {(char *)"rk_event_ri_set_enabled", &ser_rk_event_ri_set_enabled},
@@ -5747,6 +6218,11 @@ static const struct FunMap map[] = {
     {(char *)"rk_system_set_telecontrol_id", &ser_rk_system_set_telecontrol_id},
     {(char *)"rk_system_reboot", &ser_rk_system_reboot},
     {(char *)"rk_system_factory_reset", &ser_rk_system_factory_reset},
+    {(char *)"rk_system_get_boot_stats", &ser_rk_system_get_boot_stats},
+    {(char *)"rk_system_get_trace_stats", &ser_rk_system_get_trace_stats},
+    {(char *)"rk_system_get_trace_frame", &ser_rk_system_get_trace_frame},
+    {(char *)"rk_system_reset_trace", &ser_rk_system_reset_trace},
+    {(char *)"rk_system_get_lease_stats", &ser_rk_system_get_lease_stats},
     {(char *)"rk_system_export_log", &ser_rk_system_export_log},
     {(char *)"rk_system_export_db", &ser_rk_system_export_db},
     {(char *)"rk_system_import_db", &ser_rk_system_import_db},
@@ -9,6 +9,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/poll.h>
 #include <sys/shm.h>
 #include <sys/socket.h>
@@ -20,7 +21,8 @@
 
 #include "socket.h"
 
-union {
+// ancillary data of one SCM_RIGHTS fd, aligned as a cmsghdr
+typedef union {
 	struct cmsghdr cm;
 	char control[CMSG_SPACE(sizeof(int))];
 } control_un;
@@ -116,3 +118,83 @@ int sock_read(int fd, void *buff, int count) {
 
 	return status;
 }
+
+int sock_send_fd(int fd, const void *buff, int count, int send_fd) {
+	struct msghdr msg;
+	struct iovec iov;
+	control_un control;
+	struct cmsghdr *cmsg;
+	int n;
+
+	if (count <= 0)
+		return SOCKERR_INVARG;
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = (void *)buff;
+	iov.iov_len = count;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (send_fd >= 0) {
+		memset(&control, 0, sizeof(control));
+		msg.msg_control = control.control;
+		msg.msg_controllen = sizeof(control.control);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		memcpy(CMSG_DATA(cmsg), &send_fd, sizeof(int));
+	}
+
+	do {
+		n = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	} while (n < 0 && errno == EINTR);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return SOCKERR_TIMEOUT;
+		return errno == EPIPE ? SOCKERR_CLOSED : SOCKERR_IO;
+	}
+	// the fd went with the first byte, the rest would need a second message
+	if (n != count)
+		return SOCKERR_IO;
+
+	return n;
+}
+
+int sock_recv_fd(int fd, void *buff, int count, int *recv_fd) {
+	struct msghdr msg;
+	struct iovec iov;
+	control_un control;
+	struct cmsghdr *cmsg;
+	int n;
+
+	if (count <= 0 || !recv_fd)
+		return SOCKERR_INVARG;
+	*recv_fd = -1;
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = buff;
+	iov.iov_len = count;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.control;
+	msg.msg_controllen = sizeof(control.control);
+
+	do {
+		n = recvmsg(fd, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+	} while (n < 0 && errno == EINTR);
+	if (n < 0)
+		return SOCKERR_IO;
+	if (n == 0)
+		return SOCKERR_CLOSED;
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+		    cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+			memcpy(recv_fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	if (n != count) {
+		if (*recv_fd >= 0)
+			close(*recv_fd);
+		*recv_fd = -1;
+		return SOCKERR_IO;
+	}
+
+	return n;
+}
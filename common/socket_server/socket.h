@@ -16,5 +16,10 @@ int serv_listen(const char *name);
 int serv_accept(int fd);
 int sock_write(int fd, const void *buff, int count);
 int sock_read(int fd, void *buff, int count);
+// one message with send_fd attached as SCM_RIGHTS, -1 for none. Never blocks,
+// SOCKERR_TIMEOUT when the peer is not reading
+int sock_send_fd(int fd, const void *buff, int count, int send_fd);
+// one message and the fd that came with it, *recv_fd is -1 when there was none
+int sock_recv_fd(int fd, void *buff, int count, int *recv_fd);
 
 #endif
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "file_cache.h"
 #include "file_common.h"
 #include "file_msg.h"
+#include "packet_bus.h"
 #include <sys/mount.h>
 
 #ifdef LOG_TAG
@@ -1637,34 +1638,144 @@ int rkipc_storage_current_path_set(char *value) { return 0; }
 // 	return out;
 // }
 
+static void rk_storage_make_file_name(rk_storage_muxer_struct *group, int slot, time_t t) {
+	// a rotation within the second of the last one must not reopen the file being written
+	if (t <= group->last_start)
+		t = group->last_start + 1;
+	group->last_start = t;
+	struct tm tm = *localtime(&t);
+	snprintf(group->file_name[slot], sizeof(group->file_name[slot]),
+	         "%s/%d%02d%02d%02d%02d%02d.%s", group->record_path, tm.tm_year + 1900,
+	         tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, group->file_format);
+}
+
+// rkmuxer_init and rkmuxer_deinit write the file header and index, which takes hundreds of ms on
+// a slow card. They run on the standby or retired slot without g_rkmuxer_mutex, the writers
+// only ever touch the active slot under it
+static int rk_storage_open_standby(rk_storage_muxer_struct *group, time_t start) {
+	int slot = !group->active;
+	rk_storage_make_file_name(group, slot, start);
+	long long begin = rkipc_get_curren_time_ms();
+	int ret = rkmuxer_init(group->muxer_id[slot], NULL, group->file_name[slot],
+	                       &group->g_video_param, &group->g_audio_param);
+	if (ret) {
+		LOG_ERROR("[%d] rkmuxer_init %s fail %d\n", group->id, group->file_name[slot], ret);
+		rkmuxer_deinit(group->muxer_id[slot]);
+		return -1;
+	}
+	LOG_INFO("[%d] file_name is %s, opened in %lld ms\n", group->id, group->file_name[slot],
+	         rkipc_get_curren_time_ms() - begin);
+	pthread_mutex_lock(&g_rkmuxer_mutex);
+	group->standby_open = 1;
+	pthread_mutex_unlock(&g_rkmuxer_mutex);
+
+	return 0;
+}
+
+static void rk_storage_close_slot(rk_storage_muxer_struct *group, int slot, int unused) {
+	long long begin = rkipc_get_curren_time_ms();
+	rkmuxer_deinit(group->muxer_id[slot]);
+	if (unused) {
+		// pre-opened but never switched to, it only has a header
+		unlink(group->file_name[slot]);
+		return;
+	}
+	if (rk_param_get_int("storage:enable_fsync", 0)) {
+		int fd = open(group->file_name[slot], O_RDWR);
+		if (fd >= 0) {
+			fsync(fd);
+			close(fd);
+		} else {
+			LOG_ERROR("open file %s failed %s\n", group->file_name[slot], strerror(errno));
+		}
+	}
+	LOG_INFO("[%d] %s closed in %lld ms\n", group->id, group->file_name[slot],
+	         rkipc_get_curren_time_ms() - begin);
+}
+
+// called with g_rkmuxer_mutex held, by the writer of the first idr after the boundary. The idr
+// and everything after it go to the new file, nothing is lost or written twice
+static void rk_storage_switch_locked(rk_storage_muxer_struct *group) {
+	int old = group->active;
+	group->active = !old;
+	group->retired = group->g_record_run_ ? old : -1;
+	group->g_record_run_ = 1;
+	group->standby_open = 0;
+	group->switch_pending = 0;
+	LOG_DEBUG("[%d] switched to %s after %lld ms\n", group->id, group->file_name[group->active],
+	          rkipc_get_curren_time_ms() - group->switch_request_ms);
+	if (group->retired >= 0 && group->g_storage_signal)
+		rk_signal_give(group->g_storage_signal);
+}
+
+// closes the file of the slot that is not written anymore, then opens the next one
+// storage:rotate_preopen_ms before the boundary and asks the writers to switch once it is due
 static void *rk_storage_record(void *arg) {
 	int *id_ptr = arg;
 	int id = *id_ptr;
+	rk_storage_muxer_struct *group = &rk_storage_muxer_group[id];
+	long long duration_ms = group->file_duration * 1000LL;
+	long long preopen_ms = rk_param_get_int("storage:rotate_preopen_ms", 3000);
+	long long boundary_ms = rkipc_get_curren_time_ms(), retry_ms = 0;
 	printf("id: %d, #Start %s thread, arg:%p\n", id, __func__, arg);
 	prctl(PR_SET_NAME, "rk_storage_record", 0, 0, 0);
+	if (preopen_ms > duration_ms / 2)
+		preopen_ms = duration_ms / 2;
 	while (g_storage_record_flag[id] && record_flag[id] == 1) {
-		time_t t = time(NULL);
-		struct tm tm = *localtime(&t);
-		snprintf(rk_storage_muxer_group[id].file_name, 512, "%s/%d%02d%02d%02d%02d%02d.%s",
-		         rk_storage_muxer_group[id].record_path, tm.tm_year + 1900, tm.tm_mon + 1,
-		         tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
-		         rk_storage_muxer_group[id].file_format);
-		LOG_INFO("[%d], file_name is %s\n", id, rk_storage_muxer_group[id].file_name);
+		long long now = rkipc_get_curren_time_ms();
 		pthread_mutex_lock(&g_rkmuxer_mutex);
-		rk_storage_muxer_group[id].g_record_run_ = 0;
-		rkmuxer_deinit(id);
-		rkmuxer_init(id, NULL, rk_storage_muxer_group[id].file_name,
-		             &rk_storage_muxer_group[id].g_video_param,
-		             &rk_storage_muxer_group[id].g_audio_param);
-		rk_storage_muxer_group[id].g_record_run_ = 1;
+		int retired = group->retired;
+		int standby_open = group->standby_open;
+		int switch_pending = group->switch_pending;
+		group->retired = -1;
+		if (group->rotate_now) {
+			group->rotate_now = 0;
+			boundary_ms = now;
+		}
 		pthread_mutex_unlock(&g_rkmuxer_mutex);
-		rk_signal_wait(rk_storage_muxer_group[id].g_storage_signal,
-		               rk_storage_muxer_group[id].file_duration * 1000);
+
+		long long wait_ms;
+		if (retired >= 0) {
+			rk_storage_close_slot(group, retired, 0);
+			continue;
+		} else if (switch_pending) {
+			wait_ms = 1000; // until the next idr
+		} else if (!standby_open && now >= boundary_ms - preopen_ms && now >= retry_ms) {
+			// named after the time it is due to start
+			if (rk_storage_open_standby(group, time(NULL) + (boundary_ms - now) / 1000))
+				retry_ms = now + 1000;
+			continue;
+		} else if (standby_open && now >= boundary_ms) {
+			pthread_mutex_lock(&g_rkmuxer_mutex);
+			group->switch_pending = 1;
+			group->switch_request_ms = now;
+			pthread_mutex_unlock(&g_rkmuxer_mutex);
+			boundary_ms += duration_ms;
+			if (boundary_ms < now)
+				boundary_ms = now + duration_ms;
+			continue;
+		} else {
+			wait_ms = (standby_open ? boundary_ms : boundary_ms - preopen_ms) - now;
+			if (!standby_open && retry_ms > now)
+				wait_ms = retry_ms - now;
+		}
+		rk_signal_wait(group->g_storage_signal, wait_ms > 0 ? wait_ms : 1);
 	}
 	pthread_mutex_lock(&g_rkmuxer_mutex);
-	rk_storage_muxer_group[id].g_record_run_ = 0;
-	rkmuxer_deinit(id);
+	int active_open = group->g_record_run_;
+	int standby_open = group->standby_open;
+	int retired = group->retired;
+	group->g_record_run_ = 0;
+	group->standby_open = 0;
+	group->switch_pending = 0;
+	group->retired = -1;
 	pthread_mutex_unlock(&g_rkmuxer_mutex);
+	if (retired >= 0)
+		rk_storage_close_slot(group, retired, 0);
+	if (active_open)
+		rk_storage_close_slot(group, group->active, 0);
+	if (standby_open)
+		rk_storage_close_slot(group, !group->active, 1);
 
 	return NULL;
 }
@@ -1676,6 +1787,9 @@ static int rk_storage_muxer_init_by_id(int id) {
 	const char *folder_name = NULL;
 
 	rk_storage_muxer_group[id].id = id;
+	rk_storage_muxer_group[id].muxer_id[0] = RKIPC_MUXER_ID_STORAGE(id);
+	rk_storage_muxer_group[id].muxer_id[1] = RKIPC_MUXER_ID_STORAGE_STANDBY(id);
+	rk_storage_muxer_group[id].retired = -1;
 	// set rk_storage_muxer_group[id].g_video_param
 	rk_storage_muxer_group[id].g_video_param.level = 52;
 	snprintf(entry, 127, "video.%d:width", id);
@@ -1799,6 +1913,342 @@ int rk_storage_muxer_deinit_by_id(int id) {
 	return 0;
 }
 
+// reopen one stream's record file after its size or profile changed
+int rk_storage_restart_by_id(int id) {
+	if (id < 0 || id >= STORAGE_NUM || g_sd_phandle == NULL)
+		return 0;
+	rk_storage_muxer_deinit_by_id(id);
+
+	return rk_storage_muxer_init_by_id(id);
+}
+
+// pre-event recording: the main stream and its audio stay in a ram ring that always starts on an
+// idr frame. An event writes the ring into a new clip, followed by the live stream until
+// post_record_ms after the last trigger
+#define RK_EVENT_RING_ENTRY 2048
+#define RK_EVENT_PENDING_ENTRY 4096
+
+typedef struct {
+	rk_packet_s *packet;
+	int audio;
+} rk_event_entry_s;
+
+typedef struct {
+	rk_event_entry_s *entry;
+	int capacity;
+	int start;
+	int count;
+	unsigned int bytes;
+} rk_event_queue_s;
+
+static rk_event_queue_s g_event_ring;    // pre-event packets
+static rk_event_queue_s g_event_pending; // packets waiting for the clip writer
+static unsigned int g_event_ring_max_bytes, g_event_pending_max_bytes;
+static int g_event_enable, g_event_recording, g_event_pending_wait_key;
+static int g_event_post_ms, g_event_max_ms;
+static long long g_event_start_ms, g_event_end_ms;
+static char g_event_reason[32];
+static char g_event_file_name[512];
+static unsigned long long g_event_clips, g_event_dropped;
+static pthread_t g_event_tid;
+static pthread_mutex_t g_event_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_event_cond = PTHREAD_COND_INITIALIZER;
+
+static int rk_event_queue_init(rk_event_queue_s *queue, int capacity) {
+	memset(queue, 0, sizeof(*queue));
+	queue->entry = (rk_event_entry_s *)calloc(capacity, sizeof(rk_event_entry_s));
+	if (!queue->entry)
+		return -1;
+	queue->capacity = capacity;
+
+	return 0;
+}
+
+// takes over the reference of packet
+static void rk_event_queue_push(rk_event_queue_s *queue, rk_packet_s *packet, int audio) {
+	rk_event_entry_s *entry = &queue->entry[(queue->start + queue->count) % queue->capacity];
+	entry->packet = packet;
+	entry->audio = audio;
+	queue->count++;
+	queue->bytes += packet->len;
+}
+
+static rk_event_entry_s rk_event_queue_pop(rk_event_queue_s *queue) {
+	rk_event_entry_s entry = queue->entry[queue->start];
+	queue->start = (queue->start + 1) % queue->capacity;
+	queue->count--;
+	queue->bytes -= entry.packet->len;
+
+	return entry;
+}
+
+static int rk_event_queue_head_is_idr(rk_event_queue_s *queue) {
+	rk_event_entry_s *entry = &queue->entry[queue->start];
+	return !entry->audio && entry->packet->key_frame;
+}
+
+static void rk_event_queue_clear(rk_event_queue_s *queue) {
+	while (queue->count)
+		rk_packet_unref(rk_event_queue_pop(queue).packet);
+}
+
+static void rk_event_queue_free(rk_event_queue_s *queue) {
+	if (!queue->entry)
+		return;
+	rk_event_queue_clear(queue);
+	free(queue->entry);
+	queue->entry = NULL;
+}
+
+static void rk_event_ring_push_locked(rk_packet_s *packet, int audio) {
+	int idr = !audio && packet->key_frame;
+	// nothing is kept until the first idr, the clip must be decodable from its first frame
+	if (!g_event_ring.count && !idr)
+		return;
+	// drop whole gops from the head until the packet fits, so the head stays an idr
+	while (g_event_ring.count && (g_event_ring.bytes + packet->len > g_event_ring_max_bytes ||
+	                              g_event_ring.count >= g_event_ring.capacity)) {
+		rk_packet_unref(rk_event_queue_pop(&g_event_ring).packet);
+		while (g_event_ring.count && !rk_event_queue_head_is_idr(&g_event_ring))
+			rk_packet_unref(rk_event_queue_pop(&g_event_ring).packet);
+	}
+	if (!g_event_ring.count && !idr)
+		return; // a gop larger than the cap, wait for the next idr
+	if (packet->len > g_event_ring_max_bytes)
+		return;
+	rk_event_queue_push(&g_event_ring, rk_packet_ref(packet), audio);
+}
+
+static void rk_event_pending_push_locked(rk_packet_s *packet, int audio) {
+	int idr = !audio && packet->key_frame;
+	if (g_event_pending_wait_key && !idr) {
+		g_event_dropped++;
+		return;
+	}
+	if (g_event_pending.count >= g_event_pending.capacity ||
+	    g_event_pending.bytes + packet->len > g_event_pending_max_bytes) {
+		// the card is slower than the stream, skip to the next idr instead of blocking the bus
+		LOG_WARN("event clip writer is behind, skip to the next idr\n");
+		g_event_pending_wait_key = 1;
+		g_event_dropped++;
+		return;
+	}
+	g_event_pending_wait_key = 0;
+	rk_event_queue_push(&g_event_pending, rk_packet_ref(packet), audio);
+	pthread_cond_signal(&g_event_cond);
+}
+
+static void rk_event_write_locked(rk_packet_s *packet, int audio) {
+	if (!g_event_enable)
+		return;
+	rk_event_ring_push_locked(packet, audio);
+	if (g_event_recording)
+		rk_event_pending_push_locked(packet, audio);
+}
+
+int rk_storage_event_write_video(rk_packet_s *packet) {
+	pthread_mutex_lock(&g_event_mutex);
+	rk_event_write_locked(packet, 0);
+	pthread_mutex_unlock(&g_event_mutex);
+
+	return 0;
+}
+
+static int rk_storage_event_write_audio(unsigned char *buffer, unsigned int buffer_size,
+                                        int64_t present_time) {
+	if (!g_event_enable)
+		return 0;
+	rk_packet_s *packet = rk_packet_alloc(buffer_size);
+	if (!packet)
+		return -1;
+	memcpy(packet->data, buffer, buffer_size);
+	packet->stream_id = 0;
+	packet->pts = present_time;
+	packet->key_frame = 0;
+	pthread_mutex_lock(&g_event_mutex);
+	rk_event_write_locked(packet, 1);
+	pthread_mutex_unlock(&g_event_mutex);
+	rk_packet_unref(packet);
+
+	return 0;
+}
+
+int rk_storage_event_trigger(const char *reason) {
+	pthread_mutex_lock(&g_event_mutex);
+	if (!g_event_enable) {
+		pthread_mutex_unlock(&g_event_mutex);
+		LOG_WARN("storage.event:enable is 0\n");
+		return -1;
+	}
+	long long now = rkipc_get_curren_time_ms();
+	if (!g_event_recording) {
+		// the ring goes first into the clip, new packets follow it through the same queue
+		for (int i = 0; i < g_event_ring.count; i++) {
+			rk_event_entry_s *entry =
+			    &g_event_ring.entry[(g_event_ring.start + i) % g_event_ring.capacity];
+			rk_event_queue_push(&g_event_pending, rk_packet_ref(entry->packet), entry->audio);
+		}
+		g_event_pending_wait_key = !g_event_pending.count;
+		g_event_start_ms = now;
+		g_event_recording = 1;
+		snprintf(g_event_reason, sizeof(g_event_reason), "%s", reason ? reason : "");
+		LOG_INFO("event %s, %d pre-event packets, %u bytes\n", g_event_reason,
+		         g_event_pending.count, g_event_pending.bytes);
+		pthread_cond_signal(&g_event_cond);
+	}
+	// a new trigger extends the clip, up to max_record_ms
+	g_event_end_ms = now + g_event_post_ms;
+	if (g_event_end_ms > g_event_start_ms + g_event_max_ms)
+		g_event_end_ms = g_event_start_ms + g_event_max_ms;
+	pthread_mutex_unlock(&g_event_mutex);
+
+	return 0;
+}
+
+static int rk_storage_event_open_clip() {
+	rk_storage_muxer_struct *group = &rk_storage_muxer_group[0];
+	time_t t = time(NULL);
+	struct tm tm = *localtime(&t);
+	// same folder as the main stream recording, so the file list and auto delete cover it
+	snprintf(g_event_file_name, sizeof(g_event_file_name), "%s/event_%d%02d%02d%02d%02d%02d.%s",
+	         group->record_path, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+	         tm.tm_min, tm.tm_sec, group->file_format);
+	LOG_INFO("file_name is %s\n", g_event_file_name);
+	// like the record rotation, opening and closing stay outside g_rkmuxer_mutex
+	int ret = rkmuxer_init(RKIPC_MUXER_ID_EVENT, NULL, g_event_file_name, &group->g_video_param,
+	                       &group->g_audio_param);
+	if (ret)
+		LOG_ERROR("rkmuxer_init %s fail %d\n", g_event_file_name, ret);
+
+	return ret;
+}
+
+static void *rk_storage_event_thread(void *arg) {
+	prctl(PR_SET_NAME, "rk_storage_event", 0, 0, 0);
+	struct timespec ts;
+
+	pthread_mutex_lock(&g_event_mutex);
+	while (g_event_enable) {
+		if (!g_event_recording) {
+			pthread_cond_wait(&g_event_cond, &g_event_mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&g_event_mutex);
+		int opened = rk_storage_event_open_clip() == 0;
+		pthread_mutex_lock(&g_event_mutex);
+
+		while (g_event_enable) {
+			if (g_event_pending.count) {
+				rk_event_entry_s entry = rk_event_queue_pop(&g_event_pending);
+				pthread_mutex_unlock(&g_event_mutex);
+				if (opened) {
+					pthread_mutex_lock(&g_rkmuxer_mutex);
+					if (entry.audio)
+						rkmuxer_write_audio_frame(RKIPC_MUXER_ID_EVENT, entry.packet->data,
+						                          entry.packet->len, entry.packet->pts);
+					else
+						rkmuxer_write_video_frame(RKIPC_MUXER_ID_EVENT, entry.packet->data,
+						                          entry.packet->len, entry.packet->pts,
+						                          entry.packet->key_frame);
+					pthread_mutex_unlock(&g_rkmuxer_mutex);
+				}
+				rk_packet_unref(entry.packet);
+				pthread_mutex_lock(&g_event_mutex);
+				continue;
+			}
+			if (rkipc_get_curren_time_ms() >= g_event_end_ms)
+				break;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += 100 * 1000000;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&g_event_cond, &g_event_mutex, &ts);
+		}
+		g_event_recording = 0;
+		rk_event_queue_clear(&g_event_pending);
+		long long duration = rkipc_get_curren_time_ms() - g_event_start_ms;
+		pthread_mutex_unlock(&g_event_mutex);
+
+		if (opened) {
+			rkmuxer_deinit(RKIPC_MUXER_ID_EVENT);
+			LOG_INFO("event clip %s closed, %lld ms after the trigger\n", g_event_file_name,
+			         duration);
+		}
+		pthread_mutex_lock(&g_event_mutex);
+		if (opened)
+			g_event_clips++;
+	}
+	pthread_mutex_unlock(&g_event_mutex);
+
+	return NULL;
+}
+
+static int rk_storage_event_init() {
+	if (!rk_param_get_int("storage.event:enable", 0))
+		return 0;
+	pthread_mutex_lock(&g_event_mutex);
+	g_event_ring_max_bytes = rk_param_get_int("storage.event:pre_record_kb", 8192) * 1024;
+	// room for the whole ring plus the live stream while the card catches up
+	g_event_pending_max_bytes =
+	    g_event_ring_max_bytes + rk_param_get_int("storage.event:live_queue_kb", 4096) * 1024;
+	g_event_post_ms = rk_param_get_int("storage.event:post_record_ms", 10000);
+	g_event_max_ms = rk_param_get_int("storage.event:max_record_ms", 60000);
+	if (rk_event_queue_init(&g_event_ring, RK_EVENT_RING_ENTRY) ||
+	    rk_event_queue_init(&g_event_pending, RK_EVENT_PENDING_ENTRY)) {
+		rk_event_queue_free(&g_event_ring);
+		rk_event_queue_free(&g_event_pending);
+		pthread_mutex_unlock(&g_event_mutex);
+		LOG_ERROR("malloc event queue fail\n");
+		return -1;
+	}
+	g_event_recording = 0;
+	g_event_clips = g_event_dropped = 0;
+	g_event_enable = 1;
+	pthread_mutex_unlock(&g_event_mutex);
+	LOG_INFO("pre-event ring %u bytes, post %d ms, max %d ms\n", g_event_ring_max_bytes,
+	         g_event_post_ms, g_event_max_ms);
+	pthread_create(&g_event_tid, NULL, rk_storage_event_thread, NULL);
+
+	return 0;
+}
+
+static int rk_storage_event_deinit() {
+	pthread_mutex_lock(&g_event_mutex);
+	if (!g_event_enable) {
+		pthread_mutex_unlock(&g_event_mutex);
+		return 0;
+	}
+	// the clip in progress is closed with what was written so far
+	g_event_enable = 0;
+	pthread_cond_signal(&g_event_cond);
+	pthread_mutex_unlock(&g_event_mutex);
+	pthread_join(g_event_tid, NULL);
+
+	pthread_mutex_lock(&g_event_mutex);
+	rk_event_queue_free(&g_event_ring);
+	rk_event_queue_free(&g_event_pending);
+	pthread_mutex_unlock(&g_event_mutex);
+
+	return 0;
+}
+
+int rk_storage_event_get_stats(char *value, int size) {
+	RKIPC_CHECK_POINTER(value, -1);
+	pthread_mutex_lock(&g_event_mutex);
+	int len = snprintf(value, size,
+	                   "{\"enable\":%d,\"recording\":%d,\"reason\":\"%s\",\"ring_bytes\":%u,"
+	                   "\"ring_max_bytes\":%u,\"ring_packets\":%d,\"pending_bytes\":%u,"
+	                   "\"clips\":%llu,\"dropped\":%llu}",
+	                   g_event_enable, g_event_recording, g_event_reason, g_event_ring.bytes,
+	                   g_event_ring_max_bytes, g_event_ring.count, g_event_pending.bytes,
+	                   g_event_clips, g_event_dropped);
+	pthread_mutex_unlock(&g_event_mutex);
+
+	return len < size ? 0 : -1;
+}
+
 // TODO, need record plan
 int rk_storage_init() {
 	FILE_CACHE_ARG stFileCacheAttr;
@@ -1827,11 +2277,13 @@ int rk_storage_init() {
 		LOG_DEBUG("i:%d\n", i);
 		rk_storage_muxer_init_by_id(i);
 	}
+	rk_storage_event_init();
 
 	return 0;
 }
 
 int rk_storage_deinit() {
+	rk_storage_event_deinit();
 	for (int i = 0; i < STORAGE_NUM; i++) {
 		rk_storage_muxer_deinit_by_id(i);
 	}
@@ -1846,9 +2298,13 @@ int rk_storage_deinit() {
 
 int rk_storage_write_video_frame(int id, unsigned char *buffer, unsigned int buffer_size,
                                  int64_t present_time, int key_frame) {
+	rk_storage_muxer_struct *group = &rk_storage_muxer_group[id];
 	pthread_mutex_lock(&g_rkmuxer_mutex);
-	if (rk_storage_muxer_group[id].g_record_run_)
-		rkmuxer_write_video_frame(id, buffer, buffer_size, present_time, key_frame);
+	if (group->switch_pending && key_frame)
+		rk_storage_switch_locked(group);
+	if (group->g_record_run_)
+		rkmuxer_write_video_frame(group->muxer_id[group->active], buffer, buffer_size,
+		                          present_time, key_frame);
 	pthread_mutex_unlock(&g_rkmuxer_mutex);
 
 	return 0;
@@ -1856,9 +2312,13 @@ int rk_storage_write_video_frame(int id, unsigned char *buffer, unsigned int buf
 
 int rk_storage_write_audio_frame(int id, unsigned char *buffer, unsigned int buffer_size,
                                  int64_t present_time) {
+	if (id == 0)
+		rk_storage_event_write_audio(buffer, buffer_size, present_time);
+	rk_storage_muxer_struct *group = &rk_storage_muxer_group[id];
 	pthread_mutex_lock(&g_rkmuxer_mutex);
-	if (rk_storage_muxer_group[id].g_record_run_)
-		rkmuxer_write_audio_frame(id, buffer, buffer_size, present_time);
+	if (group->g_record_run_)
+		rkmuxer_write_audio_frame(group->muxer_id[group->active], buffer, buffer_size,
+		                          present_time);
 	pthread_mutex_unlock(&g_rkmuxer_mutex);
 
 	return 0;
@@ -1867,21 +2327,30 @@ int rk_storage_write_audio_frame(int id, unsigned char *buffer, unsigned int buf
 int rk_storage_record_start(int id) {
 	// only main stream, id default is 0
 	LOG_INFO("start\n");
-	time_t t = time(NULL);
-	struct tm tm = *localtime(&t);
-
-	snprintf(rk_storage_muxer_group[id].file_name, 512, "%s/%d%02d%02d%02d%02d%02d.%s",
-	         rk_storage_muxer_group[id].record_path, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
-	         tm.tm_hour, tm.tm_min, tm.tm_sec, rk_storage_muxer_group[id].file_format);
-	LOG_INFO("file_name is %s\n", rk_storage_muxer_group[id].file_name);
+	rk_storage_muxer_struct *group = &rk_storage_muxer_group[id];
+	// the record thread rotates to a new file on the next idr
+	if (group->g_storage_signal) {
+		pthread_mutex_lock(&g_rkmuxer_mutex);
+		group->rotate_now = 1;
+		pthread_mutex_unlock(&g_rkmuxer_mutex);
+		rk_signal_give(group->g_storage_signal);
+		LOG_INFO("end\n");
+		return 0;
+	}
+	pthread_mutex_lock(&g_rkmuxer_mutex);
+	int standby_open = group->standby_open;
+	pthread_mutex_unlock(&g_rkmuxer_mutex);
+	if (!standby_open && rk_storage_open_standby(group, time(NULL)))
+		return -1;
 	pthread_mutex_lock(&g_rkmuxer_mutex);
-	rk_storage_muxer_group[id].g_record_run_ = 0;
-	rkmuxer_deinit(id);
-	rkmuxer_init(id, NULL, rk_storage_muxer_group[id].file_name,
-	             &rk_storage_muxer_group[id].g_video_param,
-	             &rk_storage_muxer_group[id].g_audio_param);
-	rk_storage_muxer_group[id].g_record_run_ = 1;
+	group->switch_pending = 1;
+	group->switch_request_ms = rkipc_get_curren_time_ms();
+	int retired = group->retired;
+	group->retired = -1;
 	pthread_mutex_unlock(&g_rkmuxer_mutex);
+	// without a record thread the file a previous start left is closed here
+	if (retired >= 0)
+		rk_storage_close_slot(group, retired, 0);
 	LOG_INFO("end\n");
 
 	return 0;
@@ -1890,19 +2359,18 @@ int rk_storage_record_start(int id) {
 int rk_storage_record_stop(int id) {
 	// only main stream, id default is 0
 	LOG_INFO("start\n");
+	rk_storage_muxer_struct *group = &rk_storage_muxer_group[id];
 	pthread_mutex_lock(&g_rkmuxer_mutex);
-	rk_storage_muxer_group[id].g_record_run_ = 0;
-	rkmuxer_deinit(id);
-	if (rk_param_get_int("storage:enable_fsync", 0)) {
-		int fd = open(rk_storage_muxer_group[id].file_name, O_RDWR);
-		if (fd >= 0) {
-			fsync(fd);
-			close(fd);
-		} else {
-			LOG_ERROR("open file %s failed %s\n", rk_storage_muxer_group[id].file_name, strerror(errno));
-		}
-	}
+	int active_open = group->g_record_run_;
+	int retired = group->retired;
+	group->g_record_run_ = 0;
+	group->switch_pending = 0;
+	group->retired = -1;
 	pthread_mutex_unlock(&g_rkmuxer_mutex);
+	if (retired >= 0)
+		rk_storage_close_slot(group, retired, 0);
+	if (active_open)
+		rk_storage_close_slot(group, group->active, 0);
 	LOG_INFO("end\n");
 	return 0;
 }
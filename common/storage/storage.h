@@ -172,19 +172,30 @@ typedef struct {
 
 typedef struct rk_storage_muxer_struct_ {
 	int id;
-	char file_name[256 * 2];
+	char file_name[2][256 * 2]; // per muxer slot
 	char record_path[256];
 	const char *file_format;
 	int file_duration;
-	int g_record_run_;
+	int g_record_run_; // the active slot has a file open and takes the writes
 	void *g_storage_signal;
 	pthread_t record_thread_id;
 	VideoParam g_video_param;
 	AudioParam g_audio_param;
+	// the next file is opened on the standby slot ahead of the boundary, the writers switch to
+	// it on the first idr after the boundary and the record thread closes the old one
+	int muxer_id[2];
+	int active;
+	int standby_open;
+	int switch_pending;
+	int retired; // slot waiting to be closed, -1 for none
+	int rotate_now;
+	long long switch_request_ms;
+	time_t last_start; // of the newest file name
 } rk_storage_muxer_struct;
 
 int rk_storage_init();
 int rk_storage_deinit();
+int rk_storage_restart_by_id(int id);
 int rk_storage_write_video_frame(int id, unsigned char *buffer, unsigned int buffer_size,
                                  int64_t present_time, int key_frame);
 int rk_storage_write_audio_frame(int id, unsigned char *buffer, unsigned int buffer_size,
@@ -192,6 +203,11 @@ int rk_storage_write_audio_frame(int id, unsigned char *buffer, unsigned int buf
 int rk_storage_record_start(int id);
 int rk_storage_record_stop(int id);
 int rk_storage_record_statue_get(int id, int *value);
+// pre-event recording of the main stream, see storage.event in the ini
+struct rk_packet_s;
+int rk_storage_event_write_video(struct rk_packet_s *packet);
+int rk_storage_event_trigger(const char *reason);
+int rk_storage_event_get_stats(char *value, int size);
 int rk_storage_format();
 
 // int rkipc_storage_quota_get(int id, char **value);    // TODO, current only sd card
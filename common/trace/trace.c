@@ -0,0 +1,182 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "trace.h"
+#include "common.h"
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "trace.c"
+
+#define RK_TRACE_BUCKET_NUM 11
+
+// upper bounds in ms, the last bucket takes everything above
+static const int g_bucket_ms[RK_TRACE_BUCKET_NUM - 1] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+static const char *g_stage_name[RK_TRACE_STAGE_NUM] = {
+    "vi",      "rga",            "venc_first", "venc",           "rtsp",
+    "storage", "npu_preprocess", "npu_run",    "npu_postprocess", "npu_publish"};
+
+typedef struct {
+	unsigned long long count;
+	long long sum_us;
+	long long max_us;
+	unsigned int bucket[RK_TRACE_BUCKET_NUM];
+} rk_trace_hist_s;
+
+typedef struct {
+	int64_t pts;
+	int stream_id;
+	int stage;
+	int latency_us;
+} rk_trace_event_s;
+
+static pthread_mutex_t g_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_trace_enable = 1;
+static rk_trace_hist_s g_hist[RK_TRACE_MAX_STREAM][RK_TRACE_STAGE_NUM];
+// the latest events, looked up by pts
+static rk_trace_event_s g_ring[RK_TRACE_FRAME_RING];
+static unsigned int g_ring_pos, g_ring_count;
+static unsigned long long g_dropped;
+
+int rk_trace_init() {
+	g_trace_enable = rk_param_get_int("trace:enable", 1);
+	LOG_INFO("enable %d\n", g_trace_enable);
+	return rk_trace_reset();
+}
+
+int64_t rk_trace_now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void rk_trace_record(int stream_id, rk_trace_stage stage, int64_t pts) {
+	if (!g_trace_enable || stream_id < 0 || stream_id >= RK_TRACE_MAX_STREAM || stage < 0 ||
+	    stage >= RK_TRACE_STAGE_NUM)
+		return;
+	long long latency_us = rk_trace_now_us() - pts;
+	int bucket = 0;
+	// a pts from another clock base would only pollute the histogram
+	if (latency_us < 0 || latency_us > 10000000) {
+		pthread_mutex_lock(&g_trace_mutex);
+		g_dropped++;
+		pthread_mutex_unlock(&g_trace_mutex);
+		return;
+	}
+	while (bucket < RK_TRACE_BUCKET_NUM - 1 && latency_us > g_bucket_ms[bucket] * 1000LL)
+		bucket++;
+
+	pthread_mutex_lock(&g_trace_mutex);
+	rk_trace_hist_s *hist = &g_hist[stream_id][stage];
+	hist->count++;
+	hist->sum_us += latency_us;
+	if (latency_us > hist->max_us)
+		hist->max_us = latency_us;
+	hist->bucket[bucket]++;
+	rk_trace_event_s *event = &g_ring[g_ring_pos];
+	event->pts = pts;
+	event->stream_id = stream_id;
+	event->stage = stage;
+	event->latency_us = (int)latency_us;
+	g_ring_pos = (g_ring_pos + 1) % RK_TRACE_FRAME_RING;
+	if (g_ring_count < RK_TRACE_FRAME_RING)
+		g_ring_count++;
+	pthread_mutex_unlock(&g_trace_mutex);
+}
+
+// upper bound of the bucket holding the percent-th sample, the max for the open bucket
+static long long rk_trace_percentile_us(rk_trace_hist_s *hist, int percent) {
+	unsigned long long target = (hist->count * percent + 99) / 100;
+	unsigned long long seen = 0;
+	for (int i = 0; i < RK_TRACE_BUCKET_NUM - 1; i++) {
+		seen += hist->bucket[i];
+		if (seen >= target)
+			return g_bucket_ms[i] * 1000LL < hist->max_us ? g_bucket_ms[i] * 1000LL : hist->max_us;
+	}
+	return hist->max_us;
+}
+
+int rk_trace_get_stats(char *value, int size) {
+	RKIPC_CHECK_POINTER(value, -1);
+	int len = 0;
+
+	len += snprintf(value + len, size - len, "{\"enable\":%d,\"buckets_ms\":[", g_trace_enable);
+	for (int i = 0; i < RK_TRACE_BUCKET_NUM - 1 && len < size; i++)
+		len += snprintf(value + len, size - len, "%s%d", i ? "," : "", g_bucket_ms[i]);
+	pthread_mutex_lock(&g_trace_mutex);
+	if (len < size)
+		len += snprintf(value + len, size - len, "],\"dropped\":%llu,\"streams\":[", g_dropped);
+	for (int i = 0; i < RK_TRACE_MAX_STREAM && len < size; i++) {
+		len += snprintf(value + len, size - len, "%s{\"id\":%d,\"stages\":[", i ? "," : "", i);
+		int first = 1;
+		for (int j = 0; j < RK_TRACE_STAGE_NUM && len < size; j++) {
+			rk_trace_hist_s *hist = &g_hist[i][j];
+			if (!hist->count)
+				continue;
+			len += snprintf(value + len, size - len,
+			                "%s{\"name\":\"%s\",\"count\":%llu,\"avg_us\":%lld,\"max_us\":%lld,"
+			                "\"p50_us\":%lld,\"p90_us\":%lld,\"p99_us\":%lld,\"hist\":[",
+			                first ? "" : ",", g_stage_name[j], hist->count,
+			                hist->sum_us / (long long)hist->count, hist->max_us,
+			                rk_trace_percentile_us(hist, 50), rk_trace_percentile_us(hist, 90),
+			                rk_trace_percentile_us(hist, 99));
+			for (int k = 0; k < RK_TRACE_BUCKET_NUM && len < size; k++)
+				len += snprintf(value + len, size - len, "%s%u", k ? "," : "", hist->bucket[k]);
+			if (len < size)
+				len += snprintf(value + len, size - len, "]}");
+			first = 0;
+		}
+		if (len < size)
+			len += snprintf(value + len, size - len, "]}");
+	}
+	pthread_mutex_unlock(&g_trace_mutex);
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+
+	if (len >= size) {
+		LOG_WARN("stats truncated, need %d bytes\n", len);
+		return -1;
+	}
+
+	return 0;
+}
+
+int rk_trace_get_frame(int stream_id, int64_t pts, char *value, int size) {
+	RKIPC_CHECK_POINTER(value, -1);
+	int len = 0, found = 0;
+
+	len += snprintf(value + len, size - len,
+	                "{\"stream_id\":%d,\"pts\":%" PRId64 ",\"stages\":[", stream_id, pts);
+	pthread_mutex_lock(&g_trace_mutex);
+	// oldest first, which is the order the frame went through the stages
+	unsigned int start = (g_ring_pos + RK_TRACE_FRAME_RING - g_ring_count) % RK_TRACE_FRAME_RING;
+	for (unsigned int i = 0; i < g_ring_count && len < size; i++) {
+		rk_trace_event_s *event = &g_ring[(start + i) % RK_TRACE_FRAME_RING];
+		if (event->stream_id != stream_id || event->pts != pts)
+			continue;
+		len += snprintf(value + len, size - len, "%s{\"name\":\"%s\",\"latency_us\":%d}",
+		                found ? "," : "", g_stage_name[event->stage], event->latency_us);
+		found++;
+	}
+	pthread_mutex_unlock(&g_trace_mutex);
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+
+	if (len >= size) {
+		LOG_WARN("frame truncated, need %d bytes\n", len);
+		return -1;
+	}
+
+	return found ? 0 : -1;
+}
+
+int rk_trace_reset() {
+	pthread_mutex_lock(&g_trace_mutex);
+	memset(g_hist, 0, sizeof(g_hist));
+	g_ring_pos = g_ring_count = 0;
+	g_dropped = 0;
+	pthread_mutex_unlock(&g_trace_mutex);
+
+	return 0;
+}
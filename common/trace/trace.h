@@ -0,0 +1,47 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef __RKIPC_TRACE_H__
+#define __RKIPC_TRACE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// video streams 0..2 and the npu vi channel
+#define RK_TRACE_MAX_STREAM 4
+#define RK_TRACE_STREAM_NPU 3
+#define RK_TRACE_FRAME_RING 1024
+
+// every stage records the time elapsed since capture, the pts the vi stamped on the frame
+typedef enum {
+	RK_TRACE_VI = 0,         // frame handed to the application by vi
+	RK_TRACE_RGA,            // converted by rga
+	RK_TRACE_VENC_FIRST,     // first slice out of the encoder
+	RK_TRACE_VENC,           // whole frame out of the encoder
+	RK_TRACE_RTSP,           // first slice handed to the rtsp sessions
+	RK_TRACE_STORAGE,        // written to the muxer
+	RK_TRACE_NPU_PREPROCESS, // letterboxed into the input tensor
+	RK_TRACE_NPU_RUN,        // rknn_run returned
+	RK_TRACE_NPU_POSTPROCESS,
+	RK_TRACE_NPU_PUBLISH, // result picked up by the video thread
+	RK_TRACE_STAGE_NUM,
+} rk_trace_stage;
+
+int rk_trace_init();
+// CLOCK_MONOTONIC in us, the clock of the vi pts
+int64_t rk_trace_now_us();
+void rk_trace_record(int stream_id, rk_trace_stage stage, int64_t pts);
+// per stream and stage latency histograms in json
+int rk_trace_get_stats(char *value, int size);
+// every stage the frame with this pts went through, while it is still in the ring
+int rk_trace_get_frame(int stream_id, int64_t pts, char *value, int size);
+int rk_trace_reset();
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -1,13 +1,18 @@
 extern "C" {
 #include <getopt.h>
 #include "audio.h"
+#include "boot.h"
 #include "common.h"
 #include "isp.h"
+#include "lease.h"
 #include "log.h"
+#include "media_clock.h"
 #include "network.h"
 #include "osd.h"
+#include "packet_bus.h"
 #include "param.h"
 #include "server.h"
+#include "socket.h"
 #include "storage.h"
 #include "system.h"
 #include "video.h"
@@ -83,6 +88,59 @@ void rkipc_get_opt(int argc, char *argv[]) {
 	}
 }
 
+// boot graph nodes, each runs in its own thread once its dependencies are ready
+static int rkipc_boot_isp(void *arg) {
+	return rk_isp_init(rkipc_camera_id_, rkipc_iq_file_path_);
+}
+
+static int rkipc_boot_sys(void *arg) { return RK_MPI_SYS_Init(); }
+
+static int rkipc_boot_audio(void *arg) { return rkipc_audio_init(); }
+
+static int rkipc_boot_video(void *arg) { return rk_video_init(); }
+
+// the encoders are running once the main stream published its first packet
+static int rkipc_boot_video_ready(void *arg) {
+	return rk_packet_bus_get_published(0) > 0 ? 0 : -1;
+}
+
+static int rkipc_boot_server(void *arg) { return rkipc_server_init(); }
+
+static int rkipc_boot_server_ready(void *arg) { return rk_boot_probe_unix(CS_PATH); }
+
+static int rkipc_boot_storage(void *arg) { return rk_storage_init(); }
+
+static int rkipc_boot_network(void *arg) {
+	rk_network_init(NULL);
+	return 0;
+}
+
+static int rkipc_boot_system(void *arg) {
+	rk_system_init();
+	return 0;
+}
+
+static int rkipc_boot_yolo(void *arg) { return rkipc_yolo_init(); }
+
+static void rkipc_boot_graph_init() {
+	// isp and the mpi system do not depend on each other, audio only needs the mpi system.
+	// storage and network are independent of the video pipeline
+	rk_boot_add("isp", NULL, rkipc_boot_isp, NULL);
+	rk_boot_add("sys", NULL, rkipc_boot_sys, NULL);
+	if (rk_param_get_int("audio.0:enable", 0))
+		rk_boot_add("audio", "sys", rkipc_boot_audio, NULL);
+	rk_boot_add("video", "isp,sys", rkipc_boot_video, NULL);
+	rk_boot_add("server", "video", rkipc_boot_server, NULL);
+	rk_boot_add("storage", "sys", rkipc_boot_storage, NULL);
+	rk_boot_add("network", NULL, rkipc_boot_network, NULL);
+	rk_boot_add("system", NULL, rkipc_boot_system, NULL);
+	rk_boot_add("yolo", "video", rkipc_boot_yolo, NULL);
+
+	rk_boot_set_ready("video", rkipc_boot_video_ready, NULL,
+	                  rk_param_get_int("boot:video_ready_timeout_ms", 3000));
+	rk_boot_set_ready("server", rkipc_boot_server_ready, NULL,
+	                  rk_param_get_int("boot:server_ready_timeout_ms", 1000));
+}
 
 int main(int argc, char **argv) {
 	/* ADC keys removed; no key thread created. */
@@ -99,24 +157,11 @@ int main(int argc, char **argv) {
 	// init
 	rk_param_init(rkipc_ini_path_);
 	rkipc_camera_id_ = rk_param_get_int("video.source:camera_id", 0); // need rk_param_init
-	rk_isp_init(rkipc_camera_id_, rkipc_iq_file_path_);
-	RK_MPI_SYS_Init();
-	if (rk_param_get_int("audio.0:enable", 0))
-		rkipc_audio_init();
-	rk_video_init();
-	rkipc_server_init();
-	rk_storage_init();
-
-	rk_network_init(NULL);
-	rk_system_init();
-
-	char usb_config_cmd[128];
-	const char *output_data_type = rk_param_get_string("video.0:output_data_type", "H.264");
-	int width = rk_param_get_int("video.0:width", 1920);
-	int height = rk_param_get_int("video.0:height", 1080);
-	uint32_t flags = 0; // UVC_CONTROL_LOOP_ONCE;
-
-	rkipc_yolo_init();
+	rk_lease_init();
+	rk_media_clock_init();
+	rkipc_boot_graph_init();
+	if (rk_boot_run())
+		LOG_ERROR("some modules failed to init, see the boot table\n");
 
 	LOG_INFO("rkipc init over\n");
 
@@ -129,13 +174,16 @@ int main(int argc, char **argv) {
 	rk_system_deinit();
 	if (rk_param_get_int("audio.0:enable", 0))
 		rkipc_audio_deinit();
-	rk_video_deinit();
-	RK_MPI_SYS_Exit();
-	rk_isp_deinit(rkipc_camera_id_);
+	// the npu thread holds frames of a vi channel that rk_video_deinit disables
 	if (rk_param_get_int("video.source:enable_npu", 0)) {
 		rkipc_yolo_deinit();
 	}
-	
+	rk_video_deinit();
+	rk_lease_deinit();
+	rk_media_clock_deinit();
+	RK_MPI_SYS_Exit();
+	rk_isp_deinit(rkipc_camera_id_);
+
 	rk_network_deinit();
 	rk_param_deinit();
 	LOG_INFO("rkipc deinit over\n");
@@ -6,16 +6,31 @@ extern "C" {
 #include "video.h"
 #include "venc.h"
 #include "osd.h"
+#include "packet_bus.h"
+#include "sei.h"
+#include "boot.h"
+#include "det_ring.h"
+#include "media_clock.h"
+#include "hls.h"
+#include "frame_export.h"
+#include "lease_mpi.h"
+#include "mb_budget.h"
+#include "snapshot.h"
+#include "trace.h"
 }
 #include "draw/cv_draw.hpp"
 #include "engine/rknnPool.hpp"
+#include "engine/rknn_perf.hpp"
 #include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
 #include "rga/im2d.h"
 #include "rga/im2d_buffer.h"
 #include "rga/im2d_type.h"
 #include "rga/rga.h"
 #include "task/yolo26.h"
+#include "task/yolo26_ladder.h"
 
+#include <queue>
 #include <thread>
 
 #ifdef LOG_TAG
@@ -27,8 +42,6 @@ extern "C" {
 #define RKISP_SELFPATH 1
 #define RKISP_FBCPATH 2
 #define VIDEO_PIPE_0 0
-#define VIDEO_PIPE_1 1
-#define VIDEO_PIPE_2 2
 #define JPEG_VENC_CHN 3
 #define VPSS_ROTATE 6
 #define VPSS_GRP_ID VPSS_MAX_CHN_NUM
@@ -41,20 +54,59 @@ extern "C" {
 #define RTSP_URL_0 "/live/0"
 #define RTSP_URL_1 "/live/1"
 #define RTSP_URL_2 "/live/2"
-#define RTMP_URL_0 "rtmp://127.0.0.1:1935/live/mainstream"
-#define RTMP_URL_1 "rtmp://127.0.0.1:1935/live/substream"
-#define RTMP_URL_2 "rtmp://127.0.0.1:1935/live/thirdstream"
+#define RTMP_URL "rtmp://127.0.0.1:1935/live"
+#define RTMP_KEY_0 "mainstream"
+#define RTMP_KEY_1 "substream"
+#define RTMP_KEY_2 "thirdstream"
 
 int pipe_id_ = 0;
 int g_vi_chn_id = 0;
-int g_vi_for_venc_0_id = 3;
 int g_vi_for_npu_id = 4;
-int g_vi_for_venc_1_id = 2;
 int g_vi_for_vo_chn_id = 5;
 
-static int take_photo_one = 0;
-static RK_BOOL enable_jpeg, enable_venc_0, enable_venc_1, enable_npu, enable_wrap, enable_ivs,
-    enable_rtmp, enable_rtsp;
+// rtsp, rtmp and storage each have three fixed sessions
+#define RKIPC_MAX_VIDEO_STREAM 3
+#define RKIPC_STREAM_CONSUMER_NUM 5
+// low latency streams also publish every slice on their own bus stream for rtsp
+#define RKIPC_SLICE_STREAM_ID(id) ((id) + RKIPC_MAX_VIDEO_STREAM)
+// the auto framing stream, its venc channel is after the jpeg one
+#define RKIPC_AUTOFRAME_VENC_CHN 4
+#define RKIPC_AUTOFRAME_STREAM_ID (RKIPC_SLICE_STREAM_ID(RKIPC_MAX_VIDEO_STREAM))
+#define RKIPC_AUTOFRAME_RTSP_URL "/live/autoframe"
+
+// what the running channels were built with, diffed by rkipc_stream_reconfig
+typedef struct {
+	int width;
+	int height;
+	int src_frame_rate_num;
+	int src_frame_rate_den;
+	char output_data_type[16];
+	char h264_profile[16];
+	char smart[16];
+	char gop_mode[16];
+} rkipc_stream_param_s;
+
+// an encoded stream described by its [video.N] section, the VENC channel is always N
+// since the rk_video_set_* api, rtsp, rtmp and storage all address streams by it
+typedef struct {
+	int id;
+	RK_BOOL enable;
+	int vi_chn_id;
+	RK_BOOL share_vi; // the vi channel belongs to npu/ivs, only bound here
+	RK_BOOL low_latency; // slice output and shallow vi/venc queues
+	std::thread venc_thread;
+	int packet_bus_handle[RKIPC_STREAM_CONSUMER_NUM]; // rtsp, storage, rtmp, prerecord, hls
+	rkipc_stream_param_s param;
+} rkipc_video_stream_s;
+
+static const char *g_rtsp_url[RKIPC_MAX_VIDEO_STREAM] = {RTSP_URL_0, RTSP_URL_1, RTSP_URL_2};
+static const char *g_rtmp_key[RKIPC_MAX_VIDEO_STREAM] = {RTMP_KEY_0, RTMP_KEY_1, RTMP_KEY_2};
+static const int g_default_vi_chn_id[RKIPC_MAX_VIDEO_STREAM] = {3, 2, 4};
+static rkipc_video_stream_s g_video_stream[RKIPC_MAX_VIDEO_STREAM];
+// every vi/venc buffer count, planned against the cma budget by rk_video_init
+static rk_mb_budget_plan_s g_mb_plan;
+
+static RK_BOOL enable_jpeg, enable_npu, enable_wrap, enable_ivs, enable_rtmp, enable_rtsp;
 int g_enable_vo, g_vo_dev_id, g_vo_layer_id;
 
 static int g_video_run_ = 1;
@@ -66,33 +118,90 @@ static const char *tmp_smart;
 static const char *tmp_gop_mode;
 static const char *tmp_rc_quality;
 static const char *distortion_correction;
-static std::thread venc_thread_0, venc_thread_1, venc_thread_2, jpeg_venc_thread_id, yolo26_thread,
-    cycle_snapshot_thread_id, get_vi_thread_id, draw_nn_thread;
+static std::thread jpeg_venc_thread_id, yolo26_thread, cycle_snapshot_thread_id, get_vi_thread_id,
+    draw_nn_thread;
 
 static MPP_CHN_S vi_chn, vpss_in_chn, vi_for_vo_chn, vo_chn, vpss_out_chn[4], venc_chn, ivs_chn,
     gdc_chn;
 
+static int rkipc_stream_get_int(int id, const char *key, int value) {
+	char entry[128] = {'\0'};
+	snprintf(entry, 127, "video.%d:%s", id, key);
+	return rk_param_get_int(entry, value);
+}
+
+static const char *rkipc_stream_get_string(int id, const char *key, const char *value) {
+	char entry[128] = {'\0'};
+	snprintf(entry, 127, "video.%d:%s", id, key);
+	return rk_param_get_string(entry, value);
+}
+
+static void rkipc_stream_param_load(int id, rkipc_stream_param_s *param) {
+	memset(param, 0, sizeof(*param));
+	param->width = rkipc_stream_get_int(id, "width", 1920);
+	param->height = rkipc_stream_get_int(id, "height", 1080);
+	param->src_frame_rate_num = rkipc_stream_get_int(id, "src_frame_rate_num", -1);
+	param->src_frame_rate_den = rkipc_stream_get_int(id, "src_frame_rate_den", -1);
+	snprintf(param->output_data_type, sizeof(param->output_data_type), "%s",
+	         rkipc_stream_get_string(id, "output_data_type", "H.264"));
+	snprintf(param->h264_profile, sizeof(param->h264_profile), "%s",
+	         rkipc_stream_get_string(id, "h264_profile", "high"));
+	snprintf(param->smart, sizeof(param->smart), "%s",
+	         rkipc_stream_get_string(id, "smart", "close"));
+	snprintf(param->gop_mode, sizeof(param->gop_mode), "%s",
+	         rkipc_stream_get_string(id, "gop_mode", "normalP"));
+}
+
+static void rkipc_video_stream_load() {
+	char entry[128] = {'\0'};
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		rkipc_video_stream_s *stream = &g_video_stream[i];
+		stream->id = i;
+		snprintf(entry, 127, "video.source:enable_venc_%d", i);
+		stream->enable = (RK_BOOL)rk_param_get_int(entry, i < 2);
+		stream->vi_chn_id = rkipc_stream_get_int(i, "vi_chn_id", g_default_vi_chn_id[i]);
+		stream->share_vi = (RK_BOOL)(stream->vi_chn_id == g_vi_for_npu_id);
+		stream->low_latency = (RK_BOOL)rkipc_stream_get_int(
+		    i, "low_latency", rk_param_get_int("video.source:low_latency", 0));
+		for (int j = 0; j < RKIPC_STREAM_CONSUMER_NUM; j++)
+			stream->packet_bus_handle[j] = -1;
+		LOG_INFO("stream %d: enable %d, vi chn %d, share vi %d, low latency %d\n", i,
+		         stream->enable, stream->vi_chn_id, stream->share_vi, stream->low_latency);
+	}
+}
+
+// npu/ivs must create their vi channel when an encoder is bound to it
+static RK_BOOL rkipc_npu_vi_shared() {
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (g_video_stream[i].enable && g_video_stream[i].share_vi)
+			return RK_TRUE;
+	}
+	return RK_FALSE;
+}
+
 static void *test_get_vi(void *arg) {
 	printf("#Start %s thread, arg:%p\n", __func__, arg);
+	rkipc_video_stream_s *stream = (rkipc_video_stream_s *)arg;
 	VIDEO_FRAME_INFO_S stViFrame;
 	VI_CHN_STATUS_S stChnStatus;
 	int loopCount = 0;
 	int ret = 0;
-	int get_vi_chn_id = g_vi_for_venc_0_id;
+	int get_vi_chn_id = stream->vi_chn_id;
 	while (g_video_run_) {
 		// 5.get the frame
 		ret = RK_MPI_VI_GetChnFrame(pipe_id_, get_vi_chn_id, &stViFrame, 1000);
 		if (ret == RK_SUCCESS) {
+			RkLeaseGuard lease(
+			    rk_lease_vi_frame("test_get_vi", pipe_id_, get_vi_chn_id, &stViFrame, 0));
+			if (lease.get() < 0)
+				continue;
 			void *data = RK_MPI_MB_Handle2VirAddr(stViFrame.stVFrame.pMbBlk);
 			// LOG_ERROR("RK_MPI_VI_GetChnFrame ok:data %p loop:%d seq:%d pts:%" PRId64 " ms\n",
 			//(unsigned char*)data,
 			//           loopCount, stViFrame.stVFrame.u32TimeRef, stViFrame.stVFrame.u64PTS /
 			//           1000);
 			// 7.release the frame
-			ret = RK_MPI_VI_ReleaseChnFrame(pipe_id_, get_vi_chn_id, &stViFrame);
-			if (ret != RK_SUCCESS) {
-				LOG_ERROR("RK_MPI_VI_ReleaseChnFrame fail %x\n", ret);
-			}
+			lease.reset();
 			loopCount++;
 		} else {
 			LOG_ERROR("RK_MPI_VI_GetChnFrame timeout %x\n", ret);
@@ -102,218 +211,249 @@ static void *test_get_vi(void *arg) {
 	return 0;
 }
 
-static void *rkipc_get_venc_0(void *arg) {
+static int rkipc_venc_pack_is_key(const VENC_PACK_S *pack) {
+	return (pack->DataType.enH264EType == H264E_NALU_IDRSLICE) ||
+	       (pack->DataType.enH264EType == H264E_NALU_ISLICE) ||
+	       (pack->DataType.enH265EType == H265E_NALU_IDRSLICE) ||
+	       (pack->DataType.enH265EType == H265E_NALU_ISLICE);
+}
+
+static void *rkipc_get_venc(void *arg) {
 	printf("#Start %s thread, arg:%p\n", __func__, arg);
+	rkipc_video_stream_s *stream = (rkipc_video_stream_s *)arg;
 	VENC_STREAM_S stFrame;
-	VI_CHN_STATUS_S stChnStatus;
 	int loopCount = 0;
 	int ret = 0;
-	// FILE *fp = fopen("/data/venc.h265", "wb");
-	stFrame.pstPack = (VENC_PACK_S *)malloc(sizeof(VENC_PACK_S));
+	char thread_name[16];
+	snprintf(thread_name, sizeof(thread_name), "RkipcVenc%d", stream->id);
+	prctl(PR_SET_NAME, thread_name, 0, 0, 0);
+	// parameter sets, sei and slices can come back as separate packs of one stream
+	stFrame.pstPack = (VENC_PACK_S *)malloc(RK_PACKET_MAX_PACK * sizeof(VENC_PACK_S));
+	// room for the sei and the pack it splits
+	struct iovec iov[RK_PACKET_MAX_PACK + 2];
+	int hevc = !strcmp(stream->param.output_data_type, "H.265");
+	unsigned char *sei_nalu = NULL;
+	if (stream->id == rk_sei_get_stream())
+		sei_nalu = (unsigned char *)malloc(RK_SEI_MAX_NALU);
+	// slices of the current frame, storage and rtmp still want whole access units
+	unsigned char *frame_buf = NULL;
+	unsigned int frame_len = 0, frame_cap = 0;
+	int frame_key = 0, frame_pack_count = 0;
+	unsigned int frame_pack_len[RK_PACKET_MAX_PACK];
+	struct iovec frame_iov[RK_PACKET_MAX_PACK];
 
 	while (g_video_run_) {
 		// 5.get the frame
-		ret = RK_MPI_VENC_GetStream(VIDEO_PIPE_0, &stFrame, 2500);
+		stFrame.u32PackCount = RK_PACKET_MAX_PACK;
+		ret = RK_MPI_VENC_GetStream(stream->id, &stFrame, 2500);
 		if (ret == RK_SUCCESS) {
-			void *data = RK_MPI_MB_Handle2VirAddr(stFrame.pstPack->pMbBlk);
-			// fwrite(data, 1, stFrame.pstPack->u32Len, fp);
-			// fflush(fp);
+			// released when it goes out of scope, whichever way the loop leaves
+			RkLeaseGuard lease(rk_lease_venc_stream(thread_name, stream->id, &stFrame, 0));
+			// untracked, the stream went back to the encoder already
+			if (lease.get() < 0)
+				continue;
+			int pack_count = stFrame.u32PackCount ? stFrame.u32PackCount : 1;
+			if (pack_count > RK_PACKET_MAX_PACK) {
+				LOG_WARN("stream %d: %d packs, only %d handled\n", stream->id, pack_count,
+				         RK_PACKET_MAX_PACK);
+				pack_count = RK_PACKET_MAX_PACK;
+			}
+			int64_t pts = rk_media_clock_map(RK_MEDIA_CLOCK_VIDEO, stFrame.pstPack[0].u64PTS);
+			unsigned int len = 0;
+			int key_frame = 0, param_set = 0, frame_end = 0;
+			for (int i = 0; i < pack_count; i++) {
+				VENC_PACK_S *pack = &stFrame.pstPack[i];
+				iov[i].iov_base = RK_MPI_MB_Handle2VirAddr(pack->pMbBlk);
+				iov[i].iov_len = pack->u32Len;
+				len += pack->u32Len;
+				key_frame |= rkipc_venc_pack_is_key(pack);
+				param_set |= (pack->DataType.enH264EType == H264E_NALU_SPS) ||
+				             (pack->DataType.enH265EType == H265E_NALU_VPS);
+				frame_end |= pack->bFrameEnd;
+			}
+			// detections and utc time go in front of the first slice of the frame
+			if (sei_nalu && (!stream->low_latency || !frame_len)) {
+				int sei_len = rk_sei_build_frame(hevc, pts, sei_nalu, RK_SEI_MAX_NALU);
+				if (sei_len > 0) {
+					pack_count = rk_sei_insert_iov(iov, pack_count, RK_PACKET_MAX_PACK + 2,
+					                               sei_nalu, sei_len, hevc);
+					len += sei_len;
+				}
+			}
 			// LOG_INFO("Count:%d, Len:%d, PTS is %" PRId64", enH264EType is %d\n", loopCount,
 			// stFrame.pstPack->u32Len, stFrame.pstPack->u64PTS,
 			// stFrame.pstPack->DataType.enH264EType);
-
-			rkipc_rtsp_write_video_frame(0, (unsigned char *)data, stFrame.pstPack->u32Len,
-			                             stFrame.pstPack->u64PTS);
-			if ((stFrame.pstPack->DataType.enH264EType == H264E_NALU_IDRSLICE) ||
-			    (stFrame.pstPack->DataType.enH264EType == H264E_NALU_ISLICE) ||
-			    (stFrame.pstPack->DataType.enH265EType == H265E_NALU_IDRSLICE) ||
-			    (stFrame.pstPack->DataType.enH265EType == H265E_NALU_ISLICE)) {
-				rk_storage_write_video_frame(0, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                             stFrame.pstPack->u64PTS, 1);
-				rk_rtmp_write_video_frame(0, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                          stFrame.pstPack->u64PTS, 1);
+			// rtsp, storage and rtmp drain their own queues, never block the encoder here
+			if (!stream->low_latency) {
+				rk_trace_record(stream->id, RK_TRACE_VENC_FIRST, pts);
+				rk_trace_record(stream->id, RK_TRACE_VENC, pts);
+				rk_packet_bus_writev(stream->id, iov, pack_count, pts, key_frame);
 			} else {
-				rk_storage_write_video_frame(0, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                             stFrame.pstPack->u64PTS, 0);
-				rk_rtmp_write_video_frame(0, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                          stFrame.pstPack->u64PTS, 0);
+				int frame_start = !frame_len;
+				if (frame_start)
+					rk_trace_record(stream->id, RK_TRACE_VENC_FIRST, pts);
+				// only the first slice of a key frame is a safe place to start decoding
+				rk_packet_bus_writev_slice(RKIPC_SLICE_STREAM_ID(stream->id), iov, pack_count,
+				                           pts, frame_start && (key_frame || param_set),
+				                           frame_end);
+				// the slices of one frame come from several GetStream calls and their
+				// buffers go back to the encoder in between, so the frame needs a copy
+				if (frame_len + len > frame_cap) {
+					unsigned int cap = (frame_len + len) * 3 / 2;
+					unsigned char *buf = (unsigned char *)realloc(frame_buf, cap);
+					if (buf) {
+						frame_buf = buf;
+						frame_cap = cap;
+					}
+				}
+				if (frame_len + len <= frame_cap) {
+					for (int i = 0; i < pack_count; i++) {
+						memcpy(frame_buf + frame_len, iov[i].iov_base, iov[i].iov_len);
+						frame_len += iov[i].iov_len;
+						if (frame_pack_count < RK_PACKET_MAX_PACK)
+							frame_pack_len[frame_pack_count++] = iov[i].iov_len;
+						else
+							frame_pack_len[RK_PACKET_MAX_PACK - 1] += iov[i].iov_len;
+					}
+					frame_key |= key_frame;
+				} else {
+					LOG_ERROR("no memory for a %u bytes frame\n", frame_len + len);
+				}
+				if (frame_end && frame_len) {
+					rk_trace_record(stream->id, RK_TRACE_VENC, pts);
+					// realloc may move frame_buf, the slice boundaries are kept as lengths
+					unsigned int offset = 0;
+					for (int i = 0; i < frame_pack_count; i++) {
+						frame_iov[i].iov_base = frame_buf + offset;
+						frame_iov[i].iov_len = frame_pack_len[i];
+						offset += frame_pack_len[i];
+					}
+					rk_packet_bus_writev(stream->id, frame_iov, frame_pack_count, pts,
+					                     frame_key);
+					frame_len = 0;
+					frame_key = 0;
+					frame_pack_count = 0;
+				}
 			}
 			// 7.release the frame
-			ret = RK_MPI_VENC_ReleaseStream(VIDEO_PIPE_0, &stFrame);
-			if (ret != RK_SUCCESS) {
-				LOG_ERROR("RK_MPI_VENC_ReleaseStream fail %x\n", ret);
-			}
+			lease.reset();
 			loopCount++;
 		} else {
-			LOG_ERROR("RK_MPI_VENC_GetStream timeout %x\n", ret);
+			LOG_ERROR("RK_MPI_VENC_GetStream %d timeout %x\n", stream->id, ret);
 		}
 	}
 	if (stFrame.pstPack)
 		free(stFrame.pstPack);
-	// if (fp)
-	// fclose(fp);
+	free(frame_buf);
+	free(sei_nalu);
 
 	return 0;
 }
 
-static void *rkipc_get_venc_1(void *arg) {
-	printf("#Start %s thread, arg:%p\n", __func__, arg);
-	VENC_STREAM_S stFrame;
-	VI_CHN_STATUS_S stChnStatus;
-	int loopCount = 0;
-	int ret = 0;
-	stFrame.pstPack = (VENC_PACK_S *)malloc(sizeof(VENC_PACK_S));
+// snapshot requests, a new trigger during a burst extends it instead of queueing
+static pthread_mutex_t g_snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_snapshot_cond = PTHREAD_COND_INITIALIZER;
+static int g_snapshot_remain, g_snapshot_interval_ms, g_snapshot_persist;
+static char g_snapshot_reason[16];
 
-	while (g_video_run_) {
-		// 5.get the frame
-		ret = RK_MPI_VENC_GetStream(VIDEO_PIPE_1, &stFrame, 2500);
-		if (ret == RK_SUCCESS) {
-			void *data = RK_MPI_MB_Handle2VirAddr(stFrame.pstPack->pMbBlk);
-			// LOG_INFO("Count:%d, Len:%d, PTS is %" PRId64", enH264EType is %d\n", loopCount,
-			// stFrame.pstPack->u32Len, stFrame.pstPack->u64PTS,
-			// stFrame.pstPack->DataType.enH264EType);
-			rkipc_rtsp_write_video_frame(1, (unsigned char *)data, stFrame.pstPack->u32Len,
-			                             stFrame.pstPack->u64PTS);
-			if ((stFrame.pstPack->DataType.enH264EType == H264E_NALU_IDRSLICE) ||
-			    (stFrame.pstPack->DataType.enH264EType == H264E_NALU_ISLICE) ||
-			    (stFrame.pstPack->DataType.enH265EType == H265E_NALU_IDRSLICE) ||
-			    (stFrame.pstPack->DataType.enH265EType == H265E_NALU_ISLICE)) {
-				rk_storage_write_video_frame(1, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                             stFrame.pstPack->u64PTS, 1);
-				rk_rtmp_write_video_frame(1, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                          stFrame.pstPack->u64PTS, 1);
-			} else {
-				rk_storage_write_video_frame(1, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                             stFrame.pstPack->u64PTS, 0);
-				rk_rtmp_write_video_frame(1, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                          stFrame.pstPack->u64PTS, 0);
-			}
-			// 7.release the frame
-			ret = RK_MPI_VENC_ReleaseStream(VIDEO_PIPE_1, &stFrame);
-			if (ret != RK_SUCCESS)
-				LOG_ERROR("RK_MPI_VENC_ReleaseStream fail %x\n", ret);
-			loopCount++;
-		} else {
-			LOG_ERROR("RK_MPI_VENC_GetStream timeout %x\n", ret);
-		}
+static int rkipc_jpeg_get_one(VENC_STREAM_S *stFrame, const char *reason, int persist) {
+	int ret = RK_MPI_VENC_GetStream(JPEG_VENC_CHN, stFrame, 1000);
+	if (ret != RK_SUCCESS) {
+		LOG_ERROR("RK_MPI_VENC_GetStream timeout %x\n", ret);
+		return -1;
 	}
-	if (stFrame.pstPack)
-		free(stFrame.pstPack);
+	RkLeaseGuard lease(rk_lease_venc_stream("jpeg", JPEG_VENC_CHN, stFrame, 0));
+	if (lease.get() < 0)
+		return -1;
+	void *data = RK_MPI_MB_Handle2VirAddr(stFrame->pstPack->pMbBlk);
+	LOG_DEBUG("%s: Len:%d, PTS is %" PRId64 "\n", reason, stFrame->pstPack->u32Len,
+	          stFrame->pstPack->u64PTS);
+	// the ring keeps its own copy, the disk write happens on the snapshot writer thread
+	rk_snapshot_push(data, stFrame->pstPack->u32Len, stFrame->pstPack->u64PTS, reason, persist);
+	lease.reset();
 
 	return 0;
 }
 
-static void *rkipc_get_venc_2(void *arg) {
-	printf("#Start %s thread, arg:%p\n", __func__, arg);
-	VENC_STREAM_S stFrame;
-	VI_CHN_STATUS_S stChnStatus;
-	int loopCount = 0;
-	int ret = 0;
-	stFrame.pstPack = (VENC_PACK_S *)malloc(sizeof(VENC_PACK_S));
-
-	while (g_video_run_) {
-		// 5.get the frame
-		ret = RK_MPI_VENC_GetStream(VIDEO_PIPE_2, &stFrame, 2500);
-		if (ret == RK_SUCCESS) {
-			void *data = RK_MPI_MB_Handle2VirAddr(stFrame.pstPack->pMbBlk);
-			// LOG_INFO("Count:%d, Len:%d, PTS is %" PRId64", enH264EType is %d\n", loopCount,
-			// stFrame.pstPack->u32Len, stFrame.pstPack->u64PTS,
-			// stFrame.pstPack->DataType.enH264EType);
-			rkipc_rtsp_write_video_frame(2, (unsigned char *)data, stFrame.pstPack->u32Len,
-			                             stFrame.pstPack->u64PTS);
-			if ((stFrame.pstPack->DataType.enH264EType == H264E_NALU_IDRSLICE) ||
-			    (stFrame.pstPack->DataType.enH264EType == H264E_NALU_ISLICE) ||
-			    (stFrame.pstPack->DataType.enH265EType == H265E_NALU_IDRSLICE) ||
-			    (stFrame.pstPack->DataType.enH265EType == H265E_NALU_ISLICE)) {
-				rk_storage_write_video_frame(2, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                             stFrame.pstPack->u64PTS, 1);
-				rk_rtmp_write_video_frame(2, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                          stFrame.pstPack->u64PTS, 1);
-			} else {
-				rk_storage_write_video_frame(2, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                             stFrame.pstPack->u64PTS, 0);
-				rk_rtmp_write_video_frame(2, (unsigned char *)data, stFrame.pstPack->u32Len,
-				                          stFrame.pstPack->u64PTS, 0);
-			}
-			// 7.release the frame
-			ret = RK_MPI_VENC_ReleaseStream(VIDEO_PIPE_2, &stFrame);
-			if (ret != RK_SUCCESS)
-				LOG_ERROR("RK_MPI_VENC_ReleaseStream fail %x\n", ret);
-			loopCount++;
-		} else {
-			LOG_ERROR("RK_MPI_VENC_GetStream timeout %x\n", ret);
-		}
+static void rkipc_snapshot_wait_locked(int timeout_ms) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout_ms / 1000;
+	ts.tv_nsec += (timeout_ms % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
 	}
-	if (stFrame.pstPack)
-		free(stFrame.pstPack);
-
-	return 0;
+	pthread_cond_timedwait(&g_snapshot_cond, &g_snapshot_mutex, &ts);
 }
 
 static void *rkipc_get_jpeg(void *arg) {
 	printf("#Start %s thread, arg:%p\n", __func__, arg);
+	prctl(PR_SET_NAME, "RkipcGetJpeg", 0, 0, 0);
 	VENC_STREAM_S stFrame;
-	VI_CHN_STATUS_S stChnStatus;
-	int loopCount = 0;
-	int ret = 0;
-	char file_name[128] = {0};
-	const char *file_path = rk_param_get_string("storage:file_path", "/userdata");
+	char reason[16];
+	int persist, interval_ms;
 	stFrame.pstPack = (VENC_PACK_S *)malloc(sizeof(VENC_PACK_S));
 
+	// the frame requested by rkipc_pipe_jpeg_init, keep it in the ring only,
+	// otherwise the first trigger would return this stale picture
+	rkipc_jpeg_get_one(&stFrame, "init", 0);
+
+	pthread_mutex_lock(&g_snapshot_mutex);
 	while (g_video_run_) {
-		usleep(300 * 1000);
-		if (!take_photo_one)
+		if (!g_snapshot_remain) {
+			rkipc_snapshot_wait_locked(1000);
 			continue;
-		// 5.get the frame
-		ret = RK_MPI_VENC_GetStream(JPEG_VENC_CHN, &stFrame, 1000);
-		if (ret == RK_SUCCESS) {
-			void *data = RK_MPI_MB_Handle2VirAddr(stFrame.pstPack->pMbBlk);
-			LOG_INFO("Count:%d, Len:%d, PTS is %" PRId64 ", enH264EType is %d\n", loopCount,
-			         stFrame.pstPack->u32Len, stFrame.pstPack->u64PTS,
-			         stFrame.pstPack->DataType.enH264EType);
-			// uvc_read_camera_buffer(data, -1, stFrame.pstPack->u32Len, NULL, 0);
-			// save jpeg file
-			time_t t = time(NULL);
-			struct tm tm = *localtime(&t);
-			snprintf(file_name, 128, "%s/%d%02d%02d%02d%02d%02d.jpeg", file_path, tm.tm_year + 1900,
-			         tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
-			LOG_INFO("file_name is %s\n", file_name);
-			FILE *fp = fopen(file_name, "wb");
-			fwrite(data, 1, stFrame.pstPack->u32Len, fp);
-			fflush(fp);
-			fclose(fp);
-			take_photo_one = 0;
-			// 7.release the frame
-			ret = RK_MPI_VENC_ReleaseStream(JPEG_VENC_CHN, &stFrame);
-			if (ret != RK_SUCCESS) {
-				LOG_ERROR("RK_MPI_VENC_ReleaseStream fail %x\n", ret);
-			}
-			loopCount++;
-		} else {
-			LOG_ERROR("RK_MPI_VENC_GetStream timeout %x\n", ret);
 		}
-		// usleep(33 * 1000);
-	}
+		snprintf(reason, sizeof(reason), "%s", g_snapshot_reason);
+		persist = g_snapshot_persist;
+		interval_ms = g_snapshot_interval_ms;
+		pthread_mutex_unlock(&g_snapshot_mutex);
+
+		VENC_RECV_PIC_PARAM_S stRecvParam;
+		memset(&stRecvParam, 0, sizeof(VENC_RECV_PIC_PARAM_S));
+		stRecvParam.s32RecvPicNum = 1;
+		RK_MPI_VENC_StartRecvFrame(JPEG_VENC_CHN, &stRecvParam);
+		rkipc_jpeg_get_one(&stFrame, reason, persist);
+
+		pthread_mutex_lock(&g_snapshot_mutex);
+		if (g_snapshot_remain > 0)
+			g_snapshot_remain--;
+		if (!g_snapshot_remain)
+			g_snapshot_persist = 0;
+		else if (interval_ms > 0 && g_video_run_)
+			rkipc_snapshot_wait_locked(interval_ms);
+	}
+	g_snapshot_remain = 0;
+	pthread_mutex_unlock(&g_snapshot_mutex);
 	if (stFrame.pstPack)
 		free(stFrame.pstPack);
 
 	return 0;
 }
 
+// the sessions connect in the background and keep retrying, the local nginx may start later
 int rkipc_rtmp_init() {
 	int ret = 0;
-	ret |= rk_rtmp_init(0, RTMP_URL_0);
-	ret |= rk_rtmp_init(1, RTMP_URL_1);
-	ret |= rk_rtmp_init(2, RTMP_URL_2);
+	char entry[128] = {'\0'};
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (!g_video_stream[i].enable)
+			continue;
+		snprintf(entry, 127, "video.%d:rtmp_url", i);
+		const char *url = rk_param_get_string(entry, RTMP_URL);
+		snprintf(entry, 127, "video.%d:rtmp_key", i);
+		ret |= rk_rtmp_init(i, url, rk_param_get_string(entry, g_rtmp_key[i]));
+	}
 
 	return ret;
 }
 
 int rkipc_rtmp_deinit() {
 	int ret = 0;
-	ret |= rk_rtmp_deinit(0);
-	ret |= rk_rtmp_deinit(1);
-	ret |= rk_rtmp_deinit(2);
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (g_video_stream[i].enable)
+			ret |= rk_rtmp_deinit(i);
+	}
 
 	return ret;
 }
@@ -391,86 +531,95 @@ int rkipc_vi_dev_deinit() {
 	return 0;
 }
 
-int rkipc_vi_ext_init() {
+static int rkipc_stream_vi_init(rkipc_video_stream_s *stream) {
 	int ret = 0;
+	int id = stream->id;
 	VI_CHN_ATTR_S vi_chn_attr;
-	tmp_output_data_type = rk_param_get_string("video.0:output_data_type", NULL);
-	if (enable_venc_0) {
-		int video_width = rk_param_get_int("video.0:width", -1);
-		int video_height = rk_param_get_int("video.0:height", -1);
-		int video_max_width = rk_param_get_int("video.0:max_width", -1);
-		int video_max_height = rk_param_get_int("video.0:max_height", -1);
-		int buffer_line = rk_param_get_int("video.source:buffer_line", video_max_height / 4);
-		if (buffer_line < 128)
-			buffer_line = video_max_height;
-		memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
-		vi_chn_attr.stIspOpt.u32BufCount = rk_param_get_int("video.0:input_buffer_count", 3);
-		vi_chn_attr.stIspOpt.enMemoryType = VI_V4L2_MEMORY_TYPE_DMABUF;
-		vi_chn_attr.stIspOpt.stMaxSize.u32Width = rk_param_get_int("video.0:max_width", 2560);
-		vi_chn_attr.stIspOpt.stMaxSize.u32Height = rk_param_get_int("video.0:max_height", 1440);
-		vi_chn_attr.stSize.u32Width = rk_param_get_int("video.0:width", 2560);
-		vi_chn_attr.stSize.u32Height = rk_param_get_int("video.0:height", 1440);
-		if (!strcmp(tmp_output_data_type, "NV12"))
-			vi_chn_attr.u32Depth = 1;
-		vi_chn_attr.enPixelFormat = RK_FMT_YUV420SP;
-		if (rk_param_get_int("video.source:enable_compress", 0))
-			vi_chn_attr.enCompressMode = COMPRESS_RFBC_64x4;
-		else
-			vi_chn_attr.enCompressMode = COMPRESS_MODE_NONE;
-		ret = RK_MPI_VI_SetChnAttr(pipe_id_, g_vi_for_venc_0_id, &vi_chn_attr);
-		if (ret) {
-			LOG_ERROR("ERROR: create VI error! ret=%d\n", ret);
-			return ret;
-		}
+	const char *output_data_type = rkipc_stream_get_string(id, "output_data_type", "H.264");
+	int video_max_width = rkipc_stream_get_int(id, "max_width", 2560);
+	int video_max_height = rkipc_stream_get_int(id, "max_height", 1440);
+	// the main stream follows the global switch unless its section overrides it
+	int enable_compress = rkipc_stream_get_int(
+	    id, "enable_compress", id == 0 ? rk_param_get_int("video.source:enable_compress", 0) : 0);
+
+	memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
+	// a frame waiting in a deep queue is latency, low latency keeps the minimum
+	vi_chn_attr.stIspOpt.u32BufCount = g_mb_plan.stream[id].vi_buf_count;
+	vi_chn_attr.stIspOpt.enMemoryType = VI_V4L2_MEMORY_TYPE_DMABUF;
+	vi_chn_attr.stIspOpt.stMaxSize.u32Width = video_max_width;
+	vi_chn_attr.stIspOpt.stMaxSize.u32Height = video_max_height;
+	vi_chn_attr.stSize.u32Width = rkipc_stream_get_int(id, "width", 2560);
+	vi_chn_attr.stSize.u32Height = rkipc_stream_get_int(id, "height", 1440);
+	// auto framing reads the main stream frames next to the bound encoder
+	if (!strcmp(output_data_type, "NV12") || (id == 0 && g_mb_plan.autoframe))
+		vi_chn_attr.u32Depth = 1;
+	vi_chn_attr.enPixelFormat = RK_FMT_YUV420SP;
+	if (enable_compress)
+		vi_chn_attr.enCompressMode = COMPRESS_RFBC_64x4;
+	else
+		vi_chn_attr.enCompressMode = COMPRESS_MODE_NONE;
+	ret = RK_MPI_VI_SetChnAttr(pipe_id_, stream->vi_chn_id, &vi_chn_attr);
+	if (ret) {
+		LOG_ERROR("ERROR: create VI error! ret=%d\n", ret);
+		return ret;
+	}
 
+	// wrap only supports the main stream
+	if (enable_wrap && id == 0) {
 		VI_CHN_BUF_WRAP_S stViWrap;
 		memset(&stViWrap, 0, sizeof(VI_CHN_BUF_WRAP_S));
-		if (enable_wrap) {
-			if (buffer_line < 128 || buffer_line > video_max_height) {
-				LOG_ERROR("wrap mode buffer line must between [128, H], set as video_max_height\n");
-				buffer_line = video_max_height;
-			}
-			stViWrap.bEnable = enable_wrap;
-			stViWrap.u32BufLine = buffer_line;
-			stViWrap.u32WrapBufferSize = stViWrap.u32BufLine * video_max_width * 3 / 2;
-			LOG_INFO("set vi channel wrap line: %d, wrapBuffSize = %d\n", stViWrap.u32BufLine,
-			         stViWrap.u32WrapBufferSize);
-			RK_MPI_VI_SetChnWrapBufAttr(pipe_id_, g_vi_for_venc_0_id, &stViWrap);
+		int buffer_line = rk_param_get_int("video.source:buffer_line", video_max_height / 4);
+		if (buffer_line < 128 || buffer_line > video_max_height) {
+			LOG_ERROR("wrap mode buffer line must between [128, H], set as video_max_height\n");
+			buffer_line = video_max_height;
 		}
+		stViWrap.bEnable = enable_wrap;
+		stViWrap.u32BufLine = buffer_line;
+		stViWrap.u32WrapBufferSize = stViWrap.u32BufLine * video_max_width * 3 / 2;
+		LOG_INFO("set vi channel wrap line: %d, wrapBuffSize = %d\n", stViWrap.u32BufLine,
+		         stViWrap.u32WrapBufferSize);
+		RK_MPI_VI_SetChnWrapBufAttr(pipe_id_, stream->vi_chn_id, &stViWrap);
+	}
 
-		ret = RK_MPI_VI_EnableChn(pipe_id_, g_vi_for_venc_0_id);
-		if (ret) {
-			LOG_ERROR("ERROR: create VI error! ret=%d\n", ret);
-			return ret;
-		}
-		if (!strcmp(tmp_output_data_type, "NV12"))
-			get_vi_thread_id = std::thread(test_get_vi, nullptr);
+	ret = RK_MPI_VI_EnableChn(pipe_id_, stream->vi_chn_id);
+	if (ret) {
+		LOG_ERROR("ERROR: create VI error! ret=%d\n", ret);
+		return ret;
 	}
+	if (!strcmp(output_data_type, "NV12") && !get_vi_thread_id.joinable())
+		get_vi_thread_id = std::thread(test_get_vi, stream);
 
-	if (enable_venc_1) {
-		memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
-		vi_chn_attr.stIspOpt.u32BufCount = rk_param_get_int("video.1:input_buffer_count", 3);
-		vi_chn_attr.stIspOpt.enMemoryType = VI_V4L2_MEMORY_TYPE_DMABUF;
-		vi_chn_attr.stIspOpt.stMaxSize.u32Width = rk_param_get_int("video.1:max_width", 704);
-		vi_chn_attr.stIspOpt.stMaxSize.u32Height = rk_param_get_int("video.1:max_height", 576);
-		vi_chn_attr.stSize.u32Width = rk_param_get_int("video.1:width", 2560);
-		vi_chn_attr.stSize.u32Height = rk_param_get_int("video.1:height", 1440);
-		vi_chn_attr.u32Depth = 0;
-		vi_chn_attr.enPixelFormat = RK_FMT_YUV420SP;
-		vi_chn_attr.enCompressMode = COMPRESS_MODE_NONE;
-		ret = RK_MPI_VI_SetChnAttr(pipe_id_, g_vi_for_venc_1_id, &vi_chn_attr);
-		ret |= RK_MPI_VI_EnableChn(pipe_id_, g_vi_for_venc_1_id);
-		if (ret) {
-			LOG_ERROR("ERROR: create VI error! ret=%d\n", ret);
+	return 0;
+}
+
+static int rkipc_stream_vi_deinit(rkipc_video_stream_s *stream) {
+	int ret;
+	if (get_vi_thread_id.joinable())
+		get_vi_thread_id.join();
+	ret = RK_MPI_VI_DisableChn(pipe_id_, stream->vi_chn_id);
+	if (ret)
+		LOG_ERROR("ERROR: Destroy VI error! ret=%#x\n", ret);
+
+	return ret;
+}
+
+int rkipc_vi_ext_init() {
+	int ret = 0;
+	VI_CHN_ATTR_S vi_chn_attr;
+	tmp_output_data_type = rk_param_get_string("video.0:output_data_type", NULL);
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (!g_video_stream[i].enable || g_video_stream[i].share_vi)
+			continue;
+		ret = rkipc_stream_vi_init(&g_video_stream[i]);
+		if (ret)
 			return ret;
-		}
 	}
 
-	if (enable_npu || enable_ivs) {
+	RK_BOOL share_npu_vi = rkipc_npu_vi_shared();
+	if (enable_npu || enable_ivs || share_npu_vi) {
 		memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
-		vi_chn_attr.stIspOpt.u32BufCount = 2;
-		if (enable_npu) // ensure vi and ivs have two buffer ping-pong
-			vi_chn_attr.stIspOpt.u32BufCount += 1;
+		// vi and ivs ping-pong, plus one for npu and one for a bound encoder
+		vi_chn_attr.stIspOpt.u32BufCount = g_mb_plan.npu_vi_buf_count;
 		vi_chn_attr.stIspOpt.enMemoryType = VI_V4L2_MEMORY_TYPE_DMABUF;
 		vi_chn_attr.stIspOpt.stMaxSize.u32Width = rk_param_get_int("video.2:max_width", 960);
 		vi_chn_attr.stIspOpt.stMaxSize.u32Height = rk_param_get_int("video.2:max_height", 540);
@@ -495,7 +644,7 @@ int rkipc_vi_ext_init() {
 
 	if (g_enable_vo) {
 		memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
-		vi_chn_attr.stIspOpt.u32BufCount = 3;
+		vi_chn_attr.stIspOpt.u32BufCount = g_mb_plan.vo_vi_buf_count;
 		vi_chn_attr.stIspOpt.enMemoryType = VI_V4L2_MEMORY_TYPE_DMABUF;
 		vi_chn_attr.stSize.u32Width = 1920;
 		vi_chn_attr.stSize.u32Height = 1080;
@@ -514,17 +663,11 @@ int rkipc_vi_ext_init() {
 
 int rkipc_vi_ext_deinit() {
 	int ret = 0;
-	if (enable_venc_0) {
-		ret = RK_MPI_VI_DisableChn(pipe_id_, g_vi_for_venc_0_id);
-		if (ret)
-			LOG_ERROR("ERROR: Destroy VI error! ret=%#x\n", ret);
-	}
-	if (enable_venc_1) {
-		ret = RK_MPI_VI_DisableChn(pipe_id_, g_vi_for_venc_1_id);
-		if (ret)
-			LOG_ERROR("ERROR: Destroy VI error! ret=%#x\n", ret);
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (g_video_stream[i].enable && !g_video_stream[i].share_vi)
+			ret = rkipc_stream_vi_deinit(&g_video_stream[i]);
 	}
-	if (enable_npu || enable_ivs) {
+	if (enable_npu || enable_ivs || rkipc_npu_vi_shared()) {
 		ret = RK_MPI_VI_DisableChn(pipe_id_, g_vi_for_npu_id);
 		if (ret)
 			LOG_ERROR("ERROR: Destroy VI error! ret=%#x\n", ret);
@@ -539,160 +682,162 @@ int rkipc_vi_ext_deinit() {
 	return ret;
 }
 
-int rkipc_pipe_0_init() {
+static int rkipc_venc_h264_profile(const char *h264_profile) {
+	if (!strcmp(h264_profile, "high"))
+		return 100;
+	else if (!strcmp(h264_profile, "main"))
+		return 77;
+	else if (!strcmp(h264_profile, "baseline"))
+		return 66;
+	LOG_ERROR("tmp_h264_profile is %s\n", h264_profile);
+
+	return 0;
+}
+
+static void rkipc_venc_set_gop_attr(int id, const char *gop_mode, VENC_GOP_ATTR_S *gop_attr) {
+	if (!strcmp(gop_mode, "normalP")) {
+		gop_attr->enGopMode = VENC_GOPMODE_NORMALP;
+	} else if (!strcmp(gop_mode, "smartP")) {
+		gop_attr->enGopMode = VENC_GOPMODE_SMARTP;
+		gop_attr->s32VirIdrLen = rkipc_stream_get_int(id, "smartp_viridrlen", 25);
+		gop_attr->u32MaxLtrCount = 1; // long-term reference frame ltr is fixed to 1
+	} else if (!strcmp(gop_mode, "tsvc4")) {
+		gop_attr->enGopMode = VENC_GOPMODE_TSVC4;
+	}
+}
+
+static int rkipc_stream_venc_init(rkipc_video_stream_s *stream) {
 	int ret;
-	int video_width = rk_param_get_int("video.0:width", -1);
-	int video_height = rk_param_get_int("video.0:height", -1);
-	int video_max_width = rk_param_get_int("video.0:max_width", -1);
-	int video_max_height = rk_param_get_int("video.0:max_height", -1);
+	int id = stream->id;
+	char entry[128] = {'\0'};
+	int video_width = rkipc_stream_get_int(id, "width", 1920);
+	int video_height = rkipc_stream_get_int(id, "height", 1080);
+	int video_max_height = rkipc_stream_get_int(id, "max_height", 1440);
 	int rotation = rk_param_get_int("video.source:rotation", 0);
 
 	// VENC
 	VENC_CHN_ATTR_S venc_chn_attr;
 	memset(&venc_chn_attr, 0, sizeof(venc_chn_attr));
-	tmp_output_data_type = rk_param_get_string("video.0:output_data_type", NULL);
-	tmp_rc_mode = rk_param_get_string("video.0:rc_mode", NULL);
-	tmp_h264_profile = rk_param_get_string("video.0:h264_profile", NULL);
+	tmp_output_data_type = rkipc_stream_get_string(id, "output_data_type", NULL);
+	tmp_rc_mode = rkipc_stream_get_string(id, "rc_mode", NULL);
+	tmp_h264_profile = rkipc_stream_get_string(id, "h264_profile", "high");
 	if ((tmp_output_data_type == NULL) || (tmp_rc_mode == NULL)) {
 		LOG_ERROR("tmp_output_data_type or tmp_rc_mode is NULL\n");
 		return -1;
 	}
-	LOG_DEBUG("tmp_output_data_type is %s, tmp_rc_mode is %s, tmp_h264_profile is %s\n",
-	          tmp_output_data_type, tmp_rc_mode, tmp_h264_profile);
+	// raw frames are taken from vi by test_get_vi, no encoder
+	if (!strcmp(tmp_output_data_type, "NV12"))
+		return 0;
+	LOG_DEBUG("stream %d, tmp_output_data_type is %s, tmp_rc_mode is %s, tmp_h264_profile is %s\n",
+	          id, tmp_output_data_type, tmp_rc_mode, tmp_h264_profile);
 	if (!strcmp(tmp_output_data_type, "H.264")) {
 		venc_chn_attr.stVencAttr.enType = RK_VIDEO_ID_AVC;
-		if (!strcmp(tmp_h264_profile, "high"))
-			venc_chn_attr.stVencAttr.u32Profile = 100;
-		else if (!strcmp(tmp_h264_profile, "main"))
-			venc_chn_attr.stVencAttr.u32Profile = 77;
-		else if (!strcmp(tmp_h264_profile, "baseline"))
-			venc_chn_attr.stVencAttr.u32Profile = 66;
-		else
-			LOG_ERROR("tmp_h264_profile is %s\n", tmp_h264_profile);
+		venc_chn_attr.stVencAttr.u32Profile = rkipc_venc_h264_profile(tmp_h264_profile);
 		if (!strcmp(tmp_rc_mode, "CBR")) {
 			venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H264CBR;
-			venc_chn_attr.stRcAttr.stH264Cbr.u32Gop = rk_param_get_int("video.0:gop", -1);
-			venc_chn_attr.stRcAttr.stH264Cbr.u32BitRate = rk_param_get_int("video.0:max_rate", 0);
+			venc_chn_attr.stRcAttr.stH264Cbr.u32Gop = rkipc_stream_get_int(id, "gop", -1);
+			venc_chn_attr.stRcAttr.stH264Cbr.u32BitRate = rkipc_stream_get_int(id, "max_rate", 0);
 			venc_chn_attr.stRcAttr.stH264Cbr.fr32DstFrameRateDen =
-			    rk_param_get_int("video.0:dst_frame_rate_den", -1);
+			    rkipc_stream_get_int(id, "dst_frame_rate_den", -1);
 			venc_chn_attr.stRcAttr.stH264Cbr.fr32DstFrameRateNum =
-			    rk_param_get_int("video.0:dst_frame_rate_num", -1);
+			    rkipc_stream_get_int(id, "dst_frame_rate_num", -1);
 			venc_chn_attr.stRcAttr.stH264Cbr.u32SrcFrameRateDen =
-			    rk_param_get_int("video.0:src_frame_rate_den", -1);
+			    rkipc_stream_get_int(id, "src_frame_rate_den", -1);
 			venc_chn_attr.stRcAttr.stH264Cbr.u32SrcFrameRateNum =
-			    rk_param_get_int("video.0:src_frame_rate_num", -1);
+			    rkipc_stream_get_int(id, "src_frame_rate_num", -1);
 		} else {
 			venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H264VBR;
-			venc_chn_attr.stRcAttr.stH264Vbr.u32Gop = rk_param_get_int("video.0:gop", -1);
-			venc_chn_attr.stRcAttr.stH264Vbr.u32BitRate = rk_param_get_int("video.0:mid_rate", 0);
+			venc_chn_attr.stRcAttr.stH264Vbr.u32Gop = rkipc_stream_get_int(id, "gop", -1);
+			venc_chn_attr.stRcAttr.stH264Vbr.u32BitRate = rkipc_stream_get_int(id, "mid_rate", 0);
 			venc_chn_attr.stRcAttr.stH264Vbr.u32MaxBitRate =
-			    rk_param_get_int("video.0:max_rate", 0);
+			    rkipc_stream_get_int(id, "max_rate", 0);
 			venc_chn_attr.stRcAttr.stH264Vbr.u32MinBitRate =
-			    rk_param_get_int("video.0:min_rate", 0);
+			    rkipc_stream_get_int(id, "min_rate", 0);
 			venc_chn_attr.stRcAttr.stH264Vbr.fr32DstFrameRateDen =
-			    rk_param_get_int("video.0:dst_frame_rate_den", -1);
+			    rkipc_stream_get_int(id, "dst_frame_rate_den", -1);
 			venc_chn_attr.stRcAttr.stH264Vbr.fr32DstFrameRateNum =
-			    rk_param_get_int("video.0:dst_frame_rate_num", -1);
+			    rkipc_stream_get_int(id, "dst_frame_rate_num", -1);
 			venc_chn_attr.stRcAttr.stH264Vbr.u32SrcFrameRateDen =
-			    rk_param_get_int("video.0:src_frame_rate_den", -1);
+			    rkipc_stream_get_int(id, "src_frame_rate_den", -1);
 			venc_chn_attr.stRcAttr.stH264Vbr.u32SrcFrameRateNum =
-			    rk_param_get_int("video.0:src_frame_rate_num", -1);
+			    rkipc_stream_get_int(id, "src_frame_rate_num", -1);
 		}
 	} else if (!strcmp(tmp_output_data_type, "H.265")) {
 		venc_chn_attr.stVencAttr.enType = RK_VIDEO_ID_HEVC;
 		if (!strcmp(tmp_rc_mode, "CBR")) {
 			venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H265CBR;
-			venc_chn_attr.stRcAttr.stH265Cbr.u32Gop = rk_param_get_int("video.0:gop", -1);
-			venc_chn_attr.stRcAttr.stH265Cbr.u32BitRate = rk_param_get_int("video.0:max_rate", 0);
+			venc_chn_attr.stRcAttr.stH265Cbr.u32Gop = rkipc_stream_get_int(id, "gop", -1);
+			venc_chn_attr.stRcAttr.stH265Cbr.u32BitRate = rkipc_stream_get_int(id, "max_rate", 0);
 			venc_chn_attr.stRcAttr.stH265Cbr.fr32DstFrameRateDen =
-			    rk_param_get_int("video.0:dst_frame_rate_den", -1);
+			    rkipc_stream_get_int(id, "dst_frame_rate_den", -1);
 			venc_chn_attr.stRcAttr.stH265Cbr.fr32DstFrameRateNum =
-			    rk_param_get_int("video.0:dst_frame_rate_num", -1);
+			    rkipc_stream_get_int(id, "dst_frame_rate_num", -1);
 			venc_chn_attr.stRcAttr.stH265Cbr.u32SrcFrameRateDen =
-			    rk_param_get_int("video.0:src_frame_rate_den", -1);
+			    rkipc_stream_get_int(id, "src_frame_rate_den", -1);
 			venc_chn_attr.stRcAttr.stH265Cbr.u32SrcFrameRateNum =
-			    rk_param_get_int("video.0:src_frame_rate_num", -1);
+			    rkipc_stream_get_int(id, "src_frame_rate_num", -1);
 		} else {
 			venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H265VBR;
-			venc_chn_attr.stRcAttr.stH265Vbr.u32Gop = rk_param_get_int("video.0:gop", -1);
-			venc_chn_attr.stRcAttr.stH265Vbr.u32BitRate = rk_param_get_int("video.0:mid_rate", 0);
+			venc_chn_attr.stRcAttr.stH265Vbr.u32Gop = rkipc_stream_get_int(id, "gop", -1);
+			venc_chn_attr.stRcAttr.stH265Vbr.u32BitRate = rkipc_stream_get_int(id, "mid_rate", 0);
 			venc_chn_attr.stRcAttr.stH265Vbr.u32MaxBitRate =
-			    rk_param_get_int("video.0:max_rate", 0);
+			    rkipc_stream_get_int(id, "max_rate", 0);
 			venc_chn_attr.stRcAttr.stH265Vbr.u32MinBitRate =
-			    rk_param_get_int("video.0:min_rate", 0);
+			    rkipc_stream_get_int(id, "min_rate", 0);
 			venc_chn_attr.stRcAttr.stH265Vbr.fr32DstFrameRateDen =
-			    rk_param_get_int("video.0:dst_frame_rate_den", -1);
+			    rkipc_stream_get_int(id, "dst_frame_rate_den", -1);
 			venc_chn_attr.stRcAttr.stH265Vbr.fr32DstFrameRateNum =
-			    rk_param_get_int("video.0:dst_frame_rate_num", -1);
+			    rkipc_stream_get_int(id, "dst_frame_rate_num", -1);
 			venc_chn_attr.stRcAttr.stH265Vbr.u32SrcFrameRateDen =
-			    rk_param_get_int("video.0:src_frame_rate_den", -1);
+			    rkipc_stream_get_int(id, "src_frame_rate_den", -1);
 			venc_chn_attr.stRcAttr.stH265Vbr.u32SrcFrameRateNum =
-			    rk_param_get_int("video.0:src_frame_rate_num", -1);
+			    rkipc_stream_get_int(id, "src_frame_rate_num", -1);
 		}
 	} else {
 		LOG_ERROR("tmp_output_data_type is %s, not support\n", tmp_output_data_type);
 		return -1;
 	}
-	tmp_smart = rk_param_get_string("video.0:smart", NULL);
-	tmp_gop_mode = rk_param_get_string("video.0:gop_mode", NULL);
-	if (!strcmp(tmp_gop_mode, "normalP")) {
-		venc_chn_attr.stGopAttr.enGopMode = VENC_GOPMODE_NORMALP;
-	} else if (!strcmp(tmp_gop_mode, "smartP")) {
-		venc_chn_attr.stGopAttr.enGopMode = VENC_GOPMODE_SMARTP;
-		venc_chn_attr.stGopAttr.s32VirIdrLen = rk_param_get_int("video.0:smartp_viridrlen", 25);
-		venc_chn_attr.stGopAttr.u32MaxLtrCount = 1; // long-term reference frame ltr is fixed to 1
-	} else if (!strcmp(tmp_gop_mode, "tsvc4")) {
-		venc_chn_attr.stGopAttr.enGopMode = VENC_GOPMODE_TSVC4;
-	}
-	// venc_chn_attr.stGopAttr.u32GopSize = rk_param_get_int("video.0:gop", -1);
-	if (rk_param_get_int("video.source:0", 0) == 2)
+	tmp_smart = rkipc_stream_get_string(id, "smart", "close");
+	tmp_gop_mode = rkipc_stream_get_string(id, "gop_mode", "normalP");
+	rkipc_venc_set_gop_attr(id, tmp_gop_mode, &venc_chn_attr.stGopAttr);
+	snprintf(entry, 127, "video.source:%d", id);
+	if (rk_param_get_int(entry, 0) == 2)
 		venc_chn_attr.stVencAttr.enPixelFormat = RK_FMT_YUV422SP;
 	else
 		venc_chn_attr.stVencAttr.enPixelFormat = RK_FMT_YUV420SP;
-	venc_chn_attr.stVencAttr.u32MaxPicWidth = rk_param_get_int("video.0:max_width", 2560);
-	venc_chn_attr.stVencAttr.u32MaxPicHeight = rk_param_get_int("video.0:max_height", 1440);
+	venc_chn_attr.stVencAttr.u32MaxPicWidth = rkipc_stream_get_int(id, "max_width", 2560);
+	venc_chn_attr.stVencAttr.u32MaxPicHeight = video_max_height;
 	venc_chn_attr.stVencAttr.u32PicWidth = video_width;
 	venc_chn_attr.stVencAttr.u32PicHeight = video_height;
 	venc_chn_attr.stVencAttr.u32VirWidth = video_width;
 	venc_chn_attr.stVencAttr.u32VirHeight = video_height;
-	venc_chn_attr.stVencAttr.u32StreamBufCnt = rk_param_get_int("video.0:buffer_count", 4);
-	venc_chn_attr.stVencAttr.u32BufSize = rk_param_get_int("video.0:buffer_size", 1843200);
-	// venc_chn_attr.stVencAttr.u32Depth = 1;
-	ret = RK_MPI_VENC_CreateChn(VIDEO_PIPE_0, &venc_chn_attr);
+	venc_chn_attr.stVencAttr.u32StreamBufCnt = g_mb_plan.stream[id].venc_buf_count;
+	venc_chn_attr.stVencAttr.u32BufSize =
+	    rkipc_stream_get_int(id, "buffer_size", video_width * video_height / 2);
+	ret = RK_MPI_VENC_CreateChn(id, &venc_chn_attr);
 	if (ret) {
 		LOG_ERROR("ERROR: create VENC error! ret=%#x\n", ret);
 		return -1;
 	}
-	rk_video_reset_frame_rate(VIDEO_PIPE_0);
+	rk_video_reset_frame_rate(id);
 
 	if (!strcmp(tmp_smart, "open"))
-		RK_MPI_VENC_EnableSvc(VIDEO_PIPE_0, RK_TRUE);
+		RK_MPI_VENC_EnableSvc(id, RK_TRUE);
 
-	if (rk_param_get_int("video.0:enable_motion_deblur", 0)) {
-		ret = RK_MPI_VENC_EnableMotionDeblur(VIDEO_PIPE_0, RK_TRUE);
+	if (rkipc_stream_get_int(id, "enable_motion_deblur", 0)) {
+		ret = RK_MPI_VENC_EnableMotionDeblur(id, RK_TRUE);
 		if (ret)
 			LOG_ERROR("RK_MPI_VENC_EnableMotionDeblur error! ret=%#x\n", ret);
 	}
-	if (rk_param_get_int("video.0:enable_motion_static_switch", 0)) {
-		ret = RK_MPI_VENC_EnableMotionStaticSwitch(VIDEO_PIPE_0, RK_TRUE);
+	if (rkipc_stream_get_int(id, "enable_motion_static_switch", 0)) {
+		ret = RK_MPI_VENC_EnableMotionStaticSwitch(id, RK_TRUE);
 		if (ret)
 			LOG_ERROR("RK_MPI_VENC_EnableMotionStaticSwitch error! ret=%#x\n", ret);
 	}
 
-	// VENC_RC_PARAM_S h265_RcParam;
-	// RK_MPI_VENC_GetRcParam(VIDEO_PIPE_0, &h265_RcParam);
-	// h265_RcParam.s32FirstFrameStartQp = 26;
-	// h265_RcParam.stParamH265.u32StepQp = 8;
-	// h265_RcParam.stParamH265.u32MaxQp = 51;
-	// h265_RcParam.stParamH265.u32MinQp = 10;
-	// h265_RcParam.stParamH265.u32MaxIQp = 46;
-	// h265_RcParam.stParamH265.u32MinIQp = 24;
-	// h265_RcParam.stParamH265.s32DeltIpQp = -4;
-	// RK_MPI_VENC_SetRcParam(VIDEO_PIPE_0, &h265_RcParam);
-
-	tmp_rc_quality = rk_param_get_string("video.0:rc_quality", NULL);
+	tmp_rc_quality = rkipc_stream_get_string(id, "rc_quality", "highest");
 	VENC_RC_PARAM_S venc_rc_param;
-	RK_MPI_VENC_GetRcParam(VIDEO_PIPE_0, &venc_rc_param);
+	RK_MPI_VENC_GetRcParam(id, &venc_rc_param);
 	if (!strcmp(tmp_output_data_type, "H.264")) {
 		if (!strcmp(tmp_rc_quality, "highest")) {
 			venc_rc_param.stParamH264.u32MinQp = 10;
@@ -709,7 +854,7 @@ int rkipc_pipe_0_init() {
 		} else {
 			venc_rc_param.stParamH264.u32MinQp = 40;
 		}
-	} else if (!strcmp(tmp_output_data_type, "H.265")) {
+	} else {
 		if (!strcmp(tmp_rc_quality, "highest")) {
 			venc_rc_param.stParamH265.u32MinQp = 10;
 		} else if (!strcmp(tmp_rc_quality, "higher")) {
@@ -725,36 +870,34 @@ int rkipc_pipe_0_init() {
 		} else {
 			venc_rc_param.stParamH265.u32MinQp = 40;
 		}
-	} else {
-		LOG_ERROR("tmp_output_data_type is %s, not support\n", tmp_output_data_type);
-		return -1;
 	}
-	RK_MPI_VENC_SetRcParam(VIDEO_PIPE_0, &venc_rc_param);
+	RK_MPI_VENC_SetRcParam(id, &venc_rc_param);
 
-	VENC_CHN_BUF_WRAP_S stVencChnBufWrap;
-	memset(&stVencChnBufWrap, 0, sizeof(stVencChnBufWrap));
-	if (enable_wrap) {
+	// wrap only supports the main stream
+	if (enable_wrap && id == 0) {
+		VENC_CHN_BUF_WRAP_S stVencChnBufWrap;
+		memset(&stVencChnBufWrap, 0, sizeof(stVencChnBufWrap));
 		stVencChnBufWrap.bEnable = enable_wrap;
 		stVencChnBufWrap.u32BufLine =
 		    rk_param_get_int("video.source:buffer_line", video_max_height);
 		if (stVencChnBufWrap.u32BufLine < 128)
 			stVencChnBufWrap.u32BufLine = video_max_height;
-		RK_MPI_VENC_SetChnBufWrapAttr(VIDEO_PIPE_0, &stVencChnBufWrap);
+		RK_MPI_VENC_SetChnBufWrapAttr(id, &stVencChnBufWrap);
 	}
 
 	VENC_CHN_REF_BUF_SHARE_S stVencChnRefBufShare;
 	memset(&stVencChnRefBufShare, 0, sizeof(VENC_CHN_REF_BUF_SHARE_S));
 	stVencChnRefBufShare.bEnable =
-	    (RK_BOOL)rk_param_get_int("video.0:enable_refer_buffer_share", RK_FALSE);
-	RK_MPI_VENC_SetChnRefBufShareAttr(VIDEO_PIPE_0, &stVencChnRefBufShare);
+	    (RK_BOOL)rkipc_stream_get_int(id, "enable_refer_buffer_share", RK_FALSE);
+	RK_MPI_VENC_SetChnRefBufShareAttr(id, &stVencChnRefBufShare);
 	if (rotation == 0) {
-		RK_MPI_VENC_SetChnRotation(VIDEO_PIPE_0, ROTATION_0);
+		RK_MPI_VENC_SetChnRotation(id, ROTATION_0);
 	} else if (rotation == 90) {
-		RK_MPI_VENC_SetChnRotation(VIDEO_PIPE_0, ROTATION_90);
+		RK_MPI_VENC_SetChnRotation(id, ROTATION_90);
 	} else if (rotation == 180) {
-		RK_MPI_VENC_SetChnRotation(VIDEO_PIPE_0, ROTATION_180);
+		RK_MPI_VENC_SetChnRotation(id, ROTATION_180);
 	} else if (rotation == 270) {
-		RK_MPI_VENC_SetChnRotation(VIDEO_PIPE_0, ROTATION_270);
+		RK_MPI_VENC_SetChnRotation(id, ROTATION_270);
 	}
 
 	const char *gray_scale_mode = NULL;
@@ -766,54 +909,69 @@ int rkipc_pipe_0_init() {
 		video_full_range_flag = 1;
 	if (!strcmp(tmp_output_data_type, "H.264")) {
 		VENC_H264_VUI_S pstH264Vui;
-		RK_MPI_VENC_GetH264Vui(VIDEO_PIPE_0, &pstH264Vui);
+		RK_MPI_VENC_GetH264Vui(id, &pstH264Vui);
 		pstH264Vui.stVuiVideoSignal.video_full_range_flag = video_full_range_flag;
-		RK_MPI_VENC_SetH264Vui(VIDEO_PIPE_0, &pstH264Vui);
-	} else if (!strcmp(tmp_output_data_type, "H.265")) {
+		RK_MPI_VENC_SetH264Vui(id, &pstH264Vui);
+	} else {
 		VENC_H265_VUI_S pstH265Vui;
-		RK_MPI_VENC_GetH265Vui(VIDEO_PIPE_0, &pstH265Vui);
+		RK_MPI_VENC_GetH265Vui(id, &pstH265Vui);
 		pstH265Vui.stVuiVideoSignal.video_full_range_flag = video_full_range_flag;
-		RK_MPI_VENC_SetH265Vui(VIDEO_PIPE_0, &pstH265Vui);
+		RK_MPI_VENC_SetH265Vui(id, &pstH265Vui);
 	}
 
-	rkipc_set_advanced_venc_params(VIDEO_PIPE_0);
+	rkipc_set_advanced_venc_params(id);
+
+	// hand out each slice as soon as it is encoded instead of the whole frame
+	if (stream->low_latency) {
+		VENC_SLICE_SPLIT_S slice_split;
+		memset(&slice_split, 0, sizeof(slice_split));
+		slice_split.bSplitEnable = RK_TRUE;
+		slice_split.u32SplitMode = 1; // by macroblock/ctu lines
+		slice_split.u32SplitSize = rkipc_stream_get_int(id, "slice_split_lines", 8);
+		ret = RK_MPI_VENC_SetSliceSplit(id, &slice_split);
+		if (ret)
+			LOG_ERROR("RK_MPI_VENC_SetSliceSplit error! ret=%#x\n", ret);
+	}
 
 	VENC_RECV_PIC_PARAM_S stRecvParam;
 	memset(&stRecvParam, 0, sizeof(VENC_RECV_PIC_PARAM_S));
 	stRecvParam.s32RecvPicNum = -1;
-	RK_MPI_VENC_StartRecvFrame(VIDEO_PIPE_0, &stRecvParam);
-	if (strcmp(tmp_output_data_type, "NV12")) {
-		venc_thread_0 = std::thread(rkipc_get_venc_0, nullptr);
-		// bind
-		vi_chn.enModId = RK_ID_VI;
-		vi_chn.s32DevId = 0;
-		vi_chn.s32ChnId = g_vi_for_venc_0_id;
-		venc_chn.enModId = RK_ID_VENC;
-		venc_chn.s32DevId = 0;
-		venc_chn.s32ChnId = VIDEO_PIPE_0;
-		ret = RK_MPI_SYS_Bind(&vi_chn, &venc_chn);
-		if (ret)
-			LOG_ERROR("Bind VI and VENC error! ret=%#x\n", ret);
-	}
+	RK_MPI_VENC_StartRecvFrame(id, &stRecvParam);
+	rkipc_stream_param_load(id, &stream->param);
+	stream->venc_thread = std::thread(rkipc_get_venc, stream);
+
+	// bind
+	vi_chn.enModId = RK_ID_VI;
+	vi_chn.s32DevId = 0;
+	vi_chn.s32ChnId = stream->vi_chn_id;
+	venc_chn.enModId = RK_ID_VENC;
+	venc_chn.s32DevId = 0;
+	venc_chn.s32ChnId = id;
+	ret = RK_MPI_SYS_Bind(&vi_chn, &venc_chn);
+	if (ret)
+		LOG_ERROR("Bind VI and VENC error! ret=%#x\n", ret);
 
 	return 0;
 }
 
-int rkipc_pipe_0_deinit() {
+static int rkipc_stream_venc_deinit(rkipc_video_stream_s *stream) {
 	int ret;
+	if (!stream->venc_thread.joinable())
+		return 0; // NV12 output or create failed, no encoder
+	stream->venc_thread.join();
 	// unbind
 	vi_chn.enModId = RK_ID_VI;
 	vi_chn.s32DevId = 0;
-	vi_chn.s32ChnId = g_vi_for_venc_0_id;
+	vi_chn.s32ChnId = stream->vi_chn_id;
 	venc_chn.enModId = RK_ID_VENC;
 	venc_chn.s32DevId = 0;
-	venc_chn.s32ChnId = VIDEO_PIPE_0;
+	venc_chn.s32ChnId = stream->id;
 	ret = RK_MPI_SYS_UnBind(&vi_chn, &venc_chn);
 	if (ret)
 		LOG_ERROR("Unbind VI and VENC error! ret=%#x\n", ret);
 	// VENC
-	ret = RK_MPI_VENC_StopRecvFrame(VIDEO_PIPE_0);
-	ret |= RK_MPI_VENC_DestroyChn(VIDEO_PIPE_0);
+	ret = RK_MPI_VENC_StopRecvFrame(stream->id);
+	ret |= RK_MPI_VENC_DestroyChn(stream->id);
 	if (ret)
 		LOG_ERROR("ERROR: Destroy VENC error! ret=%#x\n", ret);
 	else
@@ -822,280 +980,805 @@ int rkipc_pipe_0_deinit() {
 	return 0;
 }
 
-int rkipc_pipe_1_init() {
+// scene activity driven rate control, stretches the gop and lowers the bitrate of the
+// encoders while nothing moves, the configured [video.N] values are never overwritten
+#define RKIPC_ADAPTIVE_RC_MAX_GOP 3000
+#define RKIPC_MOTION_WIDTH 64
+#define RKIPC_MOTION_HEIGHT 36
+
+typedef struct {
+	int enable;
+	int motion_threshold; // changed cells per mille of the frame
+	int pixel_threshold;  // luma difference of a changed cell
+	int static_ms;
+	int static_gop_scale;
+	int static_rate_percent;
+	int static_fps; // 0 keeps the configured frame rate
+	int restore_idr;
+	int is_static;
+	int motion;
+	int objects;
+	long long last_active_ms;
+	long long static_begin_ms;
+	long long static_total_ms;
+	unsigned int switch_count;
+} rkipc_adaptive_rc_s;
+
+static rkipc_adaptive_rc_s g_adaptive_rc;
+static pthread_mutex_t g_adaptive_rc_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void rkipc_adaptive_rc_init() {
+	pthread_mutex_lock(&g_adaptive_rc_mutex);
+	memset(&g_adaptive_rc, 0, sizeof(g_adaptive_rc));
+	g_adaptive_rc.enable = rk_param_get_int("video.source:adaptive_rc", 0);
+	g_adaptive_rc.motion_threshold =
+	    rk_param_get_int("video.source:adaptive_rc_motion_threshold", 5);
+	g_adaptive_rc.pixel_threshold =
+	    rk_param_get_int("video.source:adaptive_rc_pixel_threshold", 12);
+	g_adaptive_rc.static_ms = rk_param_get_int("video.source:adaptive_rc_static_ms", 10000);
+	g_adaptive_rc.static_gop_scale =
+	    rk_param_get_int("video.source:adaptive_rc_static_gop_scale", 4);
+	if (g_adaptive_rc.static_gop_scale < 1)
+		g_adaptive_rc.static_gop_scale = 1;
+	g_adaptive_rc.static_rate_percent =
+	    rk_param_get_int("video.source:adaptive_rc_static_rate_percent", 40);
+	if (g_adaptive_rc.static_rate_percent < 1 || g_adaptive_rc.static_rate_percent > 100)
+		g_adaptive_rc.static_rate_percent = 100;
+	g_adaptive_rc.static_fps = rk_param_get_int("video.source:adaptive_rc_static_fps", 0);
+	g_adaptive_rc.restore_idr = rk_param_get_int("video.source:adaptive_rc_restore_idr", 1);
+	// the encoders start with the configured values
+	g_adaptive_rc.last_active_ms = rkipc_get_curren_time_ms();
+	LOG_INFO("adaptive rc %d, motion %d/%d, static after %d ms, gop x%d, rate %d%%, fps %d\n",
+	         g_adaptive_rc.enable, g_adaptive_rc.motion_threshold, g_adaptive_rc.pixel_threshold,
+	         g_adaptive_rc.static_ms, g_adaptive_rc.static_gop_scale,
+	         g_adaptive_rc.static_rate_percent, g_adaptive_rc.static_fps);
+	pthread_mutex_unlock(&g_adaptive_rc_mutex);
+}
+
+static int rkipc_adaptive_rc_apply(int id, int is_static) {
 	int ret;
-	int video_width = rk_param_get_int("video.1:width", 1920);
-	int video_height = rk_param_get_int("video.1:height", 1080);
-	int rotation = rk_param_get_int("video.source:rotation", 0);
+	int gop = rkipc_stream_get_int(id, "gop", -1);
+	int max_rate = rkipc_stream_get_int(id, "max_rate", 0);
+	int mid_rate = rkipc_stream_get_int(id, "mid_rate", 0);
+	int min_rate = rkipc_stream_get_int(id, "min_rate", 0);
+	int fps_num = rkipc_stream_get_int(id, "dst_frame_rate_num", -1);
+	int fps_den = rkipc_stream_get_int(id, "dst_frame_rate_den", -1);
+	if (is_static) {
+		gop *= g_adaptive_rc.static_gop_scale;
+		if (gop > RKIPC_ADAPTIVE_RC_MAX_GOP)
+			gop = RKIPC_ADAPTIVE_RC_MAX_GOP;
+		max_rate = max_rate * g_adaptive_rc.static_rate_percent / 100;
+		mid_rate = mid_rate * g_adaptive_rc.static_rate_percent / 100;
+		min_rate = min_rate * g_adaptive_rc.static_rate_percent / 100;
+		if (g_adaptive_rc.static_fps > 0 && fps_den > 0 &&
+		    g_adaptive_rc.static_fps * fps_den < fps_num) {
+			fps_num = g_adaptive_rc.static_fps;
+			fps_den = 1;
+		}
+	}
 
-	// VENC
 	VENC_CHN_ATTR_S venc_chn_attr;
 	memset(&venc_chn_attr, 0, sizeof(venc_chn_attr));
-	tmp_output_data_type = rk_param_get_string("video.1:output_data_type", NULL);
-	tmp_rc_mode = rk_param_get_string("video.1:rc_mode", NULL);
-	tmp_h264_profile = rk_param_get_string("video.1:h264_profile", NULL);
-	if ((tmp_output_data_type == NULL) || (tmp_rc_mode == NULL)) {
-		LOG_ERROR("tmp_output_data_type or tmp_rc_mode is NULL\n");
-		return -1;
+	ret = RK_MPI_VENC_GetChnAttr(id, &venc_chn_attr);
+	if (ret) {
+		LOG_ERROR("RK_MPI_VENC_GetChnAttr %d error! ret=%#x\n", id, ret);
+		return ret;
 	}
-	LOG_DEBUG("tmp_output_data_type is %s, tmp_rc_mode is %s, tmp_h264_profile is %s\n",
-	          tmp_output_data_type, tmp_rc_mode, tmp_h264_profile);
-	if (!strcmp(tmp_output_data_type, "H.264")) {
-		venc_chn_attr.stVencAttr.enType = RK_VIDEO_ID_AVC;
-		if (!strcmp(tmp_h264_profile, "high"))
-			venc_chn_attr.stVencAttr.u32Profile = 100;
-		else if (!strcmp(tmp_h264_profile, "main"))
-			venc_chn_attr.stVencAttr.u32Profile = 77;
-		else if (!strcmp(tmp_h264_profile, "baseline"))
-			venc_chn_attr.stVencAttr.u32Profile = 66;
-		else
-			LOG_ERROR("tmp_h264_profile is %s\n", tmp_h264_profile);
-		if (!strcmp(tmp_rc_mode, "CBR")) {
-			venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H264CBR;
-			venc_chn_attr.stRcAttr.stH264Cbr.u32Gop = rk_param_get_int("video.1:gop", -1);
-			venc_chn_attr.stRcAttr.stH264Cbr.u32BitRate = rk_param_get_int("video.1:max_rate", 0);
-			venc_chn_attr.stRcAttr.stH264Cbr.fr32DstFrameRateDen =
-			    rk_param_get_int("video.1:dst_frame_rate_den", -1);
-			venc_chn_attr.stRcAttr.stH264Cbr.fr32DstFrameRateNum =
-			    rk_param_get_int("video.1:dst_frame_rate_num", -1);
-			venc_chn_attr.stRcAttr.stH264Cbr.u32SrcFrameRateDen =
-			    rk_param_get_int("video.1:src_frame_rate_den", -1);
-			venc_chn_attr.stRcAttr.stH264Cbr.u32SrcFrameRateNum =
-			    rk_param_get_int("video.1:src_frame_rate_num", -1);
-		} else {
-			venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H264VBR;
-			venc_chn_attr.stRcAttr.stH264Vbr.u32Gop = rk_param_get_int("video.1:gop", -1);
-			venc_chn_attr.stRcAttr.stH264Vbr.u32BitRate = rk_param_get_int("video.1:mid_rate", 0);
-			venc_chn_attr.stRcAttr.stH264Vbr.u32MaxBitRate =
-			    rk_param_get_int("video.1:max_rate", 0);
-			venc_chn_attr.stRcAttr.stH264Vbr.u32MinBitRate =
-			    rk_param_get_int("video.1:min_rate", 0);
-			venc_chn_attr.stRcAttr.stH264Vbr.fr32DstFrameRateDen =
-			    rk_param_get_int("video.1:dst_frame_rate_den", -1);
-			venc_chn_attr.stRcAttr.stH264Vbr.fr32DstFrameRateNum =
-			    rk_param_get_int("video.1:dst_frame_rate_num", -1);
-			venc_chn_attr.stRcAttr.stH264Vbr.u32SrcFrameRateDen =
-			    rk_param_get_int("video.1:src_frame_rate_den", -1);
-			venc_chn_attr.stRcAttr.stH264Vbr.u32SrcFrameRateNum =
-			    rk_param_get_int("video.1:src_frame_rate_num", -1);
-		}
-	} else if (!strcmp(tmp_output_data_type, "H.265")) {
-		venc_chn_attr.stVencAttr.enType = RK_VIDEO_ID_HEVC;
-		if (!strcmp(tmp_rc_mode, "CBR")) {
-			venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H265CBR;
-			venc_chn_attr.stRcAttr.stH265Cbr.u32Gop = rk_param_get_int("video.1:gop", -1);
-			venc_chn_attr.stRcAttr.stH265Cbr.u32BitRate = rk_param_get_int("video.1:max_rate", 0);
-			venc_chn_attr.stRcAttr.stH265Cbr.fr32DstFrameRateDen =
-			    rk_param_get_int("video.1:dst_frame_rate_den", -1);
-			venc_chn_attr.stRcAttr.stH265Cbr.fr32DstFrameRateNum =
-			    rk_param_get_int("video.1:dst_frame_rate_num", -1);
-			venc_chn_attr.stRcAttr.stH265Cbr.u32SrcFrameRateDen =
-			    rk_param_get_int("video.1:src_frame_rate_den", -1);
-			venc_chn_attr.stRcAttr.stH265Cbr.u32SrcFrameRateNum =
-			    rk_param_get_int("video.1:src_frame_rate_num", -1);
-		} else {
-			venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H265VBR;
-			venc_chn_attr.stRcAttr.stH265Vbr.u32Gop = rk_param_get_int("video.1:gop", -1);
-			venc_chn_attr.stRcAttr.stH265Vbr.u32BitRate = rk_param_get_int("video.1:mid_rate", 0);
-			venc_chn_attr.stRcAttr.stH265Vbr.u32MaxBitRate =
-			    rk_param_get_int("video.1:max_rate", 0);
-			venc_chn_attr.stRcAttr.stH265Vbr.u32MinBitRate =
-			    rk_param_get_int("video.1:min_rate", 0);
-			venc_chn_attr.stRcAttr.stH265Vbr.fr32DstFrameRateDen =
-			    rk_param_get_int("video.1:dst_frame_rate_den", -1);
-			venc_chn_attr.stRcAttr.stH265Vbr.fr32DstFrameRateNum =
-			    rk_param_get_int("video.1:dst_frame_rate_num", -1);
-			venc_chn_attr.stRcAttr.stH265Vbr.u32SrcFrameRateDen =
-			    rk_param_get_int("video.1:src_frame_rate_den", -1);
-			venc_chn_attr.stRcAttr.stH265Vbr.u32SrcFrameRateNum =
-			    rk_param_get_int("video.1:src_frame_rate_num", -1);
-		}
-	} else {
-		LOG_ERROR("tmp_output_data_type is %s, not support\n", tmp_output_data_type);
+	VENC_RC_ATTR_S *rc_attr = &venc_chn_attr.stRcAttr;
+	switch (rc_attr->enRcMode) {
+	case VENC_RC_MODE_H264CBR:
+		rc_attr->stH264Cbr.u32Gop = gop;
+		rc_attr->stH264Cbr.u32BitRate = max_rate;
+		rc_attr->stH264Cbr.fr32DstFrameRateNum = fps_num;
+		rc_attr->stH264Cbr.fr32DstFrameRateDen = fps_den;
+		break;
+	case VENC_RC_MODE_H264VBR:
+		rc_attr->stH264Vbr.u32Gop = gop;
+		rc_attr->stH264Vbr.u32BitRate = mid_rate;
+		rc_attr->stH264Vbr.u32MaxBitRate = max_rate;
+		rc_attr->stH264Vbr.u32MinBitRate = min_rate;
+		rc_attr->stH264Vbr.fr32DstFrameRateNum = fps_num;
+		rc_attr->stH264Vbr.fr32DstFrameRateDen = fps_den;
+		break;
+	case VENC_RC_MODE_H265CBR:
+		rc_attr->stH265Cbr.u32Gop = gop;
+		rc_attr->stH265Cbr.u32BitRate = max_rate;
+		rc_attr->stH265Cbr.fr32DstFrameRateNum = fps_num;
+		rc_attr->stH265Cbr.fr32DstFrameRateDen = fps_den;
+		break;
+	case VENC_RC_MODE_H265VBR:
+		rc_attr->stH265Vbr.u32Gop = gop;
+		rc_attr->stH265Vbr.u32BitRate = mid_rate;
+		rc_attr->stH265Vbr.u32MaxBitRate = max_rate;
+		rc_attr->stH265Vbr.u32MinBitRate = min_rate;
+		rc_attr->stH265Vbr.fr32DstFrameRateNum = fps_num;
+		rc_attr->stH265Vbr.fr32DstFrameRateDen = fps_den;
+		break;
+	default:
+		LOG_ERROR("rc mode %d not support\n", rc_attr->enRcMode);
 		return -1;
 	}
-	tmp_smart = rk_param_get_string("video.1:smart", NULL);
-	tmp_gop_mode = rk_param_get_string("video.1:gop_mode", NULL);
-	if (!strcmp(tmp_gop_mode, "normalP")) {
-		venc_chn_attr.stGopAttr.enGopMode = VENC_GOPMODE_NORMALP;
-	} else if (!strcmp(tmp_gop_mode, "smartP")) {
-		venc_chn_attr.stGopAttr.enGopMode = VENC_GOPMODE_SMARTP;
-		venc_chn_attr.stGopAttr.s32VirIdrLen = rk_param_get_int("video.1:smartp_viridrlen", 25);
-		venc_chn_attr.stGopAttr.u32MaxLtrCount = 1; // long-term reference frame ltr is fixed to 1
-	} else if (!strcmp(tmp_gop_mode, "tsvc4")) {
-		venc_chn_attr.stGopAttr.enGopMode = VENC_GOPMODE_TSVC4;
-	}
-	// venc_chn_attr.stGopAttr.u32GopSize = rk_param_get_int("video.1:gop", -1);
-
-	venc_chn_attr.stVencAttr.u32MaxPicWidth = rk_param_get_int("video.1:max_width", 704);
-	venc_chn_attr.stVencAttr.u32MaxPicHeight = rk_param_get_int("video.1:max_height", 576);
-	venc_chn_attr.stVencAttr.u32PicWidth = video_width;
-	venc_chn_attr.stVencAttr.u32PicHeight = video_height;
-	venc_chn_attr.stVencAttr.u32VirWidth = video_width;
-	venc_chn_attr.stVencAttr.u32VirHeight = video_height;
-	venc_chn_attr.stVencAttr.u32StreamBufCnt = rk_param_get_int("video.1:buffer_count", 4);
-	venc_chn_attr.stVencAttr.u32BufSize = rk_param_get_int("video.1:buffer_size", 202752);
-	// venc_chn_attr.stVencAttr.u32Depth = 1;
-	if (rk_param_get_int("video.source:1", 0) == 2)
-		venc_chn_attr.stVencAttr.enPixelFormat = RK_FMT_YUV422SP;
-	else
-		venc_chn_attr.stVencAttr.enPixelFormat = RK_FMT_YUV420SP;
-	ret = RK_MPI_VENC_CreateChn(VIDEO_PIPE_1, &venc_chn_attr);
+	ret = RK_MPI_VENC_SetChnAttr(id, &venc_chn_attr);
 	if (ret) {
-		LOG_ERROR("ERROR: create VENC error! ret=%#x\n", ret);
-		return -1;
+		LOG_ERROR("RK_MPI_VENC_SetChnAttr %d error! ret=%#x\n", id, ret);
+		return ret;
 	}
-	rk_video_reset_frame_rate(VIDEO_PIPE_1);
+	// the long gop of the static scene must not delay the first key frame of the activity
+	if (!is_static && g_adaptive_rc.restore_idr)
+		RK_MPI_VENC_RequestIDR(id, RK_TRUE);
 
-	if (!strcmp(tmp_smart, "open"))
-		RK_MPI_VENC_EnableSvc(VIDEO_PIPE_1, RK_TRUE);
+	return 0;
+}
 
-	tmp_rc_quality = rk_param_get_string("video.1:rc_quality", NULL);
-	VENC_RC_PARAM_S venc_rc_param;
-	RK_MPI_VENC_GetRcParam(VIDEO_PIPE_1, &venc_rc_param);
-	if (!strcmp(tmp_output_data_type, "H.264")) {
-		if (!strcmp(tmp_rc_quality, "highest")) {
-			venc_rc_param.stParamH264.u32MinQp = 10;
-		} else if (!strcmp(tmp_rc_quality, "higher")) {
-			venc_rc_param.stParamH264.u32MinQp = 15;
-		} else if (!strcmp(tmp_rc_quality, "high")) {
-			venc_rc_param.stParamH264.u32MinQp = 20;
-		} else if (!strcmp(tmp_rc_quality, "medium")) {
-			venc_rc_param.stParamH264.u32MinQp = 25;
-		} else if (!strcmp(tmp_rc_quality, "low")) {
-			venc_rc_param.stParamH264.u32MinQp = 30;
-		} else if (!strcmp(tmp_rc_quality, "lower")) {
-			venc_rc_param.stParamH264.u32MinQp = 35;
-		} else {
-			venc_rc_param.stParamH264.u32MinQp = 40;
-		}
-	} else if (!strcmp(tmp_output_data_type, "H.265")) {
-		if (!strcmp(tmp_rc_quality, "highest")) {
-			venc_rc_param.stParamH265.u32MinQp = 10;
-		} else if (!strcmp(tmp_rc_quality, "higher")) {
-			venc_rc_param.stParamH265.u32MinQp = 15;
-		} else if (!strcmp(tmp_rc_quality, "high")) {
-			venc_rc_param.stParamH265.u32MinQp = 20;
-		} else if (!strcmp(tmp_rc_quality, "medium")) {
-			venc_rc_param.stParamH265.u32MinQp = 25;
-		} else if (!strcmp(tmp_rc_quality, "low")) {
-			venc_rc_param.stParamH265.u32MinQp = 30;
-		} else if (!strcmp(tmp_rc_quality, "lower")) {
-			venc_rc_param.stParamH265.u32MinQp = 35;
-		} else {
-			venc_rc_param.stParamH265.u32MinQp = 40;
-		}
+static void rkipc_adaptive_rc_switch(int is_static, long long now) {
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (!g_video_stream[i].venc_thread.joinable() ||
+		    !rkipc_stream_get_int(i, "adaptive_rc", 1))
+			continue;
+		rkipc_adaptive_rc_apply(i, is_static);
+	}
+	if (is_static) {
+		g_adaptive_rc.static_begin_ms = now;
 	} else {
-		LOG_ERROR("tmp_output_data_type is %s, not support\n", tmp_output_data_type);
-		return -1;
+		g_adaptive_rc.static_total_ms += now - g_adaptive_rc.static_begin_ms;
+	}
+	g_adaptive_rc.is_static = is_static;
+	g_adaptive_rc.switch_count++;
+	LOG_INFO("scene %s, motion %d, objects %d\n", is_static ? "static" : "active",
+	         g_adaptive_rc.motion, g_adaptive_rc.objects);
+}
+
+// called for every npu frame, full quality is restored on the frame showing activity
+static void rkipc_adaptive_rc_report(int motion, int objects) {
+	if (!g_adaptive_rc.enable)
+		return;
+	long long now = rkipc_get_curren_time_ms();
+	pthread_mutex_lock(&g_adaptive_rc_mutex);
+	g_adaptive_rc.motion = motion;
+	g_adaptive_rc.objects = objects;
+	if (motion >= g_adaptive_rc.motion_threshold || objects > 0) {
+		g_adaptive_rc.last_active_ms = now;
+		if (g_adaptive_rc.is_static)
+			rkipc_adaptive_rc_switch(0, now);
+	} else if (!g_adaptive_rc.is_static &&
+	           now - g_adaptive_rc.last_active_ms >= g_adaptive_rc.static_ms) {
+		rkipc_adaptive_rc_switch(1, now);
+	}
+	pthread_mutex_unlock(&g_adaptive_rc_mutex);
+}
+
+// changed cells of a small luma copy, per mille of the frame
+static int rkipc_motion_score(const cv::Mat &rgb, cv::Mat &prev_gray) {
+	cv::Mat small, gray, diff;
+	cv::resize(rgb, small, cv::Size(RKIPC_MOTION_WIDTH, RKIPC_MOTION_HEIGHT), 0, 0,
+	           cv::INTER_AREA);
+	cv::cvtColor(small, gray, cv::COLOR_RGB2GRAY);
+	int score = 0;
+	if (!prev_gray.empty()) {
+		cv::absdiff(gray, prev_gray, diff);
+		score = cv::countNonZero(diff > g_adaptive_rc.pixel_threshold) * 1000 /
+		        (RKIPC_MOTION_WIDTH * RKIPC_MOTION_HEIGHT);
+	}
+	prev_gray = gray;
+
+	return score;
+}
+
+int rk_video_get_adaptive_rc_stats(char *value, int size) {
+	int len;
+	pthread_mutex_lock(&g_adaptive_rc_mutex);
+	long long now = rkipc_get_curren_time_ms();
+	long long static_total_ms = g_adaptive_rc.static_total_ms;
+	if (g_adaptive_rc.is_static)
+		static_total_ms += now - g_adaptive_rc.static_begin_ms;
+	len = snprintf(value, size,
+	               "{\"enable\":%d,\"state\":\"%s\",\"motion\":%d,\"objects\":%d,"
+	               "\"idle_ms\":%lld,\"switch_count\":%u,\"static_total_ms\":%lld}",
+	               g_adaptive_rc.enable, g_adaptive_rc.is_static ? "static" : "active",
+	               g_adaptive_rc.motion, g_adaptive_rc.objects,
+	               now - g_adaptive_rc.last_active_ms, g_adaptive_rc.switch_count,
+	               static_total_ms);
+	pthread_mutex_unlock(&g_adaptive_rc_mutex);
+
+	return len < size ? 0 : -1;
+}
+
+// hand a vi frame to the external subscribers of its channel, the lease goes with it when
+// one of them takes the frame. Only once the caller is done with the buffer itself
+static void rkipc_frame_export_offer(int chn, const VIDEO_FRAME_INFO_S *frame,
+                                     RkLeaseGuard &lease) {
+	if (!rk_frame_export_wanted(chn))
+		return;
+	rk_frame_export_frame_s info;
+	memset(&info, 0, sizeof(info));
+	info.width = frame->stVFrame.u32Width;
+	info.height = frame->stVFrame.u32Height;
+	info.hor_stride = frame->stVFrame.u32VirWidth ? frame->stVFrame.u32VirWidth : info.width;
+	info.ver_stride = frame->stVFrame.u32VirHeight ? frame->stVFrame.u32VirHeight : info.height;
+	info.fourcc = RK_FRAME_EXPORT_FOURCC_NV12;
+	info.size = RK_MPI_MB_GetSize(frame->stVFrame.pMbBlk);
+	info.pts = frame->stVFrame.u64PTS;
+	if (!rk_frame_export_publish(chn, RK_MPI_MB_Handle2Fd(frame->stVFrame.pMbBlk), &info,
+	                             lease.get()))
+		lease.release();
+}
+
+// auto framing, a digital ptz stream: the vi frames of video.0 are cropped around the
+// detected target by rga, scaled to the output size and encoded on a venc channel of its own
+typedef struct {
+	int enable;
+	int width;
+	int height;
+	int fps;
+	int class_id;          // -1 follows any class
+	int min_confidence;    // percent
+	int select_confidence; // the most confident target instead of the largest
+	int margin_percent;    // window size against the target box
+	int min_zoom_percent;
+	int max_zoom_percent;
+	int damping_percent;  // share of the remaining way moved each output frame
+	int deadband_percent; // target moves below this share of the window are ignored
+	int lost_ms;          // back to min_zoom after the target is gone that long
+	// the latest target of the npu thread, normalized to the frame
+	int has_target;
+	float target[4];
+	long long target_ms;
+} rkipc_autoframe_s;
+
+// crop window in source pixels, the height follows from the output aspect ratio
+typedef struct {
+	float cx, cy, w;
+	float goal_cx, goal_cy, goal_w;
+} rkipc_autoframe_window_s;
+
+static rkipc_autoframe_s g_autoframe;
+static pthread_mutex_t g_autoframe_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::thread autoframe_thread_id;
+static MB_POOL g_autoframe_pool = MB_INVALID_POOLID;
+
+// overlap of two normalized x, y, w, h boxes against the smaller one, in percent
+static int rkipc_autoframe_overlap(const float *a, const float *b) {
+	float w = fminf(a[0] + a[2], b[0] + b[2]) - fmaxf(a[0], b[0]);
+	float h = fminf(a[1] + a[3], b[1] + b[3]) - fmaxf(a[1], b[1]);
+	float area = fminf(a[2] * a[3], b[2] * b[3]);
+	if (w <= 0 || h <= 0 || area <= 0)
+		return 0;
+
+	return (int)(w * h * 100 / area);
+}
+
+// called with every npu result, picks the target the window follows
+static void rkipc_autoframe_update(const std::vector<Detection> &objects, int width,
+                                   int height) {
+	float best_box[4];
+	float best_score = 0;
+	if (width <= 0 || height <= 0)
+		return;
+
+	pthread_mutex_lock(&g_autoframe_mutex);
+	for (const Detection &det : objects) {
+		if ((g_autoframe.class_id >= 0 && det.class_id != g_autoframe.class_id) ||
+		    det.confidence * 100 < g_autoframe.min_confidence)
+			continue;
+		float box[4] = {(float)det.box.x / width, (float)det.box.y / height,
+		                (float)det.box.width / width, (float)det.box.height / height};
+		float score = g_autoframe.select_confidence ? det.confidence : box[2] * box[3];
+		// stay on the current target unless another one is clearly better, the window
+		// must not jump between two people of about the same size
+		if (g_autoframe.has_target && rkipc_autoframe_overlap(box, g_autoframe.target) > 50)
+			score *= 1.5f;
+		if (score > best_score) {
+			best_score = score;
+			memcpy(best_box, box, sizeof(best_box));
+		}
 	}
-	RK_MPI_VENC_SetRcParam(VIDEO_PIPE_1, &venc_rc_param);
+	if (best_score > 0) {
+		memcpy(g_autoframe.target, best_box, sizeof(best_box));
+		g_autoframe.has_target = 1;
+		g_autoframe.target_ms = rkipc_get_curren_time_ms();
+	}
+	pthread_mutex_unlock(&g_autoframe_mutex);
+}
+
+// moves the window one output frame towards the target
+static void rkipc_autoframe_step(rkipc_autoframe_window_s *win, int src_width, int src_height) {
+	float aspect = (float)g_autoframe.width / g_autoframe.height;
+	// the widest window of the output aspect ratio inside the frame
+	float full_w = src_width;
+	if (full_w / aspect > src_height)
+		full_w = src_height * aspect;
+	float max_w = full_w * 100 / g_autoframe.min_zoom_percent;
+	float min_w = full_w * 100 / g_autoframe.max_zoom_percent;
+	float cx = src_width / 2.0f, cy = src_height / 2.0f, w = max_w;
+
+	pthread_mutex_lock(&g_autoframe_mutex);
+	if (g_autoframe.has_target &&
+	    rkipc_get_curren_time_ms() - g_autoframe.target_ms < g_autoframe.lost_ms) {
+		const float *t = g_autoframe.target;
+		cx = (t[0] + t[2] / 2) * src_width;
+		cy = (t[1] + t[3] / 2) * src_height;
+		w = fmaxf(t[2] * src_width, t[3] * src_height * aspect) * g_autoframe.margin_percent /
+		    100;
+	}
+	pthread_mutex_unlock(&g_autoframe_mutex);
+	w = fminf(fmaxf(w, min_w), max_w);
+
+	if (win->w <= 0) {
+		win->cx = win->goal_cx = src_width / 2.0f;
+		win->cy = win->goal_cy = src_height / 2.0f;
+		win->w = win->goal_w = max_w;
+	}
+	// detection boxes jitter from frame to frame, only a real move changes the goal
+	float deadband = win->goal_w * g_autoframe.deadband_percent / 100;
+	if (fabsf(cx - win->goal_cx) > deadband || fabsf(cy - win->goal_cy) > deadband ||
+	    fabsf(w - win->goal_w) > deadband) {
+		win->goal_cx = cx;
+		win->goal_cy = cy;
+		win->goal_w = w;
+	}
+	float damping = g_autoframe.damping_percent / 100.0f;
+	win->cx += (win->goal_cx - win->cx) * damping;
+	win->cy += (win->goal_cy - win->cy) * damping;
+	win->w += (win->goal_w - win->w) * damping;
+	// keep the whole window inside the frame
+	float half_w = win->w / 2, half_h = win->w / aspect / 2;
+	win->cx = fminf(fmaxf(win->cx, half_w), src_width - half_w);
+	win->cy = fminf(fmaxf(win->cy, half_h), src_height - half_h);
+}
+
+static void *rkipc_autoframe_thread(void *arg) {
+	LOG_DEBUG("#Start %s thread, arg:%p\n", __func__, arg);
+	prctl(PR_SET_NAME, "RkipcAutoFrame", 0, 0, 0);
+	int ret;
+	int src_chn = g_video_stream[0].vi_chn_id;
+	int out_w = g_autoframe.width, out_h = g_autoframe.height;
+	int64_t interval_us = 1000000 / g_autoframe.fps, last_pts = 0;
+	unsigned int frame_size = out_w * out_h * 3 / 2;
+	rkipc_autoframe_window_s win;
+	VIDEO_FRAME_INFO_S stViFrame, stOutFrame;
+	VENC_STREAM_S stFrame;
+	struct iovec iov[RK_PACKET_MAX_PACK];
+	memset(&win, 0, sizeof(win));
+	stFrame.pstPack = (VENC_PACK_S *)malloc(RK_PACKET_MAX_PACK * sizeof(VENC_PACK_S));
 
-	VENC_CHN_REF_BUF_SHARE_S stVencChnRefBufShare;
-	memset(&stVencChnRefBufShare, 0, sizeof(VENC_CHN_REF_BUF_SHARE_S));
-	stVencChnRefBufShare.bEnable =
-	    (RK_BOOL)rk_param_get_int("video.1:enable_refer_buffer_share", RK_FALSE);
-	RK_MPI_VENC_SetChnRefBufShareAttr(VIDEO_PIPE_1, &stVencChnRefBufShare);
-	if (rotation == 0) {
-		RK_MPI_VENC_SetChnRotation(VIDEO_PIPE_1, ROTATION_0);
-	} else if (rotation == 90) {
-		RK_MPI_VENC_SetChnRotation(VIDEO_PIPE_1, ROTATION_90);
-	} else if (rotation == 180) {
-		RK_MPI_VENC_SetChnRotation(VIDEO_PIPE_1, ROTATION_180);
-	} else if (rotation == 270) {
-		RK_MPI_VENC_SetChnRotation(VIDEO_PIPE_1, ROTATION_270);
-	}
+	while (g_video_run_) {
+		ret = RK_MPI_VI_GetChnFrame(pipe_id_, src_chn, &stViFrame, 1000);
+		if (ret) {
+			LOG_ERROR("RK_MPI_VI_GetChnFrame %d timeout %x\n", src_chn, ret);
+			continue;
+		}
+		RkLeaseGuard lease(rk_lease_vi_frame("autoframe", pipe_id_, src_chn, &stViFrame,
+		                                     rk_frame_export_lease_timeout_ms(src_chn)));
+		if (lease.get() < 0)
+			continue;
+		int64_t pts = stViFrame.stVFrame.u64PTS;
+		if (pts - last_pts < interval_us) {
+			rkipc_frame_export_offer(src_chn, &stViFrame, lease);
+			continue;
+		}
+		last_pts = pts;
+
+		int width = stViFrame.stVFrame.u32Width;
+		int height = stViFrame.stVFrame.u32Height;
+		int wstride = stViFrame.stVFrame.u32VirWidth ? stViFrame.stVFrame.u32VirWidth : width;
+		int hstride = stViFrame.stVFrame.u32VirHeight ? stViFrame.stVFrame.u32VirHeight : height;
+		rkipc_autoframe_step(&win, width, height);
+		// rga wants even offsets and sizes for yuv420sp
+		int crop_w = (int)win.w & ~1;
+		int crop_h = (int)(win.w * out_h / out_w) & ~1;
+		im_rect src_rect = {(int)(win.cx - crop_w / 2) & ~1, (int)(win.cy - crop_h / 2) & ~1,
+		                    crop_w, crop_h};
+		im_rect dst_rect = {0, 0, out_w, out_h};
+
+		MB_BLK blk = RK_MPI_MB_GetMB(g_autoframe_pool, frame_size, RK_TRUE);
+		if (!blk) {
+			LOG_WARN("no free autoframe buffer, drop frame %" PRId64 "\n", pts);
+			continue;
+		}
+		rga_buffer_t src =
+		    wrapbuffer_fd(RK_MPI_MB_Handle2Fd(stViFrame.stVFrame.pMbBlk), width, height,
+		                  RK_FORMAT_YCbCr_420_SP, wstride, hstride);
+		rga_buffer_t dst = wrapbuffer_fd(RK_MPI_MB_Handle2Fd(blk), out_w, out_h,
+		                                 RK_FORMAT_YCbCr_420_SP, out_w, out_h);
+		ret = improcess(src, dst, {}, src_rect, dst_rect, {}, IM_SYNC);
+		// the crop is a copy, the vi frame can go back now
+		rkipc_frame_export_offer(src_chn, &stViFrame, lease);
+		lease.reset();
+		if (ret != IM_STATUS_SUCCESS) {
+			LOG_ERROR("improcess %dx%d+%d+%d fail %s\n", crop_w, crop_h, src_rect.x, src_rect.y,
+			          imStrError((IM_STATUS)ret));
+			RK_MPI_MB_ReleaseMB(blk);
+			continue;
+		}
 
-	const char *gray_scale_mode = NULL;
-	int video_full_range_flag = 0;
-	rk_isp_get_gray_scale_mode(0, &gray_scale_mode);
-	if (!strcmp(gray_scale_mode, "[16-235]"))
-		video_full_range_flag = 0;
-	else
-		video_full_range_flag = 1;
-	if (!strcmp(tmp_output_data_type, "H.264")) {
-		VENC_H264_VUI_S pstH264Vui;
-		RK_MPI_VENC_GetH264Vui(VIDEO_PIPE_1, &pstH264Vui);
-		pstH264Vui.stVuiVideoSignal.video_full_range_flag = video_full_range_flag;
-		RK_MPI_VENC_SetH264Vui(VIDEO_PIPE_1, &pstH264Vui);
-	} else if (!strcmp(tmp_output_data_type, "H.265")) {
-		VENC_H265_VUI_S pstH265Vui;
-		RK_MPI_VENC_GetH265Vui(VIDEO_PIPE_1, &pstH265Vui);
-		pstH265Vui.stVuiVideoSignal.video_full_range_flag = video_full_range_flag;
-		RK_MPI_VENC_SetH265Vui(VIDEO_PIPE_1, &pstH265Vui);
+		memset(&stOutFrame, 0, sizeof(stOutFrame));
+		stOutFrame.stVFrame.pMbBlk = blk;
+		stOutFrame.stVFrame.u32Width = out_w;
+		stOutFrame.stVFrame.u32Height = out_h;
+		stOutFrame.stVFrame.u32VirWidth = out_w;
+		stOutFrame.stVFrame.u32VirHeight = out_h;
+		stOutFrame.stVFrame.enPixelFormat = RK_FMT_YUV420SP;
+		stOutFrame.stVFrame.enCompressMode = COMPRESS_MODE_NONE;
+		stOutFrame.stVFrame.u64PTS = pts;
+		ret = RK_MPI_VENC_SendFrame(RKIPC_AUTOFRAME_VENC_CHN, &stOutFrame, 1000);
+		// venc holds its own reference until the frame is encoded
+		RK_MPI_MB_ReleaseMB(blk);
+		if (ret) {
+			LOG_ERROR("RK_MPI_VENC_SendFrame error! ret=%#x\n", ret);
+			continue;
+		}
+
+		stFrame.u32PackCount = RK_PACKET_MAX_PACK;
+		ret = RK_MPI_VENC_GetStream(RKIPC_AUTOFRAME_VENC_CHN, &stFrame, 1000);
+		if (ret) {
+			LOG_ERROR("RK_MPI_VENC_GetStream error! ret=%#x\n", ret);
+			continue;
+		}
+		RkLeaseGuard stream_lease(
+		    rk_lease_venc_stream("autoframe", RKIPC_AUTOFRAME_VENC_CHN, &stFrame, 0));
+		if (stream_lease.get() < 0)
+			continue;
+		int pack_count = stFrame.u32PackCount ? stFrame.u32PackCount : 1;
+		if (pack_count > RK_PACKET_MAX_PACK)
+			pack_count = RK_PACKET_MAX_PACK;
+		int key_frame = 0;
+		for (int i = 0; i < pack_count; i++) {
+			iov[i].iov_base = RK_MPI_MB_Handle2VirAddr(stFrame.pstPack[i].pMbBlk);
+			iov[i].iov_len = stFrame.pstPack[i].u32Len;
+			key_frame |= rkipc_venc_pack_is_key(&stFrame.pstPack[i]);
+		}
+		rk_packet_bus_writev(RKIPC_AUTOFRAME_STREAM_ID, iov, pack_count,
+		                     stFrame.pstPack[0].u64PTS, key_frame);
 	}
+	free(stFrame.pstPack);
+
+	return NULL;
+}
 
-	rkipc_set_advanced_venc_params(VIDEO_PIPE_1);
+static int rkipc_autoframe_init() {
+	int ret;
+	pthread_mutex_lock(&g_autoframe_mutex);
+	memset(&g_autoframe, 0, sizeof(g_autoframe));
+	g_autoframe.enable = g_mb_plan.autoframe;
+	g_autoframe.width =
+	    rk_param_get_int("video.autoframe:width", rkipc_stream_get_int(1, "width", 1920));
+	g_autoframe.height =
+	    rk_param_get_int("video.autoframe:height", rkipc_stream_get_int(1, "height", 1080));
+	g_autoframe.fps = rk_param_get_int("video.autoframe:fps", 15);
+	if (g_autoframe.fps < 1)
+		g_autoframe.fps = 15;
+	g_autoframe.class_id = rk_param_get_int("video.autoframe:class_id", 0);
+	g_autoframe.min_confidence = rk_param_get_int("video.autoframe:min_confidence", 40);
+	g_autoframe.select_confidence =
+	    !strcmp(rk_param_get_string("video.autoframe:select", "largest"), "confidence");
+	g_autoframe.margin_percent = rk_param_get_int("video.autoframe:margin_percent", 250);
+	g_autoframe.min_zoom_percent = rk_param_get_int("video.autoframe:min_zoom_percent", 100);
+	if (g_autoframe.min_zoom_percent < 100)
+		g_autoframe.min_zoom_percent = 100;
+	g_autoframe.max_zoom_percent = rk_param_get_int("video.autoframe:max_zoom_percent", 400);
+	if (g_autoframe.max_zoom_percent < g_autoframe.min_zoom_percent)
+		g_autoframe.max_zoom_percent = g_autoframe.min_zoom_percent;
+	g_autoframe.damping_percent = rk_param_get_int("video.autoframe:damping_percent", 10);
+	if (g_autoframe.damping_percent < 1 || g_autoframe.damping_percent > 100)
+		g_autoframe.damping_percent = 100;
+	g_autoframe.deadband_percent = rk_param_get_int("video.autoframe:deadband_percent", 5);
+	g_autoframe.lost_ms = rk_param_get_int("video.autoframe:lost_ms", 3000);
+	pthread_mutex_unlock(&g_autoframe_mutex);
+	if (!g_autoframe.enable)
+		return 0;
+	LOG_INFO("autoframe %dx%d@%d, class %d, zoom %d-%d%%, damping %d%%, deadband %d%%\n",
+	         g_autoframe.width, g_autoframe.height, g_autoframe.fps, g_autoframe.class_id,
+	         g_autoframe.min_zoom_percent, g_autoframe.max_zoom_percent,
+	         g_autoframe.damping_percent, g_autoframe.deadband_percent);
+
+	MB_POOL_CONFIG_S pool_cfg;
+	memset(&pool_cfg, 0, sizeof(pool_cfg));
+	pool_cfg.u64MBSize = g_autoframe.width * g_autoframe.height * 3 / 2;
+	pool_cfg.u32MBCnt = g_mb_plan.autoframe_pool_count;
+	pool_cfg.enRemapMode = MB_REMAP_MODE_CACHED;
+	pool_cfg.bPreAlloc = RK_TRUE;
+	g_autoframe_pool = RK_MPI_MB_CreatePool(&pool_cfg);
+	if (g_autoframe_pool == MB_INVALID_POOLID) {
+		LOG_ERROR("create autoframe pool failed\n");
+		return -1;
+	}
 
+	const char *output_data_type = rkipc_stream_get_string(1, "output_data_type", "H.264");
+	output_data_type = rk_param_get_string("video.autoframe:output_data_type", output_data_type);
+	int gop = rk_param_get_int("video.autoframe:gop", g_autoframe.fps * 2);
+	int bitrate = rk_param_get_int("video.autoframe:max_rate", 1024);
+	VENC_CHN_ATTR_S venc_chn_attr;
+	memset(&venc_chn_attr, 0, sizeof(venc_chn_attr));
+	if (!strcmp(output_data_type, "H.265")) {
+		venc_chn_attr.stVencAttr.enType = RK_VIDEO_ID_HEVC;
+		venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H265CBR;
+		venc_chn_attr.stRcAttr.stH265Cbr.u32Gop = gop;
+		venc_chn_attr.stRcAttr.stH265Cbr.u32BitRate = bitrate;
+		venc_chn_attr.stRcAttr.stH265Cbr.fr32DstFrameRateDen = 1;
+		venc_chn_attr.stRcAttr.stH265Cbr.fr32DstFrameRateNum = g_autoframe.fps;
+		venc_chn_attr.stRcAttr.stH265Cbr.u32SrcFrameRateDen = 1;
+		venc_chn_attr.stRcAttr.stH265Cbr.u32SrcFrameRateNum = g_autoframe.fps;
+	} else {
+		venc_chn_attr.stVencAttr.enType = RK_VIDEO_ID_AVC;
+		venc_chn_attr.stVencAttr.u32Profile = rkipc_venc_h264_profile(
+		    rk_param_get_string("video.autoframe:h264_profile", "high"));
+		venc_chn_attr.stRcAttr.enRcMode = VENC_RC_MODE_H264CBR;
+		venc_chn_attr.stRcAttr.stH264Cbr.u32Gop = gop;
+		venc_chn_attr.stRcAttr.stH264Cbr.u32BitRate = bitrate;
+		venc_chn_attr.stRcAttr.stH264Cbr.fr32DstFrameRateDen = 1;
+		venc_chn_attr.stRcAttr.stH264Cbr.fr32DstFrameRateNum = g_autoframe.fps;
+		venc_chn_attr.stRcAttr.stH264Cbr.u32SrcFrameRateDen = 1;
+		venc_chn_attr.stRcAttr.stH264Cbr.u32SrcFrameRateNum = g_autoframe.fps;
+	}
+	venc_chn_attr.stGopAttr.enGopMode = VENC_GOPMODE_NORMALP;
+	venc_chn_attr.stVencAttr.enPixelFormat = RK_FMT_YUV420SP;
+	venc_chn_attr.stVencAttr.u32MaxPicWidth = g_autoframe.width;
+	venc_chn_attr.stVencAttr.u32MaxPicHeight = g_autoframe.height;
+	venc_chn_attr.stVencAttr.u32PicWidth = g_autoframe.width;
+	venc_chn_attr.stVencAttr.u32PicHeight = g_autoframe.height;
+	venc_chn_attr.stVencAttr.u32VirWidth = g_autoframe.width;
+	venc_chn_attr.stVencAttr.u32VirHeight = g_autoframe.height;
+	venc_chn_attr.stVencAttr.u32StreamBufCnt = g_mb_plan.autoframe_venc_buf_count;
+	venc_chn_attr.stVencAttr.u32BufSize = g_autoframe.width * g_autoframe.height / 2;
+	ret = RK_MPI_VENC_CreateChn(RKIPC_AUTOFRAME_VENC_CHN, &venc_chn_attr);
+	if (ret) {
+		LOG_ERROR("ERROR: create VENC error! ret=%#x\n", ret);
+		RK_MPI_MB_DestroyPool(g_autoframe_pool);
+		g_autoframe_pool = MB_INVALID_POOLID;
+		return -1;
+	}
 	VENC_RECV_PIC_PARAM_S stRecvParam;
 	memset(&stRecvParam, 0, sizeof(VENC_RECV_PIC_PARAM_S));
 	stRecvParam.s32RecvPicNum = -1;
-	RK_MPI_VENC_StartRecvFrame(VIDEO_PIPE_1, &stRecvParam);
-	venc_thread_1 = std::thread(rkipc_get_venc_1, nullptr);
-
-	// pthread_create(&vi_thread_1, NULL, rkipc_get_vi_draw_send_venc, NULL);
-	// bind
-	vi_chn.enModId = RK_ID_VI;
-	vi_chn.s32DevId = 0;
-	vi_chn.s32ChnId = g_vi_for_venc_1_id;
-	venc_chn.enModId = RK_ID_VENC;
-	venc_chn.s32DevId = 0;
-	venc_chn.s32ChnId = VIDEO_PIPE_1;
-	ret = RK_MPI_SYS_Bind(&vi_chn, &venc_chn);
-	if (ret)
-		LOG_ERROR("Bind VI and VENC error! ret=%#x\n", ret);
+	RK_MPI_VENC_StartRecvFrame(RKIPC_AUTOFRAME_VENC_CHN, &stRecvParam);
+	if (enable_rtsp)
+		rkipc_rtsp_add_video_session(RKIPC_AUTOFRAME_STREAM_ID,
+		                             rk_param_get_string("video.autoframe:rtsp_url",
+		                                                 RKIPC_AUTOFRAME_RTSP_URL),
+		                             output_data_type);
+	autoframe_thread_id = std::thread(rkipc_autoframe_thread, nullptr);
 
 	return 0;
 }
 
-int rkipc_pipe_1_deinit() {
+static int rkipc_autoframe_deinit() {
 	int ret;
-	// unbind
-	vi_chn.enModId = RK_ID_VI;
-	vi_chn.s32DevId = 0;
-	vi_chn.s32ChnId = g_vi_for_venc_1_id;
-	venc_chn.enModId = RK_ID_VENC;
-	venc_chn.s32DevId = 0;
-	venc_chn.s32ChnId = VIDEO_PIPE_1;
-	ret = RK_MPI_SYS_UnBind(&vi_chn, &venc_chn);
-	if (ret)
-		LOG_ERROR("Unbind VI and VENC error! ret=%#x\n", ret);
-	// VENC
-	ret = RK_MPI_VENC_StopRecvFrame(VIDEO_PIPE_1);
-	ret |= RK_MPI_VENC_DestroyChn(VIDEO_PIPE_1);
+	if (!autoframe_thread_id.joinable())
+		return 0;
+	autoframe_thread_id.join();
+	ret = RK_MPI_VENC_StopRecvFrame(RKIPC_AUTOFRAME_VENC_CHN);
+	ret |= RK_MPI_VENC_DestroyChn(RKIPC_AUTOFRAME_VENC_CHN);
 	if (ret)
 		LOG_ERROR("ERROR: Destroy VENC error! ret=%#x\n", ret);
-	else
-		LOG_DEBUG("RK_MPI_VENC_DestroyChn success\n");
+	ret = RK_MPI_MB_DestroyPool(g_autoframe_pool);
+	if (ret)
+		LOG_ERROR("RK_MPI_MB_DestroyPool error! ret=%#x\n", ret);
+	g_autoframe_pool = MB_INVALID_POOLID;
 
 	return 0;
 }
 
+// scene cuts: lights switched on, the ir-cut toggling or a bumped camera move most of the
+// luma histogram between two frames, an idr right away keeps the encoders from smearing
+// the old picture over the p frames up to the next scheduled one
+#define RKIPC_SCENE_HIST_BINS 32
+#define RKIPC_SCENE_MAX_EVENT 16
+
+typedef struct {
+	long long utc_ms;
+	int64_t pts;
+	int delta;
+} rkipc_scene_event_s;
+
+typedef struct {
+	int enable;
+	int threshold;   // per mille of the pixels moving to another histogram bin
+	int cooldown_ms; // triggers closer than this only count as suppressed
+	int reset_rc;
+	int has_hist;
+	int hist[RKIPC_SCENE_HIST_BINS];
+	int delta;
+	long long last_trigger_ms;
+	unsigned int trigger_count;
+	unsigned int suppressed_count;
+	unsigned int event_count; // total, the ring keeps the last RKIPC_SCENE_MAX_EVENT
+	rkipc_scene_event_s event[RKIPC_SCENE_MAX_EVENT];
+} rkipc_scene_change_s;
+
+static rkipc_scene_change_s g_scene_change;
+static pthread_mutex_t g_scene_change_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void rkipc_scene_change_init() {
+	pthread_mutex_lock(&g_scene_change_mutex);
+	memset(&g_scene_change, 0, sizeof(g_scene_change));
+	g_scene_change.enable = rk_param_get_int("video.source:scene_change", 0);
+	g_scene_change.threshold = rk_param_get_int("video.source:scene_change_threshold", 300);
+	g_scene_change.cooldown_ms = rk_param_get_int("video.source:scene_change_cooldown_ms", 2000);
+	g_scene_change.reset_rc = rk_param_get_int("video.source:scene_change_reset_rc", 1);
+	LOG_INFO("scene change %d, threshold %d, cooldown %d ms, reset rc %d\n",
+	         g_scene_change.enable, g_scene_change.threshold, g_scene_change.cooldown_ms,
+	         g_scene_change.reset_rc);
+	pthread_mutex_unlock(&g_scene_change_mutex);
+}
+
+// setting the attributes again restarts the rate control from them, the qp and the
+// bit budget it learned on the old scene are dropped
+static int rkipc_venc_reset_rc(int chn) {
+	VENC_CHN_ATTR_S venc_chn_attr;
+	memset(&venc_chn_attr, 0, sizeof(venc_chn_attr));
+	// adaptive rc changes the same attributes
+	pthread_mutex_lock(&g_adaptive_rc_mutex);
+	int ret = RK_MPI_VENC_GetChnAttr(chn, &venc_chn_attr);
+	if (!ret)
+		ret = RK_MPI_VENC_SetChnAttr(chn, &venc_chn_attr);
+	pthread_mutex_unlock(&g_adaptive_rc_mutex);
+	if (ret)
+		LOG_ERROR("reset rc of venc %d error! ret=%#x\n", chn, ret);
+
+	return ret;
+}
+
+static void rkipc_scene_change_trigger(int64_t pts, int delta) {
+	char streams[32] = {'\0'};
+	int len = 0;
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (!g_video_stream[i].venc_thread.joinable())
+			continue;
+		if (g_scene_change.reset_rc)
+			rkipc_venc_reset_rc(i);
+		RK_MPI_VENC_RequestIDR(i, RK_TRUE);
+		len += snprintf(streams + len, sizeof(streams) - len, " %d", i);
+	}
+	if (autoframe_thread_id.joinable()) {
+		if (g_scene_change.reset_rc)
+			rkipc_venc_reset_rc(RKIPC_AUTOFRAME_VENC_CHN);
+		RK_MPI_VENC_RequestIDR(RKIPC_AUTOFRAME_VENC_CHN, RK_TRUE);
+		snprintf(streams + len, sizeof(streams) - len, " autoframe");
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	rkipc_scene_event_s *event =
+	    &g_scene_change.event[g_scene_change.event_count++ % RKIPC_SCENE_MAX_EVENT];
+	event->utc_ms = (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+	event->pts = pts;
+	event->delta = delta;
+	g_scene_change.trigger_count++;
+	LOG_INFO("scene change at pts %" PRId64 ", histogram delta %d, idr on%s\n", pts, delta,
+	         streams);
+}
+
+// luma histogram of a small copy against the previous frame, called for every npu frame
+static void rkipc_scene_change_report(const cv::Mat &rgb, int64_t pts) {
+	cv::Mat small, gray;
+	int hist[RKIPC_SCENE_HIST_BINS] = {0};
+	cv::resize(rgb, small, cv::Size(RKIPC_MOTION_WIDTH, RKIPC_MOTION_HEIGHT), 0, 0,
+	           cv::INTER_AREA);
+	cv::cvtColor(small, gray, cv::COLOR_RGB2GRAY);
+	for (int i = 0; i < gray.rows * gray.cols; i++)
+		hist[gray.data[i] * RKIPC_SCENE_HIST_BINS / 256]++;
+
+	pthread_mutex_lock(&g_scene_change_mutex);
+	int moved = 0;
+	for (int i = 0; i < RKIPC_SCENE_HIST_BINS; i++)
+		moved += abs(hist[i] - g_scene_change.hist[i]);
+	// every moved pixel leaves one bin and enters another
+	int delta = g_scene_change.has_hist ? moved * 1000 / (2 * gray.rows * gray.cols) : 0;
+	memcpy(g_scene_change.hist, hist, sizeof(hist));
+	g_scene_change.has_hist = 1;
+	g_scene_change.delta = delta;
+	if (delta >= g_scene_change.threshold) {
+		long long now = rkipc_get_curren_time_ms();
+		if (g_scene_change.trigger_count &&
+		    now - g_scene_change.last_trigger_ms < g_scene_change.cooldown_ms) {
+			g_scene_change.suppressed_count++;
+		} else {
+			g_scene_change.last_trigger_ms = now;
+			rkipc_scene_change_trigger(pts, delta);
+		}
+	}
+	pthread_mutex_unlock(&g_scene_change_mutex);
+}
+
+int rk_video_get_scene_change_events(char *value, int size) {
+	int len;
+	pthread_mutex_lock(&g_scene_change_mutex);
+	len = snprintf(value, size,
+	               "{\"enable\":%d,\"threshold\":%d,\"cooldown_ms\":%d,\"delta\":%d,"
+	               "\"trigger_count\":%u,\"suppressed_count\":%u,\"events\":[",
+	               g_scene_change.enable, g_scene_change.threshold, g_scene_change.cooldown_ms,
+	               g_scene_change.delta, g_scene_change.trigger_count,
+	               g_scene_change.suppressed_count);
+	// oldest first
+	unsigned int first = g_scene_change.event_count > RKIPC_SCENE_MAX_EVENT
+	                         ? g_scene_change.event_count - RKIPC_SCENE_MAX_EVENT
+	                         : 0;
+	for (unsigned int i = first; i < g_scene_change.event_count && len < size; i++) {
+		rkipc_scene_event_s *event = &g_scene_change.event[i % RKIPC_SCENE_MAX_EVENT];
+		len += snprintf(value + len, size - len,
+		                "%s{\"utc_ms\":%lld,\"pts\":%" PRId64 ",\"delta\":%d}",
+		                i > first ? "," : "", event->utc_ms, event->pts, event->delta);
+	}
+	if (len < size)
+		len += snprintf(value + len, size - len, "]}");
+	pthread_mutex_unlock(&g_scene_change_mutex);
+
+	return len < size ? 0 : -1;
+}
 
 static void *yolo26_inference(void *arg) {
 	LOG_DEBUG("#Start %s thread, arg:%p\n", __func__, arg);
-	int width = rk_param_get_int("video.0:width", -1);
-	int height = rk_param_get_int("video.0:height", -1);
 	prctl(PR_SET_NAME, "RkipcGetVi2", 0, 0, 0);
 	int ret;
 	int32_t loopCount = 0;
 	VIDEO_FRAME_INFO_S stViFrame;
 
+	// 逐层性能统计需要在模型加载前配置
+	RKNNPerfProfiler::Instance().Configure(
+	    rk_param_get_int("video.source:npu_profile", 0),
+	    rk_param_get_int("video.source:npu_profile_interval_ms", 5000),
+	    rk_param_get_int("video.source:npu_profile_top_n", 10),
+	    rk_param_get_string("video.source:npu_profile_path", "/tmp/npu_profile.json"));
+
+	// 同一模型的多个分辨率，逗号分隔，按分辨率从高到低排列
+	const char *npu_model = rk_param_get_string("video.source:npu_model", "./yolo26n.rknn");
+	int npu_levels = 1;
+	for (const char *p = npu_model; *p; p++) {
+		if (*p == ',')
+			npu_levels++;
+	}
+	Yolo26LadderConfig ladder_config;
+	ladder_config.latency_budget_ms = rk_param_get_int("video.source:npu_latency_budget_ms", 80);
+	ladder_config.temp_high = rk_param_get_int("video.source:npu_temp_high", 85);
+	ladder_config.temp_low = rk_param_get_int("video.source:npu_temp_low", 75);
+	ladder_config.hold_ms = rk_param_get_int("video.source:npu_ladder_hold_ms", 2000);
+	ladder_config.idle_ms = rk_param_get_int("video.source:npu_idle_ms", 5000);
+	ladder_config.thermal_path = rk_param_get_string("video.source:npu_thermal_path",
+	                                                 "/sys/class/thermal/thermal_zone0/temp");
+	Yolo26LadderPolicy::Instance().Configure(npu_levels, ladder_config);
+
 	// 初始化
-	rknnPool<Yolo26, cv::Mat, std::vector<Detection>> yolo26("./yolo26n.rknn", 4);
+	rknnPool<Yolo26Ladder, Yolo26Frame, std::vector<Detection>> yolo26(npu_model, 4);
 	yolo26.init();
+	// 推理池按提交顺序返回结果，按同样顺序记录每帧的pts
+	std::queue<int64_t> npu_pts;
 
 	std::vector<Detection> objects;
+	// 检测到目标时连拍，冷却时间内不重复触发
+	int detect_snapshot = rk_param_get_int("video.jpeg:enable_detect_snapshot", 0);
+	int burst_num = rk_param_get_int("video.jpeg:event_burst_num", 3);
+	int burst_interval_ms = rk_param_get_int("video.jpeg:event_burst_interval_ms", 200);
+	int snapshot_cooldown_ms = rk_param_get_int("video.jpeg:event_cooldown_ms", 5000);
+	int snapshot_persist = rk_param_get_int("video.jpeg:event_persist", 1);
+	long long last_snapshot_ms = 0;
+	// 检测到目标时触发事件录像，录像期间的触发只延长录像时间
+	int detect_record = rk_param_get_int("storage.event:enable_detect_trigger", 0);
+	// 码率自适应用的运动检测，与上一帧的缩小灰度图比较
+	cv::Mat motion_gray;
 
 	while (g_video_run_) {
 		ret = RK_MPI_VI_GetChnFrame(pipe_id_, g_vi_for_npu_id, &stViFrame, 1000);
 		if (ret == RK_SUCCESS) {
-
+			int lease_ms = rk_frame_export_lease_timeout_ms(g_vi_for_npu_id);
+			RkLeaseGuard lease(
+			    rk_lease_vi_frame("npu", pipe_id_, g_vi_for_npu_id, &stViFrame, lease_ms));
+			// 无法跟踪时帧已归还VI，直接丢弃
+			if (lease.get() < 0)
+				continue;
+			int64_t pts = stViFrame.stVFrame.u64PTS;
+			rk_trace_record(RK_TRACE_STREAM_NPU, RK_TRACE_VI, pts);
+
+			// npu通道的尺寸来自video.2，以帧自身的宽高和跨距为准
+			int width = stViFrame.stVFrame.u32Width;
+			int height = stViFrame.stVFrame.u32Height;
+			int wstride = stViFrame.stVFrame.u32VirWidth ? stViFrame.stVFrame.u32VirWidth : width;
+			int hstride =
+			    stViFrame.stVFrame.u32VirHeight ? stViFrame.stVFrame.u32VirHeight : height;
 			int32_t fd = RK_MPI_MB_Handle2Fd(stViFrame.stVFrame.pMbBlk);
 			cv::Mat src_img = cv::Mat::zeros(height, width, CV_8UC3);
 
 			rga_buffer_t yuv_buffer =
-			    wrapbuffer_fd(fd, width, height, RK_FORMAT_YCbCr_420_SP, width, height);
+			    wrapbuffer_fd(fd, width, height, RK_FORMAT_YCbCr_420_SP, wstride, hstride);
 			rga_buffer_t rgb_buffer = wrapbuffer_virtualaddr((void *)src_img.data, width, height,
 			                                                 RK_FORMAT_RGB_888, width, height);
 
@@ -1110,22 +1793,80 @@ static void *yolo26_inference(void *arg) {
 			// 	LOG_ERROR("%d imcheck fail %s \n", ret, imStrError((IM_STATUS)ret));
 			// }
 			imcopy(yuv_buffer, rgb_buffer);
+			rk_trace_record(RK_TRACE_STREAM_NPU, RK_TRACE_RGA, pts);
+			// 后面只用拷贝出来的RGB图，尽早归还VI帧，有外部订阅者时交给导出服务
+			rkipc_frame_export_offer(g_vi_for_npu_id, &stViFrame, lease);
+			lease.reset();
+			// 场景切换检测用未画框的原图
+			if (g_scene_change.enable)
+				rkipc_scene_change_report(src_img, pts);
 			if (loopCount % 4 == 0) {
 				// yolo.Run(src_img, objects);
-				yolo26.put(src_img);
+				Yolo26Frame frame;
+				frame.img = src_img;
+				frame.pts = pts;
+				yolo26.put(frame);
+				npu_pts.push(pts);
 			}
 
 			// getresult
-			if (yolo26.get(objects) != 0) {
+			int get_ret = yolo26.get(objects);
+			if (get_ret == 0 && !npu_pts.empty()) {
+				rk_trace_record(RK_TRACE_STREAM_NPU, RK_TRACE_NPU_PUBLISH, npu_pts.front());
+				// 检测结果分配跟踪号后写入SEI和共享内存检测环，pts为被检测的帧
+				rk_sei_object_s sei_objects[RK_SEI_MAX_OBJECT];
+				int sei_count = 0;
+				for (const Detection &det : objects) {
+					if (sei_count >= RK_SEI_MAX_OBJECT)
+						break;
+					rk_sei_object_s *object = &sei_objects[sei_count++];
+					object->track_id = 0;
+					object->class_id = det.class_id;
+					object->confidence = det.confidence;
+					object->x = det.box.x;
+					object->y = det.box.y;
+					object->w = det.box.width;
+					object->h = det.box.height;
+				}
+				rk_sei_set_objects(npu_pts.front(), width, height, sei_objects, sei_count);
+				rk_det_ring_object_s ring_objects[RK_DET_RING_MAX_OBJECT];
+				int ring_count =
+				    sei_count < RK_DET_RING_MAX_OBJECT ? sei_count : RK_DET_RING_MAX_OBJECT;
+				for (int i = 0; i < ring_count; i++) {
+					ring_objects[i].track_id = sei_objects[i].track_id;
+					ring_objects[i].class_id = sei_objects[i].class_id;
+					ring_objects[i].confidence = sei_objects[i].confidence;
+					ring_objects[i].x = sei_objects[i].x;
+					ring_objects[i].y = sei_objects[i].y;
+					ring_objects[i].w = sei_objects[i].w;
+					ring_objects[i].h = sei_objects[i].h;
+				}
+				rk_det_ring_publish(npu_pts.front(), width, height, ring_objects, ring_count);
+				npu_pts.pop();
+			}
+			if (get_ret != 0) {
 
 				DrawDetections(src_img, objects);
 			}
+			if (get_ret == 0 && g_autoframe.enable)
+				rkipc_autoframe_update(objects, width, height);
+			// only a fresh result triggers, objects is stale on the frames without one
+			long long now = rkipc_get_curren_time_ms();
+			if (get_ret == 0 && detect_snapshot && !objects.empty() &&
+			    now - last_snapshot_ms >= snapshot_cooldown_ms) {
+				rk_video_snapshot_trigger("detect", burst_num, burst_interval_ms,
+				                          snapshot_persist);
+				last_snapshot_ms = now;
+			}
+			// every fresh detection extends the clip until post_record_ms after it
+			if (get_ret == 0 && detect_record && !objects.empty())
+				rk_storage_event_trigger("detect");
+			if (g_adaptive_rc.enable)
+				rkipc_adaptive_rc_report(rkipc_motion_score(src_img, motion_gray),
+				                         objects.size());
 
 			// imcopy(rgb_buffer, yuv_buffer);
 
-			// ret = RK_MPI_VI_ReleaseChnFrame(pipe_id_, g_vi_for_npu_id, &stViFrame);
-			if (ret != RK_SUCCESS)
-				LOG_ERROR("RK_MPI_VI fail %x\n", ret);
 			loopCount++;
 		} else {
 			LOG_ERROR("RK_MPI_VI or VPSS_GetChnFrame timeout %x\n", ret);
@@ -1135,6 +1876,19 @@ static void *yolo26_inference(void *arg) {
 	return NULL;
 }
 
+int rk_video_get_mb_plan(char *value, int size) {
+	return rk_mb_budget_dump(&g_mb_plan, value, size);
+}
+
+int rk_video_get_npu_profile(char *value, int size) {
+	if (!RKNNPerfProfiler::Instance().Enabled()) {
+		LOG_WARN("npu profile is disabled, set video.source:npu_profile = 1\n");
+		snprintf(value, size, "{\"enable\":0}");
+		return -1;
+	}
+	return RKNNPerfProfiler::Instance().ToJson(value, size, false);
+}
+
 int rkipc_yolo_init() {
 	int ret = 0;
 	yolo26_thread = std::thread(yolo26_inference, nullptr);
@@ -1349,7 +2103,7 @@ int rkipc_osd_bmp_create(int id, osd_data_s *osd_data) {
 	stMppChn.enModId = RK_ID_VENC;
 	stMppChn.s32DevId = 0;
 
-	if (enable_venc_0) {
+	if (g_video_stream[0].enable && rkipc_stream_get_int(0, "enable_osd", 1)) {
 		stMppChn.s32ChnId = 0;
 		ret = RK_MPI_RGN_AttachToChn(RgnHandle, &stMppChn, &stRgnChnAttr);
 		if (RK_SUCCESS != ret) {
@@ -1367,20 +2121,24 @@ int rkipc_osd_bmp_create(int id, osd_data_s *osd_data) {
 		}
 		LOG_DEBUG("RK_MPI_RGN_AttachToChn to jpeg success\n");
 	}
-	if (enable_venc_1) {
+	// osd is laid out on the main stream, scale the position for the others
+	for (int i = 1; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (!g_video_stream[i].enable || !rkipc_stream_get_int(i, "enable_osd", 1))
+			continue;
 		stRgnChnAttr.unChnAttr.stOverlayChn.stPoint.s32X =
-		    UPALIGNTO16(osd_data->origin_x * rk_param_get_int("video.1:width", 1) /
+		    UPALIGNTO16(osd_data->origin_x * rkipc_stream_get_int(i, "width", 1) /
 		                rk_param_get_int("video.0:width", 1));
 		stRgnChnAttr.unChnAttr.stOverlayChn.stPoint.s32Y =
-		    UPALIGNTO16(osd_data->origin_y * rk_param_get_int("video.1:height", 1) /
+		    UPALIGNTO16(osd_data->origin_y * rkipc_stream_get_int(i, "height", 1) /
 		                rk_param_get_int("video.0:height", 1));
-		stMppChn.s32ChnId = 1;
+		stMppChn.s32ChnId = i;
 		ret = RK_MPI_RGN_AttachToChn(RgnHandle, &stMppChn, &stRgnChnAttr);
 		if (RK_SUCCESS != ret) {
-			LOG_ERROR("RK_MPI_RGN_AttachToChn (%d) to venc1 failed with %#x\n", RgnHandle, ret);
+			LOG_ERROR("RK_MPI_RGN_AttachToChn (%d) to venc%d failed with %#x\n", RgnHandle, i,
+			          ret);
 			return RK_FAILURE;
 		}
-		LOG_DEBUG("RK_MPI_RGN_AttachToChn to venc1 success\n");
+		LOG_DEBUG("RK_MPI_RGN_AttachToChn to venc%d success\n", i);
 	}
 
 	// set bitmap
@@ -1405,7 +2163,7 @@ int rkipc_osd_bmp_destroy(int id) {
 	RGN_HANDLE RgnHandle = id;
 	stMppChn.enModId = RK_ID_VENC;
 	stMppChn.s32DevId = 0;
-	if (enable_venc_0) {
+	if (g_video_stream[0].enable && rkipc_stream_get_int(0, "enable_osd", 1)) {
 		stMppChn.s32ChnId = 0;
 		ret = RK_MPI_RGN_DetachFromChn(RgnHandle, &stMppChn);
 		if (RK_SUCCESS != ret)
@@ -1417,11 +2175,14 @@ int rkipc_osd_bmp_destroy(int id) {
 		if (RK_SUCCESS != ret)
 			LOG_DEBUG("RK_MPI_RGN_DetachFrmChn (%d) to jpeg failed with %#x\n", RgnHandle, ret);
 	}
-	if (enable_venc_1) {
-		stMppChn.s32ChnId = 1;
+	for (int i = 1; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (!g_video_stream[i].enable || !rkipc_stream_get_int(i, "enable_osd", 1))
+			continue;
+		stMppChn.s32ChnId = i;
 		ret = RK_MPI_RGN_DetachFromChn(RgnHandle, &stMppChn);
 		if (RK_SUCCESS != ret)
-			LOG_DEBUG("RK_MPI_RGN_DetachFrmChn (%d) to venc1 failed with %#x\n", RgnHandle, ret);
+			LOG_DEBUG("RK_MPI_RGN_DetachFrmChn (%d) to venc%d failed with %#x\n", RgnHandle, i,
+			          ret);
 	}
 
 	// destory region
@@ -1484,7 +2245,7 @@ static void *rkipc_cycle_snapshot(void *arg) {
 
 	while (g_video_run_ && cycle_snapshot_flag) {
 		usleep(rk_param_get_int("video.jpeg:snapshot_interval_ms", 1000) * 1000);
-		rk_take_photo();
+		rk_video_snapshot_trigger("cycle", 1, 0, 1);
 	}
 	LOG_INFO("exit %s thread, arg:%p\n", __func__, arg);
 
@@ -1509,7 +2270,7 @@ int rkipc_pipe_jpeg_init() {
 	jpeg_chn_attr.stVencAttr.u32PicHeight = video_height;
 	jpeg_chn_attr.stVencAttr.u32VirWidth = video_width;
 	jpeg_chn_attr.stVencAttr.u32VirHeight = video_height;
-	jpeg_chn_attr.stVencAttr.u32StreamBufCnt = 2;
+	jpeg_chn_attr.stVencAttr.u32StreamBufCnt = g_mb_plan.jpeg_buf_count;
 	jpeg_chn_attr.stVencAttr.u32BufSize = rk_param_get_int("video.jpeg:jpeg_buffer_size", 204800);
 	// jpeg_chn_attr.stVencAttr.u32Depth = 1;
 	ret = RK_MPI_VENC_CreateChn(JPEG_VENC_CHN, &jpeg_chn_attr);
@@ -1554,6 +2315,7 @@ int rkipc_pipe_jpeg_init() {
 	RK_MPI_VENC_StartRecvFrame(JPEG_VENC_CHN,
 	                           &stRecvParam); // must, for no streams callback running failed
 
+	rk_snapshot_init();
 	jpeg_venc_thread_id = std::thread(rkipc_get_jpeg, nullptr);
 	if (rk_param_get_int("video.jpeg:enable_cycle_snapshot", 0)) {
 		cycle_snapshot_flag = 1;
@@ -1757,6 +2519,193 @@ int rkipc_pipe_vi_vo_deinit() {
 	return 0;
 }
 
+typedef enum {
+	RKIPC_RECONFIG_NONE = 0,
+	RKIPC_RECONFIG_ATTR,    // applied to the running encoder
+	RKIPC_RECONFIG_RESIZE,  // vi channel and encoder resized in place, then rebound
+	RKIPC_RECONFIG_RESTART, // whole video pipeline through rk_video_restart
+} rkipc_reconfig_level;
+
+static pthread_mutex_t g_reconfig_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void rkipc_venc_set_src_frame_rate(VENC_RC_ATTR_S *rc_attr, int num, int den) {
+	switch (rc_attr->enRcMode) {
+	case VENC_RC_MODE_H264CBR:
+		rc_attr->stH264Cbr.u32SrcFrameRateNum = num;
+		rc_attr->stH264Cbr.u32SrcFrameRateDen = den;
+		break;
+	case VENC_RC_MODE_H264VBR:
+		rc_attr->stH264Vbr.u32SrcFrameRateNum = num;
+		rc_attr->stH264Vbr.u32SrcFrameRateDen = den;
+		break;
+	case VENC_RC_MODE_H265CBR:
+		rc_attr->stH265Cbr.u32SrcFrameRateNum = num;
+		rc_attr->stH265Cbr.u32SrcFrameRateDen = den;
+		break;
+	case VENC_RC_MODE_H265VBR:
+		rc_attr->stH265Vbr.u32SrcFrameRateNum = num;
+		rc_attr->stH265Vbr.u32SrcFrameRateDen = den;
+		break;
+	default:
+		LOG_ERROR("rc mode %d not support\n", rc_attr->enRcMode);
+		break;
+	}
+}
+
+static rkipc_reconfig_level rkipc_stream_reconfig_diff(rkipc_video_stream_s *stream,
+                                                       const rkipc_stream_param_s *param) {
+	const rkipc_stream_param_s *cur = &stream->param;
+	// rtsp sdp, the muxers and the rc attr layout all follow the codec
+	if (strcmp(cur->output_data_type, param->output_data_type))
+		return RKIPC_RECONFIG_RESTART;
+	if (cur->width != param->width || cur->height != param->height) {
+		// npu/ivs read the shared channel at its size, buffers are allocated for the max size
+		if (stream->share_vi || param->width > rkipc_stream_get_int(stream->id, "max_width", 0) ||
+		    param->height > rkipc_stream_get_int(stream->id, "max_height", 0))
+			return RKIPC_RECONFIG_RESTART;
+		return RKIPC_RECONFIG_RESIZE;
+	}
+	if (strcmp(cur->h264_profile, param->h264_profile) || strcmp(cur->smart, param->smart) ||
+	    strcmp(cur->gop_mode, param->gop_mode) ||
+	    cur->src_frame_rate_num != param->src_frame_rate_num ||
+	    cur->src_frame_rate_den != param->src_frame_rate_den)
+		return RKIPC_RECONFIG_ATTR;
+
+	return RKIPC_RECONFIG_NONE;
+}
+
+static int rkipc_stream_vi_resize(rkipc_video_stream_s *stream, int width, int height) {
+	int ret;
+	VI_CHN_ATTR_S vi_chn_attr;
+	memset(&vi_chn_attr, 0, sizeof(vi_chn_attr));
+	ret = RK_MPI_VI_GetChnAttr(pipe_id_, stream->vi_chn_id, &vi_chn_attr);
+	ret |= RK_MPI_VI_DisableChn(pipe_id_, stream->vi_chn_id);
+	vi_chn_attr.stSize.u32Width = width;
+	vi_chn_attr.stSize.u32Height = height;
+	ret |= RK_MPI_VI_SetChnAttr(pipe_id_, stream->vi_chn_id, &vi_chn_attr);
+	ret |= RK_MPI_VI_EnableChn(pipe_id_, stream->vi_chn_id);
+	if (ret)
+		LOG_ERROR("resize VI %d to %dx%d error! ret=%#x\n", stream->vi_chn_id, width, height, ret);
+
+	return ret;
+}
+
+static int rkipc_stream_venc_apply(rkipc_video_stream_s *stream,
+                                   const rkipc_stream_param_s *param) {
+	int ret;
+	int id = stream->id;
+	VENC_CHN_ATTR_S venc_chn_attr;
+	memset(&venc_chn_attr, 0, sizeof(venc_chn_attr));
+	ret = RK_MPI_VENC_GetChnAttr(id, &venc_chn_attr);
+	if (ret) {
+		LOG_ERROR("RK_MPI_VENC_GetChnAttr %d error! ret=%#x\n", id, ret);
+		return ret;
+	}
+	venc_chn_attr.stVencAttr.u32PicWidth = param->width;
+	venc_chn_attr.stVencAttr.u32PicHeight = param->height;
+	venc_chn_attr.stVencAttr.u32VirWidth = param->width;
+	venc_chn_attr.stVencAttr.u32VirHeight = param->height;
+	if (!strcmp(param->output_data_type, "H.264"))
+		venc_chn_attr.stVencAttr.u32Profile = rkipc_venc_h264_profile(param->h264_profile);
+	rkipc_venc_set_gop_attr(id, param->gop_mode, &venc_chn_attr.stGopAttr);
+	rkipc_venc_set_src_frame_rate(&venc_chn_attr.stRcAttr, param->src_frame_rate_num,
+	                              param->src_frame_rate_den);
+	ret = RK_MPI_VENC_SetChnAttr(id, &venc_chn_attr);
+	if (ret) {
+		LOG_ERROR("RK_MPI_VENC_SetChnAttr %d error! ret=%#x\n", id, ret);
+		return ret;
+	}
+	if (strcmp(stream->param.smart, param->smart))
+		RK_MPI_VENC_EnableSvc(id, (RK_BOOL)!strcmp(param->smart, "open"));
+
+	// the jpeg channel is a combo of the main stream and must follow its size
+	if (id == 0 && enable_jpeg) {
+		memset(&venc_chn_attr, 0, sizeof(venc_chn_attr));
+		RK_MPI_VENC_GetChnAttr(JPEG_VENC_CHN, &venc_chn_attr);
+		venc_chn_attr.stVencAttr.u32PicWidth = rk_param_get_int("video.jpeg:width", param->width);
+		venc_chn_attr.stVencAttr.u32PicHeight =
+		    rk_param_get_int("video.jpeg:height", param->height);
+		venc_chn_attr.stVencAttr.u32VirWidth = venc_chn_attr.stVencAttr.u32PicWidth;
+		venc_chn_attr.stVencAttr.u32VirHeight = venc_chn_attr.stVencAttr.u32PicHeight;
+		ret = RK_MPI_VENC_SetChnAttr(JPEG_VENC_CHN, &venc_chn_attr);
+		if (ret)
+			LOG_ERROR("RK_MPI_VENC_SetChnAttr jpeg error! ret=%#x\n", ret);
+	}
+
+	return ret;
+}
+
+// reopen the containers of this stream only, they take size and profile when opened
+static void rkipc_stream_reopen_muxer(rkipc_video_stream_s *stream) {
+	rk_storage_restart_by_id(stream->id);
+	// the rtmp session reads the video parameters again when it reconnects
+	if (enable_rtmp)
+		rk_rtmp_set_url(stream->id, NULL, NULL);
+}
+
+/**
+ * Apply the [video.N] parameters changed since the stream was built, touching only
+ * its own channels. Falls back to rk_video_restart when that is not possible.
+ */
+static int rkipc_stream_reconfig(int stream_id) {
+	int ret = 0;
+	rkipc_stream_param_s param;
+	MPP_CHN_S stViChn, stVencChn;
+	if (stream_id < 0 || stream_id >= RKIPC_MAX_VIDEO_STREAM) {
+		LOG_ERROR("invalid stream %d\n", stream_id);
+		return -1;
+	}
+	rkipc_video_stream_s *stream = &g_video_stream[stream_id];
+	// not running, the saved parameters are used at the next init
+	if (!g_video_run_ || !stream->enable)
+		return 0;
+
+	pthread_mutex_lock(&g_reconfig_mutex);
+	rkipc_stream_param_load(stream_id, &param);
+	rkipc_reconfig_level level = rkipc_stream_reconfig_diff(stream, &param);
+	// raw NV12 output has no encoder to reconfigure
+	if (level != RKIPC_RECONFIG_NONE && !stream->venc_thread.joinable())
+		level = RKIPC_RECONFIG_RESTART;
+	LOG_INFO("stream %d reconfig level %d\n", stream_id, level);
+	if (level == RKIPC_RECONFIG_NONE || level == RKIPC_RECONFIG_RESTART) {
+		pthread_mutex_unlock(&g_reconfig_mutex);
+		return level == RKIPC_RECONFIG_RESTART ? rk_video_restart() : 0;
+	}
+
+	if (level == RKIPC_RECONFIG_RESIZE) {
+		stViChn.enModId = RK_ID_VI;
+		stViChn.s32DevId = 0;
+		stViChn.s32ChnId = stream->vi_chn_id;
+		stVencChn.enModId = RK_ID_VENC;
+		stVencChn.s32DevId = 0;
+		stVencChn.s32ChnId = stream_id;
+		ret = RK_MPI_SYS_UnBind(&stViChn, &stVencChn);
+		ret |= rkipc_stream_vi_resize(stream, param.width, param.height);
+	}
+	if (!ret)
+		ret = rkipc_stream_venc_apply(stream, &param);
+	if (level == RKIPC_RECONFIG_RESIZE) {
+		ret |= RK_MPI_SYS_Bind(&stViChn, &stVencChn);
+		// osd positions are scaled from the main stream size
+		rkipc_osd_deinit();
+		rkipc_osd_init();
+	}
+	if (ret) {
+		pthread_mutex_unlock(&g_reconfig_mutex);
+		LOG_ERROR("stream %d reconfig fail %#x, restart video\n", stream_id, ret);
+		return rk_video_restart();
+	}
+	if (level == RKIPC_RECONFIG_RESIZE || strcmp(stream->param.h264_profile, param.h264_profile))
+		rkipc_stream_reopen_muxer(stream);
+	stream->param = param;
+	// send the new parameter sets right away
+	RK_MPI_VENC_RequestIDR(stream_id, RK_TRUE);
+	pthread_mutex_unlock(&g_reconfig_mutex);
+	LOG_INFO("stream %d reconfig done\n", stream_id);
+
+	return 0;
+}
+
 // export API
 int rk_video_get_gop(int stream_id, int *value) {
 	char entry[128] = {'\0'};
@@ -1948,7 +2897,39 @@ int rk_video_set_output_data_type(int stream_id, const char *value) {
 	char entry[128] = {'\0'};
 	snprintf(entry, 127, "video.%d:output_data_type", stream_id);
 	rk_param_set_string(entry, value);
-	rk_video_restart();
+	rkipc_stream_reconfig(stream_id);
+
+	return 0;
+}
+
+int rk_video_get_rtmp_url(int stream_id, const char **value) {
+	char entry[128] = {'\0'};
+	snprintf(entry, 127, "video.%d:rtmp_url", stream_id);
+	*value = rk_param_get_string(entry, RTMP_URL);
+
+	return 0;
+}
+
+// the session reconnects to the new ingest, the stream keeps running
+int rk_video_set_rtmp_url(int stream_id, const char *value) {
+	char entry[128] = {'\0'};
+	snprintf(entry, 127, "video.%d:rtmp_url", stream_id);
+	rk_param_set_string(entry, value);
+	if (enable_rtmp && stream_id >= 0 && stream_id < RKIPC_MAX_VIDEO_STREAM &&
+	    g_video_stream[stream_id].enable)
+		return rk_rtmp_set_url(stream_id, value, NULL);
+
+	return 0;
+}
+
+// write only, the stream key is a credential
+int rk_video_set_rtmp_key(int stream_id, const char *value) {
+	char entry[128] = {'\0'};
+	snprintf(entry, 127, "video.%d:rtmp_key", stream_id);
+	rk_param_set_string(entry, value);
+	if (enable_rtmp && stream_id >= 0 && stream_id < RKIPC_MAX_VIDEO_STREAM &&
+	    g_video_stream[stream_id].enable)
+		return rk_rtmp_set_url(stream_id, NULL, value);
 
 	return 0;
 }
@@ -2025,7 +3006,7 @@ int rk_video_set_smart(int stream_id, const char *value) {
 	char entry[128] = {'\0'};
 	snprintf(entry, 127, "video.%d:smart", stream_id);
 	rk_param_set_string(entry, value);
-	rk_video_restart();
+	rkipc_stream_reconfig(stream_id);
 
 	return 0;
 }
@@ -2042,7 +3023,7 @@ int rk_video_set_gop_mode(int stream_id, const char *value) {
 	char entry[128] = {'\0'};
 	snprintf(entry, 127, "video.%d:gop_mode", stream_id);
 	rk_param_set_string(entry, value);
-	rk_video_restart();
+	rkipc_stream_reconfig(stream_id);
 
 	return 0;
 }
@@ -2075,7 +3056,7 @@ int rk_video_set_h264_profile(int stream_id, const char *value) {
 	char entry[128] = {'\0'};
 	snprintf(entry, 127, "video.%d:h264_profile", stream_id);
 	rk_param_set_string(entry, value);
-	rk_video_restart();
+	rkipc_stream_reconfig(stream_id);
 
 	return 0;
 }
@@ -2107,7 +3088,7 @@ int rk_video_set_resolution(int stream_id, const char *value) {
 		snprintf(entry, 127, "video.jpeg:height");
 		rk_param_set_int(entry, height);
 	}
-	rk_video_restart();
+	rkipc_stream_reconfig(stream_id);
 
 	return 0;
 }
@@ -2214,7 +3195,7 @@ int rk_video_set_frame_rate_in(int stream_id, const char *value) {
 	rk_param_set_int(entry, den);
 	snprintf(entry, 127, "video.%d:src_frame_rate_num", stream_id);
 	rk_param_set_int(entry, num);
-	rk_video_restart();
+	rkipc_stream_reconfig(stream_id);
 
 	return 0;
 }
@@ -2293,11 +3274,22 @@ int rk_video_set_jpeg_resolution(const char *value) {
 
 int rk_take_photo() {
 	LOG_INFO("start\n");
-	VENC_RECV_PIC_PARAM_S stRecvParam;
-	memset(&stRecvParam, 0, sizeof(VENC_RECV_PIC_PARAM_S));
-	stRecvParam.s32RecvPicNum = 1;
-	RK_MPI_VENC_StartRecvFrame(JPEG_VENC_CHN, &stRecvParam);
-	take_photo_one = 1;
+	return rk_video_snapshot_trigger("manual", 1, 0, 1);
+}
+
+int rk_video_snapshot_trigger(const char *reason, int count, int interval_ms, int persist) {
+	if (!enable_jpeg || count <= 0)
+		return -1;
+	pthread_mutex_lock(&g_snapshot_mutex);
+	if (count > g_snapshot_remain) {
+		g_snapshot_remain = count;
+		g_snapshot_interval_ms = interval_ms;
+		snprintf(g_snapshot_reason, sizeof(g_snapshot_reason), "%s", reason ? reason : "");
+	}
+	g_snapshot_persist |= persist;
+	pthread_cond_signal(&g_snapshot_cond);
+	pthread_mutex_unlock(&g_snapshot_mutex);
+	LOG_DEBUG("%s: %d frames every %d ms, persist %d\n", reason, count, interval_ms, persist);
 
 	return 0;
 }
@@ -2336,14 +3328,11 @@ int rk_roi_set(roi_data_s *roi_data) {
 		pstRoiAttr.s32Qp = -6;
 	}
 
-	if (!strcmp(roi_data->stream_type, "mainStream") &&
-	    rk_param_get_int("video.source:enable_venc_0", 0)) {
+	if (!strcmp(roi_data->stream_type, "mainStream") && g_video_stream[0].enable) {
 		venc_chn = 0;
-	} else if (!strcmp(roi_data->stream_type, "subStream") &&
-	           rk_param_get_int("video.source:enable_venc_1", 0)) {
+	} else if (!strcmp(roi_data->stream_type, "subStream") && g_video_stream[1].enable) {
 		venc_chn = 1;
-	} else if (!strcmp(roi_data->stream_type, "thirdStream") &&
-	           rk_param_get_int("video.source:enable_venc_2", 0)) {
+	} else if (!strcmp(roi_data->stream_type, "thirdStream") && g_video_stream[2].enable) {
 		venc_chn = 2;
 	} else {
 		LOG_DEBUG("%s is not exit\n", roi_data->stream_type);
@@ -2409,19 +3398,127 @@ int rk_video_set_rotation(int value) {
 	return 0;
 }
 
+static int rkipc_packet_bus_rtsp_cb(rk_packet_s *packet, void *arg) {
+	if (packet->stream_id == RKIPC_AUTOFRAME_STREAM_ID)
+		return rkipc_rtsp_write_video_packet(packet->stream_id, packet);
+	// slices arrive on their own bus stream, the rtsp session is still the video stream id
+	int id = packet->stream_id % RKIPC_MAX_VIDEO_STREAM;
+	static int64_t last_pts[RKIPC_MAX_VIDEO_STREAM];
+	int ret = rkipc_rtsp_write_video_packet(id, packet);
+	if (packet->pts != last_pts[id]) {
+		last_pts[id] = packet->pts;
+		rk_trace_record(id, RK_TRACE_RTSP, packet->pts);
+	}
+
+	return ret;
+}
+
+// a new viewer would wait up to a gop for its first decodable frame, rtsp.c rate limits this.
+// id is the stream of the viewer, -1 when rtsp.c does not know it
+static void rkipc_rtsp_join(int id) {
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if ((id >= 0 && id != i) || !g_video_stream[i].venc_thread.joinable())
+			continue;
+		LOG_DEBUG("request idr on stream %d for a new viewer\n", i);
+		RK_MPI_VENC_RequestIDR(i, RK_TRUE);
+	}
+	if ((id < 0 || id == RKIPC_AUTOFRAME_STREAM_ID) && autoframe_thread_id.joinable())
+		RK_MPI_VENC_RequestIDR(RKIPC_AUTOFRAME_VENC_CHN, RK_TRUE);
+}
+
+static int rkipc_packet_bus_storage_cb(rk_packet_s *packet, void *arg) {
+	int ret = rk_storage_write_video_frame(packet->stream_id, packet->data, packet->len,
+	                                       packet->pts, packet->key_frame);
+	rk_trace_record(packet->stream_id, RK_TRACE_STORAGE, packet->pts);
+
+	return ret;
+}
+
+// keeps its own reference of the packet in the pre-event ring
+static int rkipc_packet_bus_prerecord_cb(rk_packet_s *packet, void *arg) {
+	return rk_storage_event_write_video(packet);
+}
+
+static int rkipc_packet_bus_rtmp_cb(rk_packet_s *packet, void *arg) {
+	return rk_rtmp_write_video_packet(packet->stream_id, packet);
+}
+
+static int rkipc_packet_bus_hls_cb(rk_packet_s *packet, void *arg) {
+	return rk_hls_write_video(packet->stream_id, packet);
+}
+
+static int g_autoframe_bus_handle = -1;
+
+static int rkipc_packet_bus_subscribe() {
+	int rtsp_depth = rk_param_get_int("video.source:packet_bus_rtsp_depth", 15);
+	int rtsp_slice_depth = rk_param_get_int("video.source:packet_bus_rtsp_slice_depth", 64);
+	int storage_depth = rk_param_get_int("video.source:packet_bus_storage_depth", 90);
+	int rtmp_depth = rk_param_get_int("video.source:packet_bus_rtmp_depth", 60);
+	int prerecord_depth = rk_param_get_int("video.source:packet_bus_prerecord_depth", 30);
+	int hls_depth = rk_param_get_int("video.source:packet_bus_hls_depth", 30);
+	char entry[128] = {'\0'};
+
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		rkipc_video_stream_s *stream = &g_video_stream[i];
+		if (!stream->enable)
+			continue;
+		if (enable_rtsp && stream->low_latency)
+			stream->packet_bus_handle[0] = rk_packet_bus_subscribe(
+			    RKIPC_SLICE_STREAM_ID(i), "rtsp", rtsp_slice_depth, RK_PACKET_DROP_TO_KEY,
+			    rkipc_packet_bus_rtsp_cb, NULL);
+		else if (enable_rtsp)
+			stream->packet_bus_handle[0] = rk_packet_bus_subscribe(
+			    i, "rtsp", rtsp_depth, RK_PACKET_DROP_TO_KEY, rkipc_packet_bus_rtsp_cb, NULL);
+		// rk_storage_init reads the same key, a stream it does not record needs no consumer
+		snprintf(entry, 127, "storage.%d:enable", i);
+		if (rk_param_get_int(entry, 0))
+			stream->packet_bus_handle[1] =
+			    rk_packet_bus_subscribe(i, "storage", storage_depth, RK_PACKET_DROP_TO_KEY,
+			                            rkipc_packet_bus_storage_cb, NULL);
+		if (enable_rtmp)
+			stream->packet_bus_handle[2] = rk_packet_bus_subscribe(
+			    i, "rtmp", rtmp_depth, RK_PACKET_DROP_TO_KEY, rkipc_packet_bus_rtmp_cb, NULL);
+		// pre-event recording only covers the main stream
+		if (i == 0 && rk_param_get_int("storage.event:enable", 0))
+			stream->packet_bus_handle[3] =
+			    rk_packet_bus_subscribe(i, "prerecord", prerecord_depth, RK_PACKET_DROP_TO_KEY,
+			                            rkipc_packet_bus_prerecord_cb, NULL);
+		if (rk_hls_enabled(i))
+			stream->packet_bus_handle[4] = rk_packet_bus_subscribe(
+			    i, "hls", hls_depth, RK_PACKET_DROP_TO_KEY, rkipc_packet_bus_hls_cb, NULL);
+	}
+	// the auto framing stream only goes out over rtsp
+	if (enable_rtsp && g_autoframe.enable)
+		g_autoframe_bus_handle =
+		    rk_packet_bus_subscribe(RKIPC_AUTOFRAME_STREAM_ID, "rtsp", rtsp_depth,
+		                            RK_PACKET_DROP_TO_KEY, rkipc_packet_bus_rtsp_cb, NULL);
+
+	return 0;
+}
+
+static int rkipc_packet_bus_unsubscribe() {
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		for (int j = 0; j < RKIPC_STREAM_CONSUMER_NUM; j++) {
+			rk_packet_bus_unsubscribe(g_video_stream[i].packet_bus_handle[j]);
+			g_video_stream[i].packet_bus_handle[j] = -1;
+		}
+	}
+	rk_packet_bus_unsubscribe(g_autoframe_bus_handle);
+	g_autoframe_bus_handle = -1;
+
+	return 0;
+}
+
 int rk_video_init() {
 	LOG_INFO("begin\n");
 	int ret = 0;
 	enable_jpeg = (RK_BOOL)rk_param_get_int("video.source:enable_jpeg", 1);
-	enable_venc_0 = (RK_BOOL)rk_param_get_int("video.source:enable_venc_0", 1);
-	enable_venc_1 = (RK_BOOL)rk_param_get_int("video.source:enable_venc_1", 1);
 	enable_rtsp = (RK_BOOL)rk_param_get_int("video.source:enable_rtsp", 1);
 	enable_rtmp = (RK_BOOL)rk_param_get_int("video.source:enable_rtmp", 1);
 	enable_npu = (RK_BOOL)rk_param_get_int("video.source:enable_npu", 0);
 	enable_ivs = (RK_BOOL)rk_param_get_int("video.source:enable_ivs", 1);
 	enable_wrap = (RK_BOOL)rk_param_get_int("video.source:enable_wrap", 0);
-	LOG_INFO("enable_jpeg is %d, enable_venc_0 is %d, enable_venc_1 is %d", enable_jpeg,
-	         enable_venc_0, enable_venc_1);
+	LOG_INFO("enable_jpeg is %d\n", enable_jpeg);
 
 	pipe_id_ = rk_param_get_int("video.source:camera_id", 0);
 	g_vi_chn_id = rk_param_get_int("video.source:vi_chn_id", 0);
@@ -2430,16 +3527,34 @@ int rk_video_init() {
 	g_vo_layer_id = rk_param_get_int("video.source:vo_layer_id", 0);
 	LOG_INFO("g_vi_chn_id is %d, g_enable_vo is %d, g_vo_dev_id is %d, g_vo_layer_id is %d\n",
 	         g_vi_chn_id, g_enable_vo, g_vo_dev_id, g_vo_layer_id);
+	rkipc_video_stream_load();
+	// size every buffer pool before the first allocation, sub streams may be dropped here
+	char mb_plan[2048];
+	ret = rk_mb_budget_plan(&g_mb_plan, rk_mb_budget_get_limit());
+	rk_mb_budget_dump(&g_mb_plan, mb_plan, sizeof(mb_plan));
+	LOG_INFO("media buffer plan:\n%s", mb_plan);
+	if (ret) {
+		LOG_ERROR("the configured streams do not fit the media buffers, not starting\n");
+		return -1;
+	}
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++)
+		g_video_stream[i].enable = (RK_BOOL)g_mb_plan.stream[i].enable;
+	rk_trace_init();
+	rkipc_adaptive_rc_init();
+	rkipc_scene_change_init();
+	rk_sei_init();
+	rk_det_ring_init();
 	g_video_run_ = 1;
+	rk_packet_bus_init();
 	ret |= rkipc_vi_dev_init();
 
 	ret |= rkipc_vi_ext_init();
 	if (g_enable_vo)
 		ret |= rkipc_pipe_vi_vo_init();
-	if (enable_venc_0)
-		ret |= rkipc_pipe_0_init();
-	if (enable_venc_1)
-		ret |= rkipc_pipe_1_init();
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (g_video_stream[i].enable)
+			ret |= rkipc_stream_venc_init(&g_video_stream[i]);
+	}
 	if (enable_jpeg)
 		ret |= rkipc_pipe_jpeg_init();
 
@@ -2447,12 +3562,24 @@ int rk_video_init() {
 	rk_roi_set_all();
 	rk_region_clip_set_callback_register(rk_region_clip_set);
 	rk_region_clip_set_all();
+	if (enable_rtsp && rk_param_get_int("video.source:rtsp_join_idr", 1))
+		rkipc_rtsp_set_join_callback(rkipc_rtsp_join);
 	if (enable_rtsp)
-		ret |= rkipc_rtsp_init(RTSP_URL_0, RTSP_URL_1, RTSP_URL_2);
-	if (enable_rtmp) {
-		sleep(6); // wait for fcgi and nginx
-		ret |= rkipc_rtmp_init();
+		ret |= rkipc_rtsp_init(g_video_stream[0].enable ? g_rtsp_url[0] : NULL,
+		                       g_video_stream[1].enable ? g_rtsp_url[1] : NULL,
+		                       g_video_stream[2].enable ? g_rtsp_url[2] : NULL);
+	ret |= rkipc_autoframe_init();
+	// external processes may subscribe to the channels rkipc reads frames of itself
+	if (!rk_frame_export_init()) {
+		if (enable_npu)
+			rk_frame_export_add_channel(g_vi_for_npu_id);
+		if (g_autoframe.enable)
+			rk_frame_export_add_channel(g_video_stream[0].vi_chn_id);
 	}
+	if (enable_rtmp)
+		ret |= rkipc_rtmp_init();
+	rk_hls_init();
+	rkipc_packet_bus_subscribe();
 
 	rkipc_osd_init();
 	LOG_INFO("over\n");
@@ -2469,17 +3596,14 @@ int rk_video_deinit() {
 
 	rkipc_osd_deinit();
 
+	// before vi, they hold frames of its channels
+	ret |= rkipc_autoframe_deinit();
+	rk_frame_export_deinit();
 	if (g_enable_vo)
 		ret |= rkipc_pipe_vi_vo_deinit();
-	if (enable_venc_0) {
-		if (venc_thread_0.joinable())
-			venc_thread_0.join();
-		ret |= rkipc_pipe_0_deinit();
-	}
-	if (enable_venc_1) {
-		if (venc_thread_1.joinable())
-			venc_thread_1.join();
-		ret |= rkipc_pipe_1_deinit();
+	for (int i = 0; i < RKIPC_MAX_VIDEO_STREAM; i++) {
+		if (g_video_stream[i].enable)
+			ret |= rkipc_stream_venc_deinit(&g_video_stream[i]);
 	}
 	if (enable_jpeg) {
 		if (rk_param_get_int("video.jpeg:enable_cycle_snapshot", 0)) {
@@ -2487,17 +3611,25 @@ int rk_video_deinit() {
 			if (cycle_snapshot_thread_id.joinable())
 				cycle_snapshot_thread_id.join();
 		}
+		pthread_mutex_lock(&g_snapshot_mutex);
+		pthread_cond_broadcast(&g_snapshot_cond);
+		pthread_mutex_unlock(&g_snapshot_mutex);
 		if (jpeg_venc_thread_id.joinable())
 			jpeg_venc_thread_id.join();
+		rk_snapshot_deinit();
 		ret |= rkipc_pipe_jpeg_deinit();
 	}
 	ret |= rkipc_vi_ext_deinit();
 	ret |= rkipc_vi_dev_deinit();
+	// consumer threads must stop before their sinks are destroyed
+	rkipc_packet_bus_unsubscribe();
+	rk_packet_bus_deinit();
+	rk_hls_deinit();
 	if (enable_rtmp)
 		ret |= rkipc_rtmp_deinit();
 	if (enable_rtsp)
 		ret |= rkipc_rtsp_deinit();
-
+	rk_det_ring_deinit();
 
 	return ret;
 }
@@ -38,6 +38,9 @@ int rk_video_get_RC_mode(int stream_id, const char **value);
 int rk_video_set_RC_mode(int stream_id, const char *value);
 int rk_video_get_output_data_type(int stream_id, const char **value);
 int rk_video_set_output_data_type(int stream_id, const char *value);
+int rk_video_get_rtmp_url(int stream_id, const char **value);
+int rk_video_set_rtmp_url(int stream_id, const char *value);
+int rk_video_set_rtmp_key(int stream_id, const char *value);
 int rk_video_get_rc_quality(int stream_id, const char **value);
 int rk_video_set_rc_quality(int stream_id, const char *value);
 int rk_video_get_smart(int stream_id, const char **value);
@@ -57,6 +60,12 @@ int rk_video_get_frame_rate_in(int stream_id, char **value);
 int rk_video_set_frame_rate_in(int stream_id, const char *value);
 int rk_video_get_rotation(int *value);
 int rk_video_set_rotation(int value);
+// per pool media buffer footprint planned at init
+int rk_video_get_mb_plan(char *value, int size);
+// scene state and switch counts of the activity driven gop/bitrate controller
+int rk_video_get_adaptive_rc_stats(char *value, int size);
+// counters and the last scene cuts that forced an idr
+int rk_video_get_scene_change_events(char *value, int size);
 // jpeg
 int rk_video_get_enable_cycle_snapshot(int *value);
 int rk_video_set_enable_cycle_snapshot(int value);
@@ -67,6 +76,10 @@ int rk_video_set_snapshot_interval_ms(int value);
 int rk_video_get_jpeg_resolution(char **value);
 int rk_video_set_jpeg_resolution(const char *value);
 int rk_take_photo();
+// capture count jpegs every interval_ms into the snapshot ring, persist also writes them to disk
+int rk_video_snapshot_trigger(const char *reason, int count, int interval_ms, int persist);
 
+// npu
+int rk_video_get_npu_profile(char *value, int size);
 int rkipc_yolo_init();
 int rkipc_yolo_deinit();
@@ -3,6 +3,7 @@
 #include "types/error.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 class NNEngine {
@@ -17,6 +18,8 @@ class NNEngine {
 	virtual const std::vector<tensor_attr_s> &GetOutputShapes() = 0; // 获取输出张量的形状
 	virtual nn_error_e Run(std::vector<tensor_data_s> &inputs, std::vector<tensor_data_s> &outpus,
 	                       bool want_float) = 0; // 运行模型
+	virtual void SetCollectPerf(bool enable) = 0; // 加载模型前设置，是否收集逐层性能数据
+	virtual nn_error_e QueryPerf(std::string &detail, int64_t &run_us) = 0; // 获取最近一次推理的性能数据
 };
 
 std::shared_ptr<NNEngine> CreateRKNNEngine(); // 创建RKNN引擎
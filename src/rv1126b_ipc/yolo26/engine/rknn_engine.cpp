@@ -21,13 +21,14 @@ nn_error_e RKEngine::LoadModelFile(const char *model_file) {
 		NN_LOG_ERROR("load model file %s fail!", model_file);
 		return NN_LOAD_MODEL_FAIL; // 返回错误码：加载模型文件失败
 	}
-	int ret = rknn_init(&rknn_ctx_, model, model_len, 0, NULL); // 初始化rknn context
+	uint32_t flag = collect_perf_ ? RKNN_FLAG_COLLECT_PERF_MASK : 0;
+	int ret = rknn_init(&rknn_ctx_, model, model_len, flag, NULL); // 初始化rknn context
 	if (ret < 0) {
 		NN_LOG_ERROR("rknn_init fail! ret=%d", ret);
 		return NN_RKNN_INIT_FAIL; // 返回错误码：初始化rknn context失败
 	}
 	// 打印初始化成功信息
-	NN_LOG_INFO("rknn_init success!");
+	NN_LOG_INFO("rknn_init success!%s", collect_perf_ ? " (collect perf)" : "");
 	ctx_created_ = true;
 
 	// 获取rknn版本信息
@@ -162,6 +163,38 @@ nn_error_e RKEngine::Run(std::vector<tensor_data_s> &inputs, std::vector<tensor_
 	return NN_SUCCESS;
 }
 
+/**
+ * @brief 获取最近一次rknn_run的逐层耗时和总耗时，需要以RKNN_FLAG_COLLECT_PERF_MASK初始化
+ * @param detail 逐层耗时表（rknn_perf_detail.perf_data的拷贝）
+ * @param run_us 总耗时，单位us
+ * @return nn_error_e 错误码
+ */
+nn_error_e RKEngine::QueryPerf(std::string &detail, int64_t &run_us) {
+	if (!ctx_created_ || !collect_perf_)
+		return NN_RKNN_QUERY_FAIL;
+
+	rknn_perf_detail perf_detail;
+	memset(&perf_detail, 0, sizeof(perf_detail));
+	int ret = rknn_query(rknn_ctx_, RKNN_QUERY_PERF_DETAIL, &perf_detail, sizeof(perf_detail));
+	if (ret != RKNN_SUCC) {
+		NN_LOG_ERROR("rknn_query perf detail fail! ret=%d", ret);
+		return NN_RKNN_QUERY_FAIL;
+	}
+	// perf_data由runtime管理，不需要释放
+	detail = perf_detail.perf_data ? perf_detail.perf_data : "";
+
+	rknn_perf_run perf_run;
+	memset(&perf_run, 0, sizeof(perf_run));
+	ret = rknn_query(rknn_ctx_, RKNN_QUERY_PERF_RUN, &perf_run, sizeof(perf_run));
+	if (ret != RKNN_SUCC) {
+		NN_LOG_ERROR("rknn_query perf run fail! ret=%d", ret);
+		return NN_RKNN_QUERY_FAIL;
+	}
+	run_us = perf_run.run_duration;
+
+	return NN_SUCCESS;
+}
+
 // 析构函数
 RKEngine::~RKEngine() {
 	if (ctx_created_) {
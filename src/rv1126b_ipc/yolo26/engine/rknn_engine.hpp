@@ -10,7 +10,8 @@
 class RKEngine : public NNEngine {
   public:
 	RKEngine()
-	    : rknn_ctx_(0), ctx_created_(false), input_num_(0), output_num_(0){}; // 构造函数，初始化
+	    : rknn_ctx_(0), ctx_created_(false), collect_perf_(false), input_num_(0),
+	      output_num_(0){}; // 构造函数，初始化
 	~RKEngine() override;                                                     // 析构函数
 
 	nn_error_e LoadModelFile(const char *model_file) override;    // 加载模型文件
@@ -18,12 +19,15 @@ class RKEngine : public NNEngine {
 	const std::vector<tensor_attr_s> &GetOutputShapes() override; // 获取输出张量的形状
 	nn_error_e Run(std::vector<tensor_data_s> &inputs, std::vector<tensor_data_s> &outputs,
 	               bool want_float) override; // 运行模型
+	void SetCollectPerf(bool enable) override { collect_perf_ = enable; };
+	nn_error_e QueryPerf(std::string &detail, int64_t &run_us) override;
 	rknn_context *get_pctx() { return &rknn_ctx_; };
 
   private:
 	// rknn context
 	rknn_context rknn_ctx_; // rknn context
 	bool ctx_created_;      // rknn context是否创建
+	bool collect_perf_;     // 是否以RKNN_FLAG_COLLECT_PERF_MASK初始化
 
 	uint32_t input_num_;  // 输入的数量
 	uint32_t output_num_; // 输出的数量
@@ -0,0 +1,219 @@
+// rknn_perf.hpp的实现
+
+#include "rknn_perf.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+#include "utils/logging.h"
+
+static int64_t perf_now_ms() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+	           std::chrono::steady_clock::now().time_since_epoch())
+	    .count();
+}
+
+static std::vector<std::string> perf_split(const std::string &line) {
+	std::vector<std::string> tokens;
+	std::istringstream iss(line);
+	std::string token;
+	while (iss >> token)
+		tokens.push_back(token);
+	return tokens;
+}
+
+static bool perf_is_number(const std::string &s) {
+	if (s.empty())
+		return false;
+	for (char c : s) {
+		if (c < '0' || c > '9')
+			return false;
+	}
+	return true;
+}
+
+static void perf_json_escape(std::string &out, const std::string &in) {
+	for (char c : in) {
+		if (c == '"' || c == '\\')
+			out += '\\';
+		if ((unsigned char)c < 0x20)
+			continue;
+		out += c;
+	}
+}
+
+/**
+ * @brief 解析算子耗时表，表头形如
+ *        ID OpType DataType Target InputShape OutputShape ... Time(us) ... FullName
+ *        只取以数字开头的行。表头中"DDR Cycles"等列名含空格，所以OpType/Target按表头
+ *        从左数的位置取，Time(us)/FullName按从右数的位置取
+ */
+int ParseRKNNPerfDetail(const char *perf_data, std::vector<nn_perf_layer_s> &layers) {
+	layers.clear();
+	if (perf_data == nullptr)
+		return -1;
+
+	// col_time/col_name为从行尾数起的位置
+	int col_op = -1, col_target = -1, col_time = -1, col_name = -1;
+	std::istringstream iss(perf_data);
+	std::string line;
+	while (std::getline(iss, line)) {
+		std::vector<std::string> tokens = perf_split(line);
+		if (tokens.empty())
+			continue;
+		if (tokens[0] == "ID") {
+			col_op = col_target = col_time = col_name = -1;
+			int n = (int)tokens.size();
+			for (int i = 0; i < n; i++) {
+				if (tokens[i] == "OpType")
+					col_op = i;
+				else if (tokens[i] == "Target")
+					col_target = i;
+				else if (tokens[i] == "Time(us)")
+					col_time = n - 1 - i;
+				else if (tokens[i] == "FullName")
+					col_name = n - 1 - i;
+			}
+			continue;
+		}
+		int n = (int)tokens.size();
+		if (col_time < 0 || !perf_is_number(tokens[0]) || n <= col_time)
+			continue;
+
+		nn_perf_layer_s layer;
+		layer.id = atoi(tokens[0].c_str());
+		layer.op_type = (col_op >= 0 && col_op < n) ? tokens[col_op] : "";
+		layer.target = (col_target >= 0 && col_target < n) ? tokens[col_target] : "";
+		layer.name = (col_name >= 0 && col_name < n) ? tokens[n - 1 - col_name] : "";
+		layer.time_us = atoll(tokens[n - 1 - col_time].c_str());
+		layers.push_back(layer);
+	}
+
+	return layers.empty() ? -1 : 0;
+}
+
+RKNNPerfProfiler &RKNNPerfProfiler::Instance() {
+	static RKNNPerfProfiler profiler;
+	return profiler;
+}
+
+void RKNNPerfProfiler::Configure(bool enable, int interval_ms, int top_n, const char *dump_path) {
+	std::lock_guard<std::mutex> lock(mtx_);
+	enable_ = enable;
+	interval_ms_ = interval_ms > 0 ? interval_ms : 5000;
+	top_n_ = top_n > 0 ? top_n : 10;
+	dump_path_ = dump_path ? dump_path : "";
+	last_sample_ms_ = 0;
+	NN_LOG_INFO("npu profile %s, interval %d ms, top %d, dump %s", enable_ ? "on" : "off",
+	            interval_ms_.load(), top_n_, dump_path_.c_str());
+}
+
+bool RKNNPerfProfiler::Due() {
+	if (!enable_)
+		return false;
+	int64_t now = perf_now_ms();
+	int64_t last = last_sample_ms_.load();
+	if (now - last < interval_ms_)
+		return false;
+	// 多个推理线程同时到期时只有一个负责采样
+	return last_sample_ms_.compare_exchange_strong(last, now);
+}
+
+void RKNNPerfProfiler::Update(const char *perf_data, int64_t run_us) {
+	std::vector<nn_perf_layer_s> layers;
+	if (ParseRKNNPerfDetail(perf_data, layers) != 0) {
+		NN_LOG_WARNING("npu profile: no layer found in perf detail");
+		return;
+	}
+
+	int64_t total = 0;
+	for (auto &layer : layers)
+		total += layer.time_us;
+	std::vector<nn_perf_layer_s> top = layers;
+	std::stable_sort(top.begin(), top.end(), [](const nn_perf_layer_s &a,
+	                                            const nn_perf_layer_s &b) {
+		return a.time_us > b.time_us;
+	});
+
+	std::lock_guard<std::mutex> lock(mtx_);
+	if ((int)top.size() > top_n_)
+		top.resize(top_n_);
+	samples_++;
+	timestamp_ms_ = perf_now_ms();
+	run_us_ = run_us;
+	layer_total_us_ = total;
+	layers_.swap(layers);
+	top_.swap(top);
+	DumpLocked();
+}
+
+std::string RKNNPerfProfiler::ToJsonLocked(bool with_layers) {
+	char tmp[128];
+	std::string json;
+	snprintf(tmp, sizeof(tmp),
+	         "{\"enable\":%d,\"samples\":%lld,\"timestamp_ms\":%lld,\"run_us\":%lld,"
+	         "\"layer_total_us\":%lld,\"layer_num\":%d,",
+	         enable_ ? 1 : 0, (long long)samples_, (long long)timestamp_ms_, (long long)run_us_,
+	         (long long)layer_total_us_, (int)layers_.size());
+	json += tmp;
+
+	auto append_layers = [&](const char *key, const std::vector<nn_perf_layer_s> &v) {
+		json += "\"";
+		json += key;
+		json += "\":[";
+		for (size_t i = 0; i < v.size(); i++) {
+			snprintf(tmp, sizeof(tmp), "%s{\"id\":%d,\"time_us\":%lld,\"op_type\":\"",
+			         i ? "," : "", v[i].id, (long long)v[i].time_us);
+			json += tmp;
+			perf_json_escape(json, v[i].op_type);
+			json += "\",\"target\":\"";
+			perf_json_escape(json, v[i].target);
+			json += "\",\"name\":\"";
+			perf_json_escape(json, v[i].name);
+			json += "\"}";
+		}
+		json += "]";
+	};
+	append_layers("top", top_);
+	if (with_layers) {
+		json += ",";
+		append_layers("layers", layers_);
+	}
+	json += "}";
+
+	return json;
+}
+
+void RKNNPerfProfiler::DumpLocked() {
+	if (dump_path_.empty())
+		return;
+	// 先写临时文件再rename，避免读取方读到半个文件
+	std::string tmp_path = dump_path_ + ".tmp";
+	FILE *fp = fopen(tmp_path.c_str(), "w");
+	if (fp == nullptr) {
+		NN_LOG_ERROR("npu profile: open %s fail", tmp_path.c_str());
+		return;
+	}
+	std::string json = ToJsonLocked(true);
+	fwrite(json.c_str(), 1, json.size(), fp);
+	fclose(fp);
+	rename(tmp_path.c_str(), dump_path_.c_str());
+}
+
+int RKNNPerfProfiler::ToJson(char *buf, int size, bool with_layers) {
+	if (buf == nullptr || size <= 0)
+		return -1;
+	std::lock_guard<std::mutex> lock(mtx_);
+	std::string json = ToJsonLocked(with_layers);
+	if ((int)json.size() >= size) {
+		NN_LOG_WARNING("npu profile: json %d bytes exceeds buffer %d", (int)json.size(), size);
+		return -1;
+	}
+	memcpy(buf, json.c_str(), json.size() + 1);
+
+	return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 单个算子的耗时信息，来自RKNN_QUERY_PERF_DETAIL
+typedef struct {
+	int id;
+	std::string op_type;
+	std::string target; // NPU/CPU/...
+	std::string name;
+	int64_t time_us;
+} nn_perf_layer_s;
+
+// 解析rknn_perf_detail.perf_data中的算子表，无法识别的行会被忽略
+int ParseRKNNPerfDetail(const char *perf_data, std::vector<nn_perf_layer_s> &layers);
+
+// 全局NPU性能统计，多个推理线程共享，按间隔采样一次
+class RKNNPerfProfiler {
+  public:
+	static RKNNPerfProfiler &Instance();
+
+	// 需要在模型加载前调用，enable为0时不开启RKNN_FLAG_COLLECT_PERF_MASK
+	void Configure(bool enable, int interval_ms, int top_n, const char *dump_path);
+	bool Enabled() const { return enable_; }
+	// 是否到了采样时间，返回true的调用者负责本次采样
+	bool Due();
+	// 更新最近一次采样结果，并写出json文件
+	void Update(const char *perf_data, int64_t run_us);
+	// 输出json，with_layers为false时只包含汇总和top-N
+	int ToJson(char *buf, int size, bool with_layers);
+
+  private:
+	RKNNPerfProfiler() : enable_(false), interval_ms_(5000), top_n_(10), last_sample_ms_(0){};
+	void DumpLocked();
+	std::string ToJsonLocked(bool with_layers);
+
+	// Enabled和Due不加锁读取，Configure在锁内写入
+	std::atomic<bool> enable_;
+	std::atomic<int> interval_ms_;
+	int top_n_;
+	std::string dump_path_;
+	std::atomic<int64_t> last_sample_ms_;
+
+	std::mutex mtx_;
+	int64_t samples_ = 0;
+	int64_t timestamp_ms_ = 0;
+	int64_t run_us_ = 0;
+	int64_t layer_total_us_ = 0;
+	std::vector<nn_perf_layer_s> layers_;
+	std::vector<nn_perf_layer_s> top_;
+};
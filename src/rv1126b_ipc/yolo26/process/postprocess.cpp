@@ -47,14 +47,11 @@ typedef struct {
 	int classId;
 } DetectRect;
 float RegDeq[16] = {0};
-static int input_w = 640;
-static int input_h = 640;
 static float objectThreshold = 0.5;
 static float nmsThreshold = 0.5;
 static int headNum = 3;
 static int class_num = 80;
 static int strides[3] = {8, 16, 32};
-static int mapSize[3][2] = {{80, 80}, {40, 40}, {20, 20}};
 #define ZQ_MAX(a, b) ((a) > (b) ? (a) : (b))
 #define ZQ_MIN(a, b) ((a) < (b) ? (a) : (b))
 static inline float fast_exp(float x) {
@@ -105,32 +102,22 @@ static inline float IOU(float XMin1, float YMin1, float XMax1, float YMax1, floa
 
 static float DeQnt2F32(int8_t qnt, int zp, float scale) { return ((float)qnt - (float)zp) * scale; }
 
-std::vector<float> GenerateMeshgrid() {
-	std::vector<float> meshgrid;
-	if (headNum == 0) {
-		NN_LOG_ERROR("=== yolo26 Meshgrid  Generate failed! ");
-		exit(-1);
-	}
-
+// 按模型输入尺寸计算各检测头的特征图大小，640输入对应{80,80},{40,40},{20,20}
+static void GetMapSize(int input_w, int input_h, int mapSize[][2]) {
 	for (int index = 0; index < headNum; index++) {
-		for (int i = 0; i < mapSize[index][0]; i++) {
-			for (int j = 0; j < mapSize[index][1]; j++) {
-				meshgrid.push_back(float(j + 0.5));
-				meshgrid.push_back(float(i + 0.5));
-			}
-		}
+		mapSize[index][0] = input_h / strides[index];
+		mapSize[index][1] = input_w / strides[index];
 	}
-
-	printf("=== yolo26 Meshgrid  Generate success! \n");
-	return meshgrid;
 }
+
 // int8版本
 int GetConvDetectionResultInt8(int8_t **pBlob, std::vector<int> &qnt_zp,
-                               std::vector<float> &qnt_scale, std::vector<float> &DetectiontRects) {
+                               std::vector<float> &qnt_scale, std::vector<float> &DetectiontRects,
+                               int input_w, int input_h) {
 	int ret = 0;
-	static auto meshgrid = GenerateMeshgrid();
+	int mapSize[3][2];
+	GetMapSize(input_w, input_h, mapSize);
 
-	int gridIndex = -2;
 	float xmin = 0, ymin = 0, xmax = 0, ymax = 0;
 	float cls_val = 0;
 	float cls_max = 0;
@@ -168,8 +155,6 @@ int GetConvDetectionResultInt8(int8_t **pBlob, std::vector<int> &qnt_zp,
 
 		for (int h = 0; h < mapSize[index][0]; h++) {
 			for (int w = 0; w < mapSize[index][1]; w++) {
-				gridIndex += 2;
-
 				if (1 == class_num) {
 					cls_max = sigmoid(DeQnt2F32(
 					    cls[0 * mapSize[index][0] * mapSize[index][1] + h * mapSize[index][1] + w],
@@ -218,10 +203,10 @@ int GetConvDetectionResultInt8(int8_t **pBlob, std::vector<int> &qnt_zp,
 					// printf(" reg_l:%f, reg_t:%f, reg_r:%f, reg_b:%f\n", RegDFL[0], RegDFL[1],
 					// RegDFL[2], RegDFL[3]);
 
-					xmin = (meshgrid[gridIndex + 0] - RegDFL[0]) * strides[index];
-					ymin = (meshgrid[gridIndex + 1] - RegDFL[1]) * strides[index];
-					xmax = (meshgrid[gridIndex + 0] + RegDFL[2]) * strides[index];
-					ymax = (meshgrid[gridIndex + 1] + RegDFL[3]) * strides[index];
+					xmin = ((w + 0.5f) - RegDFL[0]) * strides[index];
+					ymin = ((h + 0.5f) - RegDFL[1]) * strides[index];
+					xmax = ((w + 0.5f) + RegDFL[2]) * strides[index];
+					ymax = ((h + 0.5f) + RegDFL[3]) * strides[index];
 
 					xmin = xmin > 0 ? xmin : 0;
 					ymin = ymin > 0 ? ymin : 0;
@@ -282,10 +267,12 @@ int GetConvDetectionResultInt8(int8_t **pBlob, std::vector<int> &qnt_zp,
 	return ret;
 }
 // 浮点数版本
-int GetConvDetectionResult(float **pBlob, std::vector<float> &DetectiontRects) {
-	static auto meshgrid = GenerateMeshgrid();
+int GetConvDetectionResult(float **pBlob, std::vector<float> &DetectiontRects, int input_w,
+                           int input_h) {
 	int ret = 0;
-	int gridIndex = -2;
+	int mapSize[3][2];
+	GetMapSize(input_w, input_h, mapSize);
+
 	float xmin = 0, ymin = 0, xmax = 0, ymax = 0;
 	float cls_val = 0;
 	float cls_max = 0;
@@ -306,8 +293,6 @@ int GetConvDetectionResult(float **pBlob, std::vector<float> &DetectiontRects) {
 
 		for (int h = 0; h < mapSize[index][0]; h++) {
 			for (int w = 0; w < mapSize[index][1]; w++) {
-				gridIndex += 2;
-
 				if (1 == class_num) {
 					cls_max = sigmoid(
 					    cls[0 * mapSize[index][0] * mapSize[index][1] + h * mapSize[index][1] + w]);
@@ -351,10 +336,10 @@ int GetConvDetectionResult(float **pBlob, std::vector<float> &DetectiontRects) {
 						RegDFL.push_back(locval);
 					}
 
-					xmin = (meshgrid[gridIndex + 0] - RegDFL[0]) * strides[index];
-					ymin = (meshgrid[gridIndex + 1] - RegDFL[1]) * strides[index];
-					xmax = (meshgrid[gridIndex + 0] + RegDFL[2]) * strides[index];
-					ymax = (meshgrid[gridIndex + 1] + RegDFL[3]) * strides[index];
+					xmin = ((w + 0.5f) - RegDFL[0]) * strides[index];
+					ymin = ((h + 0.5f) - RegDFL[1]) * strides[index];
+					xmax = ((w + 0.5f) + RegDFL[2]) * strides[index];
+					ymax = ((h + 0.5f) + RegDFL[3]) * strides[index];
 
 					xmin = xmin > 0 ? xmin : 0;
 					ymin = ymin > 0 ? ymin : 0;
@@ -6,8 +6,10 @@ int get_top(float *pfProb, float *pfMaxProb, uint32_t *pMaxClass, uint32_t outpu
             uint32_t topNum);
 
 namespace yolo {
-int GetConvDetectionResult(float **pBlob, std::vector<float> &DetectiontRects); // 浮点数版本
+// input_w/input_h为模型输入尺寸，输出坐标归一化到[0,1]
+int GetConvDetectionResult(float **pBlob, std::vector<float> &DetectiontRects, int input_w = 640,
+                           int input_h = 640); // 浮点数版本
 int GetConvDetectionResultInt8(int8_t **pBlob, std::vector<int> &qnt_zp,
-                               std::vector<float> &qnt_scale,
-                               std::vector<float> &DetectiontRects); // int8版本
+                               std::vector<float> &qnt_scale, std::vector<float> &DetectiontRects,
+                               int input_w = 640, int input_h = 640); // int8版本
 } // namespace yolo
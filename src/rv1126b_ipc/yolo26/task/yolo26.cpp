@@ -3,6 +3,11 @@
 #include "utils/logging.h"
 #include "process/preprocess.h"
 #include "process/postprocess.h"
+#include "engine/rknn_perf.hpp"
+
+extern "C" {
+#include "trace.h"
+}
 
 // define global classes
 static std::vector<std::string> g_classes = {"person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
@@ -46,6 +51,7 @@ Yolo26::~Yolo26()
 
 nn_error_e Yolo26::LoadModel(const char *model_path)
 {
+    engine_->SetCollectPerf(RKNNPerfProfiler::Instance().Enabled());
     auto ret = engine_->LoadModelFile(model_path);
     if (ret != NN_SUCCESS)
     {
@@ -131,13 +137,15 @@ nn_error_e Yolo26::Postprocess(const cv::Mat &img, std::vector<Detection> &objec
     if (want_float_)
     {
         // 使用浮点数版本的后处理，他也支持量化的模型
-        yolo::GetConvDetectionResult((float **)output_data, DetectiontRects);
+        yolo::GetConvDetectionResult((float **)output_data, DetectiontRects, InputWidth(),
+                                     InputHeight());
         // NN_LOG_INFO("use float version postprocess");
     }
     else
     {
         // 使用量化版本的后处理，只能处理量化的模型
-        yolo::GetConvDetectionResultInt8((int8_t **)output_data, out_zps_, out_scales_, DetectiontRects);
+        yolo::GetConvDetectionResultInt8((int8_t **)output_data, out_zps_, out_scales_, DetectiontRects,
+                                         InputWidth(), InputHeight());
         // NN_LOG_INFO("use int8 version postprocess");
     }
 
@@ -170,8 +178,10 @@ nn_error_e Yolo26::Postprocess(const cv::Mat &img, std::vector<Detection> &objec
 
     return NN_SUCCESS;
 }
-void letterbox_decode(std::vector<Detection> &objects, bool hor, int pad)
+// 去掉letterbox的填充，并把框限制在原图范围内
+void letterbox_decode(std::vector<Detection> &objects, bool hor, int pad, const cv::Size &img_size)
 {
+    cv::Rect img_rect(0, 0, img_size.width, img_size.height);
     for (auto &obj : objects)
     {
         if (hor)
@@ -182,39 +192,39 @@ void letterbox_decode(std::vector<Detection> &objects, bool hor, int pad)
         {
             obj.box.y -= pad;
         }
+        obj.box &= img_rect;
     }
 }
 
-std::vector<Detection> Yolo26::Run(const cv::Mat &img)
+std::vector<Detection> Yolo26::Run(const cv::Mat &img, int64_t pts)
 {
 
     // letterbox后的图像
     cv::Mat image_letterbox;
     std::vector<Detection> objects;
-    // std::chrono::steady_clock::time_point tt0 = std::chrono::steady_clock::now();
     Preprocess(img, image_letterbox);
-    // std::chrono::steady_clock::time_point tt1 = std::chrono::steady_clock::now();
+    // pts为0表示不跟踪这一帧
+    if (pts)
+        rk_trace_record(RK_TRACE_STREAM_NPU, RK_TRACE_NPU_PREPROCESS, pts);
     // 推理
     Inference();
-    // std::chrono::steady_clock::time_point tt2 = std::chrono::steady_clock::now();
-    // 后处理
+    if (pts)
+        rk_trace_record(RK_TRACE_STREAM_NPU, RK_TRACE_NPU_RUN, pts);
+    // 性能统计模式下按间隔采样逐层耗时
+    if (RKNNPerfProfiler::Instance().Due())
+    {
+        std::string perf_detail;
+        int64_t run_us = 0;
+        if (engine_->QueryPerf(perf_detail, run_us) == NN_SUCCESS)
+        {
+            RKNNPerfProfiler::Instance().Update(perf_detail.c_str(), run_us);
+        }
+    }
     // 后处理
     Postprocess(image_letterbox, objects);
-    letterbox_decode(objects, letterbox_info_.hor, letterbox_info_.pad);
-    // std::chrono::steady_clock::time_point tt3 = std::chrono::steady_clock::now();
-
-    // float tmpTime = (std::chrono::duration_cast<std::chrono::duration<double>>(tt1 - tt0)).count()*1000;
-    // float tmpTime2 = (std::chrono::duration_cast<std::chrono::duration<double>>(tt2 - tt1)).count()*1000;
-    // float tmpTime3 = (std::chrono::duration_cast<std::chrono::duration<double>>(tt3 - tt2)).count()*1000;
-    // float tmpTime4 = (std::chrono::duration_cast<std::chrono::duration<double>>(tt3 - tt0)).count()*1000;
-    // //Preprocess time ms
-    // printf("%.2f;", tmpTime);
-    // //Inference time ms
-    // printf("%.2f;", tmpTime2);
-    // //Postprocess time ms
-    // printf("%.2f;", tmpTime3);
-    // //Total time ms
-    // printf("%.2f\n", tmpTime4);
+    letterbox_decode(objects, letterbox_info_.hor, letterbox_info_.pad, img.size());
+    if (pts)
+        rk_trace_record(RK_TRACE_STREAM_NPU, RK_TRACE_NPU_POSTPROCESS, pts);
 
     return objects;
-}
\ No newline at end of file
+}
@@ -7,6 +7,8 @@
 #include "process/preprocess.h"
 #include "types/yolo_datatype.h"
 
+void letterbox_decode(std::vector<Detection> &objects, bool hor, int pad, const cv::Size &img_size);
+
 class Yolo26
 {
 public:
@@ -15,7 +17,12 @@ public:
 
     nn_error_e LoadModel(const char *model_path);
 
-    std::vector<Detection> Run(const cv::Mat &img);
+    // pts为采集时间戳，非0时按阶段记录到trace
+    std::vector<Detection> Run(const cv::Mat &img, int64_t pts = 0);
+
+    // 模型输入尺寸，NHWC
+    int InputWidth() const { return input_tensor_.attr.dims[2]; }
+    int InputHeight() const { return input_tensor_.attr.dims[1]; }
 
 private:
     nn_error_e Preprocess(const cv::Mat &img, cv::Mat &image_letterbox);
@@ -0,0 +1,165 @@
+#include "yolo26_ladder.h"
+
+#include <stdio.h>
+
+#include <chrono>
+#include <sstream>
+
+#include "utils/logging.h"
+
+static const float g_latency_ema_alpha = 0.2f; // 耗时滑动平均系数
+static const int g_temp_interval_ms = 1000;    // 温度读取间隔
+static const int g_probe_hold_times = 5;       // 上一级超预算后，隔hold_ms的多少倍再尝试升级
+
+static int64_t ladder_now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+Yolo26LadderPolicy &Yolo26LadderPolicy::Instance()
+{
+    static Yolo26LadderPolicy policy;
+    return policy;
+}
+
+void Yolo26LadderPolicy::Configure(int levels, const Yolo26LadderConfig &config)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    config_ = config;
+    levels_ = levels > 0 ? levels : 1;
+    level_ = 0;
+    latency_ema_.assign(levels_, -1.f);
+    last_switch_ms_ = ladder_now_ms();
+    last_active_ms_ = last_switch_ms_;
+    last_temp_ms_ = 0;
+    temp_ = 0;
+    idle_ = false;
+    NN_LOG_INFO("yolo26 ladder: %d levels, budget %d ms, temp %d/%d, hold %d ms, idle %d ms",
+                levels_, config_.latency_budget_ms, config_.temp_low, config_.temp_high,
+                config_.hold_ms, config_.idle_ms);
+}
+
+int Yolo26LadderPolicy::ReadTemperature(int64_t now)
+{
+    if (now - last_temp_ms_ < g_temp_interval_ms)
+        return temp_;
+    last_temp_ms_ = now;
+    FILE *fp = fopen(config_.thermal_path.c_str(), "r");
+    if (fp == nullptr)
+        return temp_;
+    int milli = 0;
+    if (fscanf(fp, "%d", &milli) == 1)
+        temp_ = milli / 1000;
+    fclose(fp);
+    return temp_;
+}
+
+int Yolo26LadderPolicy::Select()
+{
+    // levels_和latency_ema_由Configure在锁内更新
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (levels_ <= 1)
+        return 0;
+
+    int64_t now = ladder_now_ms();
+    int temp = ReadTemperature(now);
+    int cur = level_;
+    int target = cur;
+    float lat = latency_ema_[cur];
+    bool idle = config_.idle_ms > 0 && now - last_active_ms_ > config_.idle_ms;
+    const char *reason = "";
+
+    if (temp >= config_.temp_high || (lat >= 0 && lat > config_.latency_budget_ms))
+    {
+        // 降级不等待，尽快把延迟拉回预算内
+        target = cur + 1 < levels_ ? cur + 1 : cur;
+        reason = temp >= config_.temp_high ? "thermal" : "latency";
+    }
+    else if (idle)
+    {
+        target = levels_ - 1;
+        reason = "idle";
+    }
+    else if (cur > 0 && temp < config_.temp_low &&
+             (idle_ || now - last_switch_ms_ >= config_.hold_ms))
+    {
+        // 场景从静止变为活动时不等待hold_ms
+        // 上一级有数据时按其耗时判断，否则间隔一段时间试探一次
+        float up = latency_ema_[cur - 1];
+        if ((up >= 0 && up < config_.latency_budget_ms * 0.9f) || up < 0 ||
+            now - last_switch_ms_ >= (int64_t)config_.hold_ms * g_probe_hold_times)
+        {
+            target = cur - 1;
+            reason = "headroom";
+        }
+    }
+
+    idle_ = idle;
+    if (target != cur)
+    {
+        NN_LOG_INFO("yolo26 ladder: level %d -> %d (%s, latency %.1f ms, temp %d)", cur, target,
+                    reason, lat, temp);
+        // 新的一级重新统计耗时
+        latency_ema_[target] = -1.f;
+        last_switch_ms_ = now;
+        level_ = target;
+    }
+
+    return target;
+}
+
+void Yolo26LadderPolicy::Report(int level, int latency_ms, int objects)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (level < 0 || level >= levels_)
+        return;
+
+    float &ema = latency_ema_[level];
+    ema = ema < 0 ? latency_ms : ema + g_latency_ema_alpha * (latency_ms - ema);
+    if (objects > 0)
+        last_active_ms_ = ladder_now_ms();
+}
+
+nn_error_e Yolo26Ladder::LoadModel(const char *model_paths)
+{
+    std::stringstream ss(model_paths);
+    std::string path;
+    while (std::getline(ss, path, ','))
+    {
+        if (path.empty())
+            continue;
+        auto model = std::make_shared<Yolo26>();
+        nn_error_e ret = model->LoadModel(path.c_str());
+        if (ret != NN_SUCCESS)
+        {
+            NN_LOG_ERROR("yolo26 ladder load %s failed", path.c_str());
+            return ret;
+        }
+        NN_LOG_INFO("yolo26 ladder level %d: %s %dx%d", (int)models_.size(), path.c_str(),
+                    model->InputWidth(), model->InputHeight());
+        models_.push_back(model);
+    }
+    if (models_.empty())
+    {
+        NN_LOG_ERROR("yolo26 ladder: no model in \"%s\"", model_paths);
+        return NN_LOAD_MODEL_FAIL;
+    }
+
+    return NN_SUCCESS;
+}
+
+std::vector<Detection> Yolo26Ladder::Run(const Yolo26Frame &frame)
+{
+    int level = Yolo26LadderPolicy::Instance().Select();
+    if (level >= (int)models_.size())
+        level = models_.size() - 1;
+
+    int64_t start = ladder_now_ms();
+    // 框的坐标在Yolo26::Run中经letterbox_decode换算回原图，与所用的分辨率无关
+    std::vector<Detection> objects = models_[level]->Run(frame.img, frame.pts);
+    Yolo26LadderPolicy::Instance().Report(level, ladder_now_ms() - start, objects.size());
+
+    return objects;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "task/yolo26.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 分辨率阶梯的选择策略参数
+struct Yolo26LadderConfig
+{
+    int latency_budget_ms = 80;  // 单帧推理耗时预算，超过则降一级
+    int temp_high = 85;          // CPU温度(摄氏度)达到该值降一级
+    int temp_low = 75;           // CPU温度低于该值才允许升级
+    int hold_ms = 2000;          // 两次升级之间的最短间隔，降级不受限制
+    int idle_ms = 5000;          // 超过该时间无检测结果视为场景静止，使用最低一级
+    std::string thermal_path = "/sys/class/thermal/thermal_zone0/temp";
+};
+
+// 所有推理线程共享的选择策略，level 0为最高分辨率
+class Yolo26LadderPolicy
+{
+public:
+    static Yolo26LadderPolicy &Instance();
+
+    void Configure(int levels, const Yolo26LadderConfig &config);
+    // 为下一帧选择level
+    int Select();
+    // 回报一帧的推理耗时和检测数量
+    void Report(int level, int latency_ms, int objects);
+    int Level() const { return level_; }
+
+private:
+    Yolo26LadderPolicy() : levels_(1), level_(0) {}
+    int ReadTemperature(int64_t now);
+
+    Yolo26LadderConfig config_;
+    int levels_;
+    std::atomic<int> level_;
+
+    std::mutex mtx_;
+    std::vector<float> latency_ema_; // 每一级的耗时滑动平均，<0表示没有数据
+    int64_t last_switch_ms_ = 0;
+    int64_t last_active_ms_ = 0;
+    int64_t last_temp_ms_ = 0;
+    int temp_ = 0;
+    bool idle_ = false;
+};
+
+// 送入推理池的一帧，pts用于跨线程跟踪各阶段耗时
+struct Yolo26Frame
+{
+    cv::Mat img;
+    int64_t pts = 0;
+};
+
+// 同一模型的多个分辨率，按Yolo26LadderPolicy逐帧选择
+// 可以直接作为rknnPool的模型类型使用
+class Yolo26Ladder
+{
+public:
+    Yolo26Ladder() {}
+    ~Yolo26Ladder() {}
+
+    // model_paths为逗号分隔的模型列表，按分辨率从高到低排列
+    nn_error_e LoadModel(const char *model_paths);
+
+    std::vector<Detection> Run(const Yolo26Frame &frame);
+
+private:
+    std::vector<std::shared_ptr<Yolo26>> models_;
+};
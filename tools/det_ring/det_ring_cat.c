@@ -0,0 +1,88 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Prints the npu results rkipc publishes in the detection ring, one json record per line, with
+// the same fields as the analytics sei. Runs on the board next to rkipc and follows restarts.
+//
+//   $CC -O2 -o det_ring_cat -Icommon/det_ring tools/det_ring/det_ring_cat.c
+//       common/det_ring/det_ring_reader.c
+//   ./det_ring_cat [-p path] [-n results] [-l] [-i interval_ms]    -l only the latest result
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "det_ring.h"
+
+static void print_result(const rk_det_ring_slot_s *slot, uint64_t lost) {
+	printf("{\"index\":%" PRIu64 ",\"pts\":%" PRId64 ",\"utc_ms\":%" PRId64
+	       ",\"size\":[%u,%u],\"lost\":%" PRIu64 ",\"objects\":[",
+	       slot->index, slot->pts, slot->utc_ms, slot->width, slot->height, lost);
+	for (uint32_t i = 0; i < slot->count; i++) {
+		const rk_det_ring_object_s *object = &slot->object[i];
+		printf("%s{\"track\":%d,\"class\":%d,\"conf\":%.3f,\"box\":[%d,%d,%d,%d]}",
+		       i ? "," : "", object->track_id, object->class_id, object->confidence, object->x,
+		       object->y, object->w, object->h);
+	}
+	printf("]}\n");
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+	const char *path = RK_DET_RING_PATH;
+	int results = -1, latest = 0, interval_ms = 10, opt;
+	while ((opt = getopt(argc, argv, "p:n:li:")) != -1) {
+		switch (opt) {
+		case 'p':
+			path = optarg;
+			break;
+		case 'n':
+			results = atoi(optarg);
+			break;
+		case 'l':
+			latest = 1;
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p path] [-n results] [-l] [-i interval_ms]\n",
+			        argv[0]);
+			return 1;
+		}
+	}
+
+	rk_det_ring_reader_s reader;
+	rk_det_ring_slot_s slot;
+	if (rk_det_ring_open(&reader, path)) {
+		perror(path);
+		return 1;
+	}
+	while (results) {
+		int ret = latest ? rk_det_ring_read_latest(&reader, &slot)
+		                 : rk_det_ring_read(&reader, &slot);
+		if (ret > 0) {
+			print_result(&slot, reader.lost);
+			if (results > 0)
+				results--;
+			continue;
+		}
+		if (ret < 0) {
+			// rkipc replaced the file, with another slot_count for instance
+			rk_det_ring_close(&reader);
+			while (rk_det_ring_open(&reader, path))
+				sleep(1);
+			fprintf(stderr, "%s reopened\n", path);
+			continue;
+		}
+		// the reader library does not need this, it is the polling of a shell tool
+		usleep(interval_ms * 1000);
+	}
+	rk_det_ring_close(&reader);
+
+	return 0;
+}
@@ -0,0 +1,110 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Example consumer of common/frame_export: subscribes to a vi channel, maps each dma-buf,
+// prints the mean luma and returns the frame. Runs on the board next to rkipc.
+//
+//   $CC -O2 -o frame_export_client -Icommon/frame_export -Icommon/socket_server
+//       tools/frame_export/frame_export_client.c common/socket_server/socket.c
+//   ./frame_export_client [-p path] [-c chn] [-n frames] [-h hold]
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "frame_export.h"
+#include "socket.h"
+
+static int send_request(int fd, uint32_t cmd, int chn, uint32_t count, uint32_t seq) {
+	rk_frame_export_request_s req;
+	memset(&req, 0, sizeof(req));
+	req.magic = RK_FRAME_EXPORT_MAGIC;
+	req.cmd = cmd;
+	req.chn = chn;
+	req.count = count;
+	req.seq = seq;
+
+	return sock_write(fd, &req, sizeof(req)) == sizeof(req) ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+	const char *path = RK_FRAME_EXPORT_PATH;
+	int chn = 4, frames = 100, hold = 1, opt;
+	while ((opt = getopt(argc, argv, "p:c:n:h:")) != -1) {
+		switch (opt) {
+		case 'p':
+			path = optarg;
+			break;
+		case 'c':
+			chn = atoi(optarg);
+			break;
+		case 'n':
+			frames = atoi(optarg);
+			break;
+		case 'h':
+			hold = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p path] [-c chn] [-n frames] [-h hold]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror(path);
+		return 1;
+	}
+
+	rk_frame_export_frame_s frame;
+	int dma_fd;
+	if (send_request(fd, RK_FRAME_EXPORT_SUBSCRIBE, chn, hold, 0) ||
+	    sock_recv_fd(fd, &frame, sizeof(frame), &dma_fd) != sizeof(frame)) {
+		// rkipc closes the connection of a refused uid
+		fprintf(stderr, "subscribe failed, is this uid in frame_export:allow_uid?\n");
+		return 1;
+	}
+	if (frame.status) {
+		fprintf(stderr, "vi chn %d refused: %s\n", chn, strerror(-frame.status));
+		return 1;
+	}
+
+	for (int i = 0; i < frames; i++) {
+		if (sock_recv_fd(fd, &frame, sizeof(frame), &dma_fd) != sizeof(frame)) {
+			fprintf(stderr, "connection closed\n");
+			break;
+		}
+		if (dma_fd < 0)
+			continue;
+		unsigned long long sum = 0;
+		void *data = mmap(NULL, frame.size, PROT_READ, MAP_SHARED, dma_fd, 0);
+		if (data != MAP_FAILED) {
+			const unsigned char *y = (const unsigned char *)data;
+			for (uint32_t row = 0; row < frame.height; row++)
+				for (uint32_t col = 0; col < frame.width; col++)
+					sum += y[row * frame.hor_stride + col];
+			munmap(data, frame.size);
+		}
+		close(dma_fd);
+		// the buffer goes back to the vi queue, it must not be touched after this
+		send_request(fd, RK_FRAME_EXPORT_RETURN, chn, 0, frame.seq);
+		unsigned long long pixels = (unsigned long long)frame.width * frame.height;
+		printf("seq %u pts %lld %ux%u stride %u mean luma %llu dropped %u\n", frame.seq,
+		       (long long)frame.pts, frame.width, frame.height, frame.hor_stride,
+		       pixels ? sum / pixels : 0, frame.dropped);
+	}
+	close(fd);
+
+	return 0;
+}
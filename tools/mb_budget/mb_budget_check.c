@@ -0,0 +1,45 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Host side check of an rkipc ini against the media buffer budget, with the same planner
+// rk_video_init runs on the board. Exit status 0 when the configuration may start.
+//
+//   gcc -O2 -o mb_budget_check -Icommon -Icommon/param -Icommon/mb_budget
+//       tools/mb_budget/mb_budget_check.c common/mb_budget/mb_budget.c common/common.c
+//       common/param/param.c common/param/iniparser.c common/param/dictionary.c -lpthread
+//   ./mb_budget_check <ini> [total_kb]    total_kb overrides mb_budget:total_kb
+
+#include "common.h"
+#include "mb_budget.h"
+
+int enable_minilog = 0;
+int rkipc_log_level = LOG_LEVEL_WARN; // keep the downgrade steps, hide the ini dump
+
+int main(int argc, char *argv[]) {
+	rk_mb_budget_plan_s plan;
+	char dump[2048];
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <ini> [total_kb]\n", argv[0]);
+		return 2;
+	}
+	// rk_param_init would fall back to the factory ini of the board
+	if (access(argv[1], R_OK)) {
+		perror(argv[1]);
+		return 2;
+	}
+	if (rk_param_init(argv[1]))
+		return 2;
+	// not rk_mb_budget_get_limit, /proc/meminfo would be the one of the host
+	unsigned long long budget = rk_param_get_int("mb_budget:total_kb", 0) * 1024ULL;
+	if (argc > 2)
+		budget = strtoull(argv[2], NULL, 0) * 1024;
+
+	int ret = rk_mb_budget_plan(&plan, budget);
+	rk_mb_budget_dump(&plan, dump, sizeof(dump));
+	printf("%s", dump);
+	// rk_param_deinit would save the ini back in dump format, the input stays untouched
+	rk_param_close();
+
+	return ret ? 1 : 0;
+}
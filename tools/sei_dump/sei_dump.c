@@ -0,0 +1,110 @@
+// Copyright 2025 Rockchip Electronics Co., Ltd. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Host side dump of the analytics sei written by common/sei, one json record per line.
+// Works on raw h264/h265 streams and on mp4/flv recordings, where each nalu is stored in
+// one piece. Mpeg-ts splits nalus over 188 byte packets and is not supported.
+//
+//   gcc -O2 -o sei_dump tools/sei_dump/sei_dump.c
+//   ./sei_dump [-d] <file>    -d only prints the records carrying detections
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // memmem
+#endif
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SEI_UUID_LEN 16
+#define SEI_MAX_PAYLOAD 4096
+
+// must match rk_sei_uuid in common/sei/sei.c
+static const unsigned char g_uuid[SEI_UUID_LEN] = {0x72, 0x6b, 0x69, 0x70, 0x63, 0x2d,
+                                                   0x61, 0x6e, 0x61, 0x6c, 0x79, 0x74,
+                                                   0x69, 0x63, 0x73, 0x31};
+
+// the json object right after the uuid, it never holds a zero byte so no emulation
+// prevention byte can show up inside it. Return its length, 0 if it is not one
+static size_t sei_json_len(const unsigned char *data, size_t size) {
+	int depth = 0, in_string = 0;
+	if (!size || data[0] != '{')
+		return 0;
+	for (size_t i = 0; i < size && i < SEI_MAX_PAYLOAD; i++) {
+		unsigned char c = data[i];
+		if (c < 0x20 || c > 0x7e)
+			return 0;
+		if (in_string) {
+			if (c == '"')
+				in_string = 0;
+			continue;
+		}
+		if (c == '"')
+			in_string = 1;
+		else if (c == '{')
+			depth++;
+		else if (c == '}' && --depth == 0)
+			return i + 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	int only_det = 0;
+	const char *path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-d"))
+			only_det = 1;
+		else
+			path = argv[i];
+	}
+	if (!path) {
+		fprintf(stderr, "usage: %s [-d] <file>\n", argv[0]);
+		return 1;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < SEI_UUID_LEN) {
+		fprintf(stderr, "%s: empty or unreadable\n", path);
+		close(fd);
+		return 1;
+	}
+	size_t size = st.st_size;
+	const unsigned char *data =
+	    (const unsigned char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	unsigned long records = 0, detections = 0;
+	const unsigned char *p = data, *end = data + size;
+	while ((p = (const unsigned char *)memmem(p, end - p, g_uuid, SEI_UUID_LEN))) {
+		const unsigned char *json = p + SEI_UUID_LEN;
+		size_t len = sei_json_len(json, end - json);
+		p = json;
+		if (!len)
+			continue;
+		int det = memmem(json, len, "\"det\":", 6) != NULL;
+		records++;
+		detections += det;
+		if (!only_det || det)
+			printf("%.*s\n", (int)len, json);
+		p = json + len;
+	}
+	fprintf(stderr, "%lu sei records, %lu with detections\n", records, detections);
+	munmap((void *)data, size);
+
+	return 0;
+}